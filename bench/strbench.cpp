@@ -0,0 +1,225 @@
+/**@file strbench.cpp --- micro benchmark for case-insensitive string functions in strfunc.cpp.
+ * ȑO̎(_mbsicmp, strchr  _mbsnicmp ɂ stristr)ƁA݂̎̌ʂƍAxׂ.
+ * @author Hiroshi Kuno <http://code.google.com/p/win32cmdx/>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <locale.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "mydef.h"
+using namespace std;
+
+#include "mylib/sysfunc.cpp"
+#include "mylib/errfunc.cpp"
+#include "mylib/strfunc.cpp"
+
+const char* gUsage = "usage :strbench [-n<COUNT>]\n";
+
+//------------------------------------------------------------------------
+//!@name ȑO̎.
+//@{
+inline bool old_striequ(const char* s1, const char* s2)
+{
+	return _mbsicmp((const uchar*)s1, (const uchar*)s2) == 0;
+}
+
+inline bool old_striless(const char* s1, const char* s2)
+{
+	return _mbsicmp((const uchar*)s1, (const uchar*)s2) < 0;
+}
+
+inline char* old_stristr(const char* s1, const char* s2)
+{
+	int up = toupper((uchar) s2[0]);
+	int lo = tolower((uchar) s2[0]);
+	int len = strlen(s2);
+	while (*s1) {
+		const char* upper = strchr(s1, up);
+		const char* lower = strchr(s1, lo);
+		s1 = (!lower || (upper && upper < lower)) ? upper : lower;
+		if (!s1)
+			return NULL;
+		if (strniequ(s1, s2, len))
+			return (char*)s1;
+		++s1;
+	}
+	return NULL;
+}
+
+/** ̐擪ʒuƂɔrfpȌ. }`oCg܂ޏꍇ̏ƍp. */
+inline char* naive_stristr(const char* s1, const char* s2)
+{
+	size_t len = strlen(s2);
+	for (;; s1 = mbs_next(s1)) {
+		if (_mbsnbicmp((const uchar*) s1, (const uchar*) s2, len) == 0)
+			return (char*) s1;
+		if (!*s1)
+			return NULL;
+	}
+}
+//@}
+
+//------------------------------------------------------------------------
+/** oߎԂ̌v. */
+class Stopwatch {
+	clock_t mStart;
+public:
+	Stopwatch() : mStart(clock()) {}
+	double Sec() const {
+		return (double) (clock() - mStart) / CLOCKS_PER_SEC;
+	}
+};
+
+/** t@C炵. */
+string RandomName(bool mbcs)
+{
+	static const char* const words[] = {
+		"Readme", "SETUP", "zipdump", "Makefile", "src", "Release", "debug", "main", "Test", "LOG",
+	};
+	static const char* const exts[] = { ".txt", ".CPP", ".h", ".zip", ".Log", "" };
+	string s = words[rand() % 10];
+	s += (char) ('0' + rand() % 10);
+	if (mbcs && rand() % 4 == 0)
+		s += "\xc3\x84nderung";	// UTF-8  A EEg. CP932 ł2̔pJiɂȂ.
+	s += words[rand() % 10];
+	s += exts[rand() % 6];
+	return s;
+}
+
+int gErrors = 0;
+
+void Check(bool ok, const char* what, const string& s1, const string& s2)
+{
+	if (!ok && gErrors++ < 10)
+		printf("!! %s mismatch: \"%s\" \"%s\"\n", what, s1.c_str(), s2.c_str());
+}
+
+int Sign(int x)
+{
+	return x < 0 ? -1 : x > 0 ? 1 : 0;
+}
+
+//------------------------------------------------------------------------
+/** ZOm̔r. */
+void BenchCompare(const vector<string>& names, int count)
+{
+	size_t n = names.size();
+	for (size_t i = 0; i + 1 < n; ++i) {
+		const char* a = names[i].c_str();
+		const char* b = names[(i * 7 + 1) % n].c_str();
+		Check(Sign(stricmp_fast(a, b)) == Sign(_mbsicmp((const uchar*) a, (const uchar*) b)), "stricmp", a, b);
+	}
+
+	int hits = 0;
+	Stopwatch t1;
+	for (int k = 0; k < count; ++k)
+		for (size_t i = 0; i + 1 < n; ++i)
+			hits += old_striequ(names[i].c_str(), names[i+1].c_str()) + old_striless(names[i].c_str(), names[i+1].c_str());
+	double old_sec = t1.Sec();
+	Stopwatch t2;
+	for (int k = 0; k < count; ++k)
+		for (size_t i = 0; i + 1 < n; ++i)
+			hits -= striequ(names[i].c_str(), names[i+1].c_str()) + striless(names[i].c_str(), names[i+1].c_str());
+	double new_sec = t2.Sec();
+	Check(hits == 0, "striequ/striless", "", "");
+	printf("%-24s old %8.3fs  new %8.3fs  x%.1f\n", "striequ+striless", old_sec, new_sec, old_sec / (new_sec > 0 ? new_sec : 1e-9));
+}
+
+/** ̌. */
+void BenchSearch(const char* title, const string& hay, const char* needle, int count, bool compare_old)
+{
+	const char* expect = naive_stristr(hay.c_str(), needle);
+	Check(stristr(hay.c_str(), needle) == expect, "stristr", title, needle);
+
+	Stopwatch t1;
+	size_t sum = 0;
+	if (compare_old) {
+		for (int k = 0; k < count; ++k)
+			sum += (size_t) old_stristr(hay.c_str(), needle);
+	}
+	double old_sec = t1.Sec();
+	Stopwatch t2;
+	for (int k = 0; k < count; ++k)
+		sum -= (size_t) stristr(hay.c_str(), needle);
+	double new_sec = t2.Sec();
+	if (compare_old)
+		printf("%-24s old %8.3fs  new %8.3fs  x%.1f\n", title, old_sec, new_sec, old_sec / (new_sec > 0 ? new_sec : 1e-9));
+	else
+		printf("%-24s                 new %8.3fs\n", title, new_sec);
+}
+
+//------------------------------------------------------------------------
+/** C֐ */
+int main(int argc, char* argv[])
+{
+	setlocale(LC_ALL, "");
+	int count = 100;
+	if (argc > 1 && strncmp(argv[1], "-n", 2) == 0)
+		count = atoi(argv[1] + 2);
+	if (count <= 0)
+		error_abort("bad COUNT\n");
+
+	srand(1);
+	vector<string> names;
+	for (int i = 0; i < 20000; ++i)
+		names.push_back(RandomName(false));
+	BenchCompare(names, count);
+
+	vector<string> mixed;
+	for (int i = 0; i < 20000; ++i)
+		mixed.push_back(RandomName(true));
+	for (size_t i = 0; i + 1 < mixed.size(); ++i) {
+		const char* a = mixed[i].c_str();
+		const char* b = mixed[i+1].c_str();
+		Check(Sign(stricmp_fast(a, b)) == Sign(_mbsicmp((const uchar*) a, (const uchar*) b)), "stricmp(mbcs)", a, b);
+	}
+
+	// peLXg̒̌.
+	string text;
+	while (text.size() < 0x10000)
+		text += names[rand() % names.size()] + " ";
+	text += "Zipdump.Manifest";
+	BenchSearch("text: rare word", text, "zipdump.manifest", count, true);
+	BenchSearch("text: missing word", text, "qqqq", count, true);
+
+	// 擪poňP[X. ȑO͈̎ʒu strchr 2ŝ2掞ԂɂȂ.
+	string same(0x4000, 'a');
+	same += "ab";
+	BenchSearch("worst: aaa..ab", same, "AAAAAAAAAAB", count / 10 + 1, true);
+
+	// }`oCg܂ތ.
+	string mb;
+	while (mb.size() < 0x10000)
+		mb += mixed[rand() % mixed.size()] + " ";
+	mb += "\xc3\x84NDERUNGx";
+	BenchSearch("mbcs: ascii needle", mb, "nderungx", count, false);
+	BenchSearch("mbcs: mbcs needle", mb, "\xc3\x84nderungX", count, false);
+
+	// ZO̒̌. renamex ̓T^.
+	Stopwatch t1;
+	size_t found = 0;
+	for (int k = 0; k < count; ++k)
+		for (size_t i = 0; i < names.size(); ++i)
+			found += old_stristr(names[i].c_str(), "setup") != NULL;
+	double old_sec = t1.Sec();
+	Stopwatch t2;
+	for (int k = 0; k < count; ++k)
+		for (size_t i = 0; i < names.size(); ++i)
+			found -= stristr(names[i].c_str(), "setup") != NULL;
+	double new_sec = t2.Sec();
+	Check(found == 0, "stristr(names)", "", "setup");
+	printf("%-24s old %8.3fs  new %8.3fs  x%.1f\n", "names: stristr", old_sec, new_sec, old_sec / (new_sec > 0 ? new_sec : 1e-9));
+
+	if (gErrors) {
+		printf("%d mismatches\n", gErrors);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+// strbench.cpp - end.
@@ -1,16 +1,20 @@
 /**@file dirdiff.cpp -- compare and diff folder.
  * @author Hiroshi Kuno <http://code.google.com/p/win32cmdx/>
  */
+#ifdef _WIN32
 #include <windows.h>
+#include <mbstring.h>
+#include <io.h>
+#include <fcntl.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
-#include <mbstring.h>
 #include <time.h>
-#include <io.h>
-#include <process.h>
+#include <locale.h>
 
+#include <algorithm>
 #include <map>
 #include <vector>
 #include <string>
@@ -21,9 +25,20 @@ using namespace std;
 //------------------------------------------------------------------------
 // ėp֐Q - inline֐̂ŁARpCincludeŎ荞.
 //........................................................................
-#include "mylib\errfunc.cpp"
-#include "mylib\strfunc.cpp"
-#include "mylib\dirfunc.cpp"
+#include "mylib/sysfunc.cpp"
+#include "mylib/errfunc.cpp"
+#include "mylib/strfunc.cpp"
+#include "mylib/dirfunc.cpp"
+#include "mylib/memfunc.cpp"
+#include "mylib/filefunc.cpp"
+#include "mylib/thrfunc.cpp"
+#include "mylib/diagfunc.cpp"
+#include "mylib/walkfunc.cpp"
+#include "mylib/hashfunc.cpp"
+#include "mylib/cachefunc.cpp"
+#include "mylib/snapfunc.cpp"
+#include "mylib/zipfunc.cpp"
+#include "mylib/difffunc.cpp"
 
 //------------------------------------------------------------------------
 // ^A萔AO[oϐ̒`
@@ -43,9 +58,36 @@ bool gIgnoreRightOnlyFile = false;
 /** -l: ignore left only file */
 bool gIgnoreLeftOnlyFile = false;
 
-/** -d: diff for file */
+/** -R: compare sub folders recursively */
+bool gRecursive = false;
+
+/** -D: show line differences of changed files(implies -d) */
+bool gShowDiff = false;
+
+/** -m: detect moved or renamed files by contents */
+bool gDetectMoves = false;
+
+/** -d: compare contents of files on both sides */
 bool gDiff = false;
 
+/** -j<N>: number of worker threads for -R and -d. 0 is number of CPUs */
+int gThreads = 0;
+
+/** --cache FILE: digest cache file for -d */
+const char* gCacheFile = NULL;
+
+/** --cache-verify: re-read cached files and correct stale digests */
+bool gCacheVerify = false;
+
+/** --cache-rebuild: discard the digest cache and rebuild it */
+bool gCacheRebuild = false;
+
+/** --times: report time spent in each phase */
+bool gShowTimes = false;
+
+/** --snapshot DIR: write snapshot of DIR to stdout */
+const char* gSnapshotDir = NULL;
+
 /** -t,-T: time format */
 const char* gTmFmt = ISO8601FMT;
 //@}
@@ -54,7 +96,9 @@ const char* gTmFmt = ISO8601FMT;
 //!@name messages
 //@{
 /** short help-message */
-const char* gUsage  = "usage :dirdiff [-h?srlutTd] DIR1 [DIR2] [WILD]\n";
+const char* gUsage  =
+	"usage :dirdiff [-h?srlutTdDRm] [-j<N>] [--cache FILE [--cache-verify|--cache-rebuild]] [--times] DIR1 [DIR2] [WILD]\n"
+	"       dirdiff [-d] [-j<N>] [--cache FILE] --snapshot DIR >SNAPSHOT\n";
 
 /** detail help-message for options and version */
 const char* gUsage2 =
@@ -66,73 +110,338 @@ const char* gUsage2 =
 	"  -u     ignore unique file(same as -r -l)\n"
 	"  -t     use locale time format\n"
 	"  -T     use ISO 8601 time format(default)\n"
-	"  -d     diff for file\n"
-	"  DIR1   compare folder\n"
-	"  DIR2   compare folder(default is current-folder)\n"
+	"  -R     compare sub folders recursively\n"
+	"  -d     compare contents of files on both sides\n"
+	"  -D     show line differences of changed text files, ignoring white space and blank lines(implies -d)\n"
+	"  -m     detect moved or renamed files by contents\n"
+	"  -j<N>  number of worker threads for -R and -d(default: number of CPUs)\n"
+	"  --cache FILE     keep content digests for -d in FILE, and skip reading unchanged files\n"
+	"  --cache-verify   re-read cached files and correct stale digests\n"
+	"  --cache-rebuild  discard FILE and rebuild it\n"
+	"  --times          report time spent in each phase\n"
+	"  --snapshot DIR   write a snapshot of DIR tree to stdout(with -d: and content digests)\n"
+	"  DIR1   compare folder, snapshot or .zip\n"
+	"  DIR2   compare folder, snapshot or .zip(default is current-folder)\n"
 	"  WILD   file match pattern(default is '*')\n"
 	;
 //@}
 
 //------------------------------------------------------------------------
+/** FileTable::size ŁAtH_V{bNNł邱Ƃ\l. */
+const uint64 FOLDER_LINK = 1;
+
+/** rɎgt@C̕\. ږɕʁX̔zɎ(structure of arrays)Ai Ԗڂ̃t@C̏͊ez i ԖڂƂ.
+ * ˂킹ł̓L[ɓǂނ̂ŁAt@C̍\̂̔zLbVɍڂʂȂ.
+ * O FileList ̕\Ɋi[Aɂ̓nh.
+ * XibvVbg̑ł́Aet@C̃XibvVbgł̍ڂ̔ԍ.
+ */
+class FileTable {
+	const StringPool& mNames;
+public:
+	vector<StringPool::Handle> name;	///< t@C.
+	vector<StringPool::Handle> key;		///< בւ̃L[. filename_key() ōO. FileList::Sort() ō.
+	vector<time_t> time_write;			///< XV.
+	vector<uint64> size;				///< TCY. tH_̈ꗗł́AV{bNNȂ FOLDER_LINK.
+	vector<uint64> ref;					///< XibvVbg̍ڂ̔ԍ. tH_̑ł͋.
+
+	explicit FileTable(const StringPool& names)
+		: mNames(names) {}
+
+	/** t@C. */
+	size_t Count() const {
+		return name.size();
+	}
+
+	/** t@C. */
+	const char* Name(size_t i) const {
+		return mNames.Str(name[i]);
+	}
+
+	/** בւ̃L[. */
+	const char* Key(size_t i) const {
+		return mNames.Str(key[i]);
+	}
+
+	/** t@C. */
+	void Add(StringPool::Handle n, time_t t, uint64 sz) {
+		name.push_back(n);
+		time_write.push_back(t);
+		size.push_back(sz);
+	}
+
+	/** XibvVbg̍ڂ. */
+	void Add(StringPool::Handle n, time_t t, uint64 sz, uint64 r) {
+		Add(n, t, sz);
+		ref.push_back(r);
+	}
+
+	/** בւ.  order[i] Ԗڂ i ԖڂƂAorder ɖ͎̂̂Ă. */
+	void Permute(const vector<size_t>& order) {
+		Permute(name, order);
+		Permute(key, order);
+		Permute(time_write, order);
+		Permute(size, order);
+		if (!ref.empty())
+			Permute(ref, order);
+	}
+
+private:
+	template<class T>
+	static void Permute(vector<T>& v, const vector<size_t>& order) {
+		vector<T> tmp(order.size());
+		for (size_t i = 0; i < order.size(); ++i)
+			tmp[i] = v[order[i]];
+		v.swap(tmp);
+	}
+};
+
+/** tH_̃t@Cꗗ. */
+class FileList : public WalkVisitor {
+	Mutex mMutex;
+public:
+	StringPool names;
+	FileTable files;
+	FileTable folders;	///< -R: TutH_.
+
+	FileList()
+		: files(names), folders(names) {}
+
+	/** TŌt@Cꗗɉ. */
+	virtual void File(const char* dir, const _finddata_t& find) {
+		Lock lock(mMutex);
+		// ̃tH_̒ɓ̃t@Ĉ͖ŁAd𒲂ׂȂ.
+		files.Add(names.Add(find.name, strlen(find.name)), find.time_write, (uint64) find.size);
+	}
+
+	/** -R: TutH_ꗗɉ. ͒TȂ. */
+	virtual bool Folder(const char* dir, const _finddata_t& find) {
+		Lock lock(mMutex);
+		folders.Add(names.Add(find.name, strlen(find.name)), find.time_write, (find.attrib & _A_LINK) ? FOLDER_LINK : 0);
+		return false;
+	}
+
+	/** t@CƃTutH_Afilename_key() ̖Oɕבւ.
+	 * Windows ł͑啶𖳎A啶قȂ閼O͓t@CƂ݂Ȃ.
+	 * L[̓Oׂ΁AŌɌ̂c. POSIX łzip̏dOY.
+	 */
+	void Sort() {
+		Sort(files);
+		Sort(folders);
+	}
+
+private:
+	struct KeyLess {
+		const FileTable& table;
+		explicit KeyLess(const FileTable& t) : table(t) {}
+		bool operator()(size_t a, size_t b) const {
+			return strcmp(table.Key(a), table.Key(b)) < 0;
+		}
+	};
+
+	void Sort(FileTable& t) {
+		// L[. OƓL[́Â܂܋L.
+		size_t n = t.Count();
+		string key;
+		t.key.resize(n);
+		for (size_t i = 0; i < n; ++i) {
+			filename_key(t.Name(i), key);
+			t.key[i] = (key == t.Name(i)) ? t.name[i] : names.Add(key.data(), key.size());
+		}
+
+		// XibvVbĝ悤ɊɃL[̏ŏd΁AגȂ.
+		size_t sorted = 1;
+		while (sorted < n && strcmp(t.Key(sorted - 1), t.Key(sorted)) < 0)
+			++sorted;
+		if (sorted >= n)
+			return;
+
+		// YבւAŌɊezxג.
+		vector<size_t> order(n);
+		for (size_t i = 0; i < n; ++i)
+			order[i] = i;
+		stable_sort(order.begin(), order.end(), KeyLess(t));
+
+		// L[ł΁AŌ̂̂c.
+		size_t m = 0;
+		for (size_t i = 0; i < n; ++i) {
+			if (i + 1 < n && strcmp(t.Key(order[i]), t.Key(order[i+1])) == 0)
+				continue;
+			order[m++] = order[i];
+		}
+		order.resize(m);
+		t.Permute(order);
+	}
+};
+
 /** t@Cꗗ쐬 */
-void MakeFileList(vector<_finddata_t>& vec, const char* dir, const char* wild)
+void MakeFileList(FileList& list, const char* dir, const char* wild)
+{
+	WalkOptions opt;	// tH_͎WΏۂ珜OATutH_͒TȂ.
+	opt.recursive = gRecursive;	// -R: TutH_ Folder() ŏW߂邪A͍ȆgɕʂɈꗗ.
+	opt.threads = 1;
+	DirWalker(list, opt).Walk(dir, wild);
+}
+
+/** XibvVbg̃tH_̈ꗗ쐬. ڂ̓L[̏ɕł̂ŁA͈͂ɓǂނł悢. */
+void MakeSnapshotList(FileList& list, const Snapshot& snap, uint64 folder, const char* wild)
 {
-	FindFile find;
-	for (find.Open(dir, wild); find; find.Next()) {
-		// tH_͎WΏۂ珜O.
-		if (find.IsFolder())
+	uint64 first, count;
+	if (!snap.Folder(folder, first, count)) {
+		gDiag.Report(DIAG_ERROR, "broken snapshot", "broken snapshot: folder #%llu", folder);
+		return;
+	}
+	for (uint64 i = first; i < first + count; ++i) {
+		const SnapshotEntry& e = snap.Entry(i);
+		const char* name = snap.Name(e);
+		if (!name || !snap.IsValidFolder(e)) {
+			gDiag.Report(DIAG_ERROR, "broken snapshot", "broken snapshot: entry #%llu", i);
 			continue;
+		}
+		StringPool::Handle h;
+		if (e.flags & SNAP_FOLDER) {
+			if (!gRecursive)
+				continue;
+			h = list.names.Add(name, strlen(name));
+			list.folders.Add(h, (time_t) e.time_write, 0, i);
+		}
+		else if (match_wildcard(wild, name)) {
+			h = list.names.Add(name, strlen(name));
+			list.files.Add(h, (time_t) e.time_write, e.size, i);
+		}
+	}
+}
 
-		// vector ̐L.
-		if (vec.capacity() == vec.size())
-			vec.reserve(vec.size() + 1024);
+/** CRC-32 AXibvVbg̃_CWFXǧ` digest ɒu. */
+void crc32_digest(uint32 crc, uchar* digest)
+{
+	memset(digest, 0, sizeof(((SnapshotEntry*) 0)->digest));
+	for (int i = 0; i < 4; ++i)
+		digest[i] = (uchar) (crc >> (i * 8));
+}
 
-		// vectorɌt@Co^.
-		vec.push_back(find);
+/** ZIPt@C̒fBNgǂŁAXibvVbgƂĊJ. e͓WJȂ.
+ * GgpX؂ '/' ŕătH_؂Aet@C̃TCYAXVACRC-32 L^.
+ * r̃tH_̃GgΕ₢A͍̎ŏɌ̃Gg̎Ƃ.
+ * @retval false	JȂA܂ ZIP t@Cł͂Ȃ. JȂ err ɃG[R[hԂAZIP łȂ err 0Ƃ.
+ */
+bool OpenZip(const char* path, Snapshot& snap, long& err)
+{
+	err = 0;
+	FILE* fin = fopen(path, "rb");
+	if (!fin) {
+		err = last_syserror();
+		return false;
+	}
+	CentralDirReader reader;
+	if (!reader.Open(fin)) {
+		fclose(fin);
+		return false;
 	}
+	SnapshotBuilder b;
+	map<string, size_t> folders;	// tH_̃Gg("a/b/")A̔ԍ.
+	CentralDirEntry e;
+	uint64 count = 0;
+	while (reader.Next(e)) {
+		++count;
+		time_t t = (time_t) filetime_to_unixtime(EntryModTime(e));
+		size_t parent = 0;
+		size_t pos = 0;
+		for (size_t slash; (slash = e.name.find('/', pos)) != string::npos; pos = slash + 1) {
+			if (slash == pos)
+				continue;	// ̖O͖.
+			string dir(e.name, 0, slash + 1);
+			map<string, size_t>::iterator it = folders.find(dir);
+			if (it == folders.end())
+				it = folders.insert(make_pair(dir, b.AddFolder(parent, string(e.name, pos, slash - pos).c_str(), t))).first;
+			parent = it->second;
+		}
+		if (pos == e.name.size())
+			continue;	// tH_̃Gg.
+		size_t item = b.AddFile(parent, e.name.c_str() + pos, t, e.uncompressed_size);
+		crc32_digest(e.crc, b.Digest(item));
+	}
+	fclose(fin);
+	if (count != reader.Info().entries)
+		gDiag.Report(DIAG_WARNING, "broken zip", "broken zip central directory: %s: read %llu of %llu entries", path, count, reader.Info().entries);
+	vector<uchar> image;
+	b.Build(image, SNAP_DIGEST_CRC32);
+	return snap.Load(image);
 }
 
-/** ݂tH_ł邱Ƃۏ؂. 肪ΏI. */
-void ValidateFolder(const char* dir)
+/** r鑤𒲂ׂ. snap ΁AtH_łȂ̂̓XibvVbg ZIP t@CƂĊJ. 肪Ε񍐂 false Ԃ. */
+bool ValidateSide(const char* dir, Snapshot* snap)
 {
+#ifdef _WIN32
 	DWORD attr = ::GetFileAttributes(dir);
 	if (attr == -1) {
-		print_win32error(dir);
-		error_abort();
+		gDiag.SysError("can't access folder", dir);
+		return false;
 	}
-	if ((attr & FILE_ATTRIBUTE_DIRECTORY) == 0) {
-		error_abort("not a folder", dir);
+	if (attr & FILE_ATTRIBUTE_DIRECTORY)
+		return true;
+#else
+	struct stat st;
+	if (stat(dir, &st) != 0) {
+		gDiag.SysError("can't access folder", dir);
+		return false;
 	}
+	if (S_ISDIR(st.st_mode))
+		return true;
+#endif
+	if (!snap) {
+		gDiag.Report(DIAG_ERROR, "not a folder", "not a folder: %s", dir);
+		return false;
+	}
+	long err;
+	if (!snap->Open(dir, err) && (err || !OpenZip(dir, *snap, err))) {
+		if (err)
+			gDiag.SysError("can't read", dir, err);
+		else
+			gDiag.Report(DIAG_ERROR, "not a folder", "not a folder, snapshot or zip: %s", dir);
+		return false;
+	}
+	return true;
 }
 
 //------------------------------------------------------------------------
-/** Ẽt@C */
+/** Entry ŁȂɃt@CƂ\Y. */
+const size_t NO_FILE = (size_t) -1;
+
+/** Ẽt@C. FileTable ̓Yŕ\. */
 class Entry {
 public:
 	Entry()
-		: Left(NULL), Right(NULL) { }
-	const _finddata_t* Left;
-	const _finddata_t* Right;
+		: Left(NO_FILE), Right(NO_FILE) { }
+	size_t Left;
+	size_t Right;
 
-	int print(FILE* fp) const;
+	bool HasLeft() const  { return Left  != NO_FILE; }
+	bool HasRight() const { return Right != NO_FILE; }
+
+	int print(FILE* fp, const FileTable& list1, const FileTable& list2, const char* rel = "", bool folder = false) const;
 };
 
 /** \.
  * @param fp	o͐
+ * @param list1	Left ̃t@Cꗗ
+ * @param list2	Right ̃t@Cꗗ
+ * @param rel	ȎOɕt鑊΃tH_
+ * @param folder	tH_Ȃ΁AǑɃpX؂t
  * @retval -1	ignored
  * @retval 0	left only / right only
  * @retval =	same
  * @retval <	right is newer
  * @retval >	left is newer
  */
-int Entry::print(FILE* fp) const
+int Entry::print(FILE* fp, const FileTable& list1, const FileTable& list2, const char* rel, bool folder) const
 {
-	time_t l = Left  ? Left->time_write  : 0;
-	time_t r = Right ? Right->time_write : 0;
+	const char* sep = folder ? MY_PATH_SEP_STR : "";
+	time_t l = HasLeft()  ? list1.time_write[Left]  : 0;
+	time_t r = HasRight() ? list2.time_write[Right] : 0;
 	char lbuf[100];
 	char rbuf[100];
 	int mark = 0;
-	if (Left && Right) {
+	if (HasLeft() && HasRight()) {
 		if (l == r) {
 			if (gIgnoreSameFileDate) return -1;
 			mark = '=';
@@ -143,59 +452,767 @@ int Entry::print(FILE* fp) const
 			mark = '>';
 		strftime(lbuf, sizeof(lbuf), gTmFmt, localtime(&l));
 		strftime(rbuf, sizeof(rbuf), gTmFmt, localtime(&r));
-		fprintf(fp, "[ %s ] %c [ %s ] %s\n", lbuf, mark, rbuf, Left->name);
+		fprintf(fp, "[ %s ] %c [ %s ] %s%s%s\n", lbuf, mark, rbuf, rel, list1.Name(Left), sep);
 		return mark;
 	}
-	else if (Left) {
+	else if (HasLeft()) {
 		if (gIgnoreLeftOnlyFile) return -1;
 		size_t n = strftime(lbuf, sizeof(lbuf), gTmFmt, localtime(&l));
-		fprintf(fp, "[ %s ]     %*s   %s\n", lbuf, n, "", Left->name);
+		fprintf(fp, "[ %s ]     %*s   %s%s%s\n", lbuf, (int) n, "", rel, list1.Name(Left), sep);
 	}
-	else if (Right) {
+	else if (HasRight()) {
 		if (gIgnoreRightOnlyFile) return -1;
 		size_t n = strftime(rbuf, sizeof(rbuf), gTmFmt, localtime(&r));
-		fprintf(fp, "  %*s     [ %s ] %s\n", n, "", rbuf, Right->name);
+		fprintf(fp, "  %*s     [ %s ] %s%s%s\n", (int) n, "", rbuf, rel, list2.Name(Right), sep);
 	}
 	return mark;
 }
 
+/** Sort() ς݂̓̈ꗗAL[̏ɓ˂킹.
+ * @param v1	Left ̈ꗗ files  folders.
+ * @param v2	Right ̈ꗗ files  folders.
+ * @param out	˂킹. L[̏ɕ.
+ */
+void MergeFileLists(const FileTable& v1, const FileTable& v2, vector<Entry>& out)
+{
+	size_t n1 = v1.Count();
+	size_t n2 = v2.Count();
+	out.clear();
+	out.reserve(n1 > n2 ? n1 : n2);
+	size_t i = 0, j = 0;
+	while (i < n1 || j < n2) {
+		Entry e;
+		int cmp = (i == n1) ? 1 : (j == n2) ? -1 : strcmp(v1.Key(i), v2.Key(j));
+		if (cmp <= 0)
+			e.Left = i++;
+		if (cmp >= 0)
+			e.Right = j++;
+		out.push_back(e);
+	}
+}
+
 //------------------------------------------------------------------------
-/** tH_rs */
-void Compare(const char* dir1, const char* dir2, const char* wild)
+/** eř. */
+enum {
+	CMP_PENDING = -2,	///< .
+	CMP_ERROR = -1,		///< ǂ߂Ȃ.
+	CMP_SAME = 0,
+	CMP_DIFFER = 1
+};
+
+/** --times: iK̏v. e[J[XbhŔ₵Ԃv. Pʂ͕b. */
+class PhaseTimes {
+	Mutex mMutex;
+public:
+	enum Phase {
+		LIST1, LIST2,	///< Ëꗗ쐬.
+		SORT1, SORT2,	///< E̕בւ.
+		COMPARE,		///< -d: er.
+		WAIT,			///< Xbhꗗ쐬҂.
+		PHASES
+	};
+	double sum[PHASES];
+
+	PhaseTimes() {
+		for (int i = 0; i < PHASES; ++i)
+			sum[i] = 0;
+	}
+
+	/** vԂ. XbhĂł悢. */
+	void Add(Phase phase, double sec) {
+		Lock lock(mMutex);
+		sum[phase] += sec;
+	}
+} gTimes;
+
+/** --cache: t@Cẽ_CWFXg̉iLbV. */
+DigestCache gCache;
+
+/** t@Cẽ_CWFXg𓾂. --cache Ȃ΃LbVg.
+ * @retval false	ǂ߂Ȃ. err ɃG[R[hԂ.
+ */
+bool file_digest(const char* path, uchar* digest, long& err)
+{
+	if (!gCache.IsOpen())
+		return DigestCache::Compute(path, digest, err);
+	bool stale;
+	if (!gCache.Digest(path, digest, gCacheVerify, stale, err))
+		return false;
+	if (stale)
+		gDiag.Report(DIAG_WARNING, "stale digest cache entry", "stale digest cache entry: %s", path);
+	return true;
+}
+
+/** t@C̓eALbV瓾_CWFXgŔr. ߂l compare_files() Ɠ. */
+int compare_digests(const char* path1, const char* path2, long& err)
+{
+	uchar digest1[DigestCache::DIGEST_SIZE];
+	uchar digest2[DigestCache::DIGEST_SIZE];
+	if (!file_digest(path1, digest1, err) || !file_digest(path2, digest2, err))
+		return -1;
+	return memcmp(digest1, digest2, sizeof(digest1)) != 0;
+}
+
+/** t@Ce CRC-32 AXibvVbg̃_CWFXǧ`œ. ZIP t@CɋL^ CRC-32 Ɣr邽߂Ɏg.
+ * @retval false	ǂ߂Ȃ. err ɃG[R[hԂ.
+ */
+bool file_crc32(const char* path, uchar* digest, long& err)
 {
-	// dir1, dir2 LȃtH_ׂ.
-	ValidateFolder(dir1);
-	ValidateFolder(dir2);
+	RandomFile f;
+	if (!f.OpenRead(path)) {
+		err = last_syserror();
+		return false;
+	}
+	const size_t CHUNK = 0x40000;
+	vector<char> buf(CHUNK);
+	uint64 size = f.Size();
+	uint32 crc = 0;
+	for (uint64 pos = 0; pos < size; pos += CHUNK) {
+		size_t n = (size - pos) < CHUNK ? (size_t) (size - pos) : CHUNK;
+		if (f.ReadAt(&buf[0], n, pos) != n) {
+			err = last_syserror();
+			return false;
+		}
+		crc = crc32(&buf[0], n, crc);
+	}
+	crc32_digest(crc, digest);
+	return true;
+}
+
+/** XibvVbgɋL^_CWFXgƔr. L^̖́At@CǂŌvZ.
+ * @param kind				L^_CWFXg̎.
+ * @param stored1, stored2	L^_CWFXg. NULL Ȃ path ̃t@Cǂ.
+ * @return	compare_files() Ɠ.
+ */
+int compare_stored_digests(SnapshotDigest kind, const char* path1, const uchar* stored1, const char* path2, const uchar* stored2, long& err)
+{
+	uchar digest1[DigestCache::DIGEST_SIZE];
+	uchar digest2[DigestCache::DIGEST_SIZE];
+	bool (*digest)(const char*, uchar*, long&) = kind == SNAP_DIGEST_CRC32 ? file_crc32 : file_digest;
+	if ((!stored1 && !digest(path1, digest1, err)) || (!stored2 && !digest(path2, digest2, err)))
+		return -1;
+	return memcmp(stored1 ? stored1 : digest1, stored2 ? stored2 : digest2, sizeof(digest1)) != 0;
+}
+
+/** g̃t@C̓er. ʂłAZ}tHŒm点.
+ * -D Ȃ΁AقȂt@C̍s̑. \͎Xbht@CɍŝŁAł͕ɗ߂.
+ * XibvVbg ZIP t@C̑́AL^_CWFXgŔr.
+ */
+class CompareTask : public Task {
+	string mPath1, mPath2;
+	SnapshotDigest mKind;
+	const uchar* mStored1;
+	const uchar* mStored2;
+	volatile long& mResult;
+	string* mDiff;
+	Semaphore& mDone;
+public:
+	CompareTask(const char* path1, const char* path2, SnapshotDigest kind, const uchar* stored1, const uchar* stored2,
+		volatile long& result, string* diff, Semaphore& done)
+		: mPath1(path1), mPath2(path2), mKind(kind), mStored1(stored1), mStored2(stored2), mResult(result), mDiff(diff), mDone(done) {}
+
+	virtual void Run() {
+		Stopwatch sw;
+		long err = 0;
+		int ret = (mStored1 || mStored2)
+			? compare_stored_digests(mKind, mPath1.c_str(), mStored1, mPath2.c_str(), mStored2, err)
+			: gCache.IsOpen()
+			? compare_digests(mPath1.c_str(), mPath2.c_str(), err)
+			: compare_files(mPath1.c_str(), mPath2.c_str(), err);
+		if (ret == CMP_DIFFER && mDiff && !diff_files(mPath1.c_str(), mPath2.c_str(), DiffOptions(), *mDiff, err))
+			ret = CMP_ERROR;
+		if (ret < 0)
+			gDiag.SysError("can't compare", (mPath1 + ", " + mPath2).c_str(), err);
+		gTimes.Add(PhaseTimes::COMPARE, sw.Elapsed());
+		atomic_exchange(&mResult, ret);
+		mDone.Post();
+	}
+};
+
+//------------------------------------------------------------------------
+/** -m: ړ̌ƂȂAЕɂȂt@C. */
+struct MoveCandidate {
+	int side;					///< 0:, 1:E.
+	StringPool::Handle path;	///< rJntH_̑΃pX.
+	time_t time_write;
+	uint64 size;
+	uint64 sample;				///< 擪AA̕W{̃nbVl.
+	uchar digest[DigestCache::DIGEST_SIZE];	///< eŜ̃_CWFXg.
+	volatile long state;		///< w̌vZ. CMP_PENDING, CMP_ERROR, CMP_SAME(vZς).
+};
+
+/** -m: ̎wvZ. W{̃nbVlAeŜ̃_CWFXgłAZ}tHŒm点. */
+class FingerprintTask : public Task {
+	string mPath;
+	MoveCandidate& mFile;
+	bool mFull;
+	Semaphore& mDone;
+public:
+	FingerprintTask(const string& path, MoveCandidate& file, bool full, Semaphore& done)
+		: mPath(path), mFile(file), mFull(full), mDone(done) {}
+
+	virtual void Run() {
+		long err = 0;
+		bool ok = mFull ? file_digest(mPath.c_str(), mFile.digest, err) : Sample(err);
+		if (!ok)
+			gDiag.SysError("can't read", mPath.c_str(), err);
+		atomic_exchange(&mFile.state, ok ? CMP_SAME : CMP_ERROR);
+		mDone.Post();
+	}
+
+private:
+	/** 擪AA 4KB ̃nbVlvZ. 12KB ȉȂΑŜƂȂ. */
+	bool Sample(long& err) {
+		const uint64 CHUNK = 0x1000;
+		char buf[CHUNK];
+		RandomFile f;
+		if (!f.OpenRead(mPath.c_str())) {
+			err = last_syserror();
+			return false;
+		}
+		uint64 size = f.Size();
+		uint64 pos[3] = { 0, size / 2 - CHUNK / 2, size - CHUNK };
+		if (size <= CHUNK * 3) {
+			pos[1] = CHUNK;
+			pos[2] = CHUNK * 2;
+		}
+		uint64 h = fnv1a64(&size, sizeof(size));
+		for (int i = 0; i < 3 && pos[i] < size; ++i) {
+			size_t n = (size_t) (size - pos[i] < CHUNK ? size - pos[i] : CHUNK);
+			if (f.ReadAt(buf, n, pos[i]) != n) {
+				err = last_syserror();
+				return false;
+			}
+			h = fnv1a64(buf, n, h);
+		}
+		mFile.sample = h;
+		return true;
+	}
+};
+
+/** -m: ړƉ̌o.
+ * ЕɂȂt@CW߁AEœêgɂ. ǂރt@C͒iKIɍi荞.
+ *  -# TCŶΑɂt@Cc. ܂ł̓t@Cǂ܂Ȃ.
+ *  -# c̕W{̃nbVlvZATCYƕW{̂Αɂt@Cc.
+ *  -# c̓eŜ̃_CWFXgvZA_CWFXg̍E𖼑Oɑgɂ.
+ * ̃t@C͓eŋʂłȂ̂ŁAɂȂ.
+ */
+class MoveDetector : public WalkVisitor {
+	StringPool mPaths;
+	vector<MoveCandidate> mFiles;
+	Mutex mMutex;
+	int mWalkSide;			///< AddFolder() ŒT̑.
+	size_t mWalkBase;		///< AddFolder() ŒT̔rJntH_̒.
+
+	MoveDetector(const MoveDetector&);		// Rs[֎~.
+	void operator=(const MoveDetector&);	// ֎~.
+public:
+	MoveDetector()
+		: mWalkSide(0), mWalkBase(0) {}
+
+	/** .
+	 * @param side	0:, 1:E.
+	 * @param rel	rJntH_̑΃pX.
+	 */
+	void Add(int side, const char* rel, time_t time_write, uint64 size) {
+		if (size == 0)
+			return;
+		Lock lock(mMutex);
+		MoveCandidate c;
+		c.side = side;
+		c.path = mPaths.Add(rel, strlen(rel));
+		c.time_write = time_write;
+		c.size = size;
+		c.sample = 0;
+		c.state = CMP_PENDING;
+		mFiles.push_back(c);
+	}
+
+	/** -R: ЕɂȂTutH_̉̃t@CSČɉ.
+	 * @param root	rJntH_.
+	 * @param rel	TutH_̑΃tH_. pX؂ŏI.
+	 */
+	void AddFolder(int side, const char* root, const string& rel, const char* wild) {
+		PathBuf dir(root);
+		dir.Push(rel.c_str());
+		mWalkSide = side;
+		mWalkBase = dir.Length() - rel.size();
+		WalkOptions opt;
+		opt.recursive = true;
+		opt.threads = gThreads;
+		DirWalker(*this, opt).Walk(dir.c_str(), wild);
+	}
 
+	virtual void File(const char* dir, const _finddata_t& find) {
+		string rel = string(dir + mWalkBase) + find.name;
+		Add(mWalkSide, rel.c_str(), find.time_write, (uint64) find.size);
+	}
+
+	/** gTĕ\. */
+	void Report(const char* dir1, const char* dir2, ThreadPool& pool, Semaphore& done);
+
+private:
+	const char* Path(const MoveCandidate& c) const {
+		return mPaths.Str(c.path);
+	}
+
+	/** ̕я. full Ȃ΃TCYƃ_CWFXgAłȂ΃TCYƕW{ŕނA͍̒EAOƂ. */
+	struct Less {
+		const MoveDetector& self;
+		bool full;
+		Less(const MoveDetector& detector, bool by_digest) : self(detector), full(by_digest) {}
+		bool operator()(const MoveCandidate* a, const MoveCandidate* b) const {
+			if (a->size != b->size)
+				return a->size < b->size;
+			if (full) {
+				int cmp = memcmp(a->digest, b->digest, sizeof(a->digest));
+				if (cmp != 0)
+					return cmp < 0;
+			}
+			else if (a->sample != b->sample)
+				return a->sample < b->sample;
+			if (a->side != b->side)
+				return a->side < b->side;
+			return strcmp(self.Path(*a), self.Path(*b)) < 0;
+		}
+		/** ނ? */
+		bool Same(const MoveCandidate* a, const MoveCandidate* b) const {
+			return a->size == b->size && (full ? memcmp(a->digest, b->digest, sizeof(a->digest)) == 0 : a->sample == b->sample);
+		}
+	};
+
+	/** g̖Oɕׂ. */
+	struct PairLess {
+		const MoveDetector& self;
+		explicit PairLess(const MoveDetector& detector) : self(detector) {}
+		bool operator()(const pair<const MoveCandidate*, const MoveCandidate*>& a, const pair<const MoveCandidate*, const MoveCandidate*>& b) const {
+			return strcmp(self.Path(*a.first), self.Path(*b.first)) < 0;
+		}
+	};
+
+	/** v  less ŕނAE̗镪ނc. */
+	static void KeepPaired(vector<MoveCandidate*>& v, const Less& less) {
+		sort(v.begin(), v.end(), less);
+		size_t n = 0;
+		for (size_t i = 0, j; i < v.size(); i = j) {
+			for (j = i + 1; j < v.size() && less.Same(v[i], v[j]); ++j)
+				;
+			if (v[i]->side != v[j-1]->side) {	// Eɕł̂ŁA[̑قȂΗ.
+				for (size_t k = i; k < j; ++k)
+					v[n++] = v[k];
+			}
+		}
+		v.resize(n);
+	}
+
+	/** v ̑S̎wXbhv[ŌvZAvZł̂c. */
+	void Fingerprint(vector<MoveCandidate*>& v, bool full, const char* dir1, const char* dir2, ThreadPool& pool, Semaphore& done) {
+		for (size_t i = 0; i < v.size(); ++i) {
+			PathBuf path(v[i]->side == 0 ? dir1 : dir2);
+			path.Push(Path(*v[i]));
+			v[i]->state = CMP_PENDING;
+			pool.Submit(new FingerprintTask(string(path.c_str(), path.Length()), *v[i], full, done));
+		}
+		size_t n = 0;
+		for (size_t i = 0; i < v.size(); ++i) {
+			long state;
+			while ((state = atomic_load(&v[i]->state)) == CMP_PENDING)
+				done.Wait();
+			if (state != CMP_ERROR)
+				v[n++] = v[i];
+		}
+		v.resize(n);
+	}
+};
+
+void MoveDetector::Report(const char* dir1, const char* dir2, ThreadPool& pool, Semaphore& done)
+{
+	vector<MoveCandidate*> v(mFiles.size());
+	for (size_t i = 0; i < mFiles.size(); ++i)
+		v[i] = &mFiles[i];
+
+	// W{̃nbVl 0 ɑĂ΁ATCYŕނł.
+	KeepPaired(v, Less(*this, false));
+	Fingerprint(v, false, dir1, dir2, pool, done);
+	KeepPaired(v, Less(*this, false));
+	Fingerprint(v, true, dir1, dir2, pool, done);
+	Less less(*this, true);
+	KeepPaired(v, less);
+
+	// e̕ޖɁAE𖼑Oɑgɂ. \͍̖OƂ.
+	vector<pair<const MoveCandidate*, const MoveCandidate*> > moves;
+	for (size_t i = 0, j; i < v.size(); i = j) {
+		size_t right = i;
+		for (j = i + 1; j < v.size() && less.Same(v[i], v[j]); ++j) {
+			if (v[j]->side != v[right]->side)
+				right = j;
+		}
+		for (size_t k = 0; i + k < right && right + k < j; ++k)
+			moves.push_back(make_pair(v[i+k], v[right+k]));
+	}
+	sort(moves.begin(), moves.end(), PairLess(*this));
+
+	char lbuf[100];
+	char rbuf[100];
+	for (size_t i = 0; i < moves.size(); ++i) {
+		const MoveCandidate& l = *moves[i].first;
+		const MoveCandidate& r = *moves[i].second;
+		strftime(lbuf, sizeof(lbuf), gTmFmt, localtime(&l.time_write));
+		strftime(rbuf, sizeof(rbuf), gTmFmt, localtime(&r.time_write));
+		printf("[ %s ] M [ %s ] %s -> %s\n", lbuf, rbuf, Path(l), Path(r));
+	}
+}
+
+//------------------------------------------------------------------------
+/** Eg̃tH_. -R ł͗ɂ铯̃TutH_ɍ. */
+struct FolderPair {
+	string rel1, rel2;		///< rJntH_̑΃tH_. "" ApX؂ŏI.
+	uint64 node1, node2;	///< XibvVbg̑Ȃ΁ÃtH_̔ԍ.
+	FileList files1, files2;
+	bool submitted;			///< ꗗ쐬𓊓ς݂? Xbhg.
+	volatile long listed;	///< ꗗI̐. 2ȂΗƂI.
+
+	FolderPair(const string& r1, const string& r2, uint64 n1 = 0, uint64 n2 = 0)
+		: rel1(r1), rel2(r2), node1(n1), node2(n2), submitted(false), listed(0) {}
+};
+
+/** g̃tH_̕Б̈ꗗ쐬ƕבւ. IAZ}tHŒm点.
+ * E͕ʁX̍ƂƂē̂ŁAقȂfoCX̗sɗ񋓂łA
+ * ɗ񋓂ÍA̗񋓂҂ɕבւn߂.
+ * XibvVbg̑́AL^tH_͈̔͂ǂ. ɃL[̏Ȃ̂ŕבւ͏Ȃ.
+ */
+class ListTask : public Task {
+	FolderPair& mPair;
+	int mSide;
+	string mDir, mWild;
+	const Snapshot* mSnap;
+	Semaphore& mDone;
+public:
+	ListTask(FolderPair& pair, int side, const char* dir, const char* wild, const Snapshot* snap, Semaphore& done)
+		: mPair(pair), mSide(side), mDir(dir), mWild(wild), mSnap(snap), mDone(done)
+	{
+		const string& rel = side == 0 ? pair.rel1 : pair.rel2;
+		if (!rel.empty()) append_pathname(mDir, rel.c_str());
+	}
+
+	virtual void Run() {
+		FileList& list = mSide == 0 ? mPair.files1 : mPair.files2;
+		Stopwatch sw;
+		if (mSnap)
+			MakeSnapshotList(list, *mSnap, mSide == 0 ? mPair.node1 : mPair.node2, mWild.c_str());
+		else
+			MakeFileList(list, mDir.c_str(), mWild.c_str());
+		gTimes.Add(mSide == 0 ? PhaseTimes::LIST1 : PhaseTimes::LIST2, sw.Elapsed());
+		sw.Restart();
+		list.Sort();
+		gTimes.Add(mSide == 0 ? PhaseTimes::SORT1 : PhaseTimes::SORT2, sw.Elapsed());
+		atomic_increment(&mPair.listed);
+		mDone.Post();
+	}
+};
+
+//------------------------------------------------------------------------
+/** tH_r.
+ * ꗗ쐬Ɠer̓Xbhv[ōsA\͎Xbht@Cɍs.
+ * Xbh̑҂́ASƂm点̃Z}tHōs.
+ * ҂Ă錋ʂȂ΁Am点ƂKcĂ̂ŁA҂Ă悢.
+ *
+ * -R ł͍ẼtH_؂ꏏɐ[DŒH. ЕɂȂTutH_͈sŕ\A͒HȂ.
+ * ǂ̑tH_̑ɃXibvVbg ZIP t@Cł悢. ̑̃t@C͓ǂ܂Ȃ̂ŁA-D ̍s͍̑Ȃ.
+ * \҂̃tH_̑g͖OAꗗ͕\ŋ߂̂萔ɍ点.
+ * ]āAgp͖ؑŜł͂ȂAHĂoH̃tH_̕Ō܂.
+ */
+class FolderCompare {
+	const char* mDir1;
+	const char* mDir2;
+	const char* mWild;
+	const Snapshot* mSnap1;			///< XibvVbgȂ΁Aw. tH_Ȃ NULL.
+	const Snapshot* mSnap2;			///< EXibvVbgȂ΁Aw. tH_Ȃ NULL.
+	ThreadPool& mPool;
+	Semaphore& mDone;
+	MoveDetector* mMoves;			///< -m: ЕɂȂt@CW߂. -m łȂ NULL.
+	bool mShowDiff;					///< -D: s̑邩? tH_̏ꍇƂ.
+	vector<FolderPair*> mStack;		///< \҂̃tH_̑g. \.
+	size_t mAhead;					///< ꗗɍ点g̐.
+
+	FolderCompare(const FolderCompare&);	// Rs[֎~.
+	void operator=(const FolderCompare&);	// ֎~.
+public:
+	FolderCompare(const char* dir1, const char* dir2, const char* wild, const Snapshot* snap1, const Snapshot* snap2,
+		ThreadPool& pool, Semaphore& done, MoveDetector* moves)
+		: mDir1(dir1), mDir2(dir2), mWild(wild), mSnap1(snap1), mSnap2(snap2), mPool(pool), mDone(done), mMoves(moves),
+		  mShowDiff(gShowDiff && !snap1 && !snap2), mAhead(pool.Size() * 2) {}
+
+	~FolderCompare() {
+		for (size_t i = 0; i < mStack.size(); ++i)
+			delete mStack[i];
+	}
+
+	/** rs. */
+	void Run() {
+		mStack.push_back(new FolderPair("", ""));
+		while (!mStack.empty()) {
+			Prefetch();
+			FolderPair* pair = mStack.back();
+			mStack.pop_back();
+			Stopwatch sw;
+			while (atomic_load(&pair->listed) < 2)
+				mDone.Wait();
+			gTimes.Add(PhaseTimes::WAIT, sw.Elapsed());
+			size_t n = mStack.size();
+			Print(*pair);
+			reverse(mStack.begin() + n, mStack.end());	// TutH_𖼑Oɕ\邽.
+			delete pair;
+		}
+	}
+
+private:
+	/** ɕ\g mAhead ɂāAꗗ쐬𓊓. */
+	void Prefetch() {
+		size_t n = 0;
+		for (size_t i = mStack.size(); i > 0 && n < mAhead; --i, ++n) {
+			FolderPair* pair = mStack[i-1];
+			if (!pair->submitted) {
+				pair->submitted = true;
+				mPool.Submit(new ListTask(*pair, 0, mDir1, mWild, mSnap1, mDone));
+				mPool.Submit(new ListTask(*pair, 1, mDir2, mWild, mSnap2, mDone));
+			}
+		}
+	}
+
+	void Print(const FolderPair& pair);
+
+	/** XibvVbg̍ڂɋL^_CWFXg. L^Ε񍐂 NULL Ԃ. */
+	static const uchar* StoredDigest(const Snapshot& snap, uint64 ref, const char* path) {
+		const SnapshotEntry& e = snap.Entry(ref);
+		if (e.flags & SNAP_NO_DIGEST) {
+			gDiag.Report(DIAG_WARNING, "no digest in snapshot", "no digest in snapshot: %s", path);
+			return NULL;
+		}
+		return e.digest;
+	}
+};
+
+/** g̃tH_rĕ\. ɂTutH_́A\҂ɐς. */
+void FolderCompare::Print(const FolderPair& pair)
+{
+	const FileTable& files1 = pair.files1.files;
+	const FileTable& files2 = pair.files2.files;
+	const char* rel = pair.rel1.c_str();
+
+	// בւς݂̗t@Cꗗ˂킹.
+	vector<Entry> list;
+	MergeFileLists(files1, files2, list);
+
+	// ɂt@C̓erA\ɃXbhv[֓. -s ŕ\Ȃt̂̂͏.
+	// TCYقȂ͓̂ǂނ܂łȂقȂ̂ŁAȂ.
+	PathBuf file1(mDir1);
+	PathBuf file2(mDir2);
+	if (*rel) {
+		file1.Push(rel);
+		file2.Push(pair.rel2.c_str());
+	}
+	vector<long> results(list.size(), (long) CMP_PENDING);
+	vector<string> diffs(mShowDiff ? list.size() : 0);
+	if (gDiff) {
+		for (size_t k = 0; k < list.size(); ++k) {
+			const Entry& e = list[k];
+			if (!e.HasLeft() || !e.HasRight() || (gIgnoreSameFileDate && files1.time_write[e.Left] == files2.time_write[e.Right]))
+				continue;
+			if (files1.size[e.Left] != files2.size[e.Right] && !mShowDiff) {
+				results[k] = CMP_DIFFER;
+				continue;
+			}
+			size_t mark1 = file1.Push(files1.Name(e.Left));
+			size_t mark2 = file2.Push(files2.Name(e.Right));
+			const uchar* stored1 = mSnap1 ? StoredDigest(*mSnap1, files1.ref[e.Left], file1.c_str()) : NULL;
+			const uchar* stored2 = mSnap2 ? StoredDigest(*mSnap2, files2.ref[e.Right], file2.c_str()) : NULL;
+			if ((mSnap1 && !stored1) || (mSnap2 && !stored2))
+				results[k] = CMP_ERROR;
+			else
+				mPool.Submit(new CompareTask(file1.c_str(), file2.c_str(), mSnap1 ? mSnap1->Digest() : mSnap2 ? mSnap2->Digest() : SNAP_DIGEST_NONE,
+					stored1, stored2, results[k], mShowDiff ? &diffs[k] : NULL, mDone));
+			file1.Pop(mark1);
+			file2.Pop(mark2);
+		}
+	}
+
+	// ˂킹ʂ\A-d ȂΔrʂ҂đĕ\.
+	// r͂قړɏÎŁA擪̌ʂ҂Ԃɂ㑱̔ri.
+	for (size_t k = 0; k < list.size(); ++k) {
+		const Entry& e = list[k];
+		int ret = e.print(stdout, files1, files2, rel);
+		if (mMoves && !(e.HasLeft() && e.HasRight())) {
+			if (e.HasLeft())
+				mMoves->Add(0, (pair.rel1 + files1.Name(e.Left)).c_str(), files1.time_write[e.Left], files1.size[e.Left]);
+			else
+				mMoves->Add(1, (pair.rel2 + files2.Name(e.Right)).c_str(), files2.time_write[e.Right], files2.size[e.Right]);
+		}
+		if (ret <= 0 || !gDiff)
+			continue;
+		long result;
+		while ((result = atomic_load(&results[k])) == CMP_PENDING)
+			mDone.Wait();
+		if (result == CMP_ERROR) {
+			fflush(stdout);
+			gDiag.Flush();
+			continue;
+		}
+		if (mShowDiff && result == CMP_DIFFER) {
+			fputs(diffs[k].c_str(), stdout);
+			string().swap(diffs[k]);
+			continue;
+		}
+		size_t mark1 = file1.Push(files1.Name(e.Left));
+		size_t mark2 = file2.Push(files2.Name(e.Right));
+		printf("Files %s and %s %s\n", file1.c_str(), file2.c_str(), result == CMP_SAME ? "are identical" : "differ");
+		file1.Pop(mark1);
+		file2.Pop(mark2);
+	}
+
+	// -R: ЕɂȂTutH_͈sŕ\Aɂ͕̂\҂ɐς.
+	const FileTable& folders1 = pair.files1.folders;
+	const FileTable& folders2 = pair.files2.folders;
+	MergeFileLists(folders1, folders2, list);
+	for (size_t k = 0; k < list.size(); ++k) {
+		const Entry& e = list[k];
+		if (!e.HasLeft() || !e.HasRight()) {
+			e.print(stdout, folders1, folders2, rel, true);
+			if (mMoves) {
+				if (e.HasLeft())
+					mMoves->AddFolder(0, mDir1, pair.rel1 + folders1.Name(e.Left) + MY_PATH_SEP_STR, mWild);
+				else
+					mMoves->AddFolder(1, mDir2, pair.rel2 + folders2.Name(e.Right) + MY_PATH_SEP_STR, mWild);
+			}
+			continue;
+		}
+		if (folders1.size[e.Left] == FOLDER_LINK || folders2.size[e.Right] == FOLDER_LINK) {
+			// V{bNÑtH_͈sŕ\AzȂ悤ɉ͔rȂ.
+			e.print(stdout, folders1, folders2, rel, true);
+			continue;
+		}
+		string rel1 = pair.rel1 + folders1.Name(e.Left) + MY_PATH_SEP_STR;
+		string rel2 = pair.rel2 + folders2.Name(e.Right) + MY_PATH_SEP_STR;
+		uint64 node1 = mSnap1 ? mSnap1->Entry(folders1.ref[e.Left]).size : 0;
+		uint64 node2 = mSnap2 ? mSnap2->Entry(folders2.ref[e.Right]).size : 0;
+		mStack.push_back(new FolderPair(rel1, rel2, node1, node2));
+	}
+}
+
+/** tH_rs
+ * @param snap1, snap2	XibvVbg̑Ȃ΁AJXibvVbg. tH_̑Ȃ NULL.
+ */
+void Compare(const char* dir1, const char* dir2, const char* wild, const Snapshot* snap1, const Snapshot* snap2)
+{
 	printf("folder compare [ %s ] <-> [ %s ] with \"%s\"\n", dir1, dir2, wild);
 
-	// dir1, dir2 ̃t@Cꗗ𓾂.
-	vector<_finddata_t> files1, files2;
-	vector<_finddata_t>::const_iterator i;
-	MakeFileList(files1, dir1, wild);
-	MakeFileList(files2, dir2, wild);
-
-	// t@CL[Ƃ}bvɁAt@Cꗗ̗vfo^.
-	map<const char*, Entry, StrILess> list;
-	map<const char*, Entry, StrILess>::const_iterator j;
-	for (i = files1.begin(); i != files1.end(); ++i)
-		list[i->name].Left = &*i;
-	for (i = files2.begin(); i != files2.end(); ++i)
-		list[i->name].Right = &*i;
-
-	// }bv̓e\.
-	for (j = list.begin(); j != list.end(); ++j) {
-		int ret = j->second.print(stdout);
-
-		// t@CdiffƂAe{ɈقȂĂ邩mF
-		if (ret > 0 && gDiff) {
-			char file1[_MAX_PATH];
-			char file2[_MAX_PATH];
-			_makepath(file1, NULL, dir1, j->second.Left->name, NULL);
-			_makepath(file2, NULL, dir2, j->second.Right->name, NULL);
-			_spawnlp(_P_WAIT, "diff", "diff", "-Bwqs", file1, file2, NULL);
+	// ꗗ쐬͑҂ԂȂ̂ŁACPUłEsɗ񋓂ł悤2XbhȏƂ.
+	Semaphore done;
+	ThreadPool pool(gThreads > 0 ? gThreads : max(cpu_count(), 2));
+	MoveDetector moves;
+	FolderCompare(dir1, dir2, wild, snap1, snap2, pool, done, gDetectMoves ? &moves : NULL).Run();
+	if (gDetectMoves)
+		moves.Report(dir1, dir2, pool, done);
+}
+
+//------------------------------------------------------------------------
+/** --snapshot: TŌtH_ƃt@CXibvVbgɉ.
+ * DirWalker ̓TutH_ Folder() Œm点ĂẢT̂ŁAt@CtH_̔ԍ͕Ko^ς݂ł.
+ */
+class SnapshotWalker : public WalkVisitor {
+	SnapshotBuilder& mSnap;
+	Mutex mMutex;
+	map<string, size_t> mFolders;	///< TtH_̃pXA̔ԍ.
+	StringPool mDirs;
+public:
+	/** t@C. -d ł̓_CWFXgvZ邽߂ɁAtH_oĂ. */
+	struct Found {
+		size_t item;				///< XibvVbg̍ڂ̔ԍ.
+		StringPool::Handle dir;		///< tH_.
+	};
+	vector<Found> files;
+
+	SnapshotWalker(SnapshotBuilder& snap, const char* root)
+		: mSnap(snap)
+	{
+		mFolders[root] = 0;
+	}
+
+	/** t@C̃pX path ɍ. */
+	void MakePath(const Found& f, PathBuf& path) const {
+		path.Assign(mDirs.Str(f.dir));
+		path.Push(mSnap.Name(f.item));
+	}
+
+	virtual void File(const char* dir, const _finddata_t& find) {
+		Lock lock(mMutex);
+		Found f;
+		f.item = mSnap.AddFile(mFolders[dir], find.name, find.time_write, (uint64) find.size);
+		f.dir = mDirs.Intern(dir);
+		files.push_back(f);
+	}
+
+	virtual bool Folder(const char* dir, const _finddata_t& find) {
+		// DirWalker ƓAtH_ɖOƃpX؂t̂TutH_̃pXƂȂ.
+		PathBuf path(dir);
+		path.Push(find.name);
+		path.Append(MY_PATH_SEP_STR, 1);
+		Lock lock(mMutex);
+		mFolders[string(path.c_str(), path.Length())] = mSnap.AddFolder(mFolders[dir], find.name, find.time_write);
+		return true;
+	}
+};
+
+/** --snapshot -d: ̃t@C̃_CWFXgvZāAXibvVbg̍ڂɏ. */
+class SnapshotDigestTask : public Task {
+	string mPath;
+	SnapshotBuilder& mSnap;
+	size_t mItem;
+public:
+	SnapshotDigestTask(const char* path, SnapshotBuilder& snap, size_t item)
+		: mPath(path), mSnap(snap), mItem(item) {}
+
+	virtual void Run() {
+		long err = 0;
+		if (!file_digest(mPath.c_str(), mSnap.Digest(mItem), err)) {
+			gDiag.SysError("can't read", mPath.c_str(), err);
+			mSnap.NoDigest(mItem);
+		}
+	}
+};
+
+/** --snapshot: dir ̃tH_ؑŜ̃XibvVbgWo͂ɏo. -d ȂΓẽ_CWFXgL^.
+ * rɃChJ[h -R Kp̂ŁAł͑SẴt@CƃTutH_L^.
+ */
+void TakeSnapshot(const char* dir)
+{
+	SnapshotBuilder snap;
+	SnapshotWalker walker(snap, dir);
+	WalkOptions opt;
+	opt.recursive = true;
+	opt.threads = gThreads;
+	DirWalker walk(walker, opt);
+	walk.Walk(dir, "*");
+
+	if (gDiff) {
+		ThreadPool pool(gThreads);
+		PathBuf path;
+		for (size_t i = 0; i < walker.files.size(); ++i) {
+			walker.MakePath(walker.files[i], path);
+			pool.Submit(new SnapshotDigestTask(path.c_str(), snap, walker.files[i].item));
 		}
+		pool.Wait();
+	}
+
+#ifdef _WIN32
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	if (!snap.Write(stdout, gDiff ? SNAP_DIGEST_MURMUR3 : SNAP_DIGEST_NONE)) {
+		gDiag.SysError("can't write snapshot", "stdout");
+		return;
 	}
+	gDiag.Report(DIAG_NOTE, "snapshot", "snapshot of %s: %ld folders, %ld files%s",
+		dir, walk.Folders(), walk.Files(), gDiff ? " with digests" : "");
 }
 
 //------------------------------------------------------------------------
@@ -205,10 +1222,27 @@ int main(int argc, char* argv[])
 	setlocale(LC_ALL, "");
 
 	//--- R}hC̃IvV͂.
+	unsigned long n;	// l̈.
 	while (argc > 1 && argv[1][0]=='-') {
 		char* sw = &argv[1][1];
 		if (strcmp(sw, "help") == 0)
 			goto show_help;
+		else if (strcmp(sw, "-cache") == 0 && argc > 2) {
+			gCacheFile = argv[2];
+			++argv;
+			--argc;
+		}
+		else if (strcmp(sw, "-cache-verify") == 0)
+			gCacheVerify = true;
+		else if (strcmp(sw, "-cache-rebuild") == 0)
+			gCacheRebuild = true;
+		else if (strcmp(sw, "-times") == 0)
+			gShowTimes = true;
+		else if (strcmp(sw, "-snapshot") == 0 && argc > 2) {
+			gSnapshotDir = argv[2];
+			++argv;
+			--argc;
+		}
 		else {
 			do {
 				switch (*sw) {
@@ -230,6 +1264,20 @@ show_help:			error_abort(gUsage2);
 				case 'd':
 					gDiff = true;
 					break;
+				case 'D':
+					gDiff = gShowDiff = true;
+					break;
+				case 'R':
+					gRecursive = true;
+					break;
+				case 'm':
+					gDetectMoves = true;
+					break;
+				case 'j':
+					if (!parse_uint(sw+1, 1, MAX_THREADS, n))	// -j<N>
+						error_abort("-j needs N(1..1024).\n");
+					gThreads = (int) n;
+					goto next_arg;
 				case 't':
 					gTmFmt = "%c";	// locale time format.
 					break;
@@ -242,28 +1290,80 @@ show_help:			error_abort(gUsage2);
 				}
 			} while (*++sw);
 		}
-//next_arg:
+next_arg:
 		++argv;
 		--argc;
 	}
-	if (argc < 2) {
+	if (argc < 2 && !gSnapshotDir) {
 		error_abort("please specify DIR1\n");
 	}
 
 	//--- R}hC DIR1 [DIR2] [WILD] o.
-	char dir1[_MAX_PATH];
-	char dir2[_MAX_PATH];
-	char wild[_MAX_PATH];
-	strcpy(dir1, argv[1]);
-	strcpy(dir2, argc > 2 ? argv[2] : ".");
-	strcpy(wild, argc > 3 ? argv[3] : "*");
-	if (argc <= 3 && has_wildcard(dir1))
-		separate_pathname(dir1, dir1, wild);
-
-	//--- tH_rs.
-	Compare(dir1, dir2, wild);
-
-	return EXIT_SUCCESS;
+	string dir1 = argc > 1 ? argv[1] : "";
+	string dir2 = argc > 2 ? argv[2] : ".";
+	string wild = argc > 3 ? argv[3] : "*";
+	if (argc > 1 && argc <= 3 && has_wildcard(argv[1])) {
+		size_t pos = pathname_name_pos(argv[1]);
+		dir1.assign(argv[1], pos);
+		wild = argv[1] + pos;
+	}
+
+	//--- --snapshot DIR Ȃ DIR AłȂ DIR1, DIR2 LȃtH_XibvVbgłȂΏI.
+	Snapshot snap1, snap2;
+	bool valid1 = gSnapshotDir ? ValidateSide(gSnapshotDir, NULL) : ValidateSide(dir1.c_str(), &snap1);
+	bool valid2 = gSnapshotDir ? true : ValidateSide(dir2.c_str(), &snap2);
+	if (!valid1 || !valid2) {
+		gDiag.Flush();
+		error_abort();
+	}
+
+	//--- XibvVbg ZIP t@CƂ̔rł́A-d ͋L^_CWFXggA-m ͎gȂ.
+	if (gDiff && ((snap1.IsOpen() && snap1.Digest() == SNAP_DIGEST_NONE) || (snap2.IsOpen() && snap2.Digest() == SNAP_DIGEST_NONE))) {
+		error_abort("-d needs a snapshot taken with -d\n");
+	}
+	if (gDiff && snap1.IsOpen() && snap2.IsOpen() && snap1.Digest() != snap2.Digest()) {
+		error_abort("-d can't compare a snapshot with a zip file\n");
+	}
+	if (gDetectMoves && (snap1.IsOpen() || snap2.IsOpen())) {
+		gDiag.Report(DIAG_WARNING, "-m with snapshot", "-m is ignored for a snapshot or zip file");
+		gDetectMoves = false;
+	}
+
+	//--- --cache: LbVt@CJ. JȂ΁ALbVg킸ɔr.
+	if (gCacheFile && gDiff) {
+		long err;
+		if (!gCache.Open(gCacheFile, gCacheRebuild, err)) {
+			if (err == 0)
+				gDiag.Report(DIAG_ERROR, "can't open digest cache", "%s: not a digest cache file (use --cache-rebuild to replace it)", gCacheFile);
+			else
+				gDiag.SysError("can't open digest cache", gCacheFile, err);
+		}
+	}
+
+	//--- XibvVbgoAtH_rs.
+	Stopwatch wall;
+	if (gSnapshotDir)
+		TakeSnapshot(gSnapshotDir);
+	else
+		Compare(dir1.c_str(), dir2.c_str(), wild.c_str(), snap1.IsOpen() ? &snap1 : NULL, snap2.IsOpen() ? &snap2 : NULL);
+	if (gShowTimes && !gSnapshotDir) {
+		fflush(stdout);
+		gDiag.Report(DIAG_NOTE, "times", "times: list %.3fs + %.3fs, sort %.3fs + %.3fs, compare %.3fs, wait for list %.3fs, wall %.3fs",
+			gTimes.sum[PhaseTimes::LIST1], gTimes.sum[PhaseTimes::LIST2], gTimes.sum[PhaseTimes::SORT1], gTimes.sum[PhaseTimes::SORT2],
+			gTimes.sum[PhaseTimes::COMPARE], gTimes.sum[PhaseTimes::WAIT], wall.Elapsed());
+	}
+
+	//--- --cache: LbV̗p󋵂\AKvȂΊgĕ.
+	if (gCache.IsOpen()) {
+		fflush(stdout);
+		gDiag.Report(DIAG_NOTE, "digest cache", "digest cache %s: %ld hits, %ld misses, %ld stale%s",
+			gCacheFile, gCache.Hits(), gCache.Misses(), gCache.Stale(), gCache.IsWritable() ? "" : " (read only)");
+		gCache.Close();
+	}
+
+	//--- ǂ߂ȂtH_Ȃǂ΁Ǎޖɕ\.
+	gDiag.Summary("dirdiff");
+	return gDiag.Count(DIAG_ERROR) ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 //------------------------------------------------------------------------
 /**@page dirdiff-manual dirdiff.exe - show differ of directories
@@ -283,6 +1383,40 @@ show_help:			error_abort(gUsage2);
 
 @section dirdiff-func 
 	- ChJ[hŃl[Ώۂwł܂B
+	- -R ̓TutH_ċAIɔr܂BЕɂȂTutH_͈sŕ\Ả͕\܂B
+	  ẼtH_؂ꏏɒHATutH_̑gɕXbhŕsɈꗗ܂B
+	- Ëꗗ͕ʁX̃XbhœɍAIבւ܂B
+	  [JfBXNƃlbg[NL̂悤ɑ҂Ԃ̈قȂ闼łA񋓂̑҂dȂ܂B
+	  --times ͈ꗗ쐬AבւAerɔ₵ԂEʂɕ\܂B
+	  ꗗ͕\ŋ߂̂ɍ̂ŁAȃtH_؂łgp͑܂B
+	- -d ͗ɂt@C̓eOŔr܂BO diff R}h͕svłB
+	  TCYقȂΓǂ܂ɁuقȂvƂAȂΐ擪ǂݔׂčŏ̑őł؂܂B
+	  r͕XbhŕsɍsAʂ̓t@Cɕ\܂B
+	- -D  -d ňقȂƕt@ĆAs̑ unified `ŕ\܂BO diff R}h͕svłB
+	  diff -Bw Ɠ󔒂Ƌs̈Ⴂ͖܂Bes͈xnbVĔԍɒuA
+	  ʂ̐擪ƖĂAɈxsڈɕ(patience diff)Ac Myers @Ŕr܂B
+	  NUL ܂ރt@C 16MB zt@ĆATCYsŕ\܂B
+	  ̍쐬XbhŕsɍsA\̓t@Cɂ܂Ƃ߂ăt@Cɍs܂B
+	- -m ͕ЕɂȂt@CAeȆgTāAړ܂͉ƂčŌɕ\܂B
+	  TCŶΑɂt@Cǂ݁A܂擪AÄꕔ̃nbVlōi荞łA
+	  cŜ̃_CWFXgŏƍ܂B-R ł͕ЕɂȂTutH_̉T܂B̃t@C͑ΏۊOłB
+	- --cache FILE  -d ŌvZt@Cẽ_CWFXg(MurmurHash3 128bit) FILE ɋL^A
+	  񂩂̓tpXATCYAXVAt@CIDvt@Cǂ܂ɔr܂B
+	  FILE ̓Ɋ蓖ĂĒړǂݏ̂ŁAL^ɂ炸Ĵ͈ułB
+	  ɓ dirdiff ͈L^A͋L^ǂނƂȂ܂B
+	  --cache-verify ͋L^̂t@CǂݒAeςĂΌxċL^𒼂܂B
+	  FILE ΍܂BLbV̌`łȂt@C͒uɁALbVg킸ɔr܂B
+	  --cache-rebuild  FILE 蒼܂B
+	- --snapshot DIR  DIR ̃tH_ؑŜ̈ꗗ(OATCYAXVA-d ȂΓẽ_CWFXg)
+	  oCi`ŕWo͂ɏo܂BDIR1, DIR2 ɂ̓tH_̑ɂ̃XibvVbgwłA
+	  ɖtH_ʂ̃}ṼtH_Ɣrł܂B
+	  XibvVbg̓tH_ɖOɕׂĂAɊ蓖ĂĕKvȃtH_͈̔͂ǂނ̂ŁA
+	  ȃXibvVbgłבւǂݍ݂ɓ˂킹܂B
+	  XibvVbgƂ -d ͋L^_CWFXgŔrA-D ͍s̑\A-m ͎g܂B
+	- DIR1, DIR2 ɂ ZIP t@Cwł܂BWJɒfBNgǂ݁AGgATCYA
+	  XV(NTFS, UT extra field ΂̎A DOS )ACRC-32 𓾂܂B
+	  ZIP t@CƂ -d ́AΑ̃t@Cxǂ CRC-32 vZAL^lƔr܂B
+	  WJtH_zz ZIP t@Cƈv邩AZIP t@CWJɊm߂܂B
 
 @section env 
 	Windows2000ȍ~𓮍ΏۂƂĂ܂B
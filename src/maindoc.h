@@ -5,4 +5,16 @@
 	- @ref clip-manual
 	- @ref renamex-manual
 	- @ref delx-manual
+
+ @section build-linux Linux ł̃rh
+	zipdump, renamex, dirdiff  Linux Ȃǂ POSIX łrhł܂B
+	clipx, delx  Windows płB
+	@verbatim
+cmake -S . -B build && cmake --build build
+܂
+make		(GNUmakefile g)
+	@endverbatim
+	POSIX łł́ApX؂ '/'AȌƍ͑啶ʂA
+	hbgŎn܂閼OBt@CƂ݂Ȃ܂B
+	zipdump --serve/--query ̃pCv NAME ́AUnix hC\Pbg /tmp/NAME ɂȂ܂B
 */
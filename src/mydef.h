@@ -8,14 +8,46 @@ typedef unsigned char  uchar;
 typedef unsigned short ushort;
 typedef unsigned int   uint;
 typedef unsigned long  ulong;
+#ifdef _WIN32
 typedef unsigned __int8  uint8;
 typedef unsigned __int16 uint16;
 typedef unsigned __int32 uint32;
 typedef unsigned __int64 uint64;
+#else
+typedef long long          __int64;
+typedef unsigned char      uint8;
+typedef unsigned short     uint16;
+typedef unsigned int       uint32;
+typedef unsigned long long uint64;
+#endif
 //@}
 
 //........................................................................
+#ifndef _WIN32
+/** @name POSIXł̃pX̏. VC++  stdlib.h ƓOŒ`.
+ * @{
+ */
+#include <limits.h>
+#define _MAX_PATH	PATH_MAX
+#define _MAX_DRIVE	3
+#define _MAX_DIR	PATH_MAX
+#define _MAX_FNAME	(NAME_MAX + 1)
+#define _MAX_EXT	(NAME_MAX + 1)
+//@}
+#endif
+
 /** max file/path name length. Unicode_MAX_PATHȂ̂ŁAMBCSł͂̔{̒ƂȂ\. */
 #define MY_MAX_PATH	(_MAX_PATH * 2)
 
+//@{
+/** pX̋؂蕶 */
+#ifdef _WIN32
+#define MY_PATH_SEP		'\\'
+#define MY_PATH_SEP_STR	"\\"
+#else
+#define MY_PATH_SEP		'/'
+#define MY_PATH_SEP_STR	"/"
+#endif
+//@}
+
 // mydef.h - end.
@@ -0,0 +1,482 @@
+/**@file cachefunc.cpp --- persistent file digest cache.
+ * errfunc.cpp, filefunc.cpp, hashfunc.cpp, thrfunc.cpp  include 邱.
+ * @author Hiroshi Kuno <http://code.google.com/p/win32cmdx/>
+ */
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------
+/** t@Cẽ_CWFXg̉iLbV.
+ * t@CɁAtpXƃTCYAXVA{[At@CIDƂāAe MurmurHash3 128bitlL^.
+ * SĈv΁At@Cǂ܂ɋL^lg.
+ *
+ * LbVt@C̓wb_ƌŒ蒷Xbg̃nbV\ŁAŜɊ蓖ĂĒړǂݏ.
+ * Xbg̈ʒu̓pX̃nbVlŌ߁AgpȂΎ̃XbgT(`T).
+ * ߂͈̂ꎞɈ̃vZXƂAt@C̃bNŔr. bNȂΓǂݏopŎg.
+ * ǂݏovZX͊Ăǂ. Xbg͍̏XVԍɂĂsAɖ߂ďI.
+ * ǂޑ́AǂޑO̍XVԍȂΗLȓeƂ݂Ȃ(seqlock).
+ * 蒼Ɗg͈ꎞt@CɍĂ疼Otւ̂ŁAt@C蓖Ē̃vZXWȂ.
+ */
+class DigestCache {
+public:
+	enum { DIGEST_SIZE = 16 };
+
+private:
+	/** t@C̐擪. 64oCg. */
+	struct Header {
+		char magic[8];			///< "DDCACHE"  '\0'.
+		uint32 version;
+		uint32 slot_bits;		///< Xbg2Ƃΐ.
+		uint32 count;			///< gp̃Xbg.
+		uint32 reserved[11];
+	};
+	/** ̃t@C̋L^. 64oCg. */
+	struct Slot {
+		volatile uint32 seq;	///< XVԍ. ͊.
+		uint32 reserved;
+		uint64 path_hash;		///< tpX FNV-1a 64bitl. 0 Ȃ΋󂫃Xbg.
+		FileStamp stamp;
+		uchar digest[DIGEST_SIZE];
+	};
+	enum {
+		VERSION = 1,
+		INITIAL_BITS = 14,		///< VK쐬̃Xbg 16384 (1MB).
+		MAX_BITS = 30,
+	};
+
+	std::string mPath;
+#ifdef _WIN32
+	HANDLE mFile;
+	HANDLE mMapping;
+#else
+	int mFile;
+#endif
+	uchar* mData;			///< t@CŜ蓖Ă̈.
+	size_t mSize;
+	Header* mHeader;
+	Slot* mSlots;
+	uint64 mMask;			///< Xbg - 1.
+	bool mWritable;			///< ݂̃bNꂽ?
+	uint64 mDropped;		///< gp̏ɒBāAL^łȂ.
+	Mutex mMutex;			///< Xbgւ݂̏r.
+	volatile long mHits;
+	volatile long mMisses;
+	volatile long mStale;
+
+	DigestCache(const DigestCache&);		// Rs[֎~.
+	void operator=(const DigestCache&);		// ֎~.
+public:
+	DigestCache()
+		: mData(NULL), mSize(0), mHeader(NULL), mSlots(NULL), mMask(0), mWritable(false), mDropped(0),
+		  mHits(0), mMisses(0), mStale(0)
+	{
+#ifdef _WIN32
+		mFile = INVALID_HANDLE_VALUE;
+		mMapping = NULL;
+#else
+		mFile = -1;
+#endif
+	}
+
+	~DigestCache() {
+		Close();
+	}
+
+	//....................................................................
+	/** LbVt@CJ. ΍.
+	 * `̈Ⴄt@Cǂ߂Ȃt@ĆAp҂̃t@CȂ̂ŒuȂ.
+	 * @param path		LbVt@C.
+	 * @param rebuild	̓êĂč蒼? `̈Ⴄt@Cu.
+	 * @param err		s̃G[R[h. LbVt@Č`łȂ 0.
+	 * @retval false	JȂ.
+	 */
+	bool Open(const char* path, bool rebuild, long& err) {
+		Close();
+		mPath = path;
+		if (!rebuild && OpenFile(path, err))
+			return true;
+		if (rebuild || IsNotFound(err)) {
+			std::string tmp = TempName();
+			if (!Create(tmp.c_str(), INITIAL_BITS) || !Replace(tmp.c_str(), path)) {
+				err = last_syserror();
+				remove(tmp.c_str());
+				return false;
+			}
+			return OpenFile(path, err);
+		}
+		return false;
+	}
+
+	/** . ݉\ŎgpzȂ΁AXbg𑝂₵t@Cɍ蒼. */
+	void Close() {
+		if (mData && mWritable && mHeader->count + mDropped > (mMask + 1) / 2 && mHeader->slot_bits < MAX_BITS)
+			Grow();
+		CloseFile();
+	}
+
+	/** JĂ邩? */
+	bool IsOpen() const {
+		return mData != NULL;
+	}
+
+	/** L^ł邩? ̃vZXݒȂΓǂݏopƂȂ. */
+	bool IsWritable() const {
+		return mWritable;
+	}
+
+	/** L^g. */
+	long Hits() const {
+		return mHits;
+	}
+
+	/** L^. */
+	long Misses() const {
+		return mMisses;
+	}
+
+	/** œe̕ω. */
+	long Stale() const {
+		return mStale;
+	}
+
+	//....................................................................
+	/** t@Cẽ_CWFXg𓾂. L^LȂ΃t@Cǂ܂Ȃ. ȂΑŜǂŌvZAL^.
+	 * Xbh瓯ɌĂł悢.
+	 * @param fname		t@C.
+	 * @param digest	DIGEST_SIZE oCg̃_CWFXg̊i[.
+	 * @param verify	L^LłǂݒāAL^ƈقȂ stale  true ɂċL^𒼂.
+	 * @param stale		L^ƓǂݒeقȂ?
+	 * @param err		s̃G[R[h.
+	 * @retval false	JȂA܂͓ǂ߂Ȃ.
+	 */
+	bool Digest(const char* fname, uchar* digest, bool verify, bool& stale, long& err) {
+		stale = false;
+		RandomFile f;
+		FileStamp st;
+		if (!f.OpenRead(fname) || !f.Stamp(st)) {
+			err = last_syserror();
+			return false;
+		}
+		uint64 key = PathHash(fname);
+		uchar cached[DIGEST_SIZE];
+		bool hit = Lookup(key, st, cached);
+		if (hit && !verify) {
+			atomic_increment(&mHits);
+			memcpy(digest, cached, DIGEST_SIZE);
+			return true;
+		}
+		if (!HashFile(f, st.size, digest)) {
+			err = last_syserror();
+			return false;
+		}
+		if (hit) {
+			atomic_increment(&mHits);
+			if (memcmp(cached, digest, DIGEST_SIZE) == 0)
+				return true;
+			stale = true;
+			atomic_increment(&mStale);
+		}
+		else {
+			atomic_increment(&mMisses);
+		}
+		Store(key, st, digest);
+		return true;
+	}
+
+	/** LbVg킸ɁAt@Cẽ_CWFXgvZ. Digest() ƓlƂȂ.
+	 * @retval false	JȂA܂͓ǂ߂Ȃ. err ɃG[R[hԂ.
+	 */
+	static bool Compute(const char* fname, uchar* digest, long& err) {
+		RandomFile f;
+		if (!f.OpenRead(fname) || !HashFile(f, f.Size(), digest)) {
+			err = last_syserror();
+			return false;
+		}
+		return true;
+	}
+
+private:
+	/** t@CŜ̃_CWFXgvZ. */
+	static bool HashFile(const RandomFile& f, uint64 size, uchar* digest) {
+		const size_t CHUNK = 0x40000;
+		std::vector<char> buf(CHUNK);
+		Murmur3_128 h;
+		for (uint64 pos = 0; pos < size; pos += CHUNK) {
+			size_t n = (size - pos) < CHUNK ? (size_t) (size - pos) : CHUNK;
+			if (f.ReadAt(&buf[0], n, pos) != n)
+				return false;
+			h.Update(&buf[0], n);
+		}
+		h.Final(digest);
+		return true;
+	}
+
+	/** t@CƂ\G[R[h? */
+	static bool IsNotFound(long err) {
+#ifdef _WIN32
+		return err == ERROR_FILE_NOT_FOUND;
+#else
+		return err == ENOENT;
+#endif
+	}
+
+	/** ɂtpX̃nbVl. 0 ͋󂫃Xbg\̂ŎgȂ. */
+	static uint64 PathHash(const char* fname) {
+		char full[_MAX_PATH * 2];
+		const char* path = _fullpath(full, fname, sizeof(full)) ? full : fname;
+		uint64 h = fnv1a64(path, strlen(path));
+		return h ? h : 1;
+	}
+
+	/** t@C̃TCY. */
+	static uint64 FileBytes(uint32 bits) {
+		return sizeof(Header) + ((uint64) sizeof(Slot) << bits);
+	}
+
+	/** ꎞt@C. tH_ɍ̂ŁAO̕tւ̓t@C̕ʂɂȂȂ. */
+	std::string TempName() const {
+		char buf[40];
+#ifdef _WIN32
+		_snprintf(buf, sizeof(buf), ".%lu.tmp", (ulong) ::GetCurrentProcessId());
+#else
+		_snprintf(buf, sizeof(buf), ".%lu.tmp", (ulong) getpid());
+#endif
+		buf[sizeof(buf)-1] = '\0';
+		return mPath + buf;
+	}
+
+	//....................................................................
+	/** key  st vL^T. */
+	bool Lookup(uint64 key, const FileStamp& st, uchar* digest) const {
+		if (!mSlots)
+			return false;
+		for (uint64 i = key & mMask, n = 0; n <= mMask; i = (i + 1) & mMask, ++n) {
+			const Slot& s = mSlots[i];
+			uint32 seq = s.seq;
+			memory_barrier();
+			uint64 h = s.path_hash;
+			if (h == 0)
+				return false;
+			if (h != key)
+				continue;
+			FileStamp cur = s.stamp;
+			uchar d[DIGEST_SIZE];
+			memcpy(d, s.digest, DIGEST_SIZE);
+			memory_barrier();
+			if ((seq & 1) != 0 || s.seq != seq || memcmp(&cur, &st, sizeof(st)) != 0)
+				return false;
+			memcpy(digest, d, DIGEST_SIZE);
+			return true;
+		}
+		return false;
+	}
+
+	/** L^. pX̋L^Ώ. gp̏(3/4)ɒBĂ΋L^Ȃ. */
+	void Store(uint64 key, const FileStamp& st, const uchar* digest) {
+		if (!mWritable)
+			return;
+		Lock lock(mMutex);
+		for (uint64 i = key & mMask, n = 0; n <= mMask; i = (i + 1) & mMask, ++n) {
+			Slot& s = mSlots[i];
+			if (s.path_hash != 0 && s.path_hash != key)
+				continue;
+			if (s.path_hash == 0) {
+				if (mHeader->count + 1 > (mMask + 1) / 4 * 3) {
+					++mDropped;
+					return;
+				}
+				++mHeader->count;
+			}
+			uint32 seq = s.seq;
+			s.seq = seq + 1;
+			memory_barrier();
+			s.path_hash = key;
+			s.stamp = st;
+			memcpy(s.digest, digest, DIGEST_SIZE);
+			memory_barrier();
+			s.seq = seq + 2;
+			return;
+		}
+	}
+
+	//....................................................................
+	/** ̕\LbVt@C. */
+	static bool Create(const char* path, uint32 bits) {
+		RandomFile f;
+		if (!f.Create(path) || !f.Preallocate(FileBytes(bits)))
+			return false;
+		Header h;
+		memset(&h, 0, sizeof(h));
+		memcpy(h.magic, "DDCACHE", 8);
+		h.version = VERSION;
+		h.slot_bits = bits;
+		return f.Write(&h, sizeof(h));
+	}
+
+	/** src ̖O dst ɕtւ. dst Βu. */
+	static bool Replace(const char* src, const char* dst) {
+#ifdef _WIN32
+		return ::MoveFileExA(src, dst, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		return rename(src, dst) == 0;
+#endif
+	}
+
+	/** L^łȂ̂܂߂ĎgpȉƂȂXbg̃t@CɋL^ڂAOtւ.
+	 * OtւI܂ŃbNÃvZXt@Cɏ܂Ȃ悤ɂ.
+	 * Windows ł͑̃vZX蓖Ē̃t@C͒uȂ̂ŁÂƂ͍̃t@Cg.
+	 */
+	void Grow() {
+		std::string tmp = TempName();
+		uint64 need = (mHeader->count + mDropped) * 2;
+		uint32 bits = mHeader->slot_bits + 1;
+		while (bits < MAX_BITS && ((uint64) 1 << bits) < need)
+			++bits;
+		DigestCache next;
+		long err;
+		if (Create(tmp.c_str(), bits) && next.OpenFile(tmp.c_str(), err)) {
+			for (uint64 i = 0; i <= mMask; ++i) {
+				const Slot& s = mSlots[i];
+				if (s.path_hash != 0 && (s.seq & 1) == 0)
+					next.Store(s.path_hash, s.stamp, s.digest);
+			}
+			next.CloseFile();
+			Unmap();
+			bool replaced = Replace(tmp.c_str(), mPath.c_str());
+			CloseFile();
+			if (replaced)
+				return;
+		}
+		next.CloseFile();
+		remove(tmp.c_str());
+	}
+
+	/** ̃LbVt@CJĊ蓖Ă. ݂̃bNΏ݉\Ƃ.
+	 * @param err		s̃G[R[h. `Ⴆ 0.
+	 * @retval false	JȂA܂͌`Ⴄ.
+	 */
+	bool OpenFile(const char* path, long& err) {
+		CloseFile();
+		err = 0;
+		uint64 size;
+#ifdef _WIN32
+		const DWORD share = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
+		bool rw = true;
+		mFile = ::CreateFileA(path, GENERIC_READ | GENERIC_WRITE, share, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (mFile == INVALID_HANDLE_VALUE) {
+			rw = false;
+			mFile = ::CreateFileA(path, GENERIC_READ, share, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (mFile == INVALID_HANDLE_VALUE) {
+				err = last_syserror();
+				return false;
+			}
+		}
+		// oCg͈͂̃bN̓蓖ĂɂǂݏWȂ̂ŁA݌̈ƂĂg.
+		OVERLAPPED ov;
+		memset(&ov, 0, sizeof(ov));
+		mWritable = rw && ::LockFileEx(mFile, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &ov);
+		LARGE_INTEGER li;
+		if (!::GetFileSizeEx(mFile, &li)) {
+			err = last_syserror();
+			CloseFile();
+			return false;
+		}
+		size = (uint64) li.QuadPart;
+		if (size >= sizeof(Header) && size <= (size_t) -1) {
+			mMapping = ::CreateFileMapping(mFile, NULL, mWritable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+			if (mMapping)
+				mData = (uchar*) ::MapViewOfFile(mMapping, mWritable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+		}
+#else
+		bool rw = true;
+		mFile = open(path, O_RDWR | O_CLOEXEC);
+		if (mFile == -1) {
+			rw = false;
+			mFile = open(path, O_RDONLY | O_CLOEXEC);
+			if (mFile == -1) {
+				err = last_syserror();
+				return false;
+			}
+		}
+		mWritable = rw && flock(mFile, LOCK_EX | LOCK_NB) == 0;
+		struct stat st;
+		if (fstat(mFile, &st) != 0) {
+			err = last_syserror();
+			CloseFile();
+			return false;
+		}
+		size = (uint64) st.st_size;
+		if (size >= sizeof(Header) && size <= (size_t) -1) {
+			void* p = mmap(NULL, (size_t) size, mWritable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, mFile, 0);
+			if (p != MAP_FAILED)
+				mData = (uchar*) p;
+		}
+#endif
+		if (mData == NULL) {
+			if (size >= sizeof(Header))
+				err = last_syserror();	// 蓖ĂɎs.
+			CloseFile();
+			return false;
+		}
+		mSize = (size_t) size;
+		mHeader = (Header*) mData;
+		if (memcmp(mHeader->magic, "DDCACHE", 8) != 0 || mHeader->version != VERSION
+			|| mHeader->slot_bits > MAX_BITS || FileBytes(mHeader->slot_bits) != size) {
+			CloseFile();
+			return false;
+		}
+		mSlots = (Slot*) (mData + sizeof(Header));
+		mMask = ((uint64) 1 << mHeader->slot_bits) - 1;
+		mDropped = 0;
+		return true;
+	}
+
+	/** 蓖Ă. t@C͊J܂܂Ȃ̂ŁAbN͊OȂ. */
+	void Unmap() {
+#ifdef _WIN32
+		if (mData)
+			::UnmapViewOfFile(mData);
+		if (mMapping)
+			::CloseHandle(mMapping);
+		mMapping = NULL;
+#else
+		if (mData)
+			munmap(mData, mSize);
+#endif
+		mData = NULL;
+		mSize = 0;
+		mHeader = NULL;
+		mSlots = NULL;
+		mMask = 0;
+	}
+
+	/** 蓖Ăĕ. bNO. */
+	void CloseFile() {
+		Unmap();
+#ifdef _WIN32
+		if (mFile != INVALID_HANDLE_VALUE)
+			::CloseHandle(mFile);
+		mFile = INVALID_HANDLE_VALUE;
+#else
+		if (mFile != -1)
+			close(mFile);
+		mFile = -1;
+#endif
+		mWritable = false;
+	}
+};
+
+// cachefunc.cpp - end.
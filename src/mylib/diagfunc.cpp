@@ -0,0 +1,174 @@
+/**@file diagfunc.cpp --- thread-safe diagnostics sink.
+ * errfunc.cpp  thrfunc.cpp  include 邱.
+ * @author Hiroshi Kuno <http://code.google.com/p/win32cmdx/>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <utility>
+
+//------------------------------------------------------------------------
+/** ffbZ[W̏dvx. */
+enum DiagLevel {
+	DIAG_NOTE,		///< Ql. WvȂ.
+	DIAG_WARNING,	///< ͑ꂽAʂɉe邩Ȃ.
+	DIAG_ERROR,		///< ̃t@CtH_̏Ɏs.
+	DIAG_LEVELS
+};
+
+/** ffbZ[W̎WƏo.
+ * [J[Xbh͕񍐂҂ɏ𑱂AG[łIȂ. 邩~߂邩 main ֐ Count() Č߂.
+ *
+ * 񍐂Xbh͎̃obt@(m[h)ɃbZ[WAbNt[̃X^bNɐς(Y/P҃L[).
+ * o͂́A̎_ŏõ͖bNꂽXbhAς܂ꂽbZ[W܂Ƃ߂ĕ񍐏ɏo.
+ * ̃XbhoȂΐςނŖ߂̂ŁAs stderr ւ̏o͂Œ񉻂邱Ƃ͂Ȃ.
+ * oƂɁAG[̎ޖ̌𐔂ĂAŌ Summary() ŏWv\.
+ */
+class Diagnostics {
+	/** ς܂ꂽbZ[W. */
+	struct Node {
+		Node* next;
+		DiagLevel level;
+		const char* kind;	///< G[̎. WṽL[. 񃊃en.
+		char text[1];		///< bZ[W{. KvȒmۂ.
+	};
+	typedef std::map<std::pair<int, std::string>, long> KindCounts;
+
+	void* volatile mHead;		///< ς܂ꂽbZ[W̃X^bN̐擪(Ōɕ񍐂ꂽ).
+	Mutex mWriter;				///< õ͖bN. ȉی삷.
+	FILE* mOut;
+	KindCounts mKinds;			///< (dvx, ) ̌.
+	volatile long mCounts[DIAG_LEVELS];	///< dvx̌. 񍐎ɐ̂ŁAoOł.
+
+	Diagnostics(const Diagnostics&);		// Rs[֎~.
+	void operator=(const Diagnostics&);		// ֎~.
+public:
+	explicit Diagnostics(FILE* out = stderr) : mHead(NULL), mOut(out) {
+		for (int i = 0; i < DIAG_LEVELS; ++i)
+			mCounts[i] = 0;
+	}
+
+	/** oĂȂbZ[WΏo. */
+	~Diagnostics() {
+		Flush();
+	}
+
+	//....................................................................
+	/** bZ[W񍐂. ̉s͕sv.
+	 * @param level	dvx.
+	 * @param kind	G[̎. e.g. "can't open input file"
+	 */
+	void Report(DiagLevel level, const char* kind, const char* fmt, ...) {
+		va_list ap;
+		va_start(ap, fmt);
+		ReportV(level, kind, fmt, ap);
+		va_end(ap);
+	}
+
+	void ReportV(DiagLevel level, const char* kind, const char* fmt, va_list ap) {
+		char buf[2000];
+		_vsnprintf(buf, sizeof(buf), fmt, ap);
+		buf[sizeof(buf)-1] = '\0';
+		Push(level, kind, buf);
+	}
+
+	/** OS̃G[Aڍ׃G[tĕ񍐂. print_win32error ̑Ɏg.
+	 * @param kind	G[̎.
+	 * @param msg	Ώۂ̃t@CȂ.
+	 * @param code	G[R[h. ȗΒÕG[.
+	 */
+	void SysError(const char* kind, const char* msg, long code = last_syserror()) {
+		char buf[1200];
+		format_syserror(buf, sizeof(buf), msg, code);
+		Push(DIAG_ERROR, kind, buf);
+	}
+
+	//....................................................................
+	/** 񍐂ꂽ. */
+	long Count(DiagLevel level) const {
+		return mCounts[level];
+	}
+
+	/** ς܂ꂽbZ[Wo. ̃XbhoȂ΁ASďô҂. */
+	void Flush() {
+		Lock lock(mWriter);
+		Drain();
+	}
+
+	/** SbZ[WoĂAxƃG[̌ޖɕ\. xƃG[Ή\Ȃ.
+	 * @param program	\̐擪ɕtvO.
+	 */
+	void Summary(const char* program) {
+		Lock lock(mWriter);
+		Drain();
+		long warnings = mCounts[DIAG_WARNING];
+		long errors = mCounts[DIAG_ERROR];
+		if (warnings == 0 && errors == 0)
+			return;
+		fprintf(mOut, "%s: %ld error%s, %ld warning%s\n", program,
+			errors, errors == 1 ? "" : "s", warnings, warnings == 1 ? "" : "s");
+		for (int level = DIAG_LEVELS - 1; level > DIAG_NOTE; --level) {
+			for (KindCounts::const_iterator i = mKinds.begin(); i != mKinds.end(); ++i) {
+				if (i->first.first == level)
+					fprintf(mOut, "  %s: %ld x %s\n", level == DIAG_ERROR ? "error" : "warning", i->second, i->first.second.c_str());
+			}
+		}
+		fflush(mOut);
+	}
+
+private:
+	/** bZ[Wς݁Ao͖󂢂ĂΏo. */
+	void Push(DiagLevel level, const char* kind, const char* text) {
+		size_t len = strlen(text);
+		Node* node = (Node*) malloc(sizeof(Node) + len);
+		if (node == NULL)
+			return;
+		node->level = level;
+		node->kind = kind;
+		memcpy(node->text, text, len + 1);
+		for (;;) {
+			void* head = mHead;
+			node->next = (Node*) head;
+			if (atomic_compare_exchange_pointer(&mHead, node, head) == head)
+				break;
+		}
+		atomic_increment(&mCounts[level]);
+
+		// õXbhΔCĖ߂. ̃XbhbN𗣂ɐς܂ꂽ̂́AŏE.
+		while (mHead != NULL && mWriter.TryLock()) {
+			Drain();
+			mWriter.Unlock();
+		}
+	}
+
+	/** X^bNOA񍐏ɏo. mWriter bNČĂԂ. */
+	void Drain() {
+		Node* list = (Node*) atomic_exchange_pointer(&mHead, NULL);
+		if (list == NULL)
+			return;
+		Node* fifo = NULL;
+		while (list) {
+			Node* next = list->next;
+			list->next = fifo;
+			fifo = list;
+			list = next;
+		}
+		while (fifo) {
+			Node* next = fifo->next;
+			fprintf(mOut, "%s\n", fifo->text);
+			if (fifo->level != DIAG_NOTE)
+				++mKinds[std::make_pair((int) fifo->level, std::string(fifo->kind))];
+			free(fifo);
+			fifo = next;
+		}
+		fflush(mOut);
+	}
+};
+
+/** vOŜŋLffbZ[W̏o͐. */
+Diagnostics gDiag;
+
+// diagfunc.cpp - end.
@@ -0,0 +1,530 @@
+/**@file difffunc.cpp --- line diff engine.
+ * errfunc.cpp, filefunc.cpp, hashfunc.cpp  include 邱.
+ * @author Hiroshi Kuno <http://code.google.com/p/win32cmdx/>
+ */
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------
+/** sr̐ݒ. l diff -Bw ƓA󔒂Ƌs̈Ⴂ𖳎. */
+struct DiffOptions {
+	bool ignore_space;		///< 󔒂̗LƗʂ̈Ⴂ𖳎邩? (diff -w)
+	bool ignore_blank;		///< s̒ǉƍ폜𖳎邩? (diff -B)
+	int context;			///< ӏ̑Oɕ\s.
+	uint64 max_size;		///< 傫ȃt@C͍srATCY\.
+
+	DiffOptions()
+		: ignore_space(true), ignore_blank(true), context(3), max_size(0x1000000) {}
+};
+
+/** ӏ.  [a_begin, a_end) sAV [b_begin, b_end) sɒu. sԍ 0 琔. */
+struct DiffHunk {
+	size_t a_begin, a_end;
+	size_t b_begin, b_end;
+};
+
+//------------------------------------------------------------------------
+/** ̃eLXg̍sPʂ̔r.
+ * esxnbVēlނ̔ԍɒuAȍ~͔ԍ̗r.
+ * ʂ̐擪ƖćAɈxsڈɂĕ(patience diff)A
+ * ڈ̖Ԃ Myers  O(ND) @ōŒZ̕ҏWoH̒Tē񕪂. ႪԂ́AŜuƂ݂Ȃ.
+ */
+class LineDiff {
+	/** ̍s. */
+	struct Line {
+		const char* ptr;	///< s̐擪.
+		size_t len;			///< s܂܂Ȃ.
+	};
+	/** Б̃eLXg. */
+	struct Side {
+		std::vector<Line> lines;		///< SĂ̍s.
+		std::vector<uint32> ids;		///< rs̓lނ̔ԍ. ignore_blank Ȃ΋s.
+		std::vector<size_t> index;		///< ids[i] ̍s lines ł̈ʒu.
+		std::vector<char> changed;		///< ids[i] ̍sӏɊ܂܂邩?
+		bool no_eol;					///< Ō̍ssŏIĂȂ?
+	};
+	/** r҂̋. */
+	struct Range {
+		size_t a0, a1, b0, b1;
+		bool bisected;		///< Bisect() ŕԂȂ΁AڈTɑē񕪂.
+	};
+	enum {
+		MAX_EDITS = 0x1000	///< Myers @ŒTҏW̏. zԂ͑ŜuƂ݂Ȃ.
+	};
+
+	DiffOptions mOpt;
+	Side mA, mB;
+	std::vector<uint32> mTable;			///< lނ̃nbV\. l͑\s mReps ł̈ʒu + 1. 0 ͋.
+	std::vector<Line> mReps;			///< lނ̑\s. ԍ.
+	std::vector<uint64> mRepHash;		///< \s̃nbVl.
+	std::vector<uint32> mCountA;		///< Anchor(): lޖ̋̏o. gI 0 ɖ߂.
+	std::vector<uint32> mCountB;		///< Anchor(): lޖ̐V̏o. gI 0 ɖ߂.
+	std::vector<size_t> mPosB;			///< Anchor(): lޖ̐V̏oʒu.
+
+	LineDiff(const LineDiff&);			// Rs[֎~.
+	void operator=(const LineDiff&);	// ֎~.
+public:
+	explicit LineDiff(const DiffOptions& opt = DiffOptions())
+		: mOpt(opt) {}
+
+	/** text1  text2 rāAӏsԍ hunks ɓ. */
+	void Compare(const char* text1, size_t len1, const char* text2, size_t len2, std::vector<DiffHunk>& hunks);
+
+	/** Compare() ̌ʂ unified ` out ɒǉ. ӏΉǉȂ. */
+	void FormatUnified(const char* name1, const char* name2, const std::vector<DiffHunk>& hunks, std::string& out) const;
+
+private:
+	static bool IsSpace(char c) {
+		return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+	}
+
+	bool IsBlank(const Line& line) const;
+	uint64 Hash(const Line& line) const;
+	bool Equal(const Line& x, const Line& y) const;
+	uint32 Classify(const Line& line);
+	void Split(const char* text, size_t len, Side& side);
+	void Diff(size_t a0, size_t a1, size_t b0, size_t b1);
+	void Anchor(const Range& r, std::vector<Range>& work);
+	bool Bisect(const Range& r, std::vector<Range>& work);
+	bool Split(const Range& r, int x, int y, std::vector<Range>& work);
+	void MarkAll(const Range& r);
+	void MakeHunks(std::vector<DiffHunk>& hunks) const;
+	void AppendLines(std::string& out, char mark, const Side& side, size_t begin, size_t end) const;
+	static void AppendRange(std::string& out, size_t begin, size_t end);
+};
+
+//........................................................................
+/** rȂs? ignore_space Ȃ΋󔒂̍ssƂ. */
+bool LineDiff::IsBlank(const Line& line) const
+{
+	if (!mOpt.ignore_blank)
+		return false;
+	for (size_t i = 0; i < line.len; ++i) {
+		if (!(mOpt.ignore_space && IsSpace(line.ptr[i])) && line.ptr[i] != '\r')
+			return false;
+	}
+	return true;
+}
+
+/** s̃nbVl. ignore_space Ȃ΋󔒂΂. s CR ͏ɖ. */
+uint64 LineDiff::Hash(const Line& line) const
+{
+	uint64 h = FNV1A64_INIT;
+	size_t len = line.len;
+	if (len > 0 && line.ptr[len-1] == '\r')
+		--len;
+	if (!mOpt.ignore_space)
+		return fnv1a64(line.ptr, len, h);
+	for (size_t i = 0; i < len; ++i) {
+		if (!IsSpace(line.ptr[i]))
+			h = fnv1a64(&line.ptr[i], 1, h);
+	}
+	return h;
+}
+
+/** Hash() ƓKœ̍s? */
+bool LineDiff::Equal(const Line& x, const Line& y) const
+{
+	size_t xn = x.len, yn = y.len;
+	if (xn > 0 && x.ptr[xn-1] == '\r') --xn;
+	if (yn > 0 && y.ptr[yn-1] == '\r') --yn;
+	if (!mOpt.ignore_space)
+		return xn == yn && memcmp(x.ptr, y.ptr, xn) == 0;
+	size_t i = 0, j = 0;
+	for (;;) {
+		while (i < xn && IsSpace(x.ptr[i])) ++i;
+		while (j < yn && IsSpace(y.ptr[j])) ++j;
+		if (i == xn || j == yn)
+			return i == xn && j == yn;
+		if (x.ptr[i++] != y.ptr[j++])
+			return false;
+	}
+}
+
+/** s̓lނ̔ԍ𓾂. ߂Ă̓eȂΐVԍ蓖Ă. */
+uint32 LineDiff::Classify(const Line& line)
+{
+	if (mReps.size() * 2 >= mTable.size()) {
+		// nbV\{ɍLāA\s꒼.
+		size_t n = mTable.empty() ? 0x400 : mTable.size() * 2;
+		mTable.assign(n, 0);
+		for (size_t i = 0; i < mReps.size(); ++i) {
+			size_t pos = (size_t) mRepHash[i] & (n - 1);
+			while (mTable[pos] != 0)
+				pos = (pos + 1) & (n - 1);
+			mTable[pos] = (uint32) i + 1;
+		}
+	}
+	uint64 h = Hash(line);
+	size_t mask = mTable.size() - 1;
+	for (size_t pos = (size_t) h & mask; ; pos = (pos + 1) & mask) {
+		uint32 v = mTable[pos];
+		if (v == 0) {
+			mTable[pos] = (uint32) mReps.size() + 1;
+			mReps.push_back(line);
+			mRepHash.push_back(h);
+			return (uint32) mReps.size() - 1;
+		}
+		if (mRepHash[v-1] == h && Equal(mReps[v-1], line))
+			return v - 1;
+	}
+}
+
+/** eLXgsɕArs𓯒lނ̔ԍ̗ɂ. */
+void LineDiff::Split(const char* text, size_t len, Side& side)
+{
+	const char* end = text + len;
+	side.no_eol = len > 0 && end[-1] != '\n';
+	for (const char* p = text; p < end; ) {
+		const char* eol = (const char*) memchr(p, '\n', end - p);
+		Line line;
+		line.ptr = p;
+		line.len = (eol ? eol : end) - p;
+		side.lines.push_back(line);
+		p = eol ? eol + 1 : end;
+	}
+	for (size_t i = 0; i < side.lines.size(); ++i) {
+		if (IsBlank(side.lines[i]))
+			continue;
+		side.ids.push_back(Classify(side.lines[i]));
+		side.index.push_back(i);
+	}
+	side.changed.assign(side.ids.size(), 0);
+}
+
+//........................................................................
+void LineDiff::Compare(const char* text1, size_t len1, const char* text2, size_t len2, std::vector<DiffHunk>& hunks)
+{
+	Split(text1, len1, mA);
+	Split(text2, len2, mB);
+	mCountA.assign(mReps.size(), 0);
+	mCountB.assign(mReps.size(), 0);
+	mPosB.assign(mReps.size(), 0);
+	Diff(0, mA.ids.size(), 0, mB.ids.size());
+	MakeHunks(hunks);
+}
+
+/** ԂrāAႷs changed t.
+ * Ԃ͍ƃXgɐςŏɏ. [ċAŃX^bNg؂Ȃ.
+ */
+void LineDiff::Diff(size_t a0, size_t a1, size_t b0, size_t b1)
+{
+	std::vector<Range> work;
+	Range r = { a0, a1, b0, b1, false };
+	work.push_back(r);
+	while (!work.empty()) {
+		r = work.back();
+		work.pop_back();
+
+		// ʂ̐擪Ɩ.
+		while (r.a0 < r.a1 && r.b0 < r.b1 && mA.ids[r.a0] == mB.ids[r.b0])
+			++r.a0, ++r.b0;
+		while (r.a0 < r.a1 && r.b0 < r.b1 && mA.ids[r.a1-1] == mB.ids[r.b1-1])
+			--r.a1, --r.b1;
+		if (r.a0 == r.a1 || r.b0 == r.b1) {
+			MarkAll(r);
+			continue;
+		}
+		if (!r.bisected)
+			Anchor(r, work);
+		else if (!Bisect(r, work))
+			MarkAll(r);
+	}
+}
+
+/** Ԃ̒ŗɈxsTAœɕԍŒ̑gڈƂċԂ𕪊.
+ * ڈ󂪖 Myers @œ񕪂.
+ */
+void LineDiff::Anchor(const Range& r, std::vector<Range>& work)
+{
+	// lޖɁȀo񐔂ƐV̈ʒu𐔂. ͎gI߂̂ŁAԂ̒ɔႷԂōς.
+	for (size_t i = r.a0; i < r.a1; ++i)
+		++mCountA[mA.ids[i]];
+	for (size_t j = r.b0; j < r.b1; ++j) {
+		++mCountB[mB.ids[j]];
+		mPosB[mB.ids[j]] = j;
+	}
+
+	// ̏ɕׂڈ̌₩AV̈ʒuŒ̕ patience sorting ŋ߂.
+	std::vector<size_t> candA, candB;
+	for (size_t i = r.a0; i < r.a1; ++i) {
+		uint32 id = mA.ids[i];
+		if (mCountA[id] == 1 && mCountB[id] == 1) {
+			candA.push_back(i);
+			candB.push_back(mPosB[id]);
+		}
+	}
+	for (size_t i = r.a0; i < r.a1; ++i)
+		mCountA[mA.ids[i]] = 0;
+	for (size_t j = r.b0; j < r.b1; ++j)
+		mCountB[mB.ids[j]] = 0;
+	if (candA.empty()) {
+		if (!Bisect(r, work))
+			MarkAll(r);
+		return;
+	}
+	std::vector<size_t> tops;		// eR̈ԏ̌.
+	std::vector<size_t> prev(candA.size());
+	for (size_t k = 0; k < candA.size(); ++k) {
+		size_t lo = 0, hi = tops.size();
+		while (lo < hi) {
+			size_t mid = (lo + hi) / 2;
+			if (candB[tops[mid]] < candB[k])
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		prev[k] = lo > 0 ? tops[lo-1] : (size_t) -1;
+		if (lo == tops.size())
+			tops.push_back(k);
+		else
+			tops[lo] = k;
+	}
+
+	// ڈ̊ԂƃXgɐς. 납ςނ̂ŁAŐԂ珈.
+	size_t a1 = r.a1, b1 = r.b1;
+	for (size_t k = tops.back(); k != (size_t) -1; k = prev[k]) {
+		Range sub = { candA[k] + 1, a1, candB[k] + 1, b1, false };
+		work.push_back(sub);
+		a1 = candA[k];
+		b1 = candB[k];
+	}
+	Range first = { r.a0, a1, r.b0, b1, false };
+	work.push_back(first);
+}
+
+/** Myers @̐`ԔłŁAŒZ̕ҏWoH̒̈v(middle snake)TAԂœ񕪂čƃXgɐς.
+ * Oォ瓯ɌoHL΂A҂dȂΊp̓_ŕ. gL͋Ԃ̒ɔႷ.
+ * @retval false	ҏW MAX_EDITS zĂdȂȂ.
+ */
+bool LineDiff::Bisect(const Range& r, std::vector<Range>& work)
+{
+	const int n = (int) (r.a1 - r.a0);
+	const int m = (int) (r.b1 - r.b0);
+	const uint32* a = &mA.ids[r.a0];
+	const uint32* b = &mB.ids[r.b0];
+	const int max = std::min((n + m + 1) / 2, (int) MAX_EDITS);
+	const int delta = n - m;
+	const bool front = (delta & 1) != 0;	// ǑoHŏdȂ𒲂ׂ邩?
+
+	// vf[k] ͑ǑoHΊp k œBŉ x. vb[k] ͌납̌oH́AI_琔 x.
+	std::vector<int> vfbuf(2 * max + 3, -1);
+	std::vector<int> vbbuf(2 * max + 3, -1);
+	int* vf = &vfbuf[max + 1];
+	int* vb = &vbbuf[max + 1];
+	vf[1] = vb[1] = 0;
+	int kf0 = 0, kf1 = 0, kb0 = 0, kb1 = 0;	// Ԃ͂ݏoΊp΂.
+	for (int d = 0; d <= max; ++d) {
+		for (int k = -d + kf0; k <= d - kf1; k += 2) {
+			int x = (k == -d || (k != d && vf[k-1] < vf[k+1])) ? vf[k+1] : vf[k-1] + 1;
+			int y = x - k;
+			while (x < n && y < m && a[x] == b[y])
+				++x, ++y;
+			vf[k] = x;
+			if (x > n)
+				kf1 += 2;
+			else if (y > m)
+				kf0 += 2;
+			else if (front) {
+				int kb = delta - k;
+				if (kb >= -max && kb <= max && vb[kb] != -1 && x >= n - vb[kb])
+					return Split(r, x, y, work);
+			}
+		}
+		for (int k = -d + kb0; k <= d - kb1; k += 2) {
+			int x = (k == -d || (k != d && vb[k-1] < vb[k+1])) ? vb[k+1] : vb[k-1] + 1;
+			int y = x - k;
+			while (x < n && y < m && a[n-x-1] == b[m-y-1])
+				++x, ++y;
+			vb[k] = x;
+			if (x > n)
+				kb1 += 2;
+			else if (y > m)
+				kb0 += 2;
+			else if (!front) {
+				int kf = delta - k;
+				if (kf >= -max && kf <= max && vf[kf] != -1 && vf[kf] >= n - x)
+					return Split(r, vf[kf], vf[kf] - kf, work);
+			}
+		}
+	}
+	return false;
+}
+
+/** ԂA x sڂƐV y sڂœ񕪂čƃXgɐς. */
+bool LineDiff::Split(const Range& r, int x, int y, std::vector<Range>& work)
+{
+	Range head = { r.a0, r.a0 + x, r.b0, r.b0 + y, true };
+	Range tail = { r.a0 + x, r.a1, r.b0 + y, r.b1, true };
+	work.push_back(tail);
+	work.push_back(head);
+	return true;
+}
+
+/** Ԃ̑SĂ̍s changed t. */
+void LineDiff::MarkAll(const Range& r)
+{
+	for (size_t i = r.a0; i < r.a1; ++i)
+		mA.changed[i] = 1;
+	for (size_t j = r.b0; j < r.b1; ++j)
+		mB.changed[j] = 1;
+}
+
+/** changed ̕ts̘AA̍sԍ̑ӏɂ.
+ * ӏɗׂ荇s͑ӏɊ܂߂. Övs̊ԂÂ܂ܒu͈̔͂ƂȂ.
+ */
+void LineDiff::MakeHunks(std::vector<DiffHunk>& hunks) const
+{
+	hunks.clear();
+	size_t na = mA.ids.size(), nb = mB.ids.size();
+	size_t i = 0, j = 0;
+	while (i < na || j < nb) {
+		if (i < na && j < nb && !mA.changed[i] && !mB.changed[j]) {
+			++i, ++j;
+			continue;
+		}
+		size_t i0 = i, j0 = j;
+		while (i < na && mA.changed[i]) ++i;
+		while (j < nb && mB.changed[j]) ++j;
+		DiffHunk h;
+		h.a_begin = i0 > 0 ? mA.index[i0-1] + 1 : 0;
+		h.a_end = i < na ? mA.index[i] : mA.lines.size();
+		h.b_begin = j0 > 0 ? mB.index[j0-1] + 1 : 0;
+		h.b_end = j < nb ? mB.index[j] : mB.lines.size();
+		hunks.push_back(h);
+	}
+}
+
+//........................................................................
+/** unified `͈̔ "Jns,s"  out ɒǉ. diff ƓA1sȂ΍sȂA0sȂΒO̍sԍJnsƂ. */
+void LineDiff::AppendRange(std::string& out, size_t begin, size_t end)
+{
+	char buf[50];
+	if (end - begin == 1)
+		_snprintf(buf, sizeof(buf), "%llu", (uint64) end);
+	else
+		_snprintf(buf, sizeof(buf), "%llu,%llu", (uint64) (end > begin ? begin + 1 : begin), (uint64) (end - begin));
+	buf[sizeof(buf)-1] = '\0';
+	out += buf;
+}
+
+/** st out ɒǉ. */
+void LineDiff::AppendLines(std::string& out, char mark, const Side& side, size_t begin, size_t end) const
+{
+	for (size_t i = begin; i < end; ++i) {
+		const Line& line = side.lines[i];
+		size_t len = line.len;
+		if (len > 0 && line.ptr[len-1] == '\r')
+			--len;
+		out += mark;
+		out.append(line.ptr, len);
+		out += '\n';
+		if (i + 1 == side.lines.size() && side.no_eol)
+			out += "\\ No newline at end of file\n";
+	}
+}
+
+void LineDiff::FormatUnified(const char* name1, const char* name2, const std::vector<DiffHunk>& hunks, std::string& out) const
+{
+	if (hunks.empty())
+		return;
+	out += "--- ";
+	out += name1;
+	out += "\n+++ ";
+	out += name2;
+	out += '\n';
+	const size_t ctx = (size_t) mOpt.context;
+	for (size_t g = 0; g < hunks.size(); ) {
+		// O̕dȂ鑊ӏ̉ɂ܂Ƃ߂.
+		size_t e = g + 1;
+		while (e < hunks.size() && hunks[e].a_begin - hunks[e-1].a_end <= ctx * 2)
+			++e;
+		const DiffHunk& first = hunks[g];
+		const DiffHunk& last = hunks[e-1];
+		size_t a0 = first.a_begin > ctx ? first.a_begin - ctx : 0;
+		size_t a1 = std::min(last.a_end + ctx, mA.lines.size());
+		size_t b0 = first.b_begin > first.a_begin - a0 ? first.b_begin - (first.a_begin - a0) : 0;
+		size_t b1 = std::min(last.b_end + (a1 - last.a_end), mB.lines.size());
+		out += "@@ -";
+		AppendRange(out, a0, a1);
+		out += " +";
+		AppendRange(out, b0, b1);
+		out += " @@\n";
+
+		// ͋̍sŕ\. 󔒂s𖳎Ă̂ŁAVƊSɂ͈vȂƂ.
+		size_t a = a0;
+		for (size_t k = g; k < e; ++k) {
+			AppendLines(out, ' ', mA, a, hunks[k].a_begin);
+			AppendLines(out, '-', mA, hunks[k].a_begin, hunks[k].a_end);
+			AppendLines(out, '+', mB, hunks[k].b_begin, hunks[k].b_end);
+			a = hunks[k].a_end;
+		}
+		AppendLines(out, ' ', mA, a, a1);
+		g = e;
+	}
+}
+
+//------------------------------------------------------------------------
+/** t@CŜǂݏopŊ蓖Ă. ̃t@C͊蓖ĂɁA0̃eLXgƂ. */
+static bool map_text(const char* path, FILE*& fp, MappedFile& map, long& err)
+{
+	fp = fopen(path, "rb");
+	if (fp == NULL) {
+		err = last_syserror();
+		return false;
+	}
+	if (!map.Map(fp) && (_fseeki64(fp, 0, SEEK_END) != 0 || _ftelli64(fp) != 0)) {
+		err = last_syserror();
+		return false;
+	}
+	return true;
+}
+
+/** eLXgƂĈȂe? 擪 8KB  NUL ܂߂΃oCiƂ݂Ȃ. */
+static bool is_binary(const uchar* data, size_t size)
+{
+	return data && memchr(data, '\0', std::min(size, (size_t) 0x2000)) != NULL;
+}
+
+/** ̃t@C̑ out ɒǉ.
+ * eLXgȂ unified `ōs̑AoCi܂ max_size zȂ΃TCYsŕ\.
+ * Xbh瓯ɌĂł悢.
+ * @retval false	JȂ. G[R[h err Ɋi[.
+ */
+bool diff_files(const char* path1, const char* path2, const DiffOptions& opt, std::string& out, long& err)
+{
+	FILE* fp1 = NULL;
+	FILE* fp2 = NULL;
+	MappedFile map1, map2;
+	bool ok = map_text(path1, fp1, map1, err) && map_text(path2, fp2, map2, err);
+	if (ok) {
+		char buf[100];
+		const uchar* data1 = map1.Data();
+		const uchar* data2 = map2.Data();
+		uint64 size1 = map1.Size(), size2 = map2.Size();
+		if (size1 > opt.max_size || size2 > opt.max_size || is_binary(data1, (size_t) size1) || is_binary(data2, (size_t) size2)) {
+			_snprintf(buf, sizeof(buf), " differ (%llu and %llu bytes)\n", size1, size2);
+			buf[sizeof(buf)-1] = '\0';
+			out += std::string("Binary files ") + path1 + " and " + path2 + buf;
+		}
+		else {
+			LineDiff diff(opt);
+			std::vector<DiffHunk> hunks;
+			diff.Compare((const char*) data1, (size_t) size1, (const char*) data2, (size_t) size2, hunks);
+			if (hunks.empty())
+				out += std::string("Files ") + path1 + " and " + path2 + " differ only in white space or blank lines\n";
+			else
+				diff.FormatUnified(path1, path2, hunks, out);
+		}
+	}
+	map1.Close();
+	map2.Close();
+	if (fp1) fclose(fp1);
+	if (fp2) fclose(fp2);
+	return ok;
+}
+
+// difffunc.cpp - end.
@@ -3,10 +3,53 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <new>
+#include <string>
+#ifdef _WIN32
+#include <windows.h>
 #include <io.h>
+#include <mbctype.h>
+#else
+#include <time.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 //------------------------------------------------------------------------
-extern void error_abort(const char* prompt, const char* arg);
+/** @name io.h  _finddata_t .
+ * POSIX ł͉BhbgŎn܂閼OƂAVXe͖.
+ * @{
+ */
+#define _A_NORMAL	0x00
+#define _A_RDONLY	0x01
+#define _A_HIDDEN	0x02
+#define _A_SYSTEM	0x04
+#define _A_SUBDIR	0x10
+#define _A_ARCH		0x20
+#define _A_LINK		0x400	///< V{bNN. Ǝ̑ŁAl Windows  FILE_ATTRIBUTE_REPARSE_POINT ɍ킹.
+
+struct _finddata_t {
+	unsigned attrib;
+	time_t time_create;		///< POSIX ł͏ԕύX(st_ctime).
+	time_t time_access;
+	time_t time_write;
+	__int64 size;
+	char name[_MAX_FNAME];
+};
+//@}
+#endif
+#ifdef _WIN32
+/** V{bNN̑. Windows ł̓WNVȂǂʂɃtH_ƂĈ̂ 0 Ƃ. */
+#define _A_LINK		0
+#endif
 
 //------------------------------------------------------------------------
 /** ChJ[hLĂ邩? */
@@ -15,55 +58,248 @@ inline bool has_wildcard(const char* pathname)
 	return strpbrk(pathname, "*?") != NULL;
 }
 
-/** pXAtH_ƃt@Cɕ.
+/** t@CChJ[hɈv邩? '*' 0ȏA'?' 1Ɉv.
+ * _findfirst ƓAWindows ł͑啶ʂA"*.*" ͑SĂ̖OɈv.
+ * POSIX ł FindFile Ɠ fnmatch ŏƍ.
+ */
+bool match_wildcard(const char* wild, const char* name)
+{
+	if (strcmp(wild, "*.*") == 0)
+		return true;
+#ifdef _WIN32
+	const char* star = NULL;	// O '*' ̎̈ʒu.
+	const char* back = NULL;	// O '*' Ɉv̖.
+	while (*name) {
+		if (*wild == '*') {
+			star = ++wild;
+			back = name;
+			continue;
+		}
+		size_t n = (_ismbblead((uchar) *name) && name[1]) ? 2 : 1;
+		if (*wild == '?'
+			|| (n == 1 && *wild && toupper((uchar) *wild) == toupper((uchar) *name))
+			|| (n == 2 && wild[0] == name[0] && wild[1] == name[1])) {
+			wild += (*wild == '?') ? 1 : n;
+			name += n;
+			continue;
+		}
+		if (star == NULL)
+			return false;
+		// '*' Ɉv镔1΂āA蒼.
+		back += (_ismbblead((uchar) *back) && back[1]) ? 2 : 1;
+		wild = star;
+		name = back;
+	}
+	while (*wild == '*')
+		++wild;
+	return *wild == '\0';
+#else
+	return fnmatch(wild, name, 0) == 0;
+#endif
+}
+
+/** pX̒̃t@C̈ʒuԂ. Ō̃pX؂L(Windowsł̓hCu ':' )̎̈ʒuƂȂ.
+ * pX𕡎ʂɁA擪Ԃl܂łtH_AԂlt@CƂĈ.
+ * e.g. "a:\dir\dir\sample.cpp" => 11 ("a:\dir\dir\"  "sample.cpp")
  * @param pathname	͂pX.
- * @param folder	tH_̊i[(svȂNULL). e.g. "a:\dir\dir\"
- * @param name		t@C̊i[(svȂNULL). e.g. "sample.cpp"
+ * @param len		pathname ̃oCg.
  */
-void separate_pathname(const char* pathname, char* folder, char* name)
+size_t pathname_name_pos(const char* pathname, size_t len)
 {
-	if (strlen(pathname) >= _MAX_PATH)
-		error_abort("too long pathname", pathname);
-	char drv[_MAX_DRIVE];
-	char dir[_MAX_DIR];
-	char base[_MAX_FNAME];
-	char ext[_MAX_EXT];
-	_splitpath(pathname, drv, dir, base, ext);
-	if (folder != NULL)
-		_makepath(folder, drv, dir, NULL, NULL);
-	if (name != NULL)
-		_makepath(name, NULL, NULL, base, ext);
+	const char* end = pathname + len;
+	const char* name = pathname;
+#ifdef _WIN32
+	// VtgJIS2oCgڂ '\' ؂LƌFȂ悤ɁAPʂŐi߂.
+	for (const char* p = pathname; p < end; ++p) {
+		if (_ismbblead((uchar) *p) && p + 1 < end)
+			++p;
+		else if (*p == '\\' || *p == '/' || *p == ':')
+			name = p + 1;
+	}
+#else
+	for (const char* p = end; p > pathname; --p) {
+		if (p[-1] == '/') {
+			name = p;
+			break;
+		}
+	}
+#endif
+	return name - pathname;
 }
 
-/** tH_ƃt@CpXɌ.
- * @param pathname	pX̊i[.
- * @param folder	tH_
- * @param name		t@C
+size_t pathname_name_pos(const char* pathname)
+{
+	return pathname_name_pos(pathname, strlen(pathname));
+}
+
+/** len oCg̃tH_̌ɖO𑱂ƂApX؂LޕKv邩?
+ * ̃tH_(JgtH_)A؂LŏItH_AWindows̃hCu "a:" ɂ͋܂Ȃ.
  */
-void make_pathname(char* pathname, const char* folder, const char* name)
+bool pathname_needs_sep(const char* folder, size_t len)
+{
+	if (len == 0)
+		return false;
+	char c = folder[len-1];
+#ifdef _WIN32
+	if (c == '/' || c == ':')
+		return false;
+	if (c != '\\')
+		return true;
+	//  '\' ̓VtgJIS2oCgڂȂ. ̉\Ƃ擪͂.
+	if (len >= 2 && _ismbblead((uchar) folder[len-2]))
+		return pathname_name_pos(folder, len) != len;
+	return false;
+#else
+	return c != '/';
+#endif
+}
+
+/** tH_̌Ƀt@C. KvȂ΃pX؂L. */
+void append_pathname(std::string& path, const char* name)
 {
-	size_t folder_len = strlen(folder);
-	if (folder_len >= _MAX_DRIVE + _MAX_DIR)
-		error_abort("too long folder name", folder);
-	if (strlen(name) >= _MAX_FNAME)
-		error_abort("too long file name", name);
-
-	if (folder_len == 2 && folder[1] == ':')
-		_makepath(pathname, folder, NULL, name, NULL);
-	else
-		_makepath(pathname, NULL, folder, name, NULL);
+	if (pathname_needs_sep(path.data(), path.size()))
+		path += MY_PATH_SEP;
+	path += name;
 }
 
+//------------------------------------------------------------------------
+/** pX̑gݗăobt@.
+ * tH_؂~Ƃ Push() ŖO𖖔ɒǉA߂Ƃ Push() Ԃʒu܂ Pop() Ő؂l߂.
+ * ʏ̒̃pX͓̌Œobt@Ɏ߁ApX̂Ƃq[vɐL΂.
+ * xL΂͎̈g񂷂̂ŁAT̃pX̒ǉƐ؂l߂ł̓mۂŜ̕ʂNȂ.
+ * ͖̏. OSAPIɓn钷̏OSŔ肳.
+ */
+class PathBuf {
+	char* mBuf;
+	size_t mLen;
+	size_t mCap;
+	char mInline[_MAX_PATH];
+
+	PathBuf(const PathBuf&);			// Rs[֎~.
+	void operator=(const PathBuf&);		// ֎~.
+public:
+	PathBuf() : mBuf(mInline), mLen(0), mCap(sizeof(mInline)) {
+		mBuf[0] = '\0';
+	}
+	explicit PathBuf(const char* s) : mBuf(mInline), mLen(0), mCap(sizeof(mInline)) {
+		Assign(s, strlen(s));
+	}
+	~PathBuf() {
+		if (mBuf != mInline)
+			free(mBuf);
+	}
+
+	//....................................................................
+	/** pX. */
+	const char* c_str() const {
+		return mBuf;
+	}
+	/** pX̃oCg. */
+	size_t Length() const {
+		return mLen;
+	}
+	/** t@C. Ō̋؂L̎. */
+	const char* Name() const {
+		return mBuf + pathname_name_pos(mBuf, mLen);
+	}
+
+	//....................................................................
+	/** pX s ̐擪 n oCgɂ. */
+	void Assign(const char* s, size_t n) {
+		mLen = 0;
+		Append(s, n);
+	}
+	void Assign(const char* s) {
+		Assign(s, strlen(s));
+	}
+
+	/** pX̖ s ̐擪 n oCgǉ. ؂L͕Ȃ. */
+	void Append(const char* s, size_t n) {
+		Reserve(mLen + n);
+		memmove(mBuf + mLen, s, n);
+		mLen += n;
+		mBuf[mLen] = '\0';
+	}
+	void Append(const char* s) {
+		Append(s, strlen(s));
+	}
+
+	/** KvȂ΃pX؂LǉāAtH_ƂĈ悤ɂ. */
+	void AppendSep() {
+		if (pathname_needs_sep(mBuf, mLen))
+			Append(MY_PATH_SEP_STR, 1);
+	}
+
+	/** KvȂ΃pX؂LŁAOǉ.
+	 * @return	ǉO̒. Pop() ɓnƌɖ߂.
+	 */
+	size_t Push(const char* name) {
+		size_t mark = mLen;
+		AppendSep();
+		Append(name);
+		return mark;
+	}
+
+	/** Push() O̒ɐ؂l߂. */
+	void Pop(size_t mark) {
+		if (mark < mLen) {
+			mLen = mark;
+			mBuf[mLen] = '\0';
+		}
+	}
+
+	/** I[ '\0'  n oCgi[ł悤ɂ. */
+	void Reserve(size_t n) {
+		if (n < mCap)
+			return;
+		size_t cap = mCap * 2;
+		if (cap <= n)
+			cap = n + 1;
+		char* buf = (char*) malloc(cap);
+		if (buf == NULL)
+			throw std::bad_alloc();
+		memcpy(buf, mBuf, mLen);
+		buf[mLen] = '\0';
+		if (mBuf != mInline)
+			free(mBuf);
+		mBuf = buf;
+		mCap = cap;
+	}
+};
+
 //------------------------------------------------------------------------
 /** t@CNX.
  * _findfirst/next̃bp[NXł.
+ * POSIX ł openat/getdents64 ŃtH_ǂ݁AOfnmatchŏƍ.
+ * ʂ d_type 瓾̂ŁAƃTCYsvȂ need_stat=false Ƃ fstatat Ȃ.
  */
 class FindFile : public _finddata_t {
-	long mHandle;
+	long mHandle;			///< POSIX ł̓tH_̃t@CLqq.
+	long mError;			///< JnłȂƂ̃G[R[h.
+#ifndef _WIN32
+	bool mNeedStat;			///< ƃTCY𓾂邩?
+	char mWild[_MAX_FNAME];	///< ƍp^[.
+	char mBuf[0x4000];		///< getdents64 ̓ǂݏoobt@.
+	size_t mBufPos;
+	size_t mBufLen;
+#ifndef __linux__
+	DIR* mDir;
+#endif
+	const char* ReadEntry(unsigned& type);
+	bool Fill(const char* entry, unsigned type);
+#endif
+	FindFile(const FindFile&);			// Rs[֎~.
+	void operator=(const FindFile&);	// ֎~.
 public:
 	//....................................................................
-	/** RXgN^. */
-	FindFile() : mHandle(-1) {}
+	/** RXgN^.
+	 * @param need_stat	ƃTCYKv? Windowsł͏ɓ̂Ŗ.
+	 */
+#ifdef _WIN32
+	explicit FindFile(bool need_stat = true) : mHandle(-1), mError(0) {}
+#else
+	explicit FindFile(bool need_stat = true) : mHandle(-1), mError(0), mNeedStat(need_stat), mBufPos(0), mBufLen(0) {}
+#endif
 
 	/** fXgN^. rȂClose()s. */
 	~FindFile() {
@@ -80,10 +316,14 @@ public:
 
 	//@{
 	/** . I[ɒB玩IClose()s. */
+#ifdef _WIN32
 	void Next() {
 		if (_findnext(mHandle, this) != 0)
 			Close();
 	}
+#else
+	void Next();
+#endif
 	void operator++() {
 		Next();
 	}
@@ -91,9 +331,13 @@ public:
 
 	//@{
 	/// I.
+#ifdef _WIN32
 	void Close() {
 		_findclose(mHandle); mHandle = -1;
 	}
+#else
+	void Close();
+#endif
 	//@}
 
 	//....................................................................
@@ -109,6 +353,12 @@ public:
 	bool operator!() const {
 		return !Opened();
 	}
+	/** tH_ǂ߂ɌJnłȂƂ̃G[R[h(GetLastError/errno).
+	 * v閼OȂ0.
+	 */
+	long Error() const {
+		return mError;
+	}
 
 	//....................................................................
 	/** t@C擾. */
@@ -127,6 +377,10 @@ public:
 	bool IsSystem() const {
 		return (attrib & _A_SYSTEM) != 0;
 	}
+	/** V{bNN? Windows ł͏ false. */
+	bool IsLink() const {
+		return (attrib & _A_LINK) != 0;
+	}
 	/** ΃tH_("." or "..")? */
 	bool IsDotFolder() const;
 };
@@ -134,16 +388,166 @@ public:
 //........................................................................
 void FindFile::Open(const char* dir, const char* wild)
 {
-	char path[_MAX_PATH + _MAX_FNAME + 10]; // pX؂L̒ǉɔ +10̗]TƂ.
-	make_pathname(path, dir, wild);
-	Open(path);
+	PathBuf path(dir);
+	path.Push(wild);
+	Open(path.c_str());
 }
 
 //........................................................................
+#ifdef _WIN32
 void FindFile::Open(const char* pathname)
 {
 	mHandle = _findfirst(pathname, this);
+	mError = 0;
+	if (mHandle == -1) {
+		DWORD err = ::GetLastError();
+		if (err != ERROR_FILE_NOT_FOUND && err != ERROR_NO_MORE_FILES)
+			mError = (long) err;
+	}
+}
+
+#else
+void FindFile::Open(const char* pathname)
+{
+	if (mHandle != -1)
+		Close();
+
+	// pathname tH_Əƍp^[ɕ. "*.*"  Windows ƓSĂ̖OɈv.
+	const char* slash = strrchr(pathname, '/');
+	const char* wild = slash ? slash + 1 : pathname;
+	mError = 0;
+	if (strlen(wild) >= sizeof(mWild)) {
+		mError = ENAMETOOLONG;
+		return;
+	}
+	strcpy(mWild, strcmp(wild, "*.*") == 0 ? "*" : wild);
+
+	if (slash == NULL) {
+		mHandle = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	}
+	else {
+		std::string dir(pathname, (slash == pathname) ? 1 : slash - pathname);
+		mHandle = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	}
+	if (mHandle == -1) {
+		mError = errno;
+		return;
+	}
+#ifndef __linux__
+	mDir = fdopendir((int) mHandle);
+	if (mDir == NULL) {
+		mError = errno;
+		close((int) mHandle);
+		mHandle = -1;
+		return;
+	}
+#endif
+	mBufPos = mBufLen = 0;
+	Next();
+}
+
+//........................................................................
+void FindFile::Next()
+{
+	unsigned type;
+	const char* entry;
+	while ((entry = ReadEntry(type)) != NULL) {
+		if (fnmatch(mWild, entry, 0) == 0 && Fill(entry, type))
+			return;
+	}
+	Close();
+}
+
+//........................................................................
+void FindFile::Close()
+{
+	if (mHandle == -1)
+		return;
+#ifdef __linux__
+	close((int) mHandle);
+#else
+	closedir(mDir);
+#endif
+	mHandle = -1;
+}
+
+//........................................................................
+/** tH_玟̖Oǂݏo. I[Ȃ NULL Ԃ.
+ * @param type	d_type ̊i[. t@CVXeʂԂȂ DT_UNKNOWN ƂȂ.
+ */
+const char* FindFile::ReadEntry(unsigned& type)
+{
+#ifdef __linux__
+	// getdents64 ̓obt@ɋl߂邾̃GgxɕԂ. readdir ̂悤 DIR \̂̊mۂƃbNȂ.
+	struct linux_dirent64 {
+		uint64 d_ino;
+		__int64 d_off;
+		unsigned short d_reclen;
+		unsigned char d_type;
+		char d_name[1];
+	};
+	if (mBufPos >= mBufLen) {
+		long n = syscall(SYS_getdents64, (int) mHandle, mBuf, sizeof(mBuf));
+		if (n <= 0)
+			return NULL;
+		mBufLen = (size_t) n;
+		mBufPos = 0;
+	}
+	const linux_dirent64* d = (const linux_dirent64*) (mBuf + mBufPos);
+	mBufPos += d->d_reclen;
+	type = d->d_type;
+	return d->d_name;
+#else
+	const dirent* d = readdir(mDir);
+	if (d == NULL)
+		return NULL;
+	type = d->d_type;
+	return d->d_name;
+#endif
+}
+
+//........................................................................
+/** O _finddata_t 𖄂߂.
+ * @retval false	stat łȂ(񋓌ɍ폜ꂽ). ǂݔ΂.
+ */
+bool FindFile::Fill(const char* entry, unsigned type)
+{
+	size_t len = strlen(entry);
+	if (len >= sizeof(name))
+		return false;
+	memcpy(name, entry, len + 1);
+
+	// V{bNN̓N̎ʂƂANł邱Ƃ _A_LINK Ŏ.
+	bool is_link = (type == DT_LNK);
+	if (type == DT_UNKNOWN) {
+		struct stat st;
+		if (fstatat((int) mHandle, entry, &st, AT_SYMLINK_NOFOLLOW) != 0)
+			return false;
+		is_link = S_ISLNK(st.st_mode);
+	}
+	bool is_folder = (type == DT_DIR);
+	if (mNeedStat || type == DT_UNKNOWN || type == DT_LNK) {
+		struct stat st;
+		if (fstatat((int) mHandle, entry, &st, 0) != 0)
+			return false;
+		is_folder = S_ISDIR(st.st_mode);
+		time_create = st.st_ctime;
+		time_access = st.st_atime;
+		time_write  = st.st_mtime;
+		size = S_ISDIR(st.st_mode) ? 0 : (__int64) st.st_size;
+	}
+	else {
+		time_create = time_access = time_write = 0;
+		size = 0;
+	}
+	attrib = is_folder ? _A_SUBDIR : _A_NORMAL;
+	if (is_link)
+		attrib |= _A_LINK;
+	if (entry[0] == '.' && !IsDotFolder())	// "."  ".." ȊÕhbgŎn܂閼OBt@CƂ.
+		attrib |= _A_HIDDEN;
+	return true;
 }
+#endif //_WIN32
 
 //........................................................................
 bool FindFile::IsDotFolder() const
@@ -3,6 +3,8 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
 
 //------------------------------------------------------------------------
 extern const char* gUsage;
@@ -45,14 +47,48 @@ void errorf_abort(const char* fmt, ...)
 #ifdef _WIN32
 #include <windows.h>
 
-/** G[bZ[WƁAWin32̏ڍ׃G[\ */
-void print_win32error(const char* msg)
+/** ÕG[R[h(GetLastError). */
+long last_syserror()
+{
+	return (long) ::GetLastError();
+}
+
+/** G[bZ[WƁAWin32̏ڍ׃G[1s̕ɂ. ɉs͕tȂ. */
+void format_syserror(char* buf, size_t size, const char* msg, long code)
+{
+	char text[1000];
+	if (::FormatMessageA(FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, NULL, (DWORD) code, 0, text, sizeof(text), NULL) == 0)
+		text[0] = '\0';
+	size_t len = strlen(text);
+	while (len > 0 && (text[len-1] == '\n' || text[len-1] == '\r'))
+		text[--len] = '\0';
+	_snprintf(buf, size, "%s: Win32Error(%ld) %s", msg, code, text);
+	buf[size-1] = '\0';
+}
+
+#else //_WIN32
+#include <errno.h>
+
+/** ÕG[R[h(errno). */
+long last_syserror()
 {
-	DWORD win32error = ::GetLastError();
-	char buf[1000];
-	::FormatMessageA(FORMAT_MESSAGE_FROM_SYSTEM, NULL, win32error, 0, buf, sizeof(buf), NULL);
-	fprintf(stderr, "%s: Win32Error(%d) %s", msg, win32error, buf);
+	return errno;
+}
+
+/** G[bZ[WƁAerrnȍڍ׃G[1s̕ɂ. ɉs͕tȂ. */
+void format_syserror(char* buf, size_t size, const char* msg, long code)
+{
+	snprintf(buf, size, "%s: Error(%ld) %s", msg, code, strerror((int) code));
 }
 
 #endif //_WIN32
+
+/** G[bZ[WƁAOS̏ڍ׃G[\. */
+void print_win32error(const char* msg)
+{
+	char buf[1200];
+	format_syserror(buf, sizeof(buf), msg, last_syserror());
+	fprintf(stderr, "%s\n", buf);
+}
+
 // errfunc.cpp - end.
@@ -0,0 +1,488 @@
+/**@file filefunc.cpp --- file I/O functions.
+ * errfunc.cpp  include 邱.
+ * @author Hiroshi Kuno <http://code.google.com/p/win32cmdx/>
+ */
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include <string.h>
+#include <vector>
+
+//------------------------------------------------------------------------
+/** UNIX(1970N̕b)AFILETIMEl(1601N100nsP)ɕϊ. */
+inline uint64 unixtime_to_filetime(__int64 t)
+{
+	return (uint64) (t + 11644473600LL) * 10000000ULL;
+}
+
+/** FILETIMElAUNIXɕϊ. */
+inline __int64 filetime_to_unixtime(uint64 ft)
+{
+	return (__int64) (ft / 10000000ULL) - 11644473600LL;
+}
+
+/** FILETIMElAUTC̔Nbɕ.
+ * 1601N400N̐擪Ȃ̂ŁAOSI̎ɍ΁AOSAPIg킸ɋ܂.
+ * @param ymdhms	N,,,,,b̊i[.
+ */
+void filetime_to_calendar(uint64 ft, uint ymdhms[6])
+{
+	uint64 sec = ft / 10000000ULL;
+	uint days = (uint) (sec / 86400);
+	uint rest = (uint) (sec % 86400);
+	ymdhms[3] = rest / 3600;
+	ymdhms[4] = rest / 60 % 60;
+	ymdhms[5] = rest % 60;
+
+	uint year = 1601 + days / 146097 * 400;
+	days %= 146097;
+	uint n = days / 36524;		// 100N. Ō̎[̕1.
+	if (n == 4)
+		n = 3;
+	year += n * 100;
+	days -= n * 36524;
+	year += days / 1461 * 4;	// 4N.
+	days %= 1461;
+	n = days / 365;				// 1N. Ō̔N[̕1.
+	if (n == 4)
+		n = 3;
+	year += n;
+	days -= n * 365;
+
+	static const uint mdays[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+	uint month = 0;
+	for (; month < 11; ++month) {
+		uint len = mdays[month] + (month == 1 && leap);
+		if (days < len)
+			break;
+		days -= len;
+	}
+	ymdhms[0] = year;
+	ymdhms[1] = month + 1;
+	ymdhms[2] = days + 1;
+}
+
+/** DOS([J)AFILETIMEl(UTC)ɕϊ.
+ * @retval false	s.
+ */
+bool dos_datetime_to_filetime(uint16 dos_date, uint16 dos_time, uint64& ft)
+{
+#ifdef _WIN32
+	FILETIME local, utc;
+	if (!::DosDateTimeToFileTime(dos_date, dos_time, &local) || !::LocalFileTimeToFileTime(&local, &utc))
+		return false;
+	ft = ((uint64) utc.dwHighDateTime << 32) + utc.dwLowDateTime;
+	return true;
+#else
+	struct tm t;
+	memset(&t, 0, sizeof(t));
+	t.tm_year = (dos_date >> 9) + 80;
+	t.tm_mon  = ((dos_date >> 5) & 15) - 1;
+	t.tm_mday = dos_date & 31;
+	t.tm_hour = dos_time >> 11;
+	t.tm_min  = (dos_time >> 5) & 63;
+	t.tm_sec  = (dos_time & 31) * 2;
+	t.tm_isdst = -1;
+	if (t.tm_mon < 0 || t.tm_mon > 11 || t.tm_mday == 0 || t.tm_hour > 23 || t.tm_min > 59 || t.tm_sec > 59)
+		return false;
+	time_t ut = mktime(&t);
+	if (ut == (time_t) -1)
+		return false;
+	ft = unixtime_to_filetime(ut);
+	return true;
+#endif
+}
+
+//------------------------------------------------------------------------
+/** tH_쐬.
+ * @retval true	쐬A܂͊ɑ݂.
+ */
+bool create_folder(const char* path)
+{
+#ifdef _WIN32
+	return ::CreateDirectoryA(path, NULL) || ::GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+	return mkdir(path, 0777) == 0 || errno == EEXIST;
+#endif
+}
+
+//------------------------------------------------------------------------
+/** t@C̓ꐫƍXV𔻒肷. SĈv΁At@C̓eƂ݂Ȃ. */
+struct FileStamp {
+	uint64 size;
+	uint64 mtime;		///< XV. FILETIMEl.
+	uint64 volume;		///< {[̃VAԍ. POSIX ł̓foCXԍ.
+	uint64 file_id;		///< t@CID. POSIX łim[hԍ.
+};
+
+//------------------------------------------------------------------------
+/** ʒuwœǂݏt@C.
+ * ǂݏo̓t@CʒuLȂ̂ŁA̃IuWFNg𕡐Xbh瓯ɓǂݏoĂ悢.
+ * ݂͐擪珇ɍs.
+ */
+class RandomFile {
+#ifdef _WIN32
+	HANDLE mHandle;
+#else
+	int mHandle;
+#endif
+
+	RandomFile(const RandomFile&);		// Rs[֎~.
+	void operator=(const RandomFile&);	// ֎~.
+public:
+#ifdef _WIN32
+	RandomFile() : mHandle(INVALID_HANDLE_VALUE) {}
+#else
+	RandomFile() : mHandle(-1) {}
+#endif
+
+	~RandomFile() {
+		Close();
+	}
+
+	//....................................................................
+#ifdef _WIN32
+	/** ǂݏopɊJ. ReadAt()sČĂׂ悤ɁA񓯊I/O[hŊJ. */
+	bool OpenRead(const char* fname) {
+		Close();
+		mHandle = ::CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
+		return IsOpen();
+	}
+
+	/** ݗpɐVK쐬. t@C͐؂l߂. */
+	bool Create(const char* fname) {
+		Close();
+		mHandle = ::CreateFileA(fname, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+			CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		return IsOpen();
+	}
+
+	/** . */
+	void Close() {
+		if (IsOpen())
+			::CloseHandle(mHandle);
+		mHandle = INVALID_HANDLE_VALUE;
+	}
+
+	/** JĂ邩? */
+	bool IsOpen() const {
+		return mHandle != INVALID_HANDLE_VALUE;
+	}
+#else
+	/** ǂݏopɊJ. ReadAt()preadœǂނ̂ŁAsČĂł悢. */
+	bool OpenRead(const char* fname) {
+		Close();
+		mHandle = open(fname, O_RDONLY | O_CLOEXEC);
+		return IsOpen();
+	}
+
+	/** ݗpɐVK쐬. t@C͐؂l߂. */
+	bool Create(const char* fname) {
+		Close();
+		mHandle = open(fname, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+		return IsOpen();
+	}
+
+	/** . */
+	void Close() {
+		if (IsOpen())
+			close(mHandle);
+		mHandle = -1;
+	}
+
+	/** JĂ邩? */
+	bool IsOpen() const {
+		return mHandle != -1;
+	}
+#endif
+
+	//....................................................................
+	/** t@CTCY. */
+	uint64 Size() const {
+#ifdef _WIN32
+		LARGE_INTEGER size;
+		return ::GetFileSizeEx(mHandle, &size) ? (uint64) size.QuadPart : 0;
+#else
+		struct stat st;
+		return fstat(mHandle, &st) == 0 ? (uint64) st.st_size : 0;
+#endif
+	}
+
+	/** ꐫƍXV𔻒肷𓾂. */
+	bool Stamp(FileStamp& st) const;
+
+	/** offsetʒunoCgǂݏoAǂݏooCgԂ. */
+	size_t ReadAt(void* buf, size_t n, uint64 offset) const;
+
+	/** ݈ʒunoCg. */
+	bool Write(const void* buf, size_t n);
+
+	/** t@CTCY\ߊmۂ. ݈ʒu͐擪ɖ߂.
+	 * fЉAݒ̃t@CLȂ߂Ɏg.
+	 */
+	bool Preallocate(uint64 size) {
+#ifdef _WIN32
+		LARGE_INTEGER pos;
+		pos.QuadPart = (LONGLONG) size;
+		if (!::SetFilePointerEx(mHandle, pos, NULL, FILE_BEGIN) || !::SetEndOfFile(mHandle))
+			return false;
+		pos.QuadPart = 0;
+		return ::SetFilePointerEx(mHandle, pos, NULL, FILE_BEGIN) != 0;
+#else
+		// posix_fallocate ɑΉȂt@CVXeł́ATCY̐ݒ肾s.
+		if (posix_fallocate(mHandle, 0, (off_t) size) != 0 && ftruncate(mHandle, (off_t) size) != 0)
+			return false;
+		return lseek(mHandle, 0, SEEK_SET) == 0;
+#endif
+	}
+
+	/** XVݒ肷.
+	 * @param mtime	FILETIMEl.
+	 */
+	bool SetTime(uint64 mtime) {
+#ifdef _WIN32
+		FILETIME ft;
+		ft.dwLowDateTime  = (DWORD) mtime;
+		ft.dwHighDateTime = (DWORD) (mtime >> 32);
+		return ::SetFileTime(mHandle, NULL, NULL, &ft) != 0;
+#else
+		struct timespec ts[2];
+		ts[0].tv_sec  = 0;
+		ts[0].tv_nsec = UTIME_OMIT;
+		ts[1].tv_sec  = (time_t) filetime_to_unixtime(mtime);
+		ts[1].tv_nsec = (long) (mtime % 10000000ULL) * 100;
+		return futimens(mHandle, ts) == 0;
+#endif
+	}
+};
+
+//........................................................................
+#ifdef _WIN32
+bool RandomFile::Stamp(FileStamp& st) const
+{
+	BY_HANDLE_FILE_INFORMATION info;
+	if (!::GetFileInformationByHandle(mHandle, &info))
+		return false;
+	st.size    = ((uint64) info.nFileSizeHigh << 32) | info.nFileSizeLow;
+	st.mtime   = ((uint64) info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+	st.volume  = info.dwVolumeSerialNumber;
+	st.file_id = ((uint64) info.nFileIndexHigh << 32) | info.nFileIndexLow;
+	return true;
+}
+
+size_t RandomFile::ReadAt(void* buf, size_t n, uint64 offset) const
+{
+	// OVERLAPPED ŃItZbgw肷. Cxg͌Ăяoɗpӂ̂ŁAɌĂ΂ĂȂ.
+	HANDLE event = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+	size_t total = 0;
+	while (total < n) {
+		DWORD chunk = (DWORD) ((n - total) < 0x40000000 ? (n - total) : 0x40000000);
+		OVERLAPPED ov;
+		ZeroMemory(&ov, sizeof(ov));
+		ov.Offset     = (DWORD) (offset + total);
+		ov.OffsetHigh = (DWORD) ((offset + total) >> 32);
+		ov.hEvent     = event;
+		DWORD got = 0;
+		if (!::ReadFile(mHandle, (char*) buf + total, chunk, &got, &ov)) {
+			if (::GetLastError() != ERROR_IO_PENDING || !::GetOverlappedResult(mHandle, &ov, &got, TRUE))
+				break;
+		}
+		if (got == 0)
+			break;
+		total += got;
+	}
+	::CloseHandle(event);
+	return total;
+}
+
+//........................................................................
+bool RandomFile::Write(const void* buf, size_t n)
+{
+	size_t total = 0;
+	while (total < n) {
+		DWORD chunk = (DWORD) ((n - total) < 0x40000000 ? (n - total) : 0x40000000);
+		DWORD wrote = 0;
+		if (!::WriteFile(mHandle, (const char*) buf + total, chunk, &wrote, NULL) || wrote == 0)
+			return false;
+		total += wrote;
+	}
+	return true;
+}
+
+#else
+bool RandomFile::Stamp(FileStamp& st) const
+{
+	struct stat s;
+	if (fstat(mHandle, &s) != 0)
+		return false;
+	st.size    = (uint64) s.st_size;
+	st.mtime   = unixtime_to_filetime(s.st_mtim.tv_sec) + (uint64) s.st_mtim.tv_nsec / 100;
+	st.volume  = (uint64) s.st_dev;
+	st.file_id = (uint64) s.st_ino;
+	return true;
+}
+
+size_t RandomFile::ReadAt(void* buf, size_t n, uint64 offset) const
+{
+	// pread ̓t@CʒugȂ̂ŁAɌĂ΂ĂȂ.
+	size_t total = 0;
+	while (total < n) {
+		size_t chunk = (n - total) < 0x40000000 ? (n - total) : 0x40000000;
+		ssize_t got = pread(mHandle, (char*) buf + total, chunk, (off_t) (offset + total));
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got <= 0)
+			break;
+		total += got;
+	}
+	return total;
+}
+
+//........................................................................
+bool RandomFile::Write(const void* buf, size_t n)
+{
+	size_t total = 0;
+	while (total < n) {
+		size_t chunk = (n - total) < 0x40000000 ? (n - total) : 0x40000000;
+		ssize_t wrote = write(mHandle, (const char*) buf + total, chunk);
+		if (wrote < 0 && errno == EINTR)
+			continue;
+		if (wrote <= 0)
+			return false;
+		total += wrote;
+	}
+	return true;
+}
+#endif
+
+//------------------------------------------------------------------------
+/** ǂݏop̃}bvht@C.
+ * JĂt@CŜAhXԂɊ蓖Ă. pCṽt@CȂǁA蓖ĂȂ͎̂s.
+ */
+class MappedFile {
+	const uchar* mData;
+	size_t mSize;
+#ifdef _WIN32
+	HANDLE mMapping;
+#endif
+
+	MappedFile(const MappedFile&);		// Rs[֎~.
+	void operator=(const MappedFile&);	// ֎~.
+public:
+#ifdef _WIN32
+	MappedFile() : mData(NULL), mSize(0), mMapping(NULL) {}
+#else
+	MappedFile() : mData(NULL), mSize(0) {}
+#endif
+
+	~MappedFile() {
+		Close();
+	}
+
+	//....................................................................
+	/** fp̊JĂt@C蓖Ă. t@Cʒu͕ςȂ. */
+	bool Map(FILE* fp) {
+		Close();
+#ifdef _WIN32
+		HANDLE h = (HANDLE) _get_osfhandle(_fileno(fp));
+		LARGE_INTEGER size;
+		if (h == INVALID_HANDLE_VALUE || ::GetFileType(h) != FILE_TYPE_DISK
+			|| !::GetFileSizeEx(h, &size) || size.QuadPart == 0 || (uint64) size.QuadPart > (size_t) -1)
+			return false;
+		mMapping = ::CreateFileMapping(h, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mMapping == NULL)
+			return false;
+		mData = (const uchar*) ::MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+		if (mData == NULL) {
+			Close();
+			return false;
+		}
+		mSize = (size_t) size.QuadPart;
+#else
+		int fd = fileno(fp);
+		struct stat st;
+		if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 || (uint64) st.st_size > (size_t) -1)
+			return false;
+		void* p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (p == MAP_FAILED)
+			return false;
+		mData = (const uchar*) p;
+		mSize = (size_t) st.st_size;
+#endif
+		return true;
+	}
+
+	/** 蓖Ă. */
+	void Close() {
+#ifdef _WIN32
+		if (mData)
+			::UnmapViewOfFile(mData);
+		if (mMapping)
+			::CloseHandle(mMapping);
+		mMapping = NULL;
+#else
+		if (mData)
+			munmap((void*) mData, mSize);
+#endif
+		mData = NULL;
+		mSize = 0;
+	}
+
+	//....................................................................
+	/** 蓖Ăf[^̐擪. */
+	const uchar* Data() const {
+		return mData;
+	}
+
+	/** 蓖Ăf[^̃TCY. */
+	size_t Size() const {
+		return mSize;
+	}
+};
+
+//------------------------------------------------------------------------
+/** ̃t@C̓er.
+ * TCYقȂΓǂ܂ɁuقȂvƂ. Ȃΐ擪ʂʒuwœǂ݁Aŏ̑őł؂.
+ * Xbh瓯ɌĂł悢.
+ * @retval 0	e.
+ * @retval 1	قȂe.
+ * @retval -1	JȂA܂͓ǂ߂Ȃ. G[R[h err Ɋi[.
+ */
+int compare_files(const char* path1, const char* path2, long& err)
+{
+	RandomFile f1, f2;
+	if (!f1.OpenRead(path1) || !f2.OpenRead(path2)) {
+		err = last_syserror();
+		return -1;
+	}
+	uint64 size = f1.Size();
+	if (size != f2.Size())
+		return 1;
+
+	const size_t CHUNK = 0x40000;
+	std::vector<char> buf(CHUNK * 2);
+	char* b1 = &buf[0];
+	char* b2 = &buf[CHUNK];
+	for (uint64 pos = 0; pos < size; pos += CHUNK) {
+		size_t n = (size - pos) < CHUNK ? (size_t) (size - pos) : CHUNK;
+		if (f1.ReadAt(b1, n, pos) != n || f2.ReadAt(b2, n, pos) != n) {
+			err = last_syserror();
+			return -1;
+		}
+		if (memcmp(b1, b2, n) != 0)
+			return 1;
+	}
+	return 0;
+}
+
+// filefunc.cpp - end.
@@ -0,0 +1,387 @@
+/**@file hashfunc.cpp --- hash functions.
+ * @author Hiroshi Kuno <http://code.google.com/p/win32cmdx/>
+ */
+#include <stddef.h>
+#include <string.h>
+
+//------------------------------------------------------------------------
+/** FNV-1a 64bitnbV̏l */
+const uint64 FNV1A64_INIT = 0xcbf29ce484222325ULL;
+
+/** FNV-1a 64bitnbVlvZ.
+ * AubNɗ^ČvZꍇ́AO̖߂l hash ɓn.
+ * @param data	f[^
+ * @param len	f[^
+ * @param hash	nbVl̏l
+ */
+inline uint64 fnv1a64(const void* data, size_t len, uint64 hash = FNV1A64_INIT)
+{
+	const uchar* p = (const uchar*) data;
+	while (len--) {
+		hash ^= *p++;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+//------------------------------------------------------------------------
+/** CRC-32(ZIP, IEEE 802.3)̌vZ\.
+ * 8oCgPʂŏ slicing-by-8 @̂߂8ʂ̕\.
+ * XbhgĂǂ悤ɁAvOJnɐÓIō쐬.
+ */
+class Crc32Table {
+public:
+	uint32 t[8][256];
+
+	Crc32Table() {
+		for (uint32 i = 0; i < 256; ++i) {
+			uint32 c = i;
+			for (int k = 0; k < 8; ++k)
+				c = (c & 1) ? (c >> 1) ^ 0xedb88320U : (c >> 1);
+			t[0][i] = c;
+		}
+		for (uint32 i = 0; i < 256; ++i) {
+			for (int k = 1; k < 8; ++k)
+				t[k][i] = (t[k-1][i] >> 8) ^ t[0][t[k-1][i] & 0xff];
+		}
+	}
+};
+
+const Crc32Table gCrc32Table;
+
+/** CRC-32lvZ.
+ * AubNɗ^ČvZꍇ́AO̖߂l crc ɓn.
+ * @param data	f[^
+ * @param len	f[^
+ * @param crc	ǑvZl. 0.
+ */
+inline uint32 crc32(const void* data, size_t len, uint32 crc = 0)
+{
+	const uint32 (*t)[256] = gCrc32Table.t;
+	const uchar* p = (const uchar*) data;
+	crc = ~crc;
+	for (; len >= 8; len -= 8, p += 8) {
+		uint32 lo = crc ^ (p[0] | ((uint32)p[1] << 8) | ((uint32)p[2] << 16) | ((uint32)p[3] << 24));
+		uint32 hi = p[4] | ((uint32)p[5] << 8) | ((uint32)p[6] << 16) | ((uint32)p[7] << 24);
+		crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+			^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+	}
+	while (len--)
+		crc = t[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+//------------------------------------------------------------------------
+/** @name SHA-256 (FIPS 180-4).
+ * k֐́ACPUSHAg(SHA-NI)Ă΂gAC++ŌvZ.
+ * SHA-NȊgݍ݊֐ VC++2015 ȍ~ GCC/Clang łgȂ̂ŁAÂVC++łC++łƂȂ.
+ * @{
+ */
+#if defined(_MSC_VER) && _MSC_VER >= 1900 && (defined(_M_IX86) || defined(_M_X64))
+#define MY_SHA256_SHANI	1
+#include <intrin.h>
+#include <immintrin.h>
+#define MY_SHA256_TARGET
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define MY_SHA256_SHANI	1
+#include <cpuid.h>
+#include <immintrin.h>
+#define MY_SHA256_TARGET	__attribute__((target("sha,sse4.1,ssse3")))
+#endif
+
+/** SHA-256̃Eh萔 */
+const uint32 SHA256_K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+inline uint32 sha256_rotr(uint32 x, int n)
+{
+	return (x >> n) | (x << (32 - n));
+}
+
+/** 64oCgPʂ̃ubNk. C++. */
+void sha256_blocks_generic(uint32* state, const uchar* p, size_t nblocks)
+{
+	uint32 w[64];
+	for (; nblocks > 0; --nblocks, p += 64) {
+		for (int i = 0; i < 16; ++i)
+			w[i] = ((uint32)p[i*4] << 24) | ((uint32)p[i*4+1] << 16) | ((uint32)p[i*4+2] << 8) | p[i*4+3];
+		for (int i = 16; i < 64; ++i) {
+			uint32 s0 = sha256_rotr(w[i-15], 7) ^ sha256_rotr(w[i-15], 18) ^ (w[i-15] >> 3);
+			uint32 s1 = sha256_rotr(w[i-2], 17) ^ sha256_rotr(w[i-2], 19) ^ (w[i-2] >> 10);
+			w[i] = w[i-16] + s0 + w[i-7] + s1;
+		}
+		uint32 a = state[0], b = state[1], c = state[2], d = state[3];
+		uint32 e = state[4], f = state[5], g = state[6], h = state[7];
+		for (int i = 0; i < 64; ++i) {
+			uint32 t1 = h + (sha256_rotr(e, 6) ^ sha256_rotr(e, 11) ^ sha256_rotr(e, 25))
+				+ ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+			uint32 t2 = (sha256_rotr(a, 2) ^ sha256_rotr(a, 13) ^ sha256_rotr(a, 22))
+				+ ((a & b) ^ (a & c) ^ (b & c));
+			h = g; g = f; f = e; e = d + t1;
+			d = c; c = b; b = a; a = t1 + t2;
+		}
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+	}
+}
+
+#ifdef MY_SHA256_SHANI
+/** CPUSHA-NIƁAƑgݍ킹ĎgSSSE3, SSE4.1? */
+bool cpu_has_shani()
+{
+#ifdef _MSC_VER
+	int r[4];
+	__cpuid(r, 0);
+	if (r[0] < 7)
+		return false;
+	__cpuid(r, 1);
+	bool ssse3 = (r[2] & (1 << 9)) != 0, sse41 = (r[2] & (1 << 19)) != 0;
+	__cpuidex(r, 7, 0);
+	return ssse3 && sse41 && (r[1] & (1 << 29)) != 0;
+#else
+	unsigned int a = 0, b = 0, c = 0, d = 0;
+	if (__get_cpuid_max(0, 0) < 7)
+		return false;
+	__get_cpuid(1, &a, &b, &c, &d);
+	bool ssse3 = (c & (1 << 9)) != 0, sse41 = (c & (1 << 19)) != 0;
+	__cpuid_count(7, 0, a, b, c, d);
+	return ssse3 && sse41 && (b & (1 << 29)) != 0;
+#endif
+}
+
+/** 64oCgPʂ̃ubNk. SHA-NI.
+ * state  ABEF/CDGH 2WX^ɕבւĕێA4Eh.
+ */
+MY_SHA256_TARGET void sha256_blocks_shani(uint32* state, const uchar* p, size_t nblocks)
+{
+	const __m128i BSWAP = _mm_set_epi64x(0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+	__m128i tmp    = _mm_loadu_si128((const __m128i*) &state[0]);	// DCBA
+	__m128i state1 = _mm_loadu_si128((const __m128i*) &state[4]);	// HGFE
+	tmp    = _mm_shuffle_epi32(tmp, 0xB1);			// CDAB
+	state1 = _mm_shuffle_epi32(state1, 0x1B);		// EFGH
+	__m128i state0 = _mm_alignr_epi8(tmp, state1, 8);	// ABEF
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);	// CDGH
+
+	for (; nblocks > 0; --nblocks, p += 64) {
+		const __m128i abef = state0, cdgh = state1;
+		__m128i m[4], msg;
+		for (int i = 0; i < 4; ++i)
+			m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (p + i*16)), BSWAP);
+
+		// 16EhɃbZ[W4g. m[i&3]  W[4i..4i+3].
+		for (int i = 0; i < 16; ++i) {
+			msg = _mm_add_epi32(m[i & 3], _mm_loadu_si128((const __m128i*) &SHA256_K[i*4]));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			msg = _mm_shuffle_epi32(msg, 0x0E);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+			if (i >= 3 && i < 15) {
+				// W[4(i+1)..] = msg2(msg1(W[4(i-3)..], W[4(i-2)..]) + alignr(W[4i..], W[4(i-1)..]), W[4i..])
+				__m128i t = _mm_add_epi32(_mm_sha256msg1_epu32(m[(i+1) & 3], m[(i+2) & 3]),
+					_mm_alignr_epi8(m[i & 3], m[(i+3) & 3], 4));
+				m[(i+1) & 3] = _mm_sha256msg2_epu32(t, m[i & 3]);
+			}
+		}
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+	}
+
+	tmp    = _mm_shuffle_epi32(state0, 0x1B);		// FEBA
+	state1 = _mm_shuffle_epi32(state1, 0xB1);		// DCHG
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0);	// DCBA
+	state1 = _mm_alignr_epi8(state1, tmp, 8);		// HGFE
+	_mm_storeu_si128((__m128i*) &state[0], state0);
+	_mm_storeu_si128((__m128i*) &state[4], state1);
+}
+#endif //MY_SHA256_SHANI
+
+/** k֐. vOJnɁACPUɍ킹đI. */
+void (* const sha256_blocks)(uint32* state, const uchar* p, size_t nblocks) =
+#ifdef MY_SHA256_SHANI
+	cpu_has_shani() ? sha256_blocks_shani :
+#endif
+	sha256_blocks_generic;
+
+/** SHA-256nbVľvZ.
+ * f[^ Update() ŏɗ^AFinal() 32oCg̃nbVl𓾂.
+ */
+class Sha256 {
+	uint32 mState[8];
+	uchar mBuf[64];		///< ubNɖȂ.
+	size_t mBufLen;
+	uint64 mTotal;		///< ͂̑oCg.
+public:
+	Sha256() {
+		Init();
+	}
+
+	void Init() {
+		static const uint32 H0[8] = {
+			0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+		};
+		memcpy(mState, H0, sizeof(mState));
+		mBufLen = 0;
+		mTotal = 0;
+	}
+
+	void Update(const void* data, size_t len) {
+		const uchar* p = (const uchar*) data;
+		mTotal += len;
+		if (mBufLen > 0) {
+			size_t n = 64 - mBufLen < len ? 64 - mBufLen : len;
+			memcpy(mBuf + mBufLen, p, n);
+			mBufLen += n;
+			p += n;
+			len -= n;
+			if (mBufLen < 64)
+				return;
+			sha256_blocks(mState, mBuf, 1);
+			mBufLen = 0;
+		}
+		if (len >= 64) {
+			sha256_blocks(mState, p, len / 64);
+			p += len & ~(size_t)63;
+			len &= 63;
+		}
+		memcpy(mBuf, p, len);
+		mBufLen = len;
+	}
+
+	/** nbVl digest Ɋi[. Ďgɂ Init() 邱. */
+	void Final(uchar* digest) {
+		uint64 bits = mTotal * 8;
+		uchar pad[72];
+		size_t padlen = (mBufLen < 56 ? 56 : 120) - mBufLen;
+		memset(pad, 0, sizeof(pad));
+		pad[0] = 0x80;
+		for (int i = 0; i < 8; ++i)
+			pad[padlen + i] = (uchar) (bits >> (56 - i*8));
+		Update(pad, padlen + 8);
+		for (int i = 0; i < 8; ++i) {
+			digest[i*4]   = (uchar) (mState[i] >> 24);
+			digest[i*4+1] = (uchar) (mState[i] >> 16);
+			digest[i*4+2] = (uchar) (mState[i] >> 8);
+			digest[i*4+3] = (uchar) mState[i];
+		}
+	}
+};
+//@}
+
+//------------------------------------------------------------------------
+/** @name MurmurHash3 x64 128bit. Ípł͂Ȃ128bitnbV. t@Ce̓ꐫ̔Ɏg.
+ * @{
+ */
+inline uint64 murmur3_rotl64(uint64 x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+inline uint64 murmur3_fmix64(uint64 k)
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+	return k;
+}
+
+/** MurmurHash3 x64 128bit ̌vZ.
+ * f[^ Update() ŏɗ^AFinal() 16oCg̃nbVl𓾂. xɗ^ꍇƓlɂȂ.
+ */
+class Murmur3_128 {
+	uint64 mH1, mH2;
+	uchar mBuf[16];		///< ubNɖȂ.
+	size_t mBufLen;
+	uint64 mTotal;		///< ͂̑oCg.
+public:
+	explicit Murmur3_128(uint32 seed = 0) {
+		Init(seed);
+	}
+
+	void Init(uint32 seed = 0) {
+		mH1 = mH2 = seed;
+		mBufLen = 0;
+		mTotal = 0;
+	}
+
+	void Update(const void* data, size_t len) {
+		const uchar* p = (const uchar*) data;
+		mTotal += len;
+		if (mBufLen > 0) {
+			size_t n = 16 - mBufLen < len ? 16 - mBufLen : len;
+			memcpy(mBuf + mBufLen, p, n);
+			mBufLen += n;
+			p += n;
+			len -= n;
+			if (mBufLen < 16)
+				return;
+			Blocks(mBuf, 1);
+			mBufLen = 0;
+		}
+		if (len >= 16) {
+			Blocks(p, len / 16);
+			p += len & ~(size_t)15;
+			len &= 15;
+		}
+		memcpy(mBuf, p, len);
+		mBufLen = len;
+	}
+
+	/** nbVl digest Ɋi[. h1, h2 ̏ɃgGfBAŕׂ. Ďgɂ Init() 邱. */
+	void Final(uchar* digest) {
+		const uint64 c1 = 0x87c37b91114253d5ULL;
+		const uint64 c2 = 0x4cf5ad432745937fULL;
+		uint64 k1 = 0, k2 = 0;
+		for (size_t i = mBufLen; i > 8; --i)
+			k2 = (k2 << 8) | mBuf[i-1];
+		for (size_t i = mBufLen < 8 ? mBufLen : 8; i > 0; --i)
+			k1 = (k1 << 8) | mBuf[i-1];
+		if (mBufLen > 8) {
+			k2 *= c2; k2 = murmur3_rotl64(k2, 33); k2 *= c1; mH2 ^= k2;
+		}
+		if (mBufLen > 0) {
+			k1 *= c1; k1 = murmur3_rotl64(k1, 31); k1 *= c2; mH1 ^= k1;
+		}
+		uint64 h1 = mH1 ^ mTotal;
+		uint64 h2 = mH2 ^ mTotal;
+		h1 += h2;
+		h2 += h1;
+		h1 = murmur3_fmix64(h1);
+		h2 = murmur3_fmix64(h2);
+		h1 += h2;
+		h2 += h1;
+		for (int i = 0; i < 8; ++i) {
+			digest[i]   = (uchar) (h1 >> (i*8));
+			digest[i+8] = (uchar) (h2 >> (i*8));
+		}
+	}
+
+private:
+	void Blocks(const uchar* p, size_t nblocks) {
+		const uint64 c1 = 0x87c37b91114253d5ULL;
+		const uint64 c2 = 0x4cf5ad432745937fULL;
+		uint64 h1 = mH1, h2 = mH2;
+		for (; nblocks > 0; --nblocks, p += 16) {
+			uint64 k1, k2;
+			memcpy(&k1, p, 8);		// x86 ̓gGfBA.
+			memcpy(&k2, p + 8, 8);
+			k1 *= c1; k1 = murmur3_rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+			h1 = murmur3_rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+			k2 *= c2; k2 = murmur3_rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+			h2 = murmur3_rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+		}
+		mH1 = h1;
+		mH2 = h2;
+	}
+};
+//@}
+
+// hashfunc.cpp - end.
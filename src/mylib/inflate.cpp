@@ -0,0 +1,445 @@
+/**@file inflate.cpp --- deflate decoder.
+ * @author Hiroshi Kuno <http://code.google.com/p/win32cmdx/>
+ *
+ * RFC 1951 (DEFLATE Compressed Data Format Specification version 1.3) ̃fR[_.
+ * ͂ InflateSource 班ǂݏoAo͂ 32KB Pʂ InflateSink ֑ôŁA
+ * WJ̃f[^ŜɒuKv͖.
+ */
+#include <string.h>
+
+//------------------------------------------------------------------------
+/** kf[^̓͌. */
+class InflateSource {
+public:
+	virtual ~InflateSource() {}
+
+	/** őnoCg buf ɓǂݏoAǂݏooCgԂ. I[Ȃ0Ԃ. */
+	virtual size_t Read(void* buf, size_t n) = 0;
+};
+
+/** WJf[^̏o͐. */
+class InflateSink {
+public:
+	virtual ~InflateSink() {}
+
+	/** noCg̃f[^o͂. s false Ԃ. */
+	virtual bool Write(const void* data, size_t n) = 0;
+};
+
+//------------------------------------------------------------------------
+/** deflatefR[_.
+ * nt}́̕AZ(FAST_BITSȉ)\A𐳏͈͔̔rŋ߂.
+ * ̃IuWFNg𕡐̃Xg[̓WJɎg񂵂Ă悢AXbhŋLĂ͂Ȃ.
+ */
+class Inflater {
+public:
+	enum { FAST_BITS = 9 };
+
+	/** nt}\ */
+	struct Huffman {
+		uint16 fast[1 << FAST_BITS];	///< (rbg]ς) (<<9)|l \. 0͕\O.
+		uint16 firstcode[16];
+		int    maxcode[17];
+		uint16 firstsymbol[16];
+		uchar  size[288];
+		uint16 value[288];
+	};
+
+private:
+	enum { WINDOW_SIZE = 0x10000, WINDOW_MASK = WINDOW_SIZE - 1, FLUSH_SIZE = 0x8000, INPUT_SIZE = 0x10000 };
+
+	InflateSource* mSource;
+	InflateSink* mSink;
+	const char* mError;			///< G[e. ȂNULL.
+
+	uchar mInput[INPUT_SIZE];	///< ̓obt@.
+	size_t mInPos;
+	size_t mInLen;
+	int mZeroBytes;				///< ͏I[Ȍɕ0oCg̐.
+
+	uint32 mCodeBuffer;			///< rbgobt@. LSB珇ɏ.
+	int mNumBits;				///< rbgobt@̗Lrbg.
+
+	uchar mWindow[WINDOW_SIZE];	///< o͂̃XCh. O32KBȏێ.
+	uint32 mOut;				///< o͍ς݃oCg(݈̏ʒu).
+	uint32 mFlushed;			///< mSink֑ooCg.
+	uint64 mTotalOut;			///< WJ̑oCg.
+
+	Huffman mFixedLength;
+	Huffman mFixedDistance;
+	Huffman mLength;
+	Huffman mDistance;
+
+	Inflater(const Inflater&);			// Rs[֎~.
+	void operator=(const Inflater&);	// ֎~.
+public:
+	Inflater() {
+		// Œnt}\(RFC1951 3.2.6)쐬Ă.
+		uchar sizes[288];
+		int i;
+		for (i = 0;   i <= 143; ++i) sizes[i] = 8;
+		for (     ;   i <= 255; ++i) sizes[i] = 9;
+		for (     ;   i <= 279; ++i) sizes[i] = 7;
+		for (     ;   i <= 287; ++i) sizes[i] = 8;
+		BuildHuffman(mFixedLength, sizes, 288);
+		for (i = 0; i < 30; ++i) sizes[i] = 5;
+		BuildHuffman(mFixedDistance, sizes, 30);
+	}
+
+	/** deflateXg[WJ.
+	 * @retval false	G[. e Error() œ.
+	 */
+	bool Inflate(InflateSource& in, InflateSink& out);
+
+	/** G[e. */
+	const char* Error() const {
+		return mError ? mError : "no error";
+	}
+
+	/** O Inflate() œWJoCg. */
+	uint64 TotalOut() const {
+		return mTotalOut;
+	}
+
+	/** nt}\쐬.
+	 * @param z			쐬
+	 * @param sizelist	eV{̕
+	 * @param num		V{
+	 */
+	static bool BuildHuffman(Huffman& z, const uchar* sizelist, int num);
+
+private:
+	//....................................................................
+	static int BitReverse16(int n) {
+		n = ((n & 0xAAAA) >> 1) | ((n & 0x5555) << 1);
+		n = ((n & 0xCCCC) >> 2) | ((n & 0x3333) << 2);
+		n = ((n & 0xF0F0) >> 4) | ((n & 0x0F0F) << 4);
+		n = ((n & 0xFF00) >> 8) | ((n & 0x00FF) << 8);
+		return n;
+	}
+
+	static int BitReverse(int v, int bits) {
+		return BitReverse16(v) >> (16 - bits);
+	}
+
+	/** ͂1oCg. I[Ȍ0₤. */
+	int GetByte() {
+		if (mInPos >= mInLen) {
+			mInLen = mSource->Read(mInput, sizeof(mInput));
+			mInPos = 0;
+			if (mInLen == 0) {
+				++mZeroBytes;
+				return 0;
+			}
+		}
+		return mInput[mInPos++];
+	}
+
+	/** rbgobt@25rbgȏɕ[. */
+	void FillBits() {
+		do {
+			mCodeBuffer |= (uint32) GetByte() << mNumBits;
+			mNumBits += 8;
+		} while (mNumBits <= 24);
+	}
+
+	/** nrbgo. */
+	uint32 GetBits(int n) {
+		if (mNumBits < n)
+			FillBits();
+		uint32 k = mCodeBuffer & ((1U << n) - 1);
+		mCodeBuffer >>= n;
+		mNumBits -= n;
+		return k;
+	}
+
+	/** nt}. G[ȂΕԂ. */
+	int Decode(const Huffman& z) {
+		if (mNumBits < 16)
+			FillBits();
+		int b = z.fast[mCodeBuffer & ((1 << FAST_BITS) - 1)];
+		if (b) {
+			int s = b >> 9;
+			mCodeBuffer >>= s;
+			mNumBits -= s;
+			return b & 511;
+		}
+		return DecodeSlow(z);
+	}
+
+	int DecodeSlow(const Huffman& z);
+
+	/** ͏I[zēǂ݉߂ĂȂ? */
+	bool Overrun() const {
+		return mZeroBytes > 4;
+	}
+
+	//....................................................................
+	/** 1oCgo͂. */
+	bool Put(uchar c) {
+		mWindow[mOut++ & WINDOW_MASK] = c;
+		return mOut - mFlushed < FLUSH_SIZE || Flush();
+	}
+
+	bool Flush();
+	bool Stored();
+	bool Compressed(const Huffman& length, const Huffman& distance);
+	bool ComputeHuffmanCodes();
+
+	bool Fail(const char* msg) {
+		if (!mError)
+			mError = msg;
+		return false;
+	}
+};
+
+//........................................................................
+bool Inflater::BuildHuffman(Huffman& z, const uchar* sizelist, int num)
+{
+	int i, k = 0;
+	int code, next_code[16], sizes[17];
+
+	memset(sizes, 0, sizeof(sizes));
+	memset(z.fast, 0, sizeof(z.fast));
+	for (i = 0; i < num; ++i)
+		++sizes[sizelist[i]];
+	sizes[0] = 0;
+	for (i = 1; i < 16; ++i) {
+		if (sizes[i] > (1 << i))
+			return false;
+	}
+	code = 0;
+	for (i = 1; i < 16; ++i) {
+		next_code[i] = code;
+		z.firstcode[i] = (uint16) code;
+		z.firstsymbol[i] = (uint16) k;
+		code += sizes[i];
+		if (sizes[i] && code - 1 >= (1 << i))
+			return false;	// Ă.
+		z.maxcode[i] = code << (16 - i);	// 16rbgɍl߂Ȁ̕̕.
+		code <<= 1;
+		k += sizes[i];
+	}
+	z.maxcode[16] = 0x10000;
+	for (i = 0; i < num; ++i) {
+		int s = sizelist[i];
+		if (s) {
+			int c = next_code[s] - z.firstcode[s] + z.firstsymbol[s];
+			uint16 fastv = (uint16) ((s << 9) | i);
+			z.size[c]  = (uchar) s;
+			z.value[c] = (uint16) i;
+			if (s <= FAST_BITS) {
+				// ̓rbg]Ċi[Ă̂ŁA]l̏ʃrbgωđSĖ߂.
+				for (int j = BitReverse(next_code[s], s); j < (1 << FAST_BITS); j += (1 << s))
+					z.fast[j] = fastv;
+			}
+			++next_code[s];
+		}
+	}
+	return true;
+}
+
+//........................................................................
+int Inflater::DecodeSlow(const Huffman& z)
+{
+	int k = BitReverse((int) (mCodeBuffer & 0xffff), 16);
+	int s;
+	for (s = FAST_BITS + 1; ; ++s) {
+		if (k < z.maxcode[s])
+			break;
+	}
+	if (s >= 16)
+		return -1;	// sȕ.
+	int b = (k >> (16 - s)) - z.firstcode[s] + z.firstsymbol[s];
+	if (b >= 288 || z.size[b] != s)
+		return -1;
+	mCodeBuffer >>= s;
+	mNumBits -= s;
+	return z.value[b];
+}
+
+//........................................................................
+bool Inflater::Flush()
+{
+	while (mFlushed != mOut) {
+		uint32 pos = mFlushed & WINDOW_MASK;
+		uint32 n = mOut - mFlushed;
+		if (n > WINDOW_SIZE - pos)
+			n = WINDOW_SIZE - pos;	// ̏I[Ő܂Ԃ.
+		if (!mSink->Write(mWindow + pos, n))
+			return Fail("write error");
+		mFlushed += n;
+		mTotalOut += n;
+	}
+	return true;
+}
+
+//........................................................................
+bool Inflater::Stored()
+{
+	// oCgEɑ.
+	GetBits(mNumBits & 7);
+	uint32 len  = GetBits(16);
+	uint32 nlen = GetBits(16);
+	if ((len ^ 0xffff) != nlen)
+		return Fail("corrupt stored block");
+
+	// rbgobt@ɎcĂoCgɏo͂Ac͓̓obt@璼ڏo͂.
+	while (len > 0 && mNumBits > 0) {
+		if (!Put((uchar) GetBits(8)))
+			return false;
+		--len;
+	}
+	while (len > 0) {
+		int c = GetByte();
+		if (Overrun())
+			return Fail("unexpected end of stored block");
+		if (!Put((uchar) c))
+			return false;
+		--len;
+	}
+	return true;
+}
+
+//........................................................................
+bool Inflater::Compressed(const Huffman& length, const Huffman& distance)
+{
+	static const int length_base[31] = {
+		3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,
+		35,43,51,59,67,83,99,115,131,163,195,227,258,0,0 };
+	static const int length_extra[31] = {
+		0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0,0,0 };
+	static const int dist_base[32] = {
+		1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,
+		257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577,0,0 };
+	static const int dist_extra[32] = {
+		0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13,0,0 };
+
+	for (;;) {
+		int z = Decode(length);
+		if (z < 0 || Overrun())
+			return Fail("bad huffman code");
+		if (z < 256) {
+			if (!Put((uchar) z))
+				return false;
+			continue;
+		}
+		if (z == 256)
+			return true;	// end of block.
+		z -= 257;
+		if (z >= 29)
+			return Fail("bad length code");
+		int len = length_base[z];
+		if (length_extra[z])
+			len += GetBits(length_extra[z]);
+		z = Decode(distance);
+		if (z < 0 || z >= 30)
+			return Fail("bad distance code");
+		uint32 dist = dist_base[z];
+		if (dist_extra[z])
+			dist += GetBits(dist_extra[z]);
+		if (dist > FLUSH_SIZE || (mTotalOut == 0 && dist > mOut))
+			return Fail("distance too far back");
+		while (len--) {
+			if (!Put(mWindow[(mOut - dist) & WINDOW_MASK]))
+				return false;
+		}
+	}
+}
+
+//........................................................................
+bool Inflater::ComputeHuffmanCodes()
+{
+	static const uchar length_dezigzag[19] = { 16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 };
+	Huffman z_codelength;
+	uchar lencodes[286+32+137];	// ő啄 + Ō̌JԂɂ͂ݏo.
+	uchar codelength_sizes[19];
+
+	int hlit  = GetBits(5) + 257;
+	int hdist = GetBits(5) + 1;
+	int hclen = GetBits(4) + 4;
+	int ntot  = hlit + hdist;
+
+	memset(codelength_sizes, 0, sizeof(codelength_sizes));
+	for (int i = 0; i < hclen; ++i)
+		codelength_sizes[length_dezigzag[i]] = (uchar) GetBits(3);
+	if (!BuildHuffman(z_codelength, codelength_sizes, 19))
+		return Fail("bad code lengths");
+
+	int n = 0;
+	while (n < ntot) {
+		int c = Decode(z_codelength);
+		if (c < 0 || c >= 19 || Overrun())
+			return Fail("bad code lengths");
+		if (c < 16) {
+			lencodes[n++] = (uchar) c;
+			continue;
+		}
+		uchar fill = 0;
+		if (c == 16) {
+			c = GetBits(2) + 3;
+			if (n == 0)
+				return Fail("bad code lengths");
+			fill = lencodes[n-1];
+		}
+		else if (c == 17) {
+			c = GetBits(3) + 3;
+		}
+		else {
+			c = GetBits(7) + 11;
+		}
+		if (ntot - n < c)
+			return Fail("bad code lengths");
+		memset(lencodes + n, fill, c);
+		n += c;
+	}
+	if (lencodes[256] == 0)
+		return Fail("no end-of-block code");
+	if (!BuildHuffman(mLength, lencodes, hlit))
+		return Fail("bad literal/length codes");
+	if (!BuildHuffman(mDistance, lencodes + hlit, hdist))
+		return Fail("bad distance codes");
+	return true;
+}
+
+//........................................................................
+bool Inflater::Inflate(InflateSource& in, InflateSink& out)
+{
+	mSource = &in;
+	mSink = &out;
+	mError = NULL;
+	mInPos = mInLen = 0;
+	mZeroBytes = 0;
+	mCodeBuffer = 0;
+	mNumBits = 0;
+	mOut = mFlushed = 0;
+	mTotalOut = 0;
+
+	int final;
+	do {
+		final = GetBits(1);
+		int type = GetBits(2);
+		bool ok;
+		switch (type) {
+		case 0:
+			ok = Stored();
+			break;
+		case 1:
+			ok = Compressed(mFixedLength, mFixedDistance);
+			break;
+		case 2:
+			ok = ComputeHuffmanCodes() && Compressed(mLength, mDistance);
+			break;
+		default:
+			ok = Fail("bad block type");
+			break;
+		}//.endswitch
+		if (!ok)
+			return false;
+		if (Overrun())
+			return Fail("unexpected end of data");
+	} while (!final);
+	return Flush();
+}
+
+// inflate.cpp - end.
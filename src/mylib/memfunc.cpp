@@ -0,0 +1,233 @@
+/**@file memfunc.cpp --- memory allocation functions.
+ * @author Hiroshi Kuno <http://code.google.com/p/win32cmdx/>
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <vector>
+
+//------------------------------------------------------------------------
+/** A[i(ovAP[^).
+ * 傫ȃubNmۂĂA̒珇ɐ؂oĊ蓖Ă.
+ * ʂ̉͂łAClear()ňꊇ.
+ * ʂ̏ȕێꍇɁAmalloc̃I[o[wbhƒfЉ邱Ƃł.
+ */
+class Arena {
+	std::vector<char*> mBlocks;	///< mۍς݃ubN.
+	size_t mBlockSize;			///< WubNTCY.
+	char* mCur;					///< ݃ubN̖gp̈̐擪.
+	size_t mRest;				///< ݃ubN̖gp̈̃TCY.
+	size_t mUsed;				///< 蓖čς݂̑oCg.
+	size_t mReserved;			///< mۍς݃ubN̑oCg.
+
+	Arena(const Arena&);				// Rs[֎~.
+	void operator=(const Arena&);		// ֎~.
+public:
+	//....................................................................
+	/** RXgN^.
+	 * @param blocksize	xɊmۂubÑTCY.
+	 */
+	explicit Arena(size_t blocksize = 0x10000)
+		: mBlockSize(blocksize), mCur(NULL), mRest(0), mUsed(0), mReserved(0) {}
+
+	/** fXgN^. SubN. */
+	~Arena() {
+		Clear();
+	}
+
+	//....................................................................
+	/** noCg蓖Ă. 8oCgEɐ񂷂. */
+	void* Alloc(size_t n) {
+		size_t pad = (8 - ((size_t)mCur & 7)) & 7;
+		if (mRest < n + pad) {
+			NewBlock(n);
+			pad = 0;
+		}
+		char* p = mCur + pad;
+		mCur  += n + pad;
+		mRest -= n + pad;
+		mUsed += n + pad;
+		return p;
+	}
+
+	/** len̕𕡎ʂ. ʐ̖ɂ'\0't. */
+	char* StrDup(const char* s, size_t len) {
+		if (mRest < len + 1)
+			NewBlock(len + 1);
+		char* p = mCur;
+		memcpy(p, s, len);
+		p[len] = '\0';
+		mCur  += len + 1;
+		mRest -= len + 1;
+		mUsed += len + 1;
+		return p;
+	}
+
+	/** 𕡎ʂ. */
+	char* StrDup(const char* s) {
+		return StrDup(s, strlen(s));
+	}
+
+	/** SubN. */
+	void Clear() {
+		for (size_t i = 0; i < mBlocks.size(); ++i)
+			free(mBlocks[i]);
+		mBlocks.clear();
+		mCur = NULL;
+		mRest = mUsed = mReserved = 0;
+	}
+
+	//....................................................................
+	/** 蓖čς݂̑oCg. */
+	size_t Used() const {
+		return mUsed;
+	}
+
+	/** mۍς݃ubN̑oCg. */
+	size_t Reserved() const {
+		return mReserved;
+	}
+
+private:
+	/** ȂƂnoCg̋󂫂ubNVɊmۂ. */
+	void NewBlock(size_t n) {
+		size_t size = n > mBlockSize ? n : mBlockSize;
+		char* p = (char*) malloc(size);
+		if (p == NULL)
+			throw std::bad_alloc();
+		mBlocks.push_back(p);
+		mCur = p;
+		mRest = size;
+		mReserved += size;
+	}
+};
+
+//------------------------------------------------------------------------
+/** ̊i[\(C^[\).
+ *  '\0' ؂ň̘Äɋl߂Ċi[A̐擪̃ItZbg32rbg̃nhƂĕԂ.
+ * Intern() ͓e̕xi[̂ŁÃtH_ɓ̃t@CĂO̊i[͈ōς.
+ * |C^̑ɃnhĂ΁AGg̃^f[^ȍ\̂ɋl߂.
+ * Str() Ԃ|C^́Aɕǉ܂ŗL. nhClear()܂ŗL.
+ * r͂Ȃ̂ŁAXbhǉƂ͌Ăяoŕی삷邱.
+ */
+class StringPool {
+public:
+	typedef uint32 Handle;
+
+private:
+	/** nbV\̗vf. */
+	struct Slot {
+		uint32 hash;
+		uint32 len;			///< ̒. eɔׂāAŽǂ܂Ȃ悤ɂ.
+		Handle handle;
+	};
+	enum { EMPTY = 0xffffffff };
+
+	std::vector<char> mBlob;	///< i[. e̖ '\0' t.
+	std::vector<Slot> mTable;	///< I[vAhX@̃nbV\. 傫2̙p. 󂫂 handle == EMPTY.
+	size_t mCount;				///< i[̐.
+	size_t mInterned;			///< nbV\ɓo^̐.
+
+	StringPool(const StringPool&);			// Rs[֎~.
+	void operator=(const StringPool&);		// ֎~.
+public:
+	//....................................................................
+	StringPool() : mCount(0), mInterned(0) {}
+
+	//....................................................................
+	/** len̕i[ÃnhԂ. e̕񂪊i[ς݂Ȃ΁ÃnhԂ. */
+	Handle Intern(const char* s, size_t len) {
+		if (mInterned * 2 >= mTable.size())
+			Rehash(mTable.empty() ? 256 : mTable.size() * 2);
+		uint32 hash = Hash(s, len);
+		size_t mask = mTable.size() - 1;
+		for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+			Slot& slot = mTable[i];
+			if (slot.handle == EMPTY) {
+				slot.handle = Add(s, len);
+				slot.hash = hash;
+				slot.len = (uint32) len;
+				++mInterned;
+				return slot.handle;
+			}
+			if (slot.hash == hash && slot.len == len && memcmp(&mBlob[slot.handle], s, len) == 0)
+				return slot.handle;
+		}
+	}
+
+	Handle Intern(const char* s) {
+		return Intern(s, strlen(s));
+	}
+
+	/** len̕Ad𒲂ׂɊi[. dقƂǖƕĂꍇɎg. */
+	Handle Add(const char* s, size_t len) {
+		size_t pos = mBlob.size();
+		if (pos + len + 1 >= EMPTY)
+			throw std::bad_alloc();
+		mBlob.insert(mBlob.end(), s, s + len);
+		mBlob.push_back('\0');
+		++mCount;
+		return (Handle) pos;
+	}
+
+	/** S. */
+	void Clear() {
+		std::vector<char>().swap(mBlob);
+		std::vector<Slot>().swap(mTable);
+		mCount = mInterned = 0;
+	}
+
+	/** i[̈\񂷂. i[鑍oCǧ݂ĂꍇɎg. */
+	void Reserve(size_t bytes) {
+		mBlob.reserve(bytes);
+	}
+
+	//....................................................................
+	/** nh̕. */
+	const char* Str(Handle h) const {
+		return &mBlob[h];
+	}
+
+	/** i[̐. */
+	size_t Count() const {
+		return mCount;
+	}
+
+	/** i[̑oCg('\0' ܂). */
+	size_t Bytes() const {
+		return mBlob.size();
+	}
+
+private:
+	/** FNV-1a */
+	static uint32 Hash(const char* s, size_t len) {
+		uint32 h = 2166136261U;
+		for (size_t i = 0; i < len; ++i) {
+			h ^= (uchar) s[i];
+			h *= 16777619U;
+		}
+		return h;
+	}
+
+	/** nbV\ n vfɍ蒼. */
+	void Rehash(size_t n) {
+		Slot empty;
+		empty.hash = 0;
+		empty.len = 0;
+		empty.handle = EMPTY;
+		std::vector<Slot> table(n, empty);
+		size_t mask = n - 1;
+		for (size_t j = 0; j < mTable.size(); ++j) {
+			const Slot& slot = mTable[j];
+			if (slot.handle == EMPTY)
+				continue;
+			size_t i = slot.hash & mask;
+			while (table[i].handle != EMPTY)
+				i = (i + 1) & mask;
+			table[i] = slot;
+		}
+		mTable.swap(table);
+	}
+};
+
+// memfunc.cpp - end.
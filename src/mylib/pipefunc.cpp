@@ -0,0 +1,378 @@
+/**@file pipefunc.cpp --- named pipe functions.
+ * POSIX ł͖OtpCv̑ Unix hC\Pbgg.
+ * @author Hiroshi Kuno <http://code.google.com/p/win32cmdx/>
+ */
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+#include <string>
+
+//------------------------------------------------------------------------
+#ifdef _WIN32
+/** ڑς݃pCṽnh. */
+typedef HANDLE PipeHandle;
+const PipeHandle INVALID_PIPE = INVALID_HANDLE_VALUE;
+
+/** pCvSȖO "\\.\pipe\NAME" ɂ.  "\\" Ŏn܂Ă΂̂܂܎g. */
+std::string pipe_fullname(const char* name)
+{
+	if (name[0] == '\\' && name[1] == '\\')
+		return name;
+	return std::string("\\\\.\\pipe\\") + name;
+}
+#else
+/** ڑς݃\Pbg̃t@CLqq. */
+typedef int PipeHandle;
+const PipeHandle INVALID_PIPE = -1;
+
+/** pCv\Pbg̃pX "/tmp/NAME" ɂ.  '/' ܂ł΂̂܂܎g. */
+std::string pipe_fullname(const char* name)
+{
+	if (strchr(name, '/'))
+		return name;
+	return std::string("/tmp/") + name;
+}
+
+/** \Pbg̃AhX.
+ * @retval false	pX.
+ */
+bool pipe_address(const std::string& fullname, sockaddr_un& addr)
+{
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (fullname.size() >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		return false;
+	}
+	strcpy(addr.sun_path, fullname.c_str());
+	return true;
+}
+#endif
+
+//------------------------------------------------------------------------
+/** OtpCv̐ڑ. oCg[hœǂݏ.
+ * sPʂ̓ǂݏô߂ɎMobt@.
+ */
+class PipeStream {
+	PipeHandle mHandle;
+	bool mIsServer;			///< T[o[̐ڑȂ΁AOɐؒfs.
+	std::string mBuf;		///< Mς݂Ŗ̃f[^.
+	size_t mBufPos;			///< mBuf ̖̐擪.
+
+	PipeStream(const PipeStream&);		// Rs[֎~.
+	void operator=(const PipeStream&);	// ֎~.
+public:
+	/** RXgN^.
+	 * @param h			ڑς݂̃pCv. L͂̃IuWFNgɈڂ.
+	 * @param is_server	h T[o[̃pCvȂ true.
+	 */
+	explicit PipeStream(PipeHandle h = INVALID_PIPE, bool is_server = false)
+		: mHandle(h), mIsServer(is_server), mBufPos(0) {}
+
+	~PipeStream() {
+		Close();
+	}
+
+	//....................................................................
+	/** NCAgƂăT[o[ɐڑ.
+	 * SCX^XgpȂ΁Atimeout ~b܂ŋ󂫂҂.
+	 */
+#ifdef _WIN32
+	bool Connect(const char* name, DWORD timeout = 5000) {
+		Close();
+		std::string fullname = pipe_fullname(name);
+		for (;;) {
+			mHandle = ::CreateFileA(fullname.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+			if (IsOpen())
+				return true;
+			if (::GetLastError() != ERROR_PIPE_BUSY || !::WaitNamedPipeA(fullname.c_str(), timeout))
+				return false;
+		}
+	}
+
+	/** . T[o[Ȃ΁A肪ǂݏÎ҂Ăؒf. */
+	void Close() {
+		if (IsOpen()) {
+			if (mIsServer) {
+				::FlushFileBuffers(mHandle);
+				::DisconnectNamedPipe(mHandle);
+			}
+			::CloseHandle(mHandle);
+		}
+		mHandle = INVALID_PIPE;
+		mBuf.clear();
+		mBufPos = 0;
+	}
+#else
+	bool Connect(const char* name, int timeout = 5000) {
+		Close();
+		sockaddr_un addr;
+		if (!pipe_address(pipe_fullname(name), addr))
+			return false;
+		// ҂󂯃L[Ă΁Atimeout ~b܂ōĎs.
+		for (int waited = 0; ; waited += 10) {
+			mHandle = socket(AF_UNIX, SOCK_STREAM, 0);
+			if (!IsOpen())
+				return false;
+			if (connect(mHandle, (const sockaddr*) &addr, sizeof(addr)) == 0)
+				return true;
+			int err = errno;
+			Close();
+			if (err != EAGAIN || waited >= timeout) {
+				errno = err;
+				return false;
+			}
+			usleep(10000);
+		}
+	}
+
+	/** . T[o[Ȃ΁AMIƂ𑊎ɓ`Ă. */
+	void Close() {
+		if (IsOpen()) {
+			if (mIsServer)
+				shutdown(mHandle, SHUT_WR);
+			close(mHandle);
+		}
+		mHandle = INVALID_PIPE;
+		mBuf.clear();
+		mBufPos = 0;
+	}
+#endif
+
+	/** ̃Xbh҂Ăǂݏł؂. ̂ Close() ōs.
+	 * Windows ł͑҂ĂǂݏȂ̂ŁǍɎn߂ǂݏ͑ł؂Ȃ.
+	 * @retval false	ł؂Ȃ. CancelIoEx ̖ Vista O Windows.
+	 */
+	bool Shutdown() {
+		if (!IsOpen())
+			return true;
+#ifdef _WIN32
+		// Windows2000 łNł悤ɁACancelIoEx ͎sɒT.
+		typedef BOOL (WINAPI *CancelIoExFunc)(HANDLE, LPOVERLAPPED);
+		static CancelIoExFunc cancel_io = (CancelIoExFunc) ::GetProcAddress(::GetModuleHandleA("kernel32.dll"), "CancelIoEx");
+		if (cancel_io == NULL)
+			return false;
+		cancel_io(mHandle, NULL);
+#else
+		// Ȍ̓ǂݏs.
+		shutdown(mHandle, SHUT_RDWR);
+#endif
+		return true;
+	}
+
+	/** JĂ邩? */
+	bool IsOpen() const {
+		return mHandle != INVALID_PIPE;
+	}
+
+	//....................................................................
+	/** s܂ł1sǂݏo.  "\n"  "\r\n" ͎菜.
+	 * @param maxlen	s̍ő咷. zs͎sƂ.
+	 * @retval false	ؒfꂽA܂͍s.
+	 */
+	bool ReadLine(std::string& line, size_t maxlen = 0x10000) {
+		line.clear();
+		for (;;) {
+			size_t eol = mBuf.find('\n', mBufPos);
+			size_t end = (eol == std::string::npos) ? mBuf.size() : eol;
+			line.append(mBuf, mBufPos, end - mBufPos);
+			if (line.size() > maxlen)
+				return false;
+			if (eol != std::string::npos) {
+				mBufPos = eol + 1;
+				if (!line.empty() && line[line.size()-1] == '\r')
+					line.erase(line.size()-1);
+				return true;
+			}
+			if (!Fill())
+				return false;
+		}
+	}
+
+	/** noCgǂݏo.
+	 * @retval false	noCgǂݏoOɐؒfꂽ.
+	 */
+	bool Read(void* buf, size_t n) {
+		char* p = (char*) buf;
+		while (n > 0) {
+			if (mBufPos >= mBuf.size() && !Fill())
+				return false;
+			size_t len = mBuf.size() - mBufPos;
+			if (len > n)
+				len = n;
+			memcpy(p, mBuf.data() + mBufPos, len);
+			mBufPos += len;
+			p += len;
+			n -= len;
+		}
+		return true;
+	}
+
+	/** noCg. */
+	bool Write(const void* buf, size_t n) {
+		const char* p = (const char*) buf;
+		while (n > 0) {
+#ifdef _WIN32
+			DWORD chunk = (DWORD) (n < 0x10000 ? n : 0x10000);
+			DWORD wrote = 0;
+			if (!::WriteFile(mHandle, p, chunk, &wrote, NULL) || wrote == 0)
+				return false;
+#else
+			// 肪ؒfĂĂ SIGPIPE ŏIȂ悤ɁAMSG_NOSIGNAL ő.
+			ssize_t wrote = send(mHandle, p, n, MSG_NOSIGNAL);
+			if (wrote < 0 && errno == EINTR)
+				continue;
+			if (wrote <= 0)
+				return false;
+#endif
+			p += wrote;
+			n -= wrote;
+		}
+		return true;
+	}
+
+	bool Write(const std::string& s) {
+		return Write(s.data(), s.size());
+	}
+
+private:
+	/** Mobt@[. ς݂͎̂̕Ă. */
+	bool Fill() {
+		mBuf.erase(0, mBufPos);
+		mBufPos = 0;
+		char buf[0x1000];
+#ifdef _WIN32
+		DWORD got = 0;
+		if (!::ReadFile(mHandle, buf, sizeof(buf), &got, NULL) || got == 0)
+			return false;
+#else
+		ssize_t got;
+		while ((got = recv(mHandle, buf, sizeof(buf), 0)) < 0 && errno == EINTR)
+			;
+		if (got <= 0)
+			return false;
+#endif
+		mBuf.append(buf, got);
+		return true;
+	}
+};
+
+//------------------------------------------------------------------------
+/** OtpCṽT[o[̑҂.
+ * NCAgɐVpCvCX^XĐڑ󂯕t.
+ */
+class PipeListener {
+	std::string mName;
+#ifdef _WIN32
+	bool mFirst;			///< ŏ̃CX^X쐬ς݂?
+#else
+	int mSocket;			///< ҂󂯃\Pbg. ŏ Accept() ō.
+#endif
+
+	PipeListener(const PipeListener&);		// Rs[֎~.
+	void operator=(const PipeListener&);	// ֎~.
+public:
+#ifdef _WIN32
+	explicit PipeListener(const char* name)
+		: mName(pipe_fullname(name)), mFirst(true) {}
+
+	/** ̃NCAg̐ڑ҂Aڑς݂̃pCvԂ.
+	 * ŏ̃CX^X FILE_FLAG_FIRST_PIPE_INSTANCE ō쐬̂ŁÃT[o[ɓĂΎs.
+	 * @retval INVALID_PIPE	pCv쐬łȂ.
+	 */
+	PipeHandle Accept() {
+		for (;;) {
+			DWORD mode = PIPE_ACCESS_DUPLEX;
+			if (mFirst)
+				mode |= FILE_FLAG_FIRST_PIPE_INSTANCE;
+			HANDLE h = ::CreateNamedPipeA(mName.c_str(), mode,
+				PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT, PIPE_UNLIMITED_INSTANCES,
+				0x10000, 0x10000, 0, NULL);
+			if (h == INVALID_HANDLE_VALUE)
+				return h;
+			mFirst = false;
+			if (::ConnectNamedPipe(h, NULL) || ::GetLastError() == ERROR_PIPE_CONNECTED)
+				return h;
+			// ڑɐؒfNCAgȂǂ͖āA̐ڑ҂.
+			::CloseHandle(h);
+		}
+	}
+#else
+	explicit PipeListener(const char* name)
+		: mName(pipe_fullname(name)), mSocket(-1) {}
+
+	/** \PbgāA\Pbgt@C폜. */
+	~PipeListener() {
+		if (mSocket != -1) {
+			close(mSocket);
+			unlink(mName.c_str());
+		}
+	}
+
+	/** ̃NCAg̐ڑ҂Aڑς݂̃\PbgԂ.
+	 * ŏ̌ĂяoŃ\Pbg. ̃T[o[ɓĂΎsAc[̃\Pbgt@CȂ΍폜č蒼.
+	 * @retval INVALID_PIPE	\Pbg쐬łȂ.
+	 */
+	PipeHandle Accept() {
+		if (mSocket == -1 && !Listen())
+			return INVALID_PIPE;
+		for (;;) {
+			int h = accept(mSocket, NULL, NULL);
+			if (h != -1)
+				return h;
+			if (errno != EINTR && errno != ECONNABORTED)
+				return INVALID_PIPE;
+		}
+	}
+#endif
+
+	/** SȃpCv. */
+	const char* Name() const {
+		return mName.c_str();
+	}
+
+#ifndef _WIN32
+private:
+	bool Listen() {
+		sockaddr_un addr;
+		if (!pipe_address(mName, addr))
+			return false;
+		int s = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (s == -1)
+			return false;
+		if (bind(s, (const sockaddr*) &addr, sizeof(addr)) != 0) {
+			// ڑłΓ̃T[o[Ă. łȂΑÕT[o[c\Pbgt@CƂ݂Ȃ.
+			// \PbgȊÕt@C͍폜Ȃ.
+			int err = errno;
+			PipeStream probe;
+			struct stat st;
+			if (err != EADDRINUSE || probe.Connect(mName.c_str(), 0)
+				|| lstat(mName.c_str(), &st) != 0 || !S_ISSOCK(st.st_mode)) {
+				close(s);
+				errno = err;
+				return false;
+			}
+			unlink(mName.c_str());
+			if (bind(s, (const sockaddr*) &addr, sizeof(addr)) != 0) {
+				close(s);
+				return false;
+			}
+		}
+		if (listen(s, SOMAXCONN) != 0) {
+			close(s);
+			return false;
+		}
+		mSocket = s;
+		return true;
+	}
+#endif
+};
+
+// pipefunc.cpp - end.
@@ -0,0 +1,372 @@
+/**@file snapfunc.cpp --- folder tree snapshot manifest.
+ * strfunc.cpp, memfunc.cpp, filefunc.cpp  include 邱.
+ * @author Hiroshi Kuno <http://code.google.com/p/win32cmdx/>
+ */
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------
+//!@name XibvVbg̃t@C`.
+// t@C Header, Folder ̔z, Entry ̔z, Ö̗̏ɌԖׂ.
+// etH_̍(t@CƃTutH_) Entry ̔z̘A͈͂ɂAfilename_key() ̃L[̏ɕ.
+// ]ătH_̈ꗗ́At@CŜǂݍ܂Ɋ蓖Ă͈͂擪珇ɓǂނœ.
+// StB[h͌Œ蕝ŁA񂾊̃oCgƂ.
+//@{
+/** t@C̐擪. 64oCg. */
+struct SnapshotHeader {
+	char magic[8];			///< "DDSNAP"  '\0' 2.
+	uint32 version;
+	uint32 digest;			///< L^_CWFXg̎. SnapshotDigest.
+	uint64 folders;			///< Folder ̐. 0Ԃ͔rJntH_.
+	uint64 entries;			///< Entry ̐.
+	uint64 names_size;		///< Ö̗̃oCg. eO '\0' ŏI.
+	uint64 reserved[3];
+};
+
+/** ̃tH_. 16oCg. */
+struct SnapshotFolder {
+	uint64 first;			///< ŏ̍ڂ̔ԍ.
+	uint64 count;			///< ڐ.
+};
+
+/** tH_̈̍. 48oCg. */
+struct SnapshotEntry {
+	uint64 name;			///< Ö̗ł̖Öʒu.
+	__int64 time_write;		///< XV. time_t l.
+	uint64 size;			///< t@C̃TCY. TutH_Ȃ΁A Folder ̔ԍ.
+	uint32 flags;			///< SNAP_FOLDER, SNAP_NO_DIGEST.
+	uint32 reserved;
+	uchar digest[16];		///< ẽ_CWFXg.
+};
+
+/** SnapshotEntry::flags */
+enum {
+	SNAP_FOLDER = 1,		///< TutH_.
+	SNAP_NO_DIGEST = 2		///< ǂ߂Ȃ̂ŁA_CWFXgL^ĂȂ.
+};
+
+/** SnapshotHeader::digest */
+enum SnapshotDigest {
+	SNAP_DIGEST_NONE = 0,	///< _CWFXgL^ĂȂ.
+	SNAP_DIGEST_MURMUR3 = 1,	///< MurmurHash3 128bit. DigestCache Ɠl.
+	SNAP_DIGEST_CRC32 = 2		///< CRC-32. 擪4oCg little endian ŒuAc0Ƃ.
+};
+//@}
+
+//------------------------------------------------------------------------
+/** XibvVbg̍쐬.
+ * tH_ƍڂCӂ̏ɉAŌ Write() ŊetH_̍ڂבւďo.
+ * L[̓O͉ɕׂ. r̈ꗗƓAŌ̂̂c悤ɂ邽.
+ * r͂Ȃ̂ŁAXbhƂ͌Ăяoŕی삷邱.
+ */
+class SnapshotBuilder {
+	struct Item {
+		StringPool::Handle name;
+		size_t parent;			///< tH_̔ԍ.
+		__int64 time_write;
+		uint64 size;			///< t@C̃TCY. TutH_Ȃ΁A̔ԍ.
+		uint32 flags;
+		uchar digest[16];
+	};
+	StringPool mNames;
+	std::vector<Item> mItems;
+	size_t mFolders;
+
+	SnapshotBuilder(const SnapshotBuilder&);	// Rs[֎~.
+	void operator=(const SnapshotBuilder&);		// ֎~.
+public:
+	/** 0Ԃ̃tH_̃XibvVbg. */
+	SnapshotBuilder() : mFolders(1) {
+		mNames.Add("", 0);	// Ö̗ɂȂ.
+	}
+
+	//....................................................................
+	/** TutH_A̔ԍԂ.
+	 * @param parent	tH_̔ԍ.
+	 */
+	size_t AddFolder(size_t parent, const char* name, time_t time_write) {
+		Item& item = Add(parent, name, time_write, SNAP_FOLDER);
+		item.size = mFolders;
+		return mFolders++;
+	}
+
+	/** t@CA̍ڂ̔ԍԂ. ԍ Digest() Ɏg. */
+	size_t AddFile(size_t parent, const char* name, time_t time_write, uint64 size) {
+		Add(parent, name, time_write, 0).size = size;
+		return mItems.size() - 1;
+	}
+
+	/** ڂ̃_CWFXgޗ̈. ȌɍڂƖɂȂ. */
+	uchar* Digest(size_t item) {
+		return mItems[item].digest;
+	}
+
+	/** ڂɃ_CWFXgƂL^. */
+	void NoDigest(size_t item) {
+		mItems[item].flags |= SNAP_NO_DIGEST;
+	}
+
+	/** ڂ̖O. ȌɍڂƖɂȂ. */
+	const char* Name(size_t item) const {
+		return mNames.Str(mItems[item].name);
+	}
+
+	/** ڐ. */
+	size_t Count() const {
+		return mItems.size();
+	}
+
+	/** etH_̍ڂL[̏ɕבւďo.
+	 * @param digest	L^_CWFXg̎.
+	 * @retval false	߂Ȃ.
+	 */
+	bool Write(FILE* fp, SnapshotDigest digest) const {
+		FileOutput out(fp);
+		return Emit(out, digest) && fflush(fp) == 0;
+	}
+
+	/** Write() Ɠeɍ. Snapshot::Load() œǂ߂. */
+	void Build(std::vector<uchar>& image, SnapshotDigest digest) const {
+		image.clear();
+		MemoryOutput out(image);
+		Emit(out, digest);
+	}
+
+private:
+	/** Emit() ̏o͐. */
+	struct FileOutput {
+		FILE* fp;
+		explicit FileOutput(FILE* f) : fp(f) {}
+		bool operator()(const void* data, size_t n) {
+			return fwrite(data, 1, n, fp) == n;
+		}
+	};
+	struct MemoryOutput {
+		std::vector<uchar>& buf;
+		explicit MemoryOutput(std::vector<uchar>& b) : buf(b) {}
+		bool operator()(const void* data, size_t n) {
+			buf.insert(buf.end(), (const uchar*) data, (const uchar*) data + n);
+			return true;
+		}
+	};
+
+	template<class Output>
+	bool Emit(Output& out, SnapshotDigest digest) const;
+
+	Item& Add(size_t parent, const char* name, time_t time_write, uint32 flags) {
+		Item item;
+		item.name = mNames.Add(name, strlen(name));
+		item.parent = parent;
+		item.time_write = (__int64) time_write;
+		item.size = 0;
+		item.flags = flags;
+		memset(item.digest, 0, sizeof(item.digest));
+		mItems.push_back(item);
+		return mItems.back();
+	}
+
+	/** tH_̔ԍAL[̏. */
+	struct Less {
+		const std::vector<Item>& items;
+		const std::vector<std::string>& keys;
+		Less(const std::vector<Item>& i, const std::vector<std::string>& k) : items(i), keys(k) {}
+		bool operator()(size_t a, size_t b) const {
+			if (items[a].parent != items[b].parent)
+				return items[a].parent < items[b].parent;
+			return keys[a] < keys[b];
+		}
+	};
+};
+
+//........................................................................
+template<class Output>
+bool SnapshotBuilder::Emit(Output& out, SnapshotDigest digest) const
+{
+	size_t n = mItems.size();
+	std::vector<std::string> keys(n);
+	std::vector<size_t> order(n);
+	for (size_t i = 0; i < n; ++i) {
+		filename_key(mNames.Str(mItems[i].name), keys[i]);
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), Less(mItems, keys));
+	std::vector<std::string>().swap(keys);
+
+	std::vector<SnapshotFolder> folders(mFolders);
+	for (size_t i = 0; i < mFolders; ++i)
+		folders[i].first = folders[i].count = 0;
+	for (size_t i = n; i-- > 0; ) {
+		SnapshotFolder& f = folders[mItems[order[i]].parent];
+		f.first = i;
+		++f.count;
+	}
+
+	SnapshotHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, "DDSNAP", 6);
+	h.version = 1;
+	h.digest = digest;
+	h.folders = mFolders;
+	h.entries = n;
+	h.names_size = mNames.Bytes();
+	if (!out(&h, sizeof(h)) || !out(&folders[0], sizeof(SnapshotFolder) * mFolders))
+		return false;
+
+	// ڂ͈萔ϊďo.
+	const size_t CHUNK = 0x1000;
+	std::vector<SnapshotEntry> buf;
+	buf.reserve(CHUNK);
+	for (size_t i = 0; i < n; ) {
+		buf.clear();
+		for (; i < n && buf.size() < CHUNK; ++i) {
+			const Item& item = mItems[order[i]];
+			SnapshotEntry e;
+			e.name = item.name;
+			e.time_write = item.time_write;
+			e.size = item.size;
+			e.flags = item.flags;
+			e.reserved = 0;
+			memcpy(e.digest, item.digest, sizeof(e.digest));
+			buf.push_back(e);
+		}
+		if (!out(&buf[0], sizeof(SnapshotEntry) * buf.size()))
+			return false;
+	}
+	return out(mNames.Str(0), mNames.Bytes());
+}
+
+//------------------------------------------------------------------------
+/** XibvVbg̓ǂݏo.
+ * t@CŜɊ蓖ĂāAKvȃtH_͈̔͂ǂ. JƂ̓wb_ƃTCŶŁA
+ * ڐɂ炸Ĵ͈uł. ڂ̒l͎gƂɔ͈͂.
+ * SnapshotBuilder::Build() Ńɍ̂ǂ߂.
+ * J́AXbh瓯ɓǂł悢.
+ */
+class Snapshot {
+	MappedFile mFile;
+	std::vector<uchar> mImage;	///< Load() ̃XibvVbg.
+	const SnapshotHeader* mHeader;
+	const SnapshotFolder* mFolders;
+	const SnapshotEntry* mEntries;
+	const char* mNames;
+
+	Snapshot(const Snapshot&);			// Rs[֎~.
+	void operator=(const Snapshot&);	// ֎~.
+public:
+	Snapshot() : mHeader(NULL), mFolders(NULL), mEntries(NULL), mNames(NULL) {}
+
+	//....................................................................
+	/** XibvVbg̃t@CJ.
+	 * @retval false	JȂA܂̓XibvVbgł͂Ȃ. JȂ err ɃG[R[hԂA`Ⴆ err 0Ƃ.
+	 */
+	bool Open(const char* path, long& err) {
+		err = 0;
+		FILE* fp = fopen(path, "rb");
+		if (!fp) {
+			err = last_syserror();
+			return false;
+		}
+		bool ok = Map(fp);
+		fclose(fp);
+		return ok;
+	}
+
+	/** fp ̊JĂXibvVbg蓖Ă. 蓖Ă fp Ă悢.
+	 * @retval false	蓖ĂȂA܂̓XibvVbgł͂Ȃ.
+	 */
+	bool Map(FILE* fp) {
+		Close();
+		return mFile.Map(fp) && Attach(mFile.Data(), mFile.Size());
+	}
+
+	/** SnapshotBuilder::Build() ōXibvVbg. image ͋ɂȂ.
+	 * @retval false	XibvVbgł͂Ȃ.
+	 */
+	bool Load(std::vector<uchar>& image) {
+		Close();
+		mImage.swap(image);
+		return !mImage.empty() && Attach(&mImage[0], mImage.size());
+	}
+
+	/** . */
+	void Close() {
+		mFile.Close();
+		std::vector<uchar>().swap(mImage);
+		mHeader = NULL;
+		mFolders = NULL;
+		mEntries = NULL;
+		mNames = NULL;
+	}
+
+	/** JĂ邩? */
+	bool IsOpen() const {
+		return mHeader != NULL;
+	}
+
+	//....................................................................
+	/** L^_CWFXg̎. */
+	SnapshotDigest Digest() const {
+		return (SnapshotDigest) mHeader->digest;
+	}
+
+	/** tH_. */
+	uint64 Folders() const {
+		return mHeader->folders;
+	}
+
+	/** tH_̍ڂ͈̔͂𓾂.
+	 * @retval false	͈͂Ă.
+	 */
+	bool Folder(uint64 folder, uint64& first, uint64& count) const {
+		if (folder >= mHeader->folders)
+			return false;
+		first = mFolders[folder].first;
+		count = mFolders[folder].count;
+		return first <= mHeader->entries && count <= mHeader->entries - first;
+	}
+
+	/** . ԍ Folder() œ͈͂ɂ邱. */
+	const SnapshotEntry& Entry(uint64 i) const {
+		return mEntries[i];
+	}
+
+	/** ڂ̖O. Ă NULL. */
+	const char* Name(const SnapshotEntry& e) const {
+		return e.name < mHeader->names_size ? mNames + e.name : NULL;
+	}
+
+	/** ڂTutH_Ȃ΁A̔ԍ͗L? */
+	bool IsValidFolder(const SnapshotEntry& e) const {
+		return (e.flags & SNAP_FOLDER) == 0 || e.size < mHeader->folders;
+	}
+
+private:
+	/** p  total oCg̃XibvVbgāAëw. */
+	bool Attach(const uchar* p, size_t total) {
+		if (total < sizeof(SnapshotHeader))
+			return false;
+		const SnapshotHeader* h = (const SnapshotHeader*) p;
+		if (memcmp(h->magic, "DDSNAP\0\0", 8) != 0 || h->version != 1 || h->folders == 0 || h->names_size == 0)
+			return false;
+		// ë̃TCY̍vt@CTCYƈvAÖ̗悪 '\0' ŏI邱Ƃm߂.
+		uint64 size = total - sizeof(SnapshotHeader);
+		if (h->folders > size / sizeof(SnapshotFolder))
+			return false;
+		size -= h->folders * sizeof(SnapshotFolder);
+		if (h->entries > size / sizeof(SnapshotEntry))
+			return false;
+		size -= h->entries * sizeof(SnapshotEntry);
+		if (size != h->names_size || p[total - 1] != '\0')
+			return false;
+		mHeader = h;
+		mFolders = (const SnapshotFolder*) (p + sizeof(SnapshotHeader));
+		mEntries = (const SnapshotEntry*) (mFolders + h->folders);
+		mNames = (const char*) (mEntries + h->entries);
+		return true;
+	}
+};
+
+// snapfunc.cpp - end.
@@ -1,8 +1,17 @@
 /**@file strfunc.cpp --- C string functions.
  * @author Hiroshi Kuno <http://code.google.com/p/win32cmdx/>
  */
+#include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#ifdef _WIN32
 #include <mbstring.h>
+#else
+#include <wchar.h>
+#include <wctype.h>
+#endif
+#include <string>
 
 //------------------------------------------------------------------------
 /** s1s2͓? */
@@ -11,10 +20,130 @@ inline bool strequ(const char* s1, const char* s2)
 	return strcmp(s1, s2) == 0;
 }
 
+//------------------------------------------------------------------------
+/** @name 啶𖳎rƌ.
+ * ASCIÍ̕Ap啶0x20𑫂ďɑASIMD߂16/32oCg.
+ * 0x80ȏ̃oCgꂽƂA}`oCg߂ _mbsicmp ɔC.
+ * POSIX ł sysfunc.cpp  _mbsicmp P[̕R[h(UTF-8Ȃ)߂.
+ * @{
+ */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MY_STR_SSE2	1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && _MSC_VER >= 1800 && (defined(_M_IX86) || defined(_M_X64))
+#define MY_STR_AVX2	1
+#include <intrin.h>
+#include <immintrin.h>
+#define MY_AVX2_TARGET
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define MY_STR_AVX2	1
+#include <immintrin.h>
+#define MY_AVX2_TARGET	__attribute__((target("avx2")))
+#endif
+
+/** ASCIỈp啶ɂ. P[ɈˑȂ. */
+inline uint ascii_tolower(uint c)
+{
+	return (c - 'A' < 26u) ? (c | 0x20) : c;
+}
+
+/** ŉʂ1̃rbgʒu. x 0ȊOł邱.
+ * <intrin.h> AVX2łg VC++2013 ȍ~łǂݍ܂Ȃ̂ŁAÂVC++ł1rbgׂ.
+ */
+inline int lowest_bit(uint x)
+{
+#if defined(_MSC_VER) && defined(MY_STR_AVX2)
+	unsigned long i;
+	_BitScanForward(&i, x);
+	return (int) i;
+#elif defined(__GNUC__)
+	return __builtin_ctz(x);
+#else
+	int i = 0;
+	for (; (x & 1) == 0; x >>= 1)
+		++i;
+	return i;
+#endif
+}
+
+/** }`oCg̎̈̕ʒu. */
+inline const char* mbs_next(const char* p)
+{
+#ifdef _WIN32
+	return (const char*) _mbsinc((const uchar*) p);
+#else
+	mbstate_t st;
+	memset(&st, 0, sizeof(st));
+	size_t n = mbrlen(p, MB_CUR_MAX, &st);
+	return p + ((n == 0 || n >= (size_t) -2) ? 1 : n);
+#endif
+}
+
+#ifdef MY_STR_SSE2
+/** 16oCgASCIIp啶ɂ. */
+inline __m128i ascii_tolower16(__m128i x)
+{
+	// 'A'..'Z' 𕄍t -128..-103 ɈڂāAx̔rŔ͈͔肷.
+	__m128i t = _mm_add_epi8(x, _mm_set1_epi8((char) (0x80 - 'A')));
+	__m128i upper = _mm_cmplt_epi8(t, _mm_set1_epi8((char) (-128 + 26)));
+	return _mm_or_si128(x, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+/** p 16oCgǂłAy[WEzȂ?
+ * ̏I[ǂނƂɂȂ邪Ay[WȂ΃ANZXᔽɂȂȂ.
+ */
+inline bool can_load16(const void* p)
+{
+	return ((size_t) p & 0xfff) <= 0x1000 - 16;
+}
+#endif
+
+/** 啶𖳎Ĕr. ߂l̕ strcmp Ɠ. */
+inline int stricmp_fast(const char* s1, const char* s2)
+{
+	const uchar* p = (const uchar*) s1;
+	const uchar* q = (const uchar*) s2;
+	for (;;) {
+#ifdef MY_STR_SSE2
+		if (can_load16(p) && can_load16(q)) {
+			__m128i a = _mm_loadu_si128((const __m128i*) p);
+			__m128i b = _mm_loadu_si128((const __m128i*) q);
+			uint ne   = ~_mm_movemask_epi8(_mm_cmpeq_epi8(ascii_tolower16(a), ascii_tolower16(b))) & 0xffff;
+			uint nul  = _mm_movemask_epi8(_mm_cmpeq_epi8(a, _mm_setzero_si128()));
+			uint high = _mm_movemask_epi8(_mm_or_si128(a, b));
+			uint stop = ne | nul;
+			if ((stop | high) == 0) {
+				p += 16;
+				q += 16;
+				continue;
+			}
+			int i = stop ? lowest_bit(stop) : 16;
+			if (high & ((2u << i) - 1)) {
+				// 0x80ȏ̃oCg܂ł͓ASCIIȂ̂ŁA}`oCgr.
+				int h = lowest_bit(high);
+				return _mbsicmp(p + h, q + h);
+			}
+			return (int) ascii_tolower(p[i]) - (int) ascii_tolower(q[i]);
+		}
+#endif
+		uint c1 = *p, c2 = *q;
+		if ((c1 | c2) >= 0x80)
+			return _mbsicmp(p, q);
+		c1 = ascii_tolower(c1);
+		c2 = ascii_tolower(c2);
+		if (c1 != c2 || c1 == 0)
+			return (int) c1 - (int) c2;
+		++p;
+		++q;
+	}
+}
+
 /** 啶𖳎, s1s2͓? */
 inline bool striequ(const char* s1, const char* s2)
 {
-	return _mbsicmp((const uchar*)s1, (const uchar*)s2) == 0;
+	return stricmp_fast(s1, s2) == 0;
 }
 
 /** 啶𖳎, s1s2͓? */
@@ -23,24 +152,157 @@ inline bool strniequ(const char* s1, const char* s2, size_t n)
 	return _mbsnicmp((const uchar*)s1, (const uchar*)s2, n) == 0;
 }
 
+/** ASCII p  q ̐擪noCǵA啶𖳎Γ? */
+inline bool ascii_iequ(const char* p, const char* q, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+		if (ascii_tolower((uchar) p[i]) != ascii_tolower((uchar) q[i]))
+			return false;
+	}
+	return true;
+}
+
+/** ASCIĨp^[̌. 擪Ɩ̃oCgvʒuƂA₾ƍ.
+ * @param s1	Ώ.  len1.
+ * @param s2	ASCIĨp^[.  len2(>0).
+ * @param i		n߂ʒu.
+ */
+inline char* stristr_ascii_tail(const char* s1, size_t len1, const char* s2, size_t len2, size_t i)
+{
+	const uint first = ascii_tolower((uchar) s2[0]);
+	const uint last  = ascii_tolower((uchar) s2[len2-1]);
+	const size_t mid = len2 > 2 ? len2 - 2 : 0;
+	for (; i + len2 <= len1; ++i) {
+		if (ascii_tolower((uchar) s1[i]) == first && ascii_tolower((uchar) s1[i+len2-1]) == last
+			&& ascii_iequ(s1 + i + 1, s2 + 1, mid))
+			return (char*) s1 + i;
+	}
+	return NULL;
+}
+
+#ifdef MY_STR_SSE2
+/** stristr_ascii_tail 16ʒusɍs. */
+char* stristr_ascii_sse2(const char* s1, size_t len1, const char* s2, size_t len2)
+{
+	const __m128i first = _mm_set1_epi8((char) ascii_tolower((uchar) s2[0]));
+	const __m128i last  = _mm_set1_epi8((char) ascii_tolower((uchar) s2[len2-1]));
+	const size_t mid = len2 > 2 ? len2 - 2 : 0;
+	size_t i = 0;
+	for (; i + 16 + len2 - 1 <= len1; i += 16) {
+		__m128i a = ascii_tolower16(_mm_loadu_si128((const __m128i*) (s1 + i)));
+		__m128i b = ascii_tolower16(_mm_loadu_si128((const __m128i*) (s1 + i + len2 - 1)));
+		uint mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+		for (; mask; mask &= mask - 1) {
+			size_t pos = i + lowest_bit(mask);
+			if (ascii_iequ(s1 + pos + 1, s2 + 1, mid))
+				return (char*) s1 + pos;
+		}
+	}
+	return stristr_ascii_tail(s1, len1, s2, len2, i);
+}
+#endif
+
+#ifdef MY_STR_AVX2
+/** 32oCgASCIIp啶ɂ. */
+MY_AVX2_TARGET inline __m256i ascii_tolower32(__m256i x)
+{
+	__m256i t = _mm256_add_epi8(x, _mm256_set1_epi8((char) (0x80 - 'A')));
+	__m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8((char) (-128 + 26)), t);
+	return _mm256_or_si256(x, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+/** stristr_ascii_tail 32ʒusɍs. */
+MY_AVX2_TARGET char* stristr_ascii_avx2(const char* s1, size_t len1, const char* s2, size_t len2)
+{
+	const __m256i first = _mm256_set1_epi8((char) ascii_tolower((uchar) s2[0]));
+	const __m256i last  = _mm256_set1_epi8((char) ascii_tolower((uchar) s2[len2-1]));
+	const size_t mid = len2 > 2 ? len2 - 2 : 0;
+	size_t i = 0;
+	for (; i + 32 + len2 - 1 <= len1; i += 32) {
+		__m256i a = ascii_tolower32(_mm256_loadu_si256((const __m256i*) (s1 + i)));
+		__m256i b = ascii_tolower32(_mm256_loadu_si256((const __m256i*) (s1 + i + len2 - 1)));
+		uint mask = (uint) _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+		for (; mask; mask &= mask - 1) {
+			size_t pos = i + lowest_bit(mask);
+			if (ascii_iequ(s1 + pos + 1, s2 + 1, mid))
+				return (char*) s1 + pos;
+		}
+	}
+	return stristr_ascii_tail(s1, len1, s2, len2, i);
+}
+
+/** CPUOSAVX2g邩? */
+bool cpu_has_avx2()
+{
+#ifdef _MSC_VER
+	int r[4];
+	__cpuid(r, 0);
+	if (r[0] < 7)
+		return false;
+	__cpuid(r, 1);
+	if ((r[2] & (1 << 27)) == 0 || (r[2] & (1 << 28)) == 0)	// OSXSAVE, AVX
+		return false;
+	if ((_xgetbv(0) & 6) != 6)	// OSYMMWX^ۑ邩?
+		return false;
+	__cpuidex(r, 7, 0);
+	return (r[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+char* stristr_ascii_scalar(const char* s1, size_t len1, const char* s2, size_t len2)
+{
+	return stristr_ascii_tail(s1, len1, s2, len2, 0);
+}
+
+/** ASCIĨp^[̌֐. CPUɍ킹đI. */
+char* (* const stristr_ascii)(const char* s1, size_t len1, const char* s2, size_t len2) =
+#ifdef MY_STR_AVX2
+	cpu_has_avx2() ? stristr_ascii_avx2 :
+#endif
+#ifdef MY_STR_SSE2
+	stristr_ascii_sse2;
+#else
+	stristr_ascii_scalar;
+#endif
+
+/** }`oCg܂ތ. ̐擪ʒuƂɁAp^[̃oCgr. */
+inline char* stristr_mbcs(const char* s1, const char* s2, size_t len2)
+{
+	for (; *s1; s1 = mbs_next(s1)) {
+		if (_mbsnbicmp((const uchar*) s1, (const uchar*) s2, len2) == 0)
+			return (char*) s1;
+	}
+	return NULL;
+}
+
 /** 啶𖳎, s1̒ɕs2邩? */
 inline char* stristr(const char* s1, const char* s2)
 {
-	int up = toupper((uchar) s2[0]);
-	int lo = tolower((uchar) s2[0]);
-	int len = strlen(s2);
-	while (*s1) {
-		const char* upper = strchr(s1, up);
-		const char* lower = strchr(s1, lo);
-		s1 = (!lower || (upper && upper < lower)) ? upper : lower;
-		if (!s1)
-			return NULL;
-		if (strniequ(s1, s2, len))
-			return (char*)s1;
-		++s1;
+	size_t len2 = 0;
+	bool ascii = true;
+	for (; s2[len2]; ++len2) {
+		if ((uchar) s2[len2] >= 0x80)
+			ascii = false;
 	}
-	return NULL;
+	if (len2 == 0)
+		return (char*) s1;
+	if (!ascii)
+		return stristr_mbcs(s1, s2, len2);
+#ifdef _WIN32
+	// MBCSł2oCg2oCgڂASCIIƏdȂ̂ŁAs1ASCIÎƂɌ.
+	for (const char* p = s1; *p; ++p) {
+		if ((uchar) *p >= 0x80)
+			return stristr_mbcs(s1, s2, len2);
+	}
+#endif
+	// UTF-8ł̓}`oCg̑SoCg0x80ȏȂ̂ŁAASCIĨp^[̓oCgPʂŌĂ悢.
+	return stristr_ascii(s1, strlen(s1), s2, len2);
 }
+//@}
 
 //------------------------------------------------------------------------
 /** s1s2菬? */
@@ -52,7 +314,7 @@ inline bool strless(const char* s1, const char* s2)
 /** 啶𖳎, s1s2菬? */
 inline bool striless(const char* s1, const char* s2)
 {
-	return _mbsicmp((const uchar*)s1, (const uchar*)s2) < 0;
+	return stricmp_fast(s1, s2) < 0;
 }
 
 class StrILess {
@@ -62,6 +324,93 @@ public:
 	}
 };
 
+/** 啶𖳎ȑAoCg̔rōČL[.
+ * strcmp(key1, key2) ̕ stricmp_fast(s1, s2) ƓɂȂ.
+ * ̖OבւƂɁAL[xĔrPȃoCgrɂ邽߂Ɏg.
+ * Windows ł _mbsicmp ƓA1oCg2oCg菬R[hƂĕׂ.
+ * POSIX ł towlower ő𕄍. UTF-8 ̃oCg͕R[hƈv.
+ */
+void stricmp_key(const char* s, std::string& key)
+{
+	key.clear();
+	const uchar* p = (const uchar*) s;
+	while (*p) {
+		uint c = *p;
+		if (c < 0x80) {
+			key += (char) ascii_tolower(c);
+			++p;
+			continue;
+		}
+#ifdef _WIN32
+		if (_ismbblead(c) && p[1]) {
+			uint mc = _mbctolower((c << 8) | p[1]);
+			key += (char) (mc >> 8);
+			key += (char) (mc & 0xff);
+			p += 2;
+		}
+		else {
+			// 2oCg̐soCg(0x81ȏ)菬 0x80 OuāA1oCgɕׂ.
+			key += (char) 0x80;
+			key += (char) _mbctolower(c);
+			++p;
+		}
+#else
+		mbstate_t st;
+		memset(&st, 0, sizeof(st));
+		wchar_t w;
+		size_t n = mbrtowc(&w, (const char*) p, MB_CUR_MAX, &st);
+		if (n == 0 || n >= (size_t) -2) {
+			// Ƃĉ߂łȂoCǵÂ܂ܕׂ.
+			key += (char) c;
+			++p;
+			continue;
+		}
+		char buf[16];
+		memset(&st, 0, sizeof(st));
+		size_t m = wcrtomb(buf, (wchar_t) towlower(w), &st);
+		if (m == (size_t) -1 || m > sizeof(buf))
+			key.append((const char*) p, n);
+		else
+			key.append(buf, m);
+		p += n;
+#endif
+	}
+}
+
+/** t@C̏ƍ̏AoCg̔rōČL[.
+ * Windows ̃t@C͑啶ʂȂ̂ stricmp_key() ƓL[Ƃ.
+ * POSIX ł͑啶قȂ閼Oʂ̃t@CȂ̂ŁAÔ̂L[Ƃ.
+ */
+void filename_key(const char* s, std::string& key)
+{
+#ifdef _WIN32
+	stricmp_key(s, key);
+#else
+	key = s;
+#endif
+}
+
+/** 10i̕ǂ. R}hC̐lɎg.
+ * atoi ƈāA"-1"  "12x" ̂悤ȐlłȂ܂ނ̂ƁAꂷlۂ.
+ * @param s		ǂޕ.
+ * @param lo	ŏl.
+ * @param hi	ől.
+ * @param value	ǂ񂾒l̊i[.
+ * @retval false	lłȂA͈͊O.
+ */
+bool parse_uint(const char* s, unsigned long lo, unsigned long hi, unsigned long& value)
+{
+	if (!isdigit((uchar) *s))	// strtoul ǂݔ΂󔒂ƕۂ.
+		return false;
+	char* end;
+	errno = 0;
+	unsigned long v = strtoul(s, &end, 10);
+	if (*end != '\0' || errno == ERANGE || v < lo || v > hi)
+		return false;
+	value = v;
+	return true;
+}
+
 //------------------------------------------------------------------------
 /** \Ԃ. s\ɑ΂Ă'.'Ԃ */
 inline int ascii(int c)
@@ -0,0 +1,200 @@
+/**@file sysfunc.cpp --- platform compatibility functions.
+ * VC++  CRT ŗL֐APOSIX łOŌĂׂ悤ɂ.
+ * Windows ł͉Ȃ.  mylib  include 邱.
+ * @author Hiroshi Kuno <http://code.google.com/p/win32cmdx/>
+ */
+#ifndef _WIN32
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <wchar.h>
+#include <wctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <vector>
+
+//------------------------------------------------------------------------
+//!@name stdio.h, stdlib.h
+//@{
+inline int _fseeki64(FILE* fp, __int64 offset, int origin)
+{
+	return fseeko(fp, (off_t) offset, origin);
+}
+
+inline __int64 _ftelli64(FILE* fp)
+{
+	return (__int64) ftello(fp);
+}
+
+inline uint64 _strtoui64(const char* s, char** end, int base)
+{
+	return strtoull(s, end, base);
+}
+
+#define _fileno		fileno
+#define _vsnprintf	vsnprintf
+#define _snprintf	snprintf
+
+/** ΃pX΃pXɂ. VC++ ƓA݂ȂpX悤 realpath() sJgtH_Ou. */
+inline char* _fullpath(char* abspath, const char* relpath, size_t size)
+{
+	char* real = realpath(relpath, NULL);
+	if (real) {
+		size_t len = strlen(real);
+		if (len >= size) {
+			free(real);
+			return NULL;
+		}
+		memcpy(abspath, real, len + 1);
+		free(real);
+		return abspath;
+	}
+	if (relpath[0] == '/') {
+		if (strlen(relpath) >= size)
+			return NULL;
+		return strcpy(abspath, relpath);
+	}
+	if (!getcwd(abspath, size))
+		return NULL;
+	size_t len = strlen(abspath);
+	if (len + 1 + strlen(relpath) >= size)
+		return NULL;
+	abspath[len] = '/';
+	strcpy(abspath + len + 1, relpath);
+	return abspath;
+}
+//@}
+
+//------------------------------------------------------------------------
+//!@name sys/stat.h, io.h
+//@{
+#define __stat64	stat
+
+inline int _stat64(const char* path, struct stat* st)
+{
+	return stat(path, st);
+}
+
+inline int _fstat64(int fd, struct stat* st)
+{
+	return fstat(fd, st);
+}
+
+#define _access		access
+//@}
+
+//------------------------------------------------------------------------
+//!@name stdlib.h: pX̕ƍ. hCu͏ɋƂ.
+//@{
+void _splitpath(const char* path, char* drive, char* dir, char* fname, char* ext)
+{
+	const char* slash = strrchr(path, '/');
+	const char* base = slash ? slash + 1 : path;
+	const char* dot = strrchr(base, '.');
+	if (dot == NULL || dot == base)
+		dot = base + strlen(base);
+	if (drive)
+		drive[0] = '\0';
+	if (dir) {
+		memcpy(dir, path, base - path);
+		dir[base - path] = '\0';
+	}
+	if (fname) {
+		memcpy(fname, base, dot - base);
+		fname[dot - base] = '\0';
+	}
+	if (ext)
+		strcpy(ext, dot);
+}
+
+void _makepath(char* path, const char* drive, const char* dir, const char* fname, const char* ext)
+{
+	path[0] = '\0';
+	if (drive)
+		strcat(path, drive);
+	if (dir && dir[0]) {
+		strcat(path, dir);
+		if (dir[strlen(dir)-1] != '/')
+			strcat(path, "/");
+	}
+	if (fname)
+		strcat(path, fname);
+	if (ext && ext[0]) {
+		if (ext[0] != '.')
+			strcat(path, ".");
+		strcat(path, ext);
+	}
+}
+//@}
+
+//------------------------------------------------------------------------
+//!@name mbstring.h: P[̕R[h(UTF-8Ȃ)Ń}`oCg߂Atowlowerő啶𑵂Ĕr.
+//@{
+inline int _mbscmp(const uchar* s1, const uchar* s2)
+{
+	return strcmp((const char*) s1, (const char*) s2);
+}
+
+/** 啶𖳎āAs1 ̐擪 n oCg܂łr.
+ * Ƃĉ߂łȂoCgɏoA̓oCgPʂŔr.
+ */
+inline int _mbsnbicmp(const uchar* s1, const uchar* s2, size_t n)
+{
+	mbstate_t st1, st2;
+	memset(&st1, 0, sizeof(st1));
+	memset(&st2, 0, sizeof(st2));
+	for (size_t done = 0; done < n; ) {
+		wchar_t w1, w2;
+		size_t n1 = mbrtowc(&w1, (const char*) s1, MB_CUR_MAX, &st1);
+		size_t n2 = mbrtowc(&w2, (const char*) s2, MB_CUR_MAX, &st2);
+		if (n1 >= (size_t) -2 || n2 >= (size_t) -2)
+			return strncasecmp((const char*) s1, (const char*) s2, n - done);
+		wint_t c1 = towlower(w1);
+		wint_t c2 = towlower(w2);
+		if (c1 != c2)
+			return c1 < c2 ? -1 : 1;
+		if (w1 == 0)
+			return 0;
+		s1 += n1;
+		s2 += n2;
+		done += n1;
+	}
+	return 0;
+}
+
+inline int _mbsicmp(const uchar* s1, const uchar* s2)
+{
+	return _mbsnbicmp(s1, s2, (size_t) -1);
+}
+
+/** 啶𖳎āA擪 n ܂łr. */
+inline int _mbsnicmp(const uchar* s1, const uchar* s2, size_t n)
+{
+	mbstate_t st1, st2;
+	memset(&st1, 0, sizeof(st1));
+	memset(&st2, 0, sizeof(st2));
+	for (; n > 0; --n) {
+		wchar_t w1, w2;
+		size_t n1 = mbrtowc(&w1, (const char*) s1, MB_CUR_MAX, &st1);
+		size_t n2 = mbrtowc(&w2, (const char*) s2, MB_CUR_MAX, &st2);
+		if (n1 >= (size_t) -2 || n2 >= (size_t) -2)
+			return strncasecmp((const char*) s1, (const char*) s2, n);
+		wint_t c1 = towlower(w1);
+		wint_t c2 = towlower(w2);
+		if (c1 != c2)
+			return c1 < c2 ? -1 : 1;
+		if (w1 == 0)
+			return 0;
+		s1 += n1;
+		s2 += n2;
+	}
+	return 0;
+}
+//@}
+
+#endif //!_WIN32
+// sysfunc.cpp - end.
@@ -0,0 +1,515 @@
+/**@file thrfunc.cpp --- thread functions.
+ * @author Hiroshi Kuno <http://code.google.com/p/win32cmdx/>
+ */
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+#include <deque>
+#include <vector>
+
+//------------------------------------------------------------------------
+/** _CPU𓾂. */
+int cpu_count()
+{
+#ifdef _WIN32
+	SYSTEM_INFO si;
+	::GetSystemInfo(&si);
+	return si.dwNumberOfProcessors > 0 ? (int) si.dwNumberOfProcessors : 1;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (int) n : 1;
+#endif
+}
+
+//------------------------------------------------------------------------
+//!@name s. Xbh狤LQƃJE^tOɎg.
+//@{
+#ifdef _WIN32
+inline long atomic_increment(volatile long* p)
+{
+	return ::InterlockedIncrement(p);
+}
+
+inline long atomic_decrement(volatile long* p)
+{
+	return ::InterlockedDecrement(p);
+}
+
+/** *p  v ݁AȑO̒lԂ. */
+inline long atomic_exchange(volatile long* p, long v)
+{
+	return ::InterlockedExchange(p, v);
+}
+
+/** *p ǂ. ̃Xbh *p ޑOɏéAǂ񂾌Ɍ. */
+inline long atomic_load(volatile long* p)
+{
+	return ::InterlockedCompareExchange(p, 0, 0);
+}
+
+/** oA. ̑O̓ǂݏ̏ւȂ. */
+inline void memory_barrier()
+{
+	::MemoryBarrier();
+}
+
+/** *p  v ݁AȑO̒lԂ. */
+inline void* atomic_exchange_pointer(void* volatile* p, void* v)
+{
+	return ::InterlockedExchangePointer(p, v);
+}
+
+/** *p  expected Ȃ v . ȑO̒lԂ. */
+inline void* atomic_compare_exchange_pointer(void* volatile* p, void* v, void* expected)
+{
+	return ::InterlockedCompareExchangePointer(p, v, expected);
+}
+#else
+inline long atomic_increment(volatile long* p)
+{
+	return __sync_add_and_fetch(p, 1);
+}
+
+inline long atomic_decrement(volatile long* p)
+{
+	return __sync_sub_and_fetch(p, 1);
+}
+
+/** *p  v ݁AȑO̒lԂ. */
+inline long atomic_exchange(volatile long* p, long v)
+{
+	__sync_synchronize();
+	return __sync_lock_test_and_set(p, v);
+}
+
+/** *p ǂ. ̃Xbh *p ޑOɏéAǂ񂾌Ɍ. */
+inline long atomic_load(volatile long* p)
+{
+	return __sync_val_compare_and_swap(p, 0, 0);
+}
+
+/** oA. ̑O̓ǂݏ̏ւȂ. */
+inline void memory_barrier()
+{
+	__sync_synchronize();
+}
+
+/** *p  v ݁AȑO̒lԂ. */
+inline void* atomic_exchange_pointer(void* volatile* p, void* v)
+{
+	__sync_synchronize();
+	return __sync_lock_test_and_set(p, v);
+}
+
+/** *p  expected Ȃ v . ȑO̒lԂ. */
+inline void* atomic_compare_exchange_pointer(void* volatile* p, void* v, void* expected)
+{
+	return __sync_val_compare_and_swap(p, expected, v);
+}
+#endif
+//@}
+
+//------------------------------------------------------------------------
+/** rIuWFNg. */
+class Mutex {
+#ifdef _WIN32
+	CRITICAL_SECTION mCs;
+#else
+	pthread_mutex_t mCs;
+	friend class Semaphore;
+	friend class Event;
+#endif
+
+	Mutex(const Mutex&);				// Rs[֎~.
+	void operator=(const Mutex&);		// ֎~.
+public:
+#ifdef _WIN32
+	Mutex() {
+		::InitializeCriticalSection(&mCs);
+	}
+	~Mutex() {
+		::DeleteCriticalSection(&mCs);
+	}
+	void Lock() {
+		::EnterCriticalSection(&mCs);
+	}
+	void Unlock() {
+		::LeaveCriticalSection(&mCs);
+	}
+	/** bN݂. ̃XbhbNȂΑ҂ false Ԃ. */
+	bool TryLock() {
+		return ::TryEnterCriticalSection(&mCs) != 0;
+	}
+#else
+	Mutex() {
+		pthread_mutex_init(&mCs, NULL);
+	}
+	~Mutex() {
+		pthread_mutex_destroy(&mCs);
+	}
+	void Lock() {
+		pthread_mutex_lock(&mCs);
+	}
+	void Unlock() {
+		pthread_mutex_unlock(&mCs);
+	}
+	/** bN݂. ̃XbhbNȂΑ҂ false Ԃ. */
+	bool TryLock() {
+		return pthread_mutex_trylock(&mCs) == 0;
+	}
+#endif
+};
+
+/** XR[vMutexbN. */
+class Lock {
+	Mutex& mMutex;
+
+	Lock(const Lock&);					// Rs[֎~.
+	void operator=(const Lock&);		// ֎~.
+public:
+	explicit Lock(Mutex& m) : mMutex(m) {
+		mMutex.Lock();
+	}
+	~Lock() {
+		mMutex.Unlock();
+	}
+};
+
+//------------------------------------------------------------------------
+/** vZ}tH. */
+class Semaphore {
+#ifdef _WIN32
+	HANDLE mHandle;
+#else
+	Mutex mMutex;
+	pthread_cond_t mCond;
+	long mCount;
+#endif
+
+	Semaphore(const Semaphore&);		// Rs[֎~.
+	void operator=(const Semaphore&);	// ֎~.
+public:
+#ifdef _WIN32
+	Semaphore() {
+		mHandle = ::CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+	}
+	~Semaphore() {
+		::CloseHandle(mHandle);
+	}
+	/** JEgɂȂ̂҂A1炷. */
+	void Wait() {
+		::WaitForSingleObject(mHandle, INFINITE);
+	}
+	/** JEgn₷. */
+	void Post(long n = 1) {
+		::ReleaseSemaphore(mHandle, n, NULL);
+	}
+#else
+	Semaphore() : mCount(0) {
+		pthread_cond_init(&mCond, NULL);
+	}
+	~Semaphore() {
+		pthread_cond_destroy(&mCond);
+	}
+	/** JEgɂȂ̂҂A1炷. */
+	void Wait() {
+		Lock lock(mMutex);
+		while (mCount == 0)
+			pthread_cond_wait(&mCond, &mMutex.mCs);
+		--mCount;
+	}
+	/** JEgn₷. */
+	void Post(long n = 1) {
+		Lock lock(mMutex);
+		mCount += n;
+		pthread_cond_broadcast(&mCond);
+	}
+#endif
+};
+
+/** 蓮Zbg̃Cxg. */
+class Event {
+#ifdef _WIN32
+	HANDLE mHandle;
+#else
+	Mutex mMutex;
+	pthread_cond_t mCond;
+	bool mSignaled;
+#endif
+
+	Event(const Event&);				// Rs[֎~.
+	void operator=(const Event&);		// ֎~.
+public:
+#ifdef _WIN32
+	explicit Event(bool signaled = false) {
+		mHandle = ::CreateEvent(NULL, TRUE, signaled, NULL);
+	}
+	~Event() {
+		::CloseHandle(mHandle);
+	}
+	void Set() {
+		::SetEvent(mHandle);
+	}
+	void Reset() {
+		::ResetEvent(mHandle);
+	}
+	/** VOiԂɂȂ̂҂. */
+	void Wait() {
+		::WaitForSingleObject(mHandle, INFINITE);
+	}
+#else
+	explicit Event(bool signaled = false) : mSignaled(signaled) {
+		pthread_cond_init(&mCond, NULL);
+	}
+	~Event() {
+		pthread_cond_destroy(&mCond);
+	}
+	void Set() {
+		Lock lock(mMutex);
+		mSignaled = true;
+		pthread_cond_broadcast(&mCond);
+	}
+	void Reset() {
+		Lock lock(mMutex);
+		mSignaled = false;
+	}
+	/** VOiԂɂȂ̂҂. */
+	void Wait() {
+		Lock lock(mMutex);
+		while (!mSignaled)
+			pthread_cond_wait(&mCond, &mMutex.mCs);
+	}
+#endif
+};
+
+//------------------------------------------------------------------------
+/** Xbh. */
+class Thread {
+#ifdef _WIN32
+	HANDLE mHandle;
+#else
+	pthread_t mHandle;
+	bool mStarted;
+#endif
+public:
+	typedef void (*Func)(void* arg);
+
+#ifdef _WIN32
+	Thread() : mHandle(NULL) {}
+
+	/** XbhN func(arg) s. */
+	bool Start(Func func, void* arg) {
+		StartArg* p = new StartArg(func, arg);
+		mHandle = (HANDLE) _beginthreadex(NULL, 0, ThreadMain, p, 0, NULL);
+		if (mHandle == NULL)
+			delete p;
+		return mHandle != NULL;
+	}
+
+	/** Xbh̏I҂. */
+	void Join() {
+		if (mHandle) {
+			::WaitForSingleObject(mHandle, INFINITE);
+			::CloseHandle(mHandle);
+			mHandle = NULL;
+		}
+	}
+#else
+	Thread() : mStarted(false) {}
+
+	/** XbhN func(arg) s. */
+	bool Start(Func func, void* arg) {
+		StartArg* p = new StartArg(func, arg);
+		mStarted = pthread_create(&mHandle, NULL, ThreadMain, p) == 0;
+		if (!mStarted)
+			delete p;
+		return mStarted;
+	}
+
+	/** Xbh̏I҂. */
+	void Join() {
+		if (mStarted) {
+			pthread_join(mHandle, NULL);
+			mStarted = false;
+		}
+	}
+#endif
+
+private:
+	struct StartArg {
+		Func func;
+		void* arg;
+		StartArg(Func f, void* a) : func(f), arg(a) {}
+	};
+
+#ifdef _WIN32
+	static unsigned __stdcall ThreadMain(void* p) {
+#else
+	static void* ThreadMain(void* p) {
+#endif
+		StartArg a = *(StartArg*) p;
+		delete (StartArg*) p;
+		a.func(a.arg);
+		return 0;
+	}
+};
+
+//------------------------------------------------------------------------
+/** oߎԂ̌v. CPUԂł͂ȂԂ𑪂̂ŁAI/OXbh̑҂܂. */
+class Stopwatch {
+#ifdef _WIN32
+	LARGE_INTEGER mStart;
+#else
+	timespec mStart;
+#endif
+public:
+	Stopwatch() {
+		Restart();
+	}
+
+	/** vnߒ. */
+	void Restart() {
+#ifdef _WIN32
+		::QueryPerformanceCounter(&mStart);
+#else
+		clock_gettime(CLOCK_MONOTONIC, &mStart);
+#endif
+	}
+
+	/** Jňoߕb. */
+	double Elapsed() const {
+#ifdef _WIN32
+		LARGE_INTEGER now, freq;
+		::QueryPerformanceCounter(&now);
+		::QueryPerformanceFrequency(&freq);
+		return (double) (now.QuadPart - mStart.QuadPart) / freq.QuadPart;
+#else
+		timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return (now.tv_sec - mStart.tv_sec) + (now.tv_nsec - mStart.tv_nsec) / 1e9;
+#endif
+	}
+};
+
+//------------------------------------------------------------------------
+/** Xbhv[ŎsƒP. */
+class Task {
+public:
+	virtual ~Task() {}
+
+	/** Ƃs. [J[XbhŌĂ΂. */
+	virtual void Run() = 0;
+};
+
+/** R}hC -j<N> Ŏwł郏[J[Xbh̏. */
+const unsigned long MAX_THREADS = 1024;
+
+/** Xbhv[.
+ * Submit()œꂽTaskAŒ萔̃[J[XbhœɎs.
+ * sITask̓v[delete.
+ */
+class ThreadPool {
+	std::vector<Thread> mThreads;
+	std::deque<Task*> mQueue;	///< s҂Task.
+	Mutex mMutex;				///< mQueue, mPending, mQuit ی삷.
+	Semaphore mReady;			///< s҂Task𐔂Z}tH.
+	Event mIdle;				///< TaskƂɃVOiԂɂȂCxg.
+	long mPending;				///< Task.
+	bool mQuit;					///< [J[Xbh̏Iv.
+
+	ThreadPool(const ThreadPool&);		// Rs[֎~.
+	void operator=(const ThreadPool&);	// ֎~.
+public:
+	/** RXgN^.
+	 * @param n	[J[Xbh. 0ȂΘ_CPUƂ.
+	 */
+	explicit ThreadPool(int n = 0)
+		: mIdle(true), mPending(0), mQuit(false)
+	{
+		if (n <= 0)
+			n = cpu_count();
+		mThreads.reserve(n);
+		for (int i = 0; i < n; ++i) {
+			mThreads.push_back(Thread());
+			if (!mThreads.back().Start(WorkerMain, this))
+				mThreads.pop_back();
+		}
+	}
+
+	/** fXgN^. STask̊҂ĂA[J[XbhI. */
+	~ThreadPool() {
+		Wait();
+		{
+			Lock lock(mMutex);
+			mQuit = true;
+		}
+		mReady.Post((long) mThreads.size());
+		for (size_t i = 0; i < mThreads.size(); ++i)
+			mThreads[i].Join();
+	}
+
+	//....................................................................
+	/** Task𓊓. L̓v[Ɉڂ. */
+	void Submit(Task* task) {
+		if (mThreads.empty()) {
+			// XbhȂȂ΁AĂяõXbhŎs.
+			task->Run();
+			delete task;
+			return;
+		}
+		{
+			Lock lock(mMutex);
+			if (mPending++ == 0)
+				mIdle.Reset();
+			mQueue.push_back(task);
+		}
+		mReady.Post();
+	}
+
+	/** ς݂̑STask̊҂. */
+	void Wait() {
+		mIdle.Wait();
+	}
+
+	/** [J[Xbh. */
+	int Size() const {
+		return mThreads.empty() ? 1 : (int) mThreads.size();
+	}
+
+private:
+	static void WorkerMain(void* arg) {
+		ThreadPool* pool = (ThreadPool*) arg;
+		pool->Work();
+	}
+
+	void Work() {
+		for (;;) {
+			mReady.Wait();
+			Task* task;
+			{
+				Lock lock(mMutex);
+				if (mQueue.empty()) {
+					if (mQuit)
+						return;
+					continue;
+				}
+				task = mQueue.front();
+				mQueue.pop_front();
+			}
+			task->Run();
+			delete task;
+			{
+				Lock lock(mMutex);
+				if (--mPending == 0)
+					mIdle.Set();
+			}
+		}
+	}
+};
+
+// thrfunc.cpp - end.
@@ -0,0 +1,318 @@
+/**@file walkfunc.cpp --- parallel directory tree walker.
+ * dirfunc.cpp, memfunc.cpp, thrfunc.cpp, diagfunc.cpp  include 邱.
+ * @author Hiroshi Kuno <http://code.google.com/p/win32cmdx/>
+ */
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------
+/** T̐ݒ. */
+struct WalkOptions {
+	bool recursive;					///< TutH_T邩?
+	bool prune_hidden;				///< B̃tH_̉TȂ?
+	bool prune_system;				///< VXẽtH_̉TȂ?
+	std::vector<std::string> prune;	///< TȂtH_̃ChJ[h. e.g. "CVS"
+	bool need_stat;					///< t@C̎ƃTCYKv? svȂPOSIXstatȂ.
+	int threads;					///< [J[Xbh. 0ȂΘ_CPUƂ.
+
+	WalkOptions()
+		: recursive(false), prune_hidden(false), prune_system(false), need_stat(true), threads(0) {}
+};
+
+/** TŌt@C󂯎R[obN.
+ * ̃[J[Xbh瓯ɌĂ΂̂ŁALԂ͌Ă΂鑤ŕی삷邱.
+ */
+class WalkVisitor {
+public:
+	virtual ~WalkVisitor() {}
+
+	/** ChJ[hɈvt@C.
+	 * @param dir	t@ĈtH_. TJntH_ɃTutH_ƃpX؂ɕt.
+	 * @param find	t@Č.
+	 */
+	virtual void File(const char* dir, const _finddata_t& find) = 0;
+
+	/** TutH_. }̐ݒʉ߂̂ɂČĂ΂.
+	 * @retval false	̃tH_̉TȂ.
+	 */
+	virtual bool Folder(const char* dir, const _finddata_t& find) {
+		return true;
+	}
+};
+
+//------------------------------------------------------------------------
+/** tH_؂̕T.
+ * etH_x񋓂At@C̓ChJ[hŏƍăR[obNɓnA
+ * TutH_͍ƃL[ɐςŃ[J[XbhŕsɒT.
+ *
+ * ƃL[̓[J[ɎÃL[͌(Ōɐς񂾐[tH_)A
+ * ̃L[ȂΑ̃[J[̃L[̐擪(󂢑傫ȕ)𓐂.
+ * e[J[̕؂[DŐi߂̂ŁAL[̋͋󂢂[J[ނƂƂȂ.
+ */
+class DirWalker {
+	/** [J[̍ƃL[. */
+	struct Queue {
+		Mutex mutex;
+		std::deque<std::string> dirs;
+	};
+	/** [J[Xbḧ. */
+	struct WorkerArg {
+		DirWalker* walker;
+		int index;
+	};
+
+	WalkVisitor& mVisitor;
+	WalkOptions mOpt;
+	std::string mWild;			///< t@Cƍ郏ChJ[h.
+	std::vector<Queue*> mQueues;
+	Semaphore mReady;			///< SL[̒̃tH_𐔂Z}tH.
+	volatile long mPending;		///< T҂܂͒T̃tH_. 0ɂȂΊ.
+	volatile long mDone;		///< 1.
+	volatile long mFolders;		///< TtH_.
+	volatile long mFiles;		///< vt@C.
+
+	DirWalker(const DirWalker&);		// Rs[֎~.
+	void operator=(const DirWalker&);	// ֎~.
+public:
+	//....................................................................
+	DirWalker(WalkVisitor& visitor, const WalkOptions& opt)
+		: mVisitor(visitor), mOpt(opt), mPending(0), mDone(0), mFolders(0), mFiles(0) {}
+
+	~DirWalker() {
+		for (size_t i = 0; i < mQueues.size(); ++i)
+			delete mQueues[i];
+	}
+
+	//....................................................................
+	/** dir ̉ wild Ɉvt@CT. TI܂Ŗ߂Ȃ.
+	 * @param dir	TJntH_. "" Ȃ΃JgtH_.
+	 */
+	void Walk(const char* dir, const char* wild);
+
+	/** TtH_. */
+	long Folders() const {
+		return mFolders;
+	}
+
+	/** vt@C. */
+	long Files() const {
+		return mFiles;
+	}
+
+private:
+	static void WorkerMain(void* arg) {
+		WorkerArg* a = (WorkerArg*) arg;
+		a->walker->Work(a->index);
+	}
+
+	void Work(int self);
+	void Push(int self, const std::string& dir);
+	bool Pop(int self, std::string& dir);
+	void ScanFolder(int self, const std::string& dir);
+	bool IsPruned(const FindFile& find) const;
+};
+
+//........................................................................
+void DirWalker::Walk(const char* dir, const char* wild)
+{
+	mWild = wild;
+	int n = mOpt.recursive ? mOpt.threads : 1;
+	if (n <= 0)
+		n = cpu_count();
+	if (n == 1) {
+		// Xbh炸AĂяõXbhŐ[DɒT.
+		mQueues.push_back(new Queue);
+		Push(0, dir);
+		std::string d;
+		while (Pop(0, d))
+			ScanFolder(0, d);
+		return;
+	}
+
+	for (int i = 0; i < n; ++i)
+		mQueues.push_back(new Queue);
+	Push(0, dir);
+	std::vector<WorkerArg> args(n);
+	std::vector<Thread> threads(n);
+	int started = 0;
+	for (int i = 0; i < n; ++i) {
+		args[i].walker = this;
+		args[i].index = i;
+		if (threads[i].Start(WorkerMain, &args[i]))
+			++started;
+	}
+	if (started == 0)
+		Work(0);	// XbhȂȂ΁AĂяõXbhŒT.
+	for (int i = 0; i < n; ++i)
+		threads[i].Join();
+}
+
+//........................................................................
+/** [J[Xbh̖{. L[̃tH_sAT̃tH_ȂΏI. */
+void DirWalker::Work(int self)
+{
+	for (;;) {
+		mReady.Wait();
+		if (mDone)
+			return;
+		// Z}tHꂽȂ΁Aǂ̃L[ɃtH_cĂ.
+		std::string dir;
+		while (!Pop(self, dir))
+			;
+		ScanFolder(self, dir);
+		if (atomic_decrement(&mPending) == 0) {
+			atomic_exchange(&mDone, 1);
+			mReady.Post((long) mQueues.size());
+		}
+	}
+}
+
+//........................................................................
+/** ̃L[ɃtH_ς. */
+void DirWalker::Push(int self, const std::string& dir)
+{
+	atomic_increment(&mPending);
+	{
+		Lock lock(mQueues[self]->mutex);
+		mQueues[self]->dirs.push_back(dir);
+	}
+	mReady.Post();
+}
+
+//........................................................................
+/** ̃L[̌납AȂΑ̃L[̐擪tH_.
+ * @retval false	SẴL[󂾂.
+ */
+bool DirWalker::Pop(int self, std::string& dir)
+{
+	{
+		Queue& q = *mQueues[self];
+		Lock lock(q.mutex);
+		if (!q.dirs.empty()) {
+			dir.swap(q.dirs.back());
+			q.dirs.pop_back();
+			return true;
+		}
+	}
+	int n = (int) mQueues.size();
+	for (int i = 1; i < n; ++i) {
+		Queue& q = *mQueues[(self + i) % n];
+		Lock lock(q.mutex);
+		if (!q.dirs.empty()) {
+			dir.swap(q.dirs.front());
+			q.dirs.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+//........................................................................
+/** ̃tH_񋓂. vt@C񍐂ATutH_̃L[ɐς. */
+void DirWalker::ScanFolder(int self, const std::string& dir)
+{
+	atomic_increment(&mFolders);
+	// TutH_̃pX́ÃtH_̃pXɖOǉčAς񂾂؂l߂Ďg.
+	PathBuf path(dir.c_str());
+	FindFile find(mOpt.need_stat);
+	find.Open(dir.c_str(), "*");
+	if (find.Error()) {
+		// ǂ߂ȂtH_͕񍐂Ĕ΂AT͑.
+		gDiag.SysError("can't read folder", dir.empty() ? "." : dir.c_str(), find.Error());
+		return;
+	}
+	for (; find; find.Next()) {
+		if (find.IsFolder()) {
+			// V{bNÑtH_͕񍐂邪AzȂ悤ɉ͒TȂ.
+			if (!mOpt.recursive || find.IsDotFolder() || IsPruned(find) || !mVisitor.Folder(dir.c_str(), find) || find.IsLink())
+				continue;
+			size_t mark = path.Push(find.Name());
+			path.Append(MY_PATH_SEP_STR, 1);
+			Push(self, std::string(path.c_str(), path.Length()));
+			path.Pop(mark);
+		}
+		else if (match_wildcard(mWild.c_str(), find.Name())) {
+			atomic_increment(&mFiles);
+			mVisitor.File(dir.c_str(), find);
+		}
+	}
+}
+
+//........................................................................
+/** }肷tH_? */
+bool DirWalker::IsPruned(const FindFile& find) const
+{
+	if ((mOpt.prune_hidden && find.IsHidden()) || (mOpt.prune_system && find.IsSystem()))
+		return true;
+	for (size_t i = 0; i < mOpt.prune.size(); ++i) {
+		if (match_wildcard(mOpt.prune[i].c_str(), find.Name()))
+			return true;
+	}
+	return false;
+}
+
+//------------------------------------------------------------------------
+/** TŌt@C̃pXW߂.
+ * tH_ƃt@CʁX StringPool Ɋi[Aet@C͓̃nh.
+ * tH_̃t@C̓tH_L̂ŁA[tH_ɑ̃t@CĂpXŜxi[Ȃ.
+ */
+class WalkList : public WalkVisitor {
+public:
+	/** t@C. */
+	struct Entry {
+		StringPool::Handle dir;		///< tH_. TJntH_ɃTutH_ƃpX؂𑱂.
+		StringPool::Handle name;	///< t@C.
+	};
+	std::vector<Entry> entries;
+
+	/** tH_. */
+	const char* Dir(const Entry& e) const {
+		return mNames.Str(e.dir);
+	}
+
+	/** t@C. */
+	const char* Name(const Entry& e) const {
+		return mNames.Str(e.name);
+	}
+
+	/** tH_ƃt@CpX path ɍ. */
+	void MakePath(const Entry& e, PathBuf& path) const {
+		path.Assign(Dir(e));
+		path.Push(Name(e));
+	}
+
+	virtual void File(const char* dir, const _finddata_t& find) {
+		Lock lock(mMutex);
+		Entry e;
+		e.dir = mNames.Intern(dir);
+		e.name = mNames.Intern(find.name);
+		entries.push_back(e);
+	}
+
+	/** T͎sɕς̂ŁAʂgOɕבւ. tH_AtH_ł̓t@CƂ. */
+	void Sort() {
+		std::sort(entries.begin(), entries.end(), Less(mNames));
+	}
+
+private:
+	struct Less {
+		const StringPool& names;
+		explicit Less(const StringPool& pool) : names(pool) {}
+		bool operator()(const Entry& a, const Entry& b) const {
+			if (a.dir != b.dir) {
+				int cmp = strcmp(names.Str(a.dir), names.Str(b.dir));
+				if (cmp != 0)
+					return cmp < 0;
+			}
+			return strcmp(names.Str(a.name), names.Str(b.name)) < 0;
+		}
+	};
+
+	Mutex mMutex;
+	StringPool mNames;
+};
+
+// walkfunc.cpp - end.
@@ -0,0 +1,1091 @@
+/**@file zipfunc.cpp --- ZIP file reader functions.
+ * @author Hiroshi Kuno <http://code.google.com/p/win32cmdx/>
+ *
+ * PKZIP APPNOTE.TXT ɊÂAZIPt@C̊eR[hǂݏo.
+ * - ZipReader: t@C擪珇ɑSR[h𑖍AR[h ZipVisitor Ăяo.
+ * - CentralDirReader: t@C̒fBNgǂݏo.
+ * ǂݏoʂ̕\H͌Ăяo ZipVisitor ŝŁA_vȊO̗prɂgݍ߂.
+ * filefunc.cpp  include 邱.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------
+//!@name little endian get from buffer.
+//@{
+inline uint16 Get16(const uchar* p)
+{
+	return (uint16)(((uint16)p[1] << 8) + p[0]);
+}
+
+inline uint32 Get32(const uchar* p)
+{
+	return ((uint32)Get16(p+2) << 16) + Get16(p);
+}
+
+inline uint64 Get64(const uchar* p)
+{
+	return ((uint64)Get32(p+4) << 32) + Get32(p);
+}
+//@}
+
+//........................................................................
+//!@name little endian put to buffer.
+//@{
+inline void Put16(std::vector<uchar>& buf, uint16 val)
+{
+	buf.push_back((uchar) val);
+	buf.push_back((uchar)(val >> 8));
+}
+
+inline void Put32(std::vector<uchar>& buf, uint32 val)
+{
+	Put16(buf, (uint16) val);
+	Put16(buf, (uint16)(val >> 16));
+}
+
+inline void Put64(std::vector<uchar>& buf, uint64 val)
+{
+	Put32(buf, (uint32) val);
+	Put32(buf, (uint32)(val >> 32));
+}
+//@}
+
+//------------------------------------------------------------------------
+/** ZIPt@C̓͌.
+ * stdioƓAI[zēǂƂEof()^ɂȂASeek()ŉ.
+ */
+class ZipSource {
+public:
+	virtual ~ZipSource() {}
+
+	/** őnoCgǂݏoAǂݏooCgԂ. */
+	virtual size_t Read(void* buf, size_t n) = 0;
+
+	/** 1oCgǂݏo. I[ȂEOFԂ. */
+	virtual int Getc() = 0;
+
+	/** ǂݏoʒuړ. origin  SEEK_SET ܂ SEEK_CUR. */
+	virtual void Seek(__int64 offset, int origin) = 0;
+
+	/** ǂݏoʒu. */
+	virtual __int64 Tell() = 0;
+
+	/** Ŝ̃TCY. */
+	virtual __int64 Size() = 0;
+
+	/** I[zēǂƂ? */
+	virtual bool Eof() = 0;
+};
+
+/** FILE* ͌Ƃ. */
+class ZipFileSource : public ZipSource {
+	FILE* mFin;
+public:
+	explicit ZipFileSource(FILE* fin) : mFin(fin) {}
+
+	virtual size_t Read(void* buf, size_t n) {
+		return fread(buf, 1, n, mFin);
+	}
+	virtual int Getc() {
+		return getc(mFin);
+	}
+	virtual void Seek(__int64 offset, int origin) {
+		_fseeki64(mFin, offset, origin);
+	}
+	virtual __int64 Tell() {
+		return _ftelli64(mFin);
+	}
+	virtual __int64 Size() {
+		__int64 pos = _ftelli64(mFin);
+		_fseeki64(mFin, 0, SEEK_END);
+		__int64 size = _ftelli64(mFin);
+		_fseeki64(mFin, pos, SEEK_SET);
+		return size;
+	}
+	virtual bool Eof() {
+		return feof(mFin) != 0;
+	}
+};
+
+/** ̃f[^͌Ƃ. f[^͕ʂȂ̂ŁAĂяoŕێ邱. */
+class ZipMemorySource : public ZipSource {
+	const uchar* mData;
+	size_t mSize;
+	size_t mPos;
+	bool mEof;
+public:
+	ZipMemorySource(const void* data, size_t size)
+		: mData((const uchar*) data), mSize(size), mPos(0), mEof(false) {}
+
+	virtual size_t Read(void* buf, size_t n) {
+		size_t rest = mPos < mSize ? mSize - mPos : 0;
+		if (n > rest) {
+			n = rest;
+			mEof = true;
+		}
+		memcpy(buf, mData + mPos, n);
+		mPos += n;
+		return n;
+	}
+	virtual int Getc() {
+		if (mPos >= mSize) {
+			mEof = true;
+			return EOF;
+		}
+		return mData[mPos++];
+	}
+	virtual void Seek(__int64 offset, int origin) {
+		if (origin == SEEK_CUR)
+			offset += mPos;
+		else if (origin == SEEK_END)
+			offset += mSize;
+		mPos = offset < 0 ? 0 : (size_t) offset;
+		mEof = false;
+	}
+	virtual __int64 Tell() {
+		return mPos;
+	}
+	virtual __int64 Size() {
+		return mSize;
+	}
+	virtual bool Eof() {
+		return mEof;
+	}
+};
+
+//........................................................................
+//!@name little endian read.
+//@{
+inline bool Read8(ZipSource& in, uint8& val)
+{
+	int c = in.Getc();
+	val = (uint8) c;
+	return c != EOF;
+}
+
+inline bool Read16(ZipSource& in, uint16& val)
+{
+	uint8 lo, hi;
+	if (Read8(in, lo) && Read8(in, hi)) {
+		val = ((uint16)hi << 8) + lo;
+		return true;
+	}
+	return false;
+}
+
+inline bool Read32(ZipSource& in, uint32& val)
+{
+	uint16 lo, hi;
+	if (Read16(in, lo) && Read16(in, hi)) {
+		val = ((uint32)hi << 16) + lo;
+		return true;
+	}
+	return false;
+}
+
+inline bool Read64(ZipSource& in, uint64& val)
+{
+	uint32 lo, hi;
+	if (Read32(in, lo) && Read32(in, hi)) {
+		val = ((uint64)hi << 32) + lo;
+		return true;
+	}
+	return false;
+}
+//@}
+
+//------------------------------------------------------------------------
+//!@name ZIPR[h.
+// etB[ȟ^̓t@C̕ƈvĂ. l̓t@C̒l̂܂܂ŁAZIP64g͓KpȂ.
+//@{
+/** R[h̋ʕ */
+struct ZipRecord {
+	uint32 signature;	///< header signature.
+	__int64 offset;		///< signature ̈ʒu.
+	int n;				///< ʂԍ. Local file header  Central file header ŕʂɐ. ԍȂR[h-1.
+	size_t length;		///< signature ɑŒ蒷̂AǂݏooCg. ǂݏoȂtB[h0Ƃ.
+};
+
+/*
+  A.  Local file header:
+
+        local file header signature     4 bytes  (0x04034b50)
+        version needed to extract       2 bytes
+        general purpose bit flag        2 bytes
+        compression method              2 bytes
+        last mod file time              2 bytes
+        last mod file date              2 bytes
+        crc-32                          4 bytes
+        compressed size                 4 bytes
+        uncompressed size               4 bytes
+        file name length                2 bytes
+        extra field length              2 bytes
+
+        file name (variable size)
+        extra field (variable size)
+
+  B.  File data
+
+      Immediately following the local header for a file
+      is the compressed or stored data for the file.
+      The series of [local file header][file data][data
+      descriptor] repeats for each file in the .ZIP archive.
+*/
+struct ZipLocalFileHeader : ZipRecord {
+	uint16 version_needed;
+	uint16 flags;
+	uint16 method;
+	uint16 mod_time;
+	uint16 mod_date;
+	uint32 crc;					///< ZIP64ł́A0xFFFFFFFFɌŒ肷.
+	uint32 compressed_size;		///< ZIP64ł́A0xFFFFFFFFɌŒ肷.
+	uint32 uncompressed_size;	///< ZIP64ł́A0xFFFFFFFFɌŒ肷.
+	uint16 file_name_length;
+	uint16 extra_field_length;
+	std::string file_name;
+	std::vector<uchar> extra_field;
+};
+
+/*
+  C.  Data descriptor:
+
+      [Info-ZIP discrepancy:
+       The Info-ZIP zip program starts the data descriptor with a 4-byte
+       PK-style signature.  Despite the specification, none of the PKWARE
+       programs supports the data descriptor.  PKZIP 4.0 -fix function
+       (and PKZIPFIX 2.04) ignores the data descriptor info even when bit 3
+       of the general purpose bit flag is set.
+        data descriptor signature       4 bytes  (0x08074b50)
+      ]
+
+        crc-32                          4 bytes
+        compressed size                 4 bytes
+        uncompressed size               4 bytes
+
+      This descriptor exists only if bit 3 of the general
+      purpose bit flag is set (see below).  It is byte aligned
+      and immediately follows the last byte of compressed data.
+      This descriptor is used only when it was not possible to
+      seek in the output .ZIP file, e.g., when the output .ZIP file
+      was standard output or a non-seekable device.  For ZIP64(tm) format
+      archives, the compressed and uncompressed sizes are 8 bytes each.
+
+      When compressing files, compressed and uncompressed sizes
+      should be stored in ZIP64 format (as 8 byte values) when a
+      files size exceeds 0xFFFFFFFF.   However ZIP64 format may be
+      used regardless of the size of a file.  When extracting, if
+      the zip64 extended information extra field is present for
+      the file the compressed and uncompressed sizes will be 8
+      byte values.
+*/
+struct ZipDataDescriptor : ZipRecord {
+	// signature 0Ȃ΁ALocal file header  bit 3 ɏ] file data ̒ォǂݏo.
+	uint32 crc;
+	uint32 compressed_size;
+	uint32 uncompressed_size;
+};
+
+/*
+  E.  Archive extra data record:
+
+        archive extra data signature    4 bytes  (0x08064b50)
+        extra field length              4 bytes
+        extra field data                (variable size)
+
+      The Archive Extra Data Record is introduced in version 6.2
+      of the ZIP format specification.  This record exists in support
+      of the Central Directory Encryption Feature implemented as part of
+      the Strong Encryption Specification as described in this document.
+      When present, this record immediately precedes the central
+      directory data structure.  The size of this data record will be
+      included in the Size of the Central Directory field in the
+      End of Central Directory record.  If the central directory structure
+      is compressed, but not encrypted, the location of the start of
+      this data record is determined using the Start of Central Directory
+      field in the Zip64 End of Central Directory record.
+*/
+struct ZipArchiveExtraDataRecord : ZipRecord {
+	uint32 extra_field_length;
+	std::vector<uchar> extra_field;
+};
+
+/*
+  F.  Central directory structure:
+
+      [file header 1]
+      .
+      .
+      .
+      [file header n]
+      [digital signature]
+
+      File header:
+
+        central file header signature   4 bytes  (0x02014b50)
+        version made by                 2 bytes
+        version needed to extract       2 bytes
+        general purpose bit flag        2 bytes
+        compression method              2 bytes
+        last mod file time              2 bytes
+        last mod file date              2 bytes
+        crc-32                          4 bytes
+        compressed size                 4 bytes
+        uncompressed size               4 bytes
+        file name length                2 bytes
+        extra field length              2 bytes
+        file comment length             2 bytes
+        disk number start               2 bytes
+        internal file attributes        2 bytes
+        external file attributes        4 bytes
+        relative offset of local header 4 bytes
+
+        file name (variable size)
+        extra field (variable size)
+        file comment (variable size)
+*/
+struct ZipCentralFileHeader : ZipRecord {
+	uint16 version_made;
+	uint16 version_needed;
+	uint16 flags;
+	uint16 method;
+	uint16 mod_time;
+	uint16 mod_date;
+	uint32 crc;					///< ZIP64ł́A0xFFFFFFFFɌŒ肷.
+	uint32 compressed_size;		///< ZIP64ł́A0xFFFFFFFFɌŒ肷.
+	uint32 uncompressed_size;	///< ZIP64ł́A0xFFFFFFFFɌŒ肷.
+	uint16 file_name_length;
+	uint16 extra_field_length;
+	uint16 file_comment_length;
+	uint16 disk_start;			///< ZIP64ł́A0xFFFFɌŒ肷.
+	uint16 internal_attr;
+	uint32 external_attr;
+	uint32 local_header_offset;	///< ZIP64ł́A0xFFFFFFFFɌŒ肷.
+	std::string file_name;
+	std::vector<uchar> extra_field;
+	std::string file_comment;
+};
+
+/*
+      Digital signature:
+
+        header signature                4 bytes  (0x05054b50)
+        size of data                    2 bytes
+        signature data (variable size)
+
+      With the introduction of the Central Directory Encryption
+      feature in version 6.2 of this specification, the Central
+      Directory Structure may be stored both compressed and encrypted.
+      Although not required, it is assumed when encrypting the
+      Central Directory Structure, that it will be compressed
+      for greater storage efficiency.  Information on the
+      Central Directory Encryption feature can be found in the section
+      describing the Strong Encryption Specification. The Digital
+      Signature record will be neither compressed nor encrypted.
+*/
+struct ZipDigitalSignature : ZipRecord {
+	uint16 size;	///< signature data  ZIP_DATA_SIGNATURE Ƃĕʂɒʒm.
+};
+
+/*
+  G.  Zip64 end of central directory record
+
+        zip64 end of central dir
+        signature                       4 bytes  (0x06064b50)
+        size of zip64 end of central
+        directory record                8 bytes
+        version made by                 2 bytes
+        version needed to extract       2 bytes
+        number of this disk             4 bytes
+        number of the disk with the
+        start of the central directory  4 bytes
+        total number of entries in the
+        central directory on this disk  8 bytes
+        total number of entries in the
+        central directory               8 bytes
+        size of the central directory   8 bytes
+        offset of start of central
+        directory with respect to
+        the starting disk number        8 bytes
+        zip64 extensible data sector    (variable size)
+
+        The value stored into the "size of zip64 end of central
+        directory record" should be the size of the remaining
+        record and should not include the leading 12 bytes.
+
+        Size = SizeOfFixedFields + SizeOfVariableData - 12.
+
+        The above record structure defines Version 1 of the
+        zip64 end of central directory record. Version 1 was
+        implemented in versions of this specification preceding
+        6.2 in support of the ZIP64 large file feature. The
+        introduction of the Central Directory Encryption feature
+        implemented in version 6.2 as part of the Strong Encryption
+        Specification defines Version 2 of this record structure.
+        Refer to the section describing the Strong Encryption
+        Specification for details on the version 2 format for
+        this record.
+
+        Special purpose data may reside in the zip64 extensible data
+        sector field following either a V1 or V2 version of this
+        record.  To ensure identification of this special purpose data
+        it must include an identifying header block consisting of the
+        following:
+
+           Header ID  -  2 bytes
+           Data Size  -  4 bytes
+
+        The Header ID field indicates the type of data that is in the
+        data block that follows.
+
+        Data Size identifies the number of bytes that follow for this
+        data block type.
+
+        Multiple special purpose data blocks may be present, but each
+        must be preceded by a Header ID and Data Size field.  Current
+        mappings of Header ID values supported in this field are as
+        defined in APPENDIX C.
+*/
+struct ZipZip64EndOfCentralDirectoryRecord : ZipRecord {
+	uint64 size;				///< size of this record. sizetB[hȌ̃TCY.
+	uint16 version_made;
+	uint16 version_needed;
+	uint32 disk;				///< number of this disk.
+	uint32 dir_disk;			///< disk of starting directory.
+	uint64 disk_entries;		///< directory-entries on this disk.
+	uint64 entries;				///< directory-entries in all disks.
+	uint64 dir_size;			///< size of the directory.
+	uint64 dir_offset;			///< offset of starting directory.
+};
+
+/*
+  H.  Zip64 end of central directory locator
+
+        zip64 end of central dir locator
+        signature                       4 bytes  (0x07064b50)
+        number of the disk with the
+        start of the zip64 end of
+        central directory               4 bytes
+        relative offset of the zip64
+        end of central directory record 8 bytes
+        total number of disks           4 bytes
+*/
+struct ZipZip64EndOfCentralDirectoryLocator : ZipRecord {
+	uint32 dir_disk;			///< disk of starting directory.
+	uint64 record_offset;		///< relative offset of zip64 record.
+	uint32 disks;				///< total number of disks.
+};
+
+/*
+  I.  End of central directory record:
+
+        end of central dir signature    4 bytes  (0x06054b50)
+        number of this disk             2 bytes
+        number of the disk with the
+        start of the central directory  2 bytes
+        total number of entries in the
+        central directory on this disk  2 bytes
+        total number of entries in
+        the central directory           2 bytes
+        size of the central directory   4 bytes
+        offset of start of central
+        directory with respect to
+        the starting disk number        4 bytes
+        .ZIP file comment length        2 bytes
+        .ZIP file comment       (variable size)
+*/
+struct ZipEndOfCentralDirectoryRecord : ZipRecord {
+	uint16 disk;				///< ZIP64ł́A0xFFFFɌŒ肷.
+	uint16 dir_disk;			///< ZIP64ł́A0xFFFFɌŒ肷.
+	uint16 disk_entries;		///< ZIP64ł́A0xFFFFɌŒ肷.
+	uint16 entries;				///< ZIP64ł́A0xFFFFɌŒ肷.
+	uint32 dir_size;			///< ZIP64ł́A0xFFFFFFFFɌŒ肷.
+	uint32 dir_offset;			///< ZIP64ł́A0xFFFFFFFFɌŒ肷.
+	uint16 comment_length;
+	std::string comment;
+};
+
+/** R[hȊÕf[^̈̎ */
+enum ZipDataKind {
+	ZIP_DATA_UNKNOWN,			///< ǂ̃R[hɂȂ̈.
+	ZIP_DATA_FILE,				///< file data.
+	ZIP_DATA_SIGNATURE,			///< Digital signature  signature data.
+	ZIP_DATA_ZIP64_EXTENSIBLE,	///< Zip64 end of central directory record  zip64 extensible data sector.
+};
+
+/** R[hȊÕf[^̈. e͑傫Ƃ̂œǂݏoɁAʒuƃTCYʒm. */
+struct ZipData {
+	ZipDataKind kind;
+	__int64 offset;
+	uint64 size;
+	int n;				///< 郌R[h̒ʂԍ. -1.
+};
+
+/** extra field R[h̎ */
+enum ZipExtraOwner {
+	ZIP_EXTRA_LOCAL,			///< Local file header.
+	ZIP_EXTRA_CENTRAL,			///< Central file header.
+	ZIP_EXTRA_ARCHIVE,			///< Archive extra data record.
+};
+//@}
+
+//------------------------------------------------------------------------
+/** ZipReader AR[hɌĂяoC^tF[X.
+ * Kvȃ\bhI[o[Ch΂悢.
+ * extra field R[h̊̏́AVisitExtraFields() Ŋe extra field ɂ ExtraField() ĂԂƂł.
+ */
+class ZipVisitor {
+public:
+	virtual ~ZipVisitor() {}
+
+	virtual void LocalFileHeader(const ZipLocalFileHeader& r) {
+		VisitExtraFields(ZIP_EXTRA_LOCAL, r.extra_field);
+	}
+	virtual void DataDescriptor(const ZipDataDescriptor&) {}
+	virtual void ArchiveExtraDataRecord(const ZipArchiveExtraDataRecord& r) {
+		VisitExtraFields(ZIP_EXTRA_ARCHIVE, r.extra_field);
+	}
+	virtual void CentralFileHeader(const ZipCentralFileHeader& r) {
+		VisitExtraFields(ZIP_EXTRA_CENTRAL, r.extra_field);
+	}
+	virtual void DigitalSignature(const ZipDigitalSignature&) {}
+	virtual void Zip64EndOfCentralDirectoryRecord(const ZipZip64EndOfCentralDirectoryRecord&) {}
+	virtual void Zip64EndOfCentralDirectoryLocator(const ZipZip64EndOfCentralDirectoryLocator&) {}
+	virtual void EndOfCentralDirectoryRecord(const ZipEndOfCentralDirectoryRecord&) {}
+
+	/** m signature R[h. signature ̒ォ瑖𑱂. */
+	virtual void UnknownRecord(const ZipRecord&) {}
+
+	/** f[^̈.
+	 * @param in	͌. ǂݏoʒu d.offset ɂ. ĂяoAZipReader ͗̈̏I[ɓǂݏoʒu߂.
+	 */
+	virtual void Data(const ZipData& d, ZipSource& in) {}
+
+	/** extra field ̈.
+	 * @param data	f[^. sizeZƂ́AR[h̏I[œr؂Ă.
+	 * @param avail	data ̗LoCg.
+	 */
+	virtual void ExtraField(ZipExtraOwner owner, uint16 id, uint16 size, const uchar* data, size_t avail) {}
+
+	/** extra field 𕪉āAe extra field ɂ ExtraField() Ă.
+	 * 4oCgɖȂ]͖.
+	 */
+	void VisitExtraFields(ZipExtraOwner owner, const std::vector<uchar>& extra);
+};
+
+/*
+          In order to allow different programs and different types
+          of information to be stored in the 'extra' field in .ZIP
+          files, the following structure should be used for all
+          programs storing data in this field:
+
+          header1+data1 + header2+data2 . . .
+
+          Each header should consist of:
+
+            Header ID - 2 bytes
+            Data Size - 2 bytes
+
+          Note: all fields stored in Intel low-byte/high-byte order.
+*/
+void ZipVisitor::VisitExtraFields(ZipExtraOwner owner, const std::vector<uchar>& extra)
+{
+	size_t offset = 0;
+	while (offset + 4 <= extra.size()) {
+		const uchar* p = &extra[offset];
+		uint16 id = Get16(p), size = Get16(p+2);
+		size_t rest = extra.size() - offset - 4;
+		ExtraField(owner, id, size, p + 4, size < rest ? size : rest);
+		offset += 4 + size;
+	}
+}
+
+//------------------------------------------------------------------------
+/** ZIPt@C擪珇ɑāAeR[h ZipVisitor ɒʒm.
+ * fBNgɗ炸Asignature "PK" TȂǂݐiނ̂ŁAꂽt@Cłǂ߂̃R[hʒm.
+ * R[h̊Ԃɂ関m̗̈ ZIP_DATA_UNKNOWN ƂĒʒm.
+ */
+class ZipReader {
+	ZipSource& mIn;
+	int mFileCount;		///< Local file header ̐.
+	int mDirCount;		///< Central file header ̐.
+public:
+	explicit ZipReader(ZipSource& in) : mIn(in), mFileCount(0), mDirCount(0) {}
+
+	/** SR[h𑖍. */
+	void Read(ZipVisitor& v);
+
+private:
+	bool SkipToNextPK(ZipVisitor& v);
+	void VisitData(ZipVisitor& v, ZipDataKind kind, uint64 size, int n);
+	void InitRecord(ZipRecord& r, uint32 signature, __int64 offset, int n);
+	void ReadFixed(ZipRecord& r, uchar* buf, size_t size);
+	void ReadString(std::string& s, size_t n);
+	void ReadBytes(std::vector<uchar>& buf, uint64 n);
+	void ReadLocalFileHeader(ZipVisitor& v, __int64 offset);
+	void ReadDataDescriptor(ZipVisitor& v, uint32 signature, __int64 offset);
+	void ReadArchiveExtraDataRecord(ZipVisitor& v, __int64 offset);
+	void ReadCentralFileHeader(ZipVisitor& v, __int64 offset);
+	void ReadDigitalSignature(ZipVisitor& v, __int64 offset);
+	void ReadZip64EndOfCentralDirectoryRecord(ZipVisitor& v, __int64 offset);
+	void ReadZip64EndOfCentralDirectoryLocator(ZipVisitor& v, __int64 offset);
+	void ReadEndOfCentralDirectoryRecord(ZipVisitor& v, __int64 offset);
+};
+
+//........................................................................
+void ZipReader::Read(ZipVisitor& v)
+{
+	mFileCount = mDirCount = 0;
+	uint32 signature = 0;
+	while (SkipToNextPK(v)) {
+		__int64 offset = mIn.Tell();
+		if (!Read32(mIn, signature)) {
+			continue;
+		}
+		switch (signature) {
+		case 0x04034b50: ReadLocalFileHeader(v, offset); break;
+		case 0x08074b50: ReadDataDescriptor(v, signature, offset); break;
+		case 0x08064b50: ReadArchiveExtraDataRecord(v, offset); break;
+		case 0x02014b50: ReadCentralFileHeader(v, offset); break;
+		case 0x05054b50: ReadDigitalSignature(v, offset); break;
+		case 0x06064b50: ReadZip64EndOfCentralDirectoryRecord(v, offset); break;
+		case 0x07064b50: ReadZip64EndOfCentralDirectoryLocator(v, offset); break;
+		case 0x06054b50: ReadEndOfCentralDirectoryRecord(v, offset); break;
+		default: {
+			ZipRecord r;
+			InitRecord(r, signature, offset, -1);
+			v.UnknownRecord(r);
+			break;
+		}
+		}//.endswitch signature
+	}//.endwhile NextPK
+}
+
+/** ZIP\wb_܂œǂݔ΂. ǂݔ΂̈ ZIP_DATA_UNKNOWN ƂĒʒm. */
+bool ZipReader::SkipToNextPK(ZipVisitor& v)
+{
+	__int64 skipsize = 0;
+	int c;
+	int prev = 0;
+
+	while ((c = mIn.Getc()) != EOF) {
+		if (prev == 'P' && c == 'K') {
+			mIn.Seek(-2, SEEK_CUR);
+			--skipsize;
+			break;
+		}
+		prev = c;
+		++skipsize;
+	}
+	if (skipsize > 0) {
+		mIn.Seek(-skipsize, SEEK_CUR);
+		VisitData(v, ZIP_DATA_UNKNOWN, skipsize, -1);
+	}
+	return !mIn.Eof();
+}
+
+/** ݈ʒusizeoCg̃f[^̈ʒmāȀI[ɐi. */
+void ZipReader::VisitData(ZipVisitor& v, ZipDataKind kind, uint64 size, int n)
+{
+	ZipData d;
+	d.kind   = kind;
+	d.offset = mIn.Tell();
+	d.size   = size;
+	d.n      = n;
+	v.Data(d, mIn);
+	mIn.Seek(d.offset + size, SEEK_SET);
+}
+
+void ZipReader::InitRecord(ZipRecord& r, uint32 signature, __int64 offset, int n)
+{
+	r.signature = signature;
+	r.offset    = offset;
+	r.n         = n;
+	r.length    = 0;
+}
+
+/** Œ蒷ǂݏo. ǂݏoȂ0Ŗ߂. */
+void ZipReader::ReadFixed(ZipRecord& r, uchar* buf, size_t size)
+{
+	r.length = mIn.Read(buf, size);
+	memset(buf + r.length, 0, size - r.length);
+}
+
+void ZipReader::ReadString(std::string& s, size_t n)
+{
+	s.resize(n);
+	if (n)
+		s.resize(mIn.Read(&s[0], n));
+}
+
+/** noCgǂݏo. ꂽTCYlŋȗ̈mۂȂ悤ɁAt@C̎cTCYŐ. */
+void ZipReader::ReadBytes(std::vector<uchar>& buf, uint64 n)
+{
+	__int64 rest = mIn.Size() - mIn.Tell();
+	if (rest < 0)
+		rest = 0;
+	if (n > (uint64) rest)
+		n = rest;
+	buf.resize((size_t) n);
+	if (n)
+		buf.resize(mIn.Read(&buf[0], (size_t) n));
+}
+
+//........................................................................
+void ZipReader::ReadLocalFileHeader(ZipVisitor& v, __int64 offset)
+{
+	ZipLocalFileHeader r;
+	uchar h[26];
+	InitRecord(r, 0x04034b50, offset, ++mFileCount);
+	ReadFixed(r, h, sizeof(h));
+	r.version_needed     = Get16(h);
+	r.flags              = Get16(h+2);
+	r.method             = Get16(h+4);
+	r.mod_time           = Get16(h+6);
+	r.mod_date           = Get16(h+8);
+	r.crc                = Get32(h+10);
+	r.compressed_size    = Get32(h+14);
+	r.uncompressed_size  = Get32(h+18);
+	r.file_name_length   = Get16(h+22);
+	r.extra_field_length = Get16(h+24);
+	ReadString(r.file_name, r.file_name_length);
+	ReadBytes(r.extra_field, r.extra_field_length);
+	v.LocalFileHeader(r);
+
+	if (r.compressed_size == 0xFFFFFFFF)
+		return;	// ZIP64 tH[}bĝ߁A㑱f[^̃TCYsȂ̂ File data  Data descriptor ͒ʒmȂ.
+
+	if (r.compressed_size) {
+		VisitData(v, ZIP_DATA_FILE, r.compressed_size, r.n);
+	}
+	if (r.flags & 0x0008) { // Bit 3: on
+		ReadDataDescriptor(v, 0, mIn.Tell());
+	}
+}
+
+void ZipReader::ReadDataDescriptor(ZipVisitor& v, uint32 signature, __int64 offset)
+{
+	ZipDataDescriptor r;
+	uchar h[12];
+	InitRecord(r, signature, offset, mFileCount);
+	ReadFixed(r, h, sizeof(h));
+	r.crc               = Get32(h);
+	r.compressed_size   = Get32(h+4);
+	r.uncompressed_size = Get32(h+8);
+	v.DataDescriptor(r);
+}
+
+void ZipReader::ReadArchiveExtraDataRecord(ZipVisitor& v, __int64 offset)
+{
+	ZipArchiveExtraDataRecord r;
+	uchar h[4];
+	InitRecord(r, 0x08064b50, offset, -1);
+	ReadFixed(r, h, sizeof(h));
+	r.extra_field_length = Get32(h);
+	ReadBytes(r.extra_field, r.extra_field_length);
+	v.ArchiveExtraDataRecord(r);
+}
+
+void ZipReader::ReadCentralFileHeader(ZipVisitor& v, __int64 offset)
+{
+	ZipCentralFileHeader r;
+	uchar h[42];
+	InitRecord(r, 0x02014b50, offset, ++mDirCount);
+	ReadFixed(r, h, sizeof(h));
+	r.version_made        = Get16(h);
+	r.version_needed      = Get16(h+2);
+	r.flags               = Get16(h+4);
+	r.method              = Get16(h+6);
+	r.mod_time            = Get16(h+8);
+	r.mod_date            = Get16(h+10);
+	r.crc                 = Get32(h+12);
+	r.compressed_size     = Get32(h+16);
+	r.uncompressed_size   = Get32(h+20);
+	r.file_name_length    = Get16(h+24);
+	r.extra_field_length  = Get16(h+26);
+	r.file_comment_length = Get16(h+28);
+	r.disk_start          = Get16(h+30);
+	r.internal_attr       = Get16(h+32);
+	r.external_attr       = Get32(h+34);
+	r.local_header_offset = Get32(h+38);
+	ReadString(r.file_name, r.file_name_length);
+	ReadBytes(r.extra_field, r.extra_field_length);
+	ReadString(r.file_comment, r.file_comment_length);
+	v.CentralFileHeader(r);
+}
+
+void ZipReader::ReadDigitalSignature(ZipVisitor& v, __int64 offset)
+{
+	ZipDigitalSignature r;
+	uchar h[2];
+	InitRecord(r, 0x05054b50, offset, -1);
+	ReadFixed(r, h, sizeof(h));
+	r.size = Get16(h);
+	v.DigitalSignature(r);
+	if (r.size) {
+		VisitData(v, ZIP_DATA_SIGNATURE, r.size, -1);
+	}
+}
+
+void ZipReader::ReadZip64EndOfCentralDirectoryRecord(ZipVisitor& v, __int64 offset)
+{
+	ZipZip64EndOfCentralDirectoryRecord r;
+	uchar h[52];
+	InitRecord(r, 0x06064b50, offset, -1);
+	ReadFixed(r, h, sizeof(h));
+	r.size           = Get64(h);
+	r.version_made   = Get16(h+8);
+	r.version_needed = Get16(h+10);
+	r.disk           = Get32(h+12);
+	r.dir_disk       = Get32(h+16);
+	r.disk_entries   = Get64(h+20);
+	r.entries        = Get64(h+28);
+	r.dir_size       = Get64(h+36);
+	r.dir_offset     = Get64(h+44);
+	v.Zip64EndOfCentralDirectoryRecord(r);
+
+	// sizetB[hȌ̌Œ蒷̂Azip64 extensible data sector ̃TCYƂȂ.
+	const uint64 FIXED_SIZE = 2*2 + 4*2 + 8*4;
+	VisitData(v, ZIP_DATA_ZIP64_EXTENSIBLE, r.size > FIXED_SIZE ? r.size - FIXED_SIZE : 0, -1);
+}
+
+void ZipReader::ReadZip64EndOfCentralDirectoryLocator(ZipVisitor& v, __int64 offset)
+{
+	ZipZip64EndOfCentralDirectoryLocator r;
+	uchar h[16];
+	InitRecord(r, 0x07064b50, offset, -1);
+	ReadFixed(r, h, sizeof(h));
+	r.dir_disk      = Get32(h);
+	r.record_offset = Get64(h+4);
+	r.disks         = Get32(h+12);
+	v.Zip64EndOfCentralDirectoryLocator(r);
+}
+
+void ZipReader::ReadEndOfCentralDirectoryRecord(ZipVisitor& v, __int64 offset)
+{
+	ZipEndOfCentralDirectoryRecord r;
+	uchar h[18];
+	InitRecord(r, 0x06054b50, offset, -1);
+	ReadFixed(r, h, sizeof(h));
+	r.disk           = Get16(h);
+	r.dir_disk       = Get16(h+2);
+	r.disk_entries   = Get16(h+4);
+	r.entries        = Get16(h+6);
+	r.dir_size       = Get32(h+8);
+	r.dir_offset     = Get32(h+12);
+	r.comment_length = Get16(h+16);
+	ReadString(r.comment, r.comment_length);
+	v.EndOfCentralDirectoryRecord(r);
+}
+
+//------------------------------------------------------------------------
+//!@name fBNǧ.
+//@{
+/** fBNg̈ʒu */
+struct CentralDirInfo {
+	__int64 eocd_offset;	///< End of central directory record ̈ʒu.
+	__int64 file_size;		///< ZIPt@C̃TCY.
+	uint64 entries;			///< fBNg̃Gg.
+	uint64 dir_size;		///< fBNg̃TCY.
+	uint64 dir_offset;		///< fBNg̊Jnʒu.
+};
+
+/** t@C End of central directory record TāAfBNg̈ʒu𓾂.
+ * ZIP64`Ȃ΁AZip64 end of central directory record ̒l̗p.
+ * fin̓ǂݏoʒu͕ۑȂ̂ŁAĂяoōĐݒ肷邱.
+ * @retval false	EOCDȂ.
+ */
+bool FindCentralDirectory(FILE* fin, CentralDirInfo& info)
+{
+	// EOCD͌Œ蒷22oCg{Rg(ő65535oCg)Ȃ̂ŁA炻͈̔͂TΗǂ.
+	const __int64 EOCD_SIZE = 22;
+	const __int64 MAX_TAIL = EOCD_SIZE + 0xffff;
+
+	_fseeki64(fin, 0, SEEK_END);
+	info.file_size = _ftelli64(fin);
+	if (info.file_size < EOCD_SIZE)
+		return false;
+	size_t tail_size = (size_t) (info.file_size < MAX_TAIL ? info.file_size : MAX_TAIL);
+	__int64 tail_offset = info.file_size - tail_size;
+	std::vector<uchar> tail(tail_size);
+	_fseeki64(fin, tail_offset, SEEK_SET);
+	if (fread(&tail[0], 1, tail_size, fin) != tail_size)
+		return false;
+
+	//  signature T. Rgt@CƖȂ̗̂p.
+	const uchar* eocd = NULL;
+	for (size_t i = tail_size - (size_t)EOCD_SIZE + 1; i-- > 0; ) {
+		const uchar* p = &tail[i];
+		if (Get32(p) == 0x06054b50 && i + EOCD_SIZE + Get16(p+20) <= tail_size) {
+			eocd = p;
+			break;
+		}
+	}
+	if (!eocd)
+		return false;
+	info.eocd_offset = tail_offset + (eocd - &tail[0]);
+	info.entries     = Get16(eocd+10);
+	info.dir_size    = Get32(eocd+12);
+	info.dir_offset  = Get32(eocd+16);
+
+	// ZIP64`Ȃ΁AlocatoroR Zip64 EOCD record ǂݏo.
+	if (info.entries != 0xffff && info.dir_size != 0xffffffff && info.dir_offset != 0xffffffff)
+		return true;
+	uchar buf[56];
+	if (info.eocd_offset < 20)
+		return true;
+	_fseeki64(fin, info.eocd_offset - 20, SEEK_SET);
+	if (fread(buf, 1, 20, fin) != 20 || Get32(buf) != 0x07064b50)
+		return true;
+	_fseeki64(fin, Get64(buf+8), SEEK_SET);
+	if (fread(buf, 1, 56, fin) != 56 || Get32(buf) != 0x06064b50)
+		return true;
+	info.entries    = Get64(buf+32);
+	info.dir_size   = Get64(buf+40);
+	info.dir_offset = Get64(buf+48);
+	return true;
+}
+//@}
+
+//........................................................................
+//!@name fBNg̒ǂݏo.
+//@{
+/** fBNg̃Gg. ZIP64g͓Kpς݂̒lƂ. */
+struct CentralDirEntry {
+	__int64 offset;				///< ̃Gg(Central file header)̈ʒu.
+	uint16 version_made;
+	uint16 version_needed;
+	uint16 flags;
+	uint16 method;
+	uint16 mod_time;
+	uint16 mod_date;
+	uint32 crc;
+	uint64 compressed_size;
+	uint64 uncompressed_size;
+	uint32 disk_start;
+	uint16 internal_attr;
+	uint32 external_attr;
+	uint64 local_header_offset;
+	std::string name;
+	std::vector<uchar> extra;
+	std::string comment;
+};
+
+/** fBNg擪珇ɓǂݏoNX.
+ * SGgɕێȂ̂ŁAȒfBNgłgpʂ͈ł.
+ */
+class CentralDirReader {
+	FILE* mFin;
+	CentralDirInfo mInfo;
+	uint64 mPos;		///< ɓǂݏoGg̈ʒu.
+	uint64 mCount;		///< ǂݏoς݂̃Gg.
+public:
+	CentralDirReader() : mFin(NULL), mPos(0), mCount(0) {}
+
+	/** fBNgTāAǂݏoJn.
+	 * @retval false	fBNgȂ.
+	 */
+	bool Open(FILE* fin) {
+		mFin = fin;
+		mCount = 0;
+		if (!FindCentralDirectory(fin, mInfo))
+			return false;
+		mPos = mInfo.dir_offset;
+		_fseeki64(fin, mPos, SEEK_SET);
+		return true;
+	}
+
+	/** ̃Ggǂݏo.
+	 * @retval false	fBNg̏I[ɒBA܂̓GgĂ.
+	 */
+	bool Next(CentralDirEntry& e);
+
+	/** fBNg̈ʒu */
+	const CentralDirInfo& Info() const {
+		return mInfo;
+	}
+};
+
+bool CentralDirReader::Next(CentralDirEntry& e)
+{
+	uchar h[46];
+	if (mPos + sizeof(h) > mInfo.dir_offset + mInfo.dir_size)
+		return false;
+	if (fread(h, 1, sizeof(h), mFin) != sizeof(h) || Get32(h) != 0x02014b50)
+		return false;
+	e.offset              = mPos;
+	e.version_made        = Get16(h+4);
+	e.version_needed      = Get16(h+6);
+	e.flags               = Get16(h+8);
+	e.method              = Get16(h+10);
+	e.mod_time            = Get16(h+12);
+	e.mod_date            = Get16(h+14);
+	e.crc                 = Get32(h+16);
+	e.compressed_size     = Get32(h+20);
+	e.uncompressed_size   = Get32(h+24);
+	e.disk_start          = Get16(h+34);
+	e.internal_attr       = Get16(h+36);
+	e.external_attr       = Get32(h+38);
+	e.local_header_offset = Get32(h+42);
+
+	size_t name_len = Get16(h+28), extra_len = Get16(h+30), comment_len = Get16(h+32);
+	e.name.resize(name_len);
+	e.extra.resize(extra_len);
+	e.comment.resize(comment_len);
+	if ((name_len && fread(&e.name[0], 1, name_len, mFin) != name_len)
+	 || (extra_len && fread(&e.extra[0], 1, extra_len, mFin) != extra_len)
+	 || (comment_len && fread(&e.comment[0], 1, comment_len, mFin) != comment_len))
+		return false;
+	mPos += sizeof(h) + name_len + extra_len + comment_len;
+	++mCount;
+
+	// Zip64 Extended Information Extra Field ΁A0xFFFFFFFF ̍ڂ̒lŒu.
+	for (size_t i = 0; i + 4 <= extra_len; ) {
+		const uchar* p = &e.extra[i];
+		size_t size = Get16(p+2);
+		if (i + 4 + size > extra_len)
+			break;
+		if (Get16(p) == 0x0001) {
+			const uchar* q = p + 4;
+			const uchar* end = q + size;
+			if (e.uncompressed_size == 0xffffffff && q + 8 <= end)   { e.uncompressed_size   = Get64(q); q += 8; }
+			if (e.compressed_size == 0xffffffff && q + 8 <= end)     { e.compressed_size     = Get64(q); q += 8; }
+			if (e.local_header_offset == 0xffffffff && q + 8 <= end) { e.local_header_offset = Get64(q); q += 8; }
+			if (e.disk_start == 0xffff && q + 4 <= end)              { e.disk_start          = Get32(q); q += 4; }
+			break;
+		}
+		i += 4 + size;
+	}
+	return true;
+}
+
+/** Gg̍XV(FILETIMEl)𓾂.
+ * NTFS extra field ̎(100nsx)AExtended Timestamp ̎(UTCb)ADOS([J)̏ɗD悷.
+ */
+uint64 EntryModTime(const CentralDirEntry& e)
+{
+	uint64 ut = 0;
+	const size_t extra_len = e.extra.size();
+	for (size_t i = 0; i + 4 <= extra_len; ) {
+		const uchar* p = &e.extra[i];
+		size_t size = Get16(p+2);
+		if (i + 4 + size > extra_len)
+			break;
+		if (Get16(p) == 0x000a && size >= 4 + 4 + 24 && Get16(p+8) == 1 && Get16(p+10) >= 24)
+			return Get64(p+12);
+		if (Get16(p) == 0x5455 && size >= 5 && (p[4] & 1))
+			ut = unixtime_to_filetime(Get32(p+5));
+		i += 4 + size;
+	}
+	if (ut)
+		return ut;
+	uint64 ft;
+	if (!dos_datetime_to_filetime(e.mod_date, e.mod_time, ft))
+		return 0;
+	return ft;
+}
+//@}
+
+// zipfunc.cpp - end.
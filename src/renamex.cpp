@@ -1,15 +1,18 @@
 /**@file renamex.cpp --- rename file with pattern.
  * @author Hiroshi Kuno <http://code.google.com/p/win32cmdx/>
  */
+#ifdef _WIN32
 #include <windows.h>
+#include <mbstring.h>
+#include <io.h>
+#include <process.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
-#include <mbstring.h>
 #include <time.h>
-#include <io.h>
-#include <process.h>
+#include <locale.h>
 
 #include <map>
 #include <vector>
@@ -21,9 +24,14 @@ using namespace std;
 //------------------------------------------------------------------------
 // ėp֐Q - inline֐̂ŁARpCincludeŎ荞.
 //........................................................................
-#include "mylib\errfunc.cpp"
-#include "mylib\strfunc.cpp"
-#include "mylib\dirfunc.cpp"
+#include "mylib/sysfunc.cpp"
+#include "mylib/errfunc.cpp"
+#include "mylib/strfunc.cpp"
+#include "mylib/dirfunc.cpp"
+#include "mylib/memfunc.cpp"
+#include "mylib/thrfunc.cpp"
+#include "mylib/diagfunc.cpp"
+#include "mylib/walkfunc.cpp"
 
 //------------------------------------------------------------------------
 // ^A萔AO[oϐ̒`
@@ -64,67 +72,57 @@ const char* gUsage2 =
 //@}
 
 //------------------------------------------------------------------------
-/** l[s */
-void Rename(const char* from, const char* to, const char* dir, const char* wild)
+/** l[s.
+ * ɑΏۃt@CSďW߂Ă疼Oς. 񋓒̃tH_ŖOςƁAύX̖OĂї񋓂邱Ƃ邽.
+ * @retval false	l[ɎŝŒf(-i w莞͒fɑ).
+ */
+bool Rename(const char* from, const char* to, const char* dir, const char* wild)
 {
-	char oldpath[_MAX_PATH + _MAX_FNAME + 10];
-	char newpath[_MAX_PATH + _MAX_FNAME + 10];
-	char newname[_MAX_FNAME];
+	PathBuf newpath;
 	size_t from_len = strlen(from);
-	size_t to_len = strlen(to);
-
-	if (strlen(dir) >= _MAX_PATH)
-		error_abort("too long folder name", dir);
-	if (to_len >= _MAX_FNAME)
-		error_abort("too long TO pattern", to);
 
-	FindFile find;
-	for (find.Open(dir, wild); find; find.Next()) {
-		// tH_̓l[ΏۊO.
-		if (find.IsFolder())
-			continue;
+	// BAVXeACVS̃tH_̉͒TȂ.
+	WalkOptions opt;
+	opt.recursive = gRecursive;
+	opt.prune_hidden = true;
+	opt.prune_system = true;
+	opt.prune.push_back("CVS");
+	opt.need_stat = false;	// ƃTCY͎gȂ.
+	WalkList list;
+	DirWalker(list, opt).Walk(dir, wild);
+	list.Sort();
+
+	PathBuf path;
+	for (size_t i = 0; i < list.entries.size(); ++i) {
+		const WalkList::Entry& e = list.entries[i];
+		const char* name = list.Name(e);
 
 		// p^[ɈvȂΑΏۊO.
-		char* match = gCaseSensitive ? strstr(find.name, from) : stristr(find.name, from);
+		const char* match = gCaseSensitive ? strstr(name, from) : stristr(name, from);
 		if (!match)
 			continue;
 
-		// p^[ut@C𐶐.
-		size_t pre_len = match - find.name;
-		strncpy(newname, find.name, pre_len);
-		strcpy(newname + pre_len, to);
-		strcpy(newname + pre_len + to_len, match + from_len);
-
-		make_pathname(oldpath, dir, find.name);
-		make_pathname(newpath, dir, newname);
+		// p^[upXÃtH_ɑĐ.
+		list.MakePath(e, path);
+		size_t name_pos = path.Length() - strlen(name);
+		newpath.Assign(path.c_str(), name_pos);
+		newpath.Append(name, match - name);
+		newpath.Append(to);
+		newpath.Append(match + from_len);
 
 		// 󋵂\.
-		printf("%s%s => %s\n", dir, find.name, newname);
+		printf("%s => %s\n", path.c_str(), newpath.c_str() + name_pos);
 		if (gTestOnly)
 			continue;
 
 		// l[s.
-		if (rename(oldpath, newpath) != 0) {
-			print_win32error("rename");
+		if (rename(path.c_str(), newpath.c_str()) != 0) {
+			gDiag.SysError("can't rename", path.c_str());
 			if (!gIgnoreError)
-				error_abort();
+				return false;
 		}
-	}//.endfor find
-
-	if (gRecursive) {
-		// eTutH_ɑ΂čċA.
-		find.Close();
-		for (find.Open(dir, "*"); find; find.Next()) {
-			if (find.IsFolder() && !find.IsDotFolder()) {
-				if (find.IsHidden() || find.IsSystem()) continue;
-				if (strequ(find.name, "CVS")) continue;
-				char subdir[_MAX_PATH + _MAX_FNAME + 10];
-				make_pathname(subdir, dir, find.name);
-				strcat(subdir, "\\");
-				Rename(from, to, subdir, wild);
-			}
-		}//.endfor find dir
 	}
+	return true;
 }
 
 //------------------------------------------------------------------------
@@ -180,13 +178,16 @@ show_help:			error_abort(gUsage2);
 	}
 	else {
 		for (int i = 3; i < argc; ++i) {
-			char dir[_MAX_PATH];
-			char name[_MAX_FNAME];
-			separate_pathname(argv[i], dir, name);
-			Rename(from, to, dir, name);
+			size_t pos = pathname_name_pos(argv[i]);
+			string dir(argv[i], pos);
+			if (!Rename(from, to, dir.c_str(), argv[i] + pos))
+				break;
 		}//.endfor
 	}
-	return EXIT_SUCCESS;
+
+	//--- s΁Ǎޖɕ\.
+	gDiag.Summary("renamex");
+	return gDiag.Count(DIAG_ERROR) ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 //------------------------------------------------------------------------
 /**@page renamex-manual renamex.exe - rename file with pattern
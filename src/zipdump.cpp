@@ -1,23 +1,46 @@
 /**@file zipdump.cpp --- ZIPt@C̍\_vs.
  * @author Hiroshi Kuno <http://code.google.com/p/win32cmdx/>
  */
+#ifdef _WIN32
 #include <windows.h>
+#include <io.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
 #include <time.h>
 #include <locale.h>
-#include <io.h>
 #include <ctype.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
 
 #include "mydef.h"
-//using namespace std;
+using namespace std;
 
 //------------------------------------------------------------------------
 // ėp֐Q - inline֐̂ŁARpCincludeŎ荞.
 //........................................................................
-#include "mylib\errfunc.cpp"
-#include "mylib\strfunc.cpp"
+#include "mylib/sysfunc.cpp"
+#include "mylib/errfunc.cpp"
+#include "mylib/strfunc.cpp"
+#include "mylib/dirfunc.cpp"
+#include "mylib/hashfunc.cpp"
+#include "mylib/memfunc.cpp"
+#include "mylib/filefunc.cpp"
+#include "mylib/thrfunc.cpp"
+#include "mylib/diagfunc.cpp"
+#include "mylib/walkfunc.cpp"
+#include "mylib/inflate.cpp"
+#include "mylib/zipfunc.cpp"
+#include "mylib/pipefunc.cpp"
 
 //------------------------------------------------------------------------
 // ^A萔AO[oϐ̒`.
@@ -41,13 +64,54 @@ bool gIsRecursive = false;
 
 /** -d<DIR>: output folder */
 const char* gOutDir = NULL;
+
+/** -u: update only new or changed files */
+bool gUpdateOnly = false;
+
+/** -l<KEY>: list entries sorted by KEY('n':name, 's':size, 'o':offset). 0 is dump mode */
+int gListKey = 0;
+
+/** -a: analyze layout of records */
+bool gAnalyzeLayout = false;
+
+/** -m<MB>: memory limit for sorted listing */
+size_t gSortMemLimit = 64 * 1024 * 1024;
+
+/** --extract DIR: extract all entries to DIR */
+const char* gExtractDir = NULL;
+
+/** --repack OUT.zip: rewrite archive without slack */
+const char* gRepackFile = NULL;
+
+/** --align N: alignment of stored entries for --repack */
+unsigned gRepackAlign = 4;
+
+/** --check: cross-validate central directory and local headers */
+bool gCheck = false;
+
+/** --manifest: output SHA-256 of each entry's content */
+bool gDigestManifest = false;
+
+/** -j<N>: number of worker threads. 0 is number of CPUs */
+int gThreads = 0;
+
+/** --serve NAME: serve queries on the named pipe NAME */
+const char* gServePipe = NULL;
+
+/** --cache MB: memory budget of parsed central directories for --serve */
+size_t gServeCacheSize = 64 * 1024 * 1024;
+
+/** number of suspicious files found by -a or --check, or files with errors by --manifest */
+int gSuspiciousFiles = 0;
 //@}
 
 //........................................................................
 //!@name messages
 //@{
 /** short help-message */
-const char* gUsage  = "usage :zipdump [-h?fqosr] [-d<DIR>] file1.zip file2.zip ...\n";
+const char* gUsage  = "usage :zipdump [-h?fqosrua] [-d<DIR>] [-l<KEY>] [-m<MB>] [-j<N>] [--check] [--manifest] [--extract DIR] [--repack OUT.zip [--align N]] file1.zip file2.zip ...\n"
+	"       zipdump [-j<N>] --serve NAME [--cache MB]\n"
+	"       zipdump --query NAME LIST|STAT|HEX|STATS|QUIT [args...]\n";
 
 /** detail help-message for options and version */
 const char* gUsage2 =
@@ -59,39 +123,49 @@ const char* gUsage2 =
 	"  -s         output to stdout instend of files(*.zipdump)\n"
 	"  -r         recursive search under the input-file's folder(wildcard needed)\n"
 	"  -d<DIR>    output to DIR\n"
+	"  -u         update only new or changed files, and remove stale outputs.\n"
+	"             the manifest is kept in DIR(-d needed)\n"
+	"  -l<KEY>    list entries sorted by KEY(n:name, s:size, o:offset), output *.ziplist\n"
+	"  -a         analyze layout: gaps, overlaps, duplicate entries, compression ratio.\n"
+	"             output *.ziplayout, exit with 1 if suspicious\n"
+	"  -m<MB>     memory limit for sorted list(default 64MB). over it, use temporary files\n"
+	"  -j<N>      number of worker threads(default: number of CPUs)\n"
+	"  --check    cross-validate central directory and local headers: name, method, crc, sizes.\n"
+	"             report orphans on both sides, output *.zipcheck, exit with 1 if suspicious\n"
+	"  --manifest output SHA-256 of each entry's content sorted by name, to *.sha256(sha256sum format)\n"
+	"  --extract DIR  extract all entries to DIR in parallel(stored and deflated)\n"
+	"  --repack OUT.zip  rewrite to OUT.zip without slack, copying compressed data as is\n"
+	"  --align N  align data of stored entries to N bytes by extra field(default 4, 1:no align)\n"
+	"  --serve NAME  serve queries on the named pipe NAME, keeping central directories in cache\n"
+	"  --cache MB memory budget of the cache for --serve(default 64MB)\n"
+	"  --query NAME CMD [args...]  send a query to the server NAME and print the response\n"
+	"             LIST zip / STAT zip entry / HEX zip offset length / STATS / QUIT\n"
 	"  fileN.zip  input-files. wildcard OK\n"
 	;
 //@}
 
-//........................................................................
-// fuction-proto-type decl.
-void Dump_Data_descriptor(FILE* fin, FILE* fout);
-
 //------------------------------------------------------------------------
 // ėp֐Q
 //........................................................................
 //!@name t@Cn.
 //@{
 /** ̓t@CI[v.
- * I[vsɂ̓^[ȂŁAŏI.
+ * I[vsɂ̓G[񍐂NULLԂ. Ăяo͂̃t@C΂ď𑱂.
  */
 FILE* OpenInput(const char* fname)
 {
 	FILE* fp = fopen(fname, "rb");
-	if (fp == NULL) {
-		fprintf(stderr, "can't open input file: %s\n", fname);
-		exit(EXIT_FAILURE);
-	}
+	if (fp == NULL)
+		gDiag.Report(DIAG_ERROR, "can't open input file", "can't open input file: %s", fname);
 	return fp;
 }
 
-/** o̓t@CI[v.
+/** o̓t@C쐬.
  * o̓t@ĆAnꂽt@C̖ extname ǉ̂Ƃ.
- * I[vsɂ̓^[ȂŁAŏI.
+ * @param fname	o̓t@C̊i[. MY_MAX_PATH+100 ̑傫Kv.
  */
-FILE* OpenOutput(const char* inputfname, const char* extname)
+void MakeOutputName(char* fname, const char* inputfname, const char* extname)
 {
-	char fname[MY_MAX_PATH+100];	// gqɂ100݂ĂΏ\.
 	if (gOutDir) {
 		char base[MY_MAX_PATH];
 		char ext[MY_MAX_PATH];
@@ -102,52 +176,28 @@ FILE* OpenOutput(const char* inputfname, const char* extname)
 		strcpy(fname, inputfname);
 	}
 	strcat(fname, extname);
-
-	FILE* fp = fopen(fname, "w");
-	if (fp == NULL) {
-		fprintf(stderr, "can't open output file: %s\n", fname);
-		exit(EXIT_FAILURE);
-	}
-	return fp;
-}
-//@}
-
-//........................................................................
-//!@name little endian read.
-//@{
-bool Read8(FILE* fin, uint8& val)
-{
-	return fread(&val, sizeof(val), 1, fin) == 1;
 }
 
-bool Read16(FILE* fin, uint16& val)
+/** o̓t@C̊gq. */
+const char* OutputExt()
 {
-	uint8 lo, hi;
-	if (Read8(fin, lo) && Read8(fin, hi)) {
-		val = ((uint16)hi << 8) + lo;
-		return true;
-	}
-	return false;
+	return gAnalyzeLayout ? ".ziplayout" : gCheck ? ".zipcheck" : gDigestManifest ? ".sha256"
+		: gListKey ? ".ziplist" : ".zipdump";
 }
 
-bool Read32(FILE* fin, uint32& val)
+/** o̓t@CI[v.
+ * o̓t@ĆAnꂽt@C̖ extname ǉ̂Ƃ.
+ * I[vsɂ̓^[ȂŁAŏI.
+ */
+FILE* OpenOutput(const char* inputfname, const char* extname)
 {
-	uint16 lo, hi;
-	if (Read16(fin, lo) && Read16(fin, hi)) {
-		val = ((uint32)hi << 16) + lo;
-		return true;
-	}
-	return false;
-}
+	char fname[MY_MAX_PATH+100];	// gqɂ100݂ĂΏ\.
+	MakeOutputName(fname, inputfname, extname);
 
-bool Read64(FILE* fin, uint64& val)
-{
-	uint32 lo, hi;
-	if (Read32(fin, lo) && Read32(fin, hi)) {
-		val = ((uint64)hi << 32) + lo;
-		return true;
-	}
-	return false;
+	FILE* fp = fopen(fname, "w");
+	if (fp == NULL)
+		gDiag.Report(DIAG_ERROR, "can't open output file", "can't open output file: %s", fname);
+	return fp;
 }
 //@}
 
@@ -180,7 +230,7 @@ void Print_u(FILE* fout, const char* prompt, uint32 a)
 
 void Print_u(FILE* fout, const char* prompt, uint64 a)
 {
-	fprintf(fout, "%32s : %I64u\n", prompt, a);
+	fprintf(fout, "%32s : %llu\n", prompt, a);
 }
 
 //........................................................................
@@ -201,7 +251,7 @@ void Print_x(FILE* fout, const char* prompt, uint32 a)
 
 void Print_x(FILE* fout, const char* prompt, uint64 a)
 {
-	fprintf(fout, "%32s : 0x%016I64X\n", prompt, a);
+	fprintf(fout, "%32s : 0x%016llX\n", prompt, a);
 }
 
 //........................................................................
@@ -222,7 +272,7 @@ void Print_ux(FILE* fout, const char* prompt, uint32 a)
 
 void Print_ux(FILE* fout, const char* prompt, uint64 a)
 {
-	fprintf(fout, "%32s : %u(0x%016I64X)\n", prompt, a, a);
+	fprintf(fout, "%32s : %llu(0x%016llX)\n", prompt, a, a);
 }
 
 //........................................................................
@@ -271,7 +321,7 @@ void Print_section(FILE* fout, const char* section, __int64 offset, int n = -1)
 		fprintf(fout, "\n[%s #%d]", section, n);
 	}
 	if (offset >= 0 && !gQuiet) {
-		fprintf(fout, " offset : %I64d(0x%016I64X)", offset, offset);
+		fprintf(fout, " offset : %lld(0x%016llX)", offset, offset);
 	}
 	fputc('\n', fout);
 }
@@ -313,42 +363,32 @@ void Print_UTC(FILE* fout, uint32 time)
 	time_t t = (time_t) time;
 	char buf[200];
 	size_t n = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S UTC", gmtime(&t));
-	size_t m = strftime(buf + n, sizeof(buf)-n, " (%c %z)", localtime(&t));
+	strftime(buf + n, sizeof(buf)-n, " (%c %z)", localtime(&t));
 	Print_note(fout, buf);
 }
 
-void Print_filetime(FILE* fout, const FILETIME& ft)
+void Print_filetime(FILE* fout, uint64 ft)
 {
-	// use windows API
-	SYSTEMTIME st;
-	::FileTimeToSystemTime(&ft, &st);
+	uint t[6];
+	filetime_to_calendar(ft, t);
 
 	char buf[20*6];
-	sprintf_s(buf, sizeof(buf), "%u-%02u-%02uT%02d:%02u:%02u",
-		st.wYear,
-		st.wMonth,
-		st.wDay,
-		st.wHour,
-		st.wMinute,
-		st.wSecond);
+	sprintf(buf, "%u-%02u-%02uT%02u:%02u:%02u", t[0], t[1], t[2], t[3], t[4], t[5]);
 	Print_note(fout, buf);
 }
 
-void Print_filetime(FILE* fout, const ULARGE_INTEGER& ii)
-{
-	FILETIME ft;
-
-	ft.dwLowDateTime = ii.LowPart;
-	ft.dwHighDateTime = ii.HighPart;
-	Print_filetime(fout, ft);
-
-}
-
 void Print_date_and_time(FILE* fout, uint16 mod_time, uint16 mod_date)
 {
-	FILETIME ft;
-	::DosDateTimeToFileTime(mod_date, mod_time, &ft);
-	Print_filetime(fout, ft);
+	// DOS̓[J̃tB[hȂ̂ŁAϊɂ̂܂ܕ\.
+	char buf[20*6];
+	sprintf(buf, "%u-%02u-%02uT%02u:%02u:%02u",
+		(mod_date >> 9) + 1980,
+		(mod_date >> 5) & 15,
+		mod_date & 31,
+		mod_time >> 11,
+		(mod_time >> 5) & 63,
+		(mod_time & 31) * 2);
+	Print_note(fout, buf);
 }
 
 void Print_internal_file_attributes(FILE* fout, uint16 attr)
@@ -617,10 +657,24 @@ void Print_version(FILE* fout, uint16 ver)
 //........................................................................
 //!@name generic dump
 //@{
-void Dump_string(FILE* fin, FILE* fout, uint64 length)
+void Print_string(FILE* fout, const string& s)
+{
+	for (size_t i = 0; i < s.size(); ++i) {
+		int c = (uchar) s[i];
+		if (iscntrl(c)) {
+			fprintf(fout, "^%c", c + '@'); // print control-code as visible.
+		}
+		else {
+			fputc(c, fout);
+		}
+	}
+	fputc('\n', fout);
+}
+
+void Dump_string(ZipSource& fin, FILE* fout, uint64 length)
 {
 	int c;
-	while (length-- && (c = getc(fin)) != EOF) {
+	while (length-- && (c = fin.Getc()) != EOF) {
 		if (iscntrl(c)) {
 			fprintf(fout, "^%c", c + '@'); // print control-code as visible.
 		}
@@ -631,7 +685,7 @@ void Dump_string(FILE* fin, FILE* fout, uint64 length)
 	fputc('\n', fout);
 }
 
-void Dump_bytes(FILE* fin, FILE* fout, uint64 length)
+void Dump_bytes(ZipSource& fin, FILE* fout, uint64 length)
 {
 	int c;
 	char prev[16], current[16];
@@ -640,7 +694,7 @@ void Dump_bytes(FILE* fin, FILE* fout, uint64 length)
 	size_t i = 0;
 	uint64 offset = 0;
 	uint64 omit_lines = 0;
-	while (length-- && (c = getc(fin)) != EOF) {
+	while (length-- && (c = fin.Getc()) != EOF) {
 		++offset;
 		sprintf(hex_dump + i*3, "%02X%c", c, i==7 ? '-' : ' ');
 		ascii_dump[i] = ascii(c);
@@ -653,7 +707,7 @@ void Dump_bytes(FILE* fin, FILE* fout, uint64 length)
 			else {
 				omit_lines = 0;
 				ascii_dump[16] = 0;
-				fprintf(fout, "+%08I64X : %-48s:%-16s\n", offset-i, hex_dump, ascii_dump);
+				fprintf(fout, "+%08llX : %-48s:%-16s\n", offset-i, hex_dump, ascii_dump);
 			}
 			i = 0;
 			memcpy(prev, current, sizeof(prev));
@@ -661,18 +715,18 @@ void Dump_bytes(FILE* fin, FILE* fout, uint64 length)
 	}//.endwhile
 	if (i != 0) {
 		ascii_dump[i] = 0;
-		fprintf(fout, "+%08I64X : %-48s:%-16s\n", offset-i, hex_dump, ascii_dump);
+		fprintf(fout, "+%08llX : %-48s:%-16s\n", offset-i, hex_dump, ascii_dump);
 	}
 }
 
-void Dump_if_fulldump(FILE* fin, FILE* fout, const char* caption, uint64 length)
+void Dump_if_fulldump(ZipSource& fin, FILE* fout, const char* caption, uint64 length)
 {
 	if (gIsFullDump) {
 		Dump_bytes(fin, fout, length);
 	}
 	else {
-		_fseeki64(fin, length, SEEK_CUR);
-		if (!gQuiet) fprintf(fout, "; skip %s(%I64u bytes), use -f option to dump the data\n", caption, length);
+		fin.Seek(length, SEEK_CUR);
+		if (!gQuiet) fprintf(fout, "; skip %s(%llu bytes), use -f option to dump the data\n", caption, length);
 	}
 }
 //@}
@@ -681,45 +735,22 @@ void Dump_if_fulldump(FILE* fin, FILE* fout, const char* caption, uint64 length)
 //!@name mf[^̃XLbv.
 //@{
 /** w̃oCgǂݔ΂ */
-void SkipUnknownData(FILE* fin, FILE* fout, uint64 skipsize)
+void SkipUnknownData(ZipSource& fin, FILE* fout, uint64 skipsize)
 {
-	fprintf(fout, "!! Skip unknown data %I64u(0x%I64X) bytes\n", skipsize, skipsize);
+	fprintf(fout, "!! Skip unknown data %llu(0x%llX) bytes\n", skipsize, skipsize);
 	if (gIsFullDump) {
 		Dump_bytes(fin, fout, skipsize);
 	}
 	else {
-		_fseeki64(fin, skipsize, SEEK_CUR);
+		fin.Seek(skipsize, SEEK_CUR);
 	}
 }
 
-/** ZIP\wb_܂œǂݔ΂. */
-bool SkipToNextPK(FILE* fin, FILE* fout)
-{
-	__int64 skipsize = 0;
-	int c;
-	int prev = 0;
-
-	while ((c = getc(fin)) != EOF) {
-		if (prev == 'P' && c == 'K') {
-			_fseeki64(fin, -2, SEEK_CUR);
-			--skipsize;
-			break;
-		}
-		prev = c;
-		++skipsize;
-	}
-	if (skipsize > 0) {
-		_fseeki64(fin, -skipsize, SEEK_CUR);
-		SkipUnknownData(fin, fout, skipsize);
-	}
-	return !feof(fin);
-}
-//@}
 
 //........................................................................
 //!@name ZIP\wb_̃_v.
 //@{
-void Dump_extra_Zip64_Extended_Info(FILE* fin, FILE* fout, size_t length)
+void Dump_extra_Zip64_Extended_Info(ZipSource& fin, FILE* fout, size_t length)
 {
 /*
          -Zip64 Extended Information Extra Field (0x0001):
@@ -771,7 +802,7 @@ void Dump_extra_Zip64_Extended_Info(FILE* fin, FILE* fout, size_t length)
 	}
 }
 
-void Dump_extra_OS2_Extended_Attributes(FILE* fin, FILE* fout, size_t length)
+void Dump_extra_OS2_Extended_Attributes(ZipSource& fin, FILE* fout, size_t length)
 {
 /*
          -OS/2 Extra Field (0x0009):
@@ -848,7 +879,7 @@ void Dump_extra_OS2_Extended_Attributes(FILE* fin, FILE* fout, size_t length)
 	}
 }
 
-void Dump_extra_NTFS(FILE* fin, FILE* fout, size_t length)
+void Dump_extra_NTFS(ZipSource& fin, FILE* fout, size_t length)
 {
 /*
          -NTFS Extra Field (0x000a):
@@ -887,7 +918,7 @@ void Dump_extra_NTFS(FILE* fin, FILE* fout, size_t length)
 */
 	uint16 tag, size;
 	uint32 w32;
-	ULARGE_INTEGER ii;
+	uint64 ft;
 	size_t extra_offset = 0;
 
 	DUMP4("reserved", w32, x); extra_offset += 4;
@@ -897,9 +928,9 @@ void Dump_extra_NTFS(FILE* fin, FILE* fout, size_t length)
 		case 1:
 			Print_extra(fout, "NTFS file time", tag, size);
 			//     "12345678901234567890123456789012",
-			DUMP8x("last mod time",      ii.QuadPart, x, Print_filetime(fout, ii)); tag_offset += 8;
-			DUMP8x("last access time",   ii.QuadPart, x, Print_filetime(fout, ii)); tag_offset += 8;
-			DUMP8x("last creation time", ii.QuadPart, x, Print_filetime(fout, ii)); tag_offset += 8;
+			DUMP8x("last mod time",      ft, x, Print_filetime(fout, ft)); tag_offset += 8;
+			DUMP8x("last access time",   ft, x, Print_filetime(fout, ft)); tag_offset += 8;
+			DUMP8x("last creation time", ft, x, Print_filetime(fout, ft)); tag_offset += 8;
 			break;
 
 		default:
@@ -910,7 +941,7 @@ void Dump_extra_NTFS(FILE* fin, FILE* fout, size_t length)
 		if (size > tag_offset) {
 			SkipUnknownData(fin, fout, size - tag_offset);
 		}
-		extra_offset += size;
+		extra_offset += 4 + size;
 	}//.endwhile
 
 	if (length > extra_offset) {
@@ -918,7 +949,7 @@ void Dump_extra_NTFS(FILE* fin, FILE* fout, size_t length)
 	}
 }
 
-void Dump_extra_WindowsNT_SD(FILE* fin, FILE* fout, size_t length)
+void Dump_extra_WindowsNT_SD(ZipSource& fin, FILE* fout, size_t length)
 {
 /*
          -Windows NT Security Descriptor Extra Field (0x4453):
@@ -966,7 +997,7 @@ void Dump_extra_WindowsNT_SD(FILE* fin, FILE* fout, size_t length)
 	}
 }
 
-void Dump_extra_ExtendedTimestamp(FILE* fin, FILE* fout, size_t length)
+void Dump_extra_ExtendedTimestamp(ZipSource& fin, FILE* fout, size_t length)
 {
 /*
          -Extended Timestamp Extra Field:
@@ -1010,7 +1041,7 @@ void Dump_extra_ExtendedTimestamp(FILE* fin, FILE* fout, size_t length)
 	}
 }
 
-void Dump_extra_UnicodeComment(FILE* fin, FILE* fout, size_t length)
+void Dump_extra_UnicodeComment(ZipSource& fin, FILE* fout, size_t length)
 {
 /*
          -Info-ZIP Unicode Comment Extra Field (0x6375):
@@ -1066,7 +1097,7 @@ void Dump_extra_UnicodeComment(FILE* fin, FILE* fout, size_t length)
 	}
 }
 
-void Dump_extra_UnicodePath(FILE* fin, FILE* fout, size_t length)
+void Dump_extra_UnicodePath(ZipSource& fin, FILE* fout, size_t length)
 {
 /*
          -Info-ZIP Unicode Path Extra Field (0x7075):
@@ -1122,442 +1153,269 @@ void Dump_extra_UnicodePath(FILE* fin, FILE* fout, size_t length)
 	}
 }
 
-void Dump_extra_field(FILE* fin, FILE* fout, size_t length)
+void Dump_extra_field(ZipSource& fin, FILE* fout, uint16 id, uint16 size)
 {
-/*
-          In order to allow different programs and different types
-          of information to be stored in the 'extra' field in .ZIP
-          files, the following structure should be used for all
-          programs storing data in this field:
-
-          header1+data1 + header2+data2 . . .
-
-          Each header should consist of:
-
-            Header ID - 2 bytes
-            Data Size - 2 bytes
-
-          Note: all fields stored in Intel low-byte/high-byte order.
-*/
-	uint16 id, size;
-	size_t offset = 0;
-	while (offset < length && Read16(fin, id) && Read16(fin, size)) {
-		switch (id) {
-		case 0x0001:
-			Print_extra(fout, "Zip64 Extended Information Extra Field", id, size);
-			Dump_extra_Zip64_Extended_Info(fin, fout, size);
-			break;
-		case 0x0009:
-			Print_extra(fout, "OS/2 Extended Attributes Extra Field", id, size);
-			Dump_extra_OS2_Extended_Attributes(fin, fout, size);
-			break;
+	switch (id) {
+	case 0x0001:
+		Print_extra(fout, "Zip64 Extended Information Extra Field", id, size);
+		Dump_extra_Zip64_Extended_Info(fin, fout, size);
+		break;
+	case 0x0009:
+		Print_extra(fout, "OS/2 Extended Attributes Extra Field", id, size);
+		Dump_extra_OS2_Extended_Attributes(fin, fout, size);
+		break;
 
-		case 0x000a:
-			Print_extra(fout, "NTFS Extra Field", id, size);
-			Dump_extra_NTFS(fin, fout, size);
-			break;
+	case 0x000a:
+		Print_extra(fout, "NTFS Extra Field", id, size);
+		Dump_extra_NTFS(fin, fout, size);
+		break;
 
-		case 0x4453:
-			Print_extra(fout, "Windows NT Security Descriptor Extra Field", id, size);
-			Dump_extra_WindowsNT_SD(fin, fout, size);
-			break;
-		case 0x5455:
-			Print_extra(fout, "Extended Timestamp Extra Field", id, size);
-			Dump_extra_ExtendedTimestamp(fin, fout, size);
-			break;
-		case 0x6375:
-			Print_extra(fout, "Info-ZIP Unicode Comment Extra Field", id, size);
-			Dump_extra_UnicodeComment(fin, fout, size);
-			break;
-		case 0x7075:
-			Print_extra(fout, "Info-ZIP Unicode Path Extra Field", id, size);
-			Dump_extra_UnicodePath(fin, fout, size);
-			break;
-		default:
-			Print_extra(fout, "!! Unknown Extra Field", id, size);
-			Dump_bytes(fin, fout, size);
-			break;
-		}
-		offset += size + 4;
+	case 0x4453:
+		Print_extra(fout, "Windows NT Security Descriptor Extra Field", id, size);
+		Dump_extra_WindowsNT_SD(fin, fout, size);
+		break;
+	case 0x5455:
+		Print_extra(fout, "Extended Timestamp Extra Field", id, size);
+		Dump_extra_ExtendedTimestamp(fin, fout, size);
+		break;
+	case 0x6375:
+		Print_extra(fout, "Info-ZIP Unicode Comment Extra Field", id, size);
+		Dump_extra_UnicodeComment(fin, fout, size);
+		break;
+	case 0x7075:
+		Print_extra(fout, "Info-ZIP Unicode Path Extra Field", id, size);
+		Dump_extra_UnicodePath(fin, fout, size);
+		break;
+	default:
+		Print_extra(fout, "!! Unknown Extra Field", id, size);
+		Dump_bytes(fin, fout, size);
+		break;
 	}
 }
+//@}
 
-void Dump_Local_file(FILE* fin, FILE* fout, int n)
-{
-/*
-  A.  Local file header:
-
-        local file header signature     4 bytes  (0x04034b50)
-        version needed to extract       2 bytes
-        general purpose bit flag        2 bytes
-        compression method              2 bytes
-        last mod file time              2 bytes
-        last mod file date              2 bytes
-        crc-32                          4 bytes
-        compressed size                 4 bytes
-        uncompressed size               4 bytes
-        file name length                2 bytes
-        extra field length              2 bytes
-
-        file name (variable size)
-        extra field (variable size)
-*/
-	uint16 w16, flags=0, method=0, mod_time=0, mod_date=0, file_name_length=0, extra_field_length=0;
-	uint32 w32, compressed_size=0;
-
-	//     "12345678901234567890123456789012",
-	DUMP2x("version needed to extract",       w16,                 x, Print_version(fout, w16));
-	DUMP2 ("general purpose bit flag",        flags,               x);
-	DUMP2x("compression method",              method,              x, Print_general_purpose_bit_flag(fout, flags, method));
-	DUMP2 ("last mod file time",              mod_time,            x);
-	DUMP2x("last mod file date",              mod_date,            x, Print_date_and_time(fout, mod_time, mod_date));
-	DUMP4 ("crc-32",                          w32,                 x); // ZIP64ł́A0xFFFFFFFFɌŒ肷.
-	DUMP4 ("compressed size",                 compressed_size,    ux); // ZIP64ł́A0xFFFFFFFFɌŒ肷.
-	DUMP4 ("uncompressed size",               w32,                ux); // ZIP64ł́A0xFFFFFFFFɌŒ肷.
-	DUMP2 ("file name length",                file_name_length,   ux); // 65,535ȏ͕s.
-	DUMP2 ("extra field length",              extra_field_length, ux); // 65,535ȏ͕s.
-	if (file_name_length) {
-		Print_section(fout, "Local file name", _ftelli64(fin), n);
-		Dump_string(fin, fout, file_name_length);
-	}
-	if (extra_field_length) {
-		Print_section(fout, "Local extra field", _ftelli64(fin), n);
-		Dump_extra_field(fin, fout, extra_field_length);
+//........................................................................
+//!@name dump a record field MACRO.
+//@{
+/** R[ȟŒ蒷̂AǂݏotB[h\邽߂̃J[\. */
+class FieldCursor {
+	size_t mRest;
+public:
+	explicit FieldCursor(const ZipRecord& r) : mRest(r.length) {}
+
+	/** noCg̃tB[hǂݏoĂ? */
+	bool Next(size_t n) {
+		if (mRest < n) {
+			mRest = 0;
+			return false;
+		}
+		mRest -= n;
+		return true;
 	}
+};
 
-/*
-  B.  File data
-
-      Immediately following the local header for a file
-      is the compressed or stored data for the file. 
-      The series of [local file header][file data][data
-      descriptor] repeats for each file in the .ZIP archive. 
-*/
-	if (compressed_size == 0xFFFFFFFF)
-		return;	// ZIP64 tH[}bĝ߁A㑱f[^̃TCYsȂ̂ File data  Data descriptor ̃_v͎~߂.
+#define FIELD(prompt,var,format)			if (cur.Next(sizeof(var))) { Print_##format(fout, prompt, var); }
+#define FIELDx(prompt,var,format,detail)	if (cur.Next(sizeof(var))) { Print_##format(fout, prompt, var); if (!gQuiet) { detail; } }
+//@}
 
-	if (compressed_size) {
-		Print_section(fout, "File data", _ftelli64(fin), n);
-		Dump_if_fulldump(fin, fout, "file data", compressed_size);
+//........................................................................
+/** ZipReader ǂݏoeR[hAeLXgŃ_vo͂. */
+class ZipTextDumper : public ZipVisitor {
+	FILE* fout;
+public:
+	explicit ZipTextDumper(FILE* out) : fout(out) {}
+
+	virtual void LocalFileHeader(const ZipLocalFileHeader& r) {
+		FieldCursor cur(r);
+		Print_header(fout, "Local file header", r.signature, r.offset, r.n);
+		//     "12345678901234567890123456789012",
+		FIELDx("version needed to extract",       r.version_needed,     x, Print_version(fout, r.version_needed));
+		FIELD ("general purpose bit flag",        r.flags,              x);
+		FIELDx("compression method",              r.method,             x, Print_general_purpose_bit_flag(fout, r.flags, r.method));
+		FIELD ("last mod file time",              r.mod_time,           x);
+		FIELDx("last mod file date",              r.mod_date,           x, Print_date_and_time(fout, r.mod_time, r.mod_date));
+		FIELD ("crc-32",                          r.crc,                x);
+		FIELD ("compressed size",                 r.compressed_size,    ux);
+		FIELD ("uncompressed size",               r.uncompressed_size,  ux);
+		FIELD ("file name length",                r.file_name_length,   ux); // 65,535ȏ͕s.
+		FIELD ("extra field length",              r.extra_field_length, ux); // 65,535ȏ͕s.
+		__int64 pos = r.offset + 4 + r.length;
+		if (r.file_name_length) {
+			Print_section(fout, "Local file name", pos, r.n);
+			Print_string(fout, r.file_name);
+			pos += r.file_name.size();
+		}
+		if (r.extra_field_length) {
+			Print_section(fout, "Local extra field", pos, r.n);
+			VisitExtraFields(ZIP_EXTRA_LOCAL, r.extra_field);
+		}
 	}
 
-	if (flags & 0x0008) { // Bit 3: on
-		Print_section(fout, "Data descriptor", _ftelli64(fin), n);
-		Dump_Data_descriptor(fin, fout);
+	virtual void DataDescriptor(const ZipDataDescriptor& r) {
+		FieldCursor cur(r);
+		if (r.signature)
+			Print_header(fout, "Data descriptor header", r.signature, r.offset, r.n);
+		else
+			Print_section(fout, "Data descriptor", r.offset, r.n);
+		//    "12345678901234567890123456789012",
+		FIELD("crc-32",                          r.crc,                x);
+		FIELD("compressed size",                 r.compressed_size,   ux);
+		FIELD("uncompressed size",               r.uncompressed_size, ux);
 	}
-}
 
-void Dump_Data_descriptor(FILE* fin, FILE* fout)
-{
-/*
-  C.  Data descriptor:
-
-      [Info-ZIP discrepancy:
-       The Info-ZIP zip program starts the data descriptor with a 4-byte
-       PK-style signature.  Despite the specification, none of the PKWARE
-       programs supports the data descriptor.  PKZIP 4.0 -fix function
-       (and PKZIPFIX 2.04) ignores the data descriptor info even when bit 3
-       of the general purpose bit flag is set.
-        data descriptor signature       4 bytes  (0x08074b50)
-      ]
-
-        crc-32                          4 bytes
-        compressed size                 4 bytes
-        uncompressed size               4 bytes
-
-      This descriptor exists only if bit 3 of the general
-      purpose bit flag is set (see below).  It is byte aligned
-      and immediately follows the last byte of compressed data.
-      This descriptor is used only when it was not possible to
-      seek in the output .ZIP file, e.g., when the output .ZIP file
-      was standard output or a non-seekable device.  For ZIP64(tm) format
-      archives, the compressed and uncompressed sizes are 8 bytes each.
-
-      When compressing files, compressed and uncompressed sizes 
-      should be stored in ZIP64 format (as 8 byte values) when a 
-      files size exceeds 0xFFFFFFFF.   However ZIP64 format may be 
-      used regardless of the size of a file.  When extracting, if 
-      the zip64 extended information extra field is present for 
-      the file the compressed and uncompressed sizes will be 8
-      byte values.  
-*/
-	uint32 w32;
-	//    "12345678901234567890123456789012",
-	DUMP4("crc-32",                          w32,  x); // ZIP64ł́A0xFFFFFFFFɌŒ肷.
-	DUMP4("compressed size",                 w32, ux); // ZIP64ł́A0xFFFFFFFFɌŒ肷.
-	DUMP4("uncompressed size",               w32, ux); // ZIP64ł́A0xFFFFFFFFɌŒ肷.
-}
-
-void Dump_Archive_extra_data_record(FILE* fin, FILE* fout)
-{
-/*
-  E.  Archive extra data record: 
-
-        archive extra data signature    4 bytes  (0x08064b50)
-        extra field length              4 bytes
-        extra field data                (variable size)
-
-      The Archive Extra Data Record is introduced in version 6.2
-      of the ZIP format specification.  This record exists in support
-      of the Central Directory Encryption Feature implemented as part of 
-      the Strong Encryption Specification as described in this document.
-      When present, this record immediately precedes the central 
-      directory data structure.  The size of this data record will be
-      included in the Size of the Central Directory field in the
-      End of Central Directory record.  If the central directory structure
-      is compressed, but not encrypted, the location of the start of
-      this data record is determined using the Start of Central Directory
-      field in the Zip64 End of Central Directory record.  
-*/
-	uint32 extra_field_length = 0;
-
-	DUMP4("extra field length", extra_field_length, ux);
-	if (extra_field_length) {
-		Print_section(fout, "extra field data", _ftelli64(fin));
-		Dump_extra_field(fin, fout, extra_field_length);
+	virtual void ArchiveExtraDataRecord(const ZipArchiveExtraDataRecord& r) {
+		FieldCursor cur(r);
+		Print_header(fout, "Archive extra data record", r.signature, r.offset);
+		FIELD("extra field length", r.extra_field_length, ux);
+		if (r.extra_field_length) {
+			Print_section(fout, "extra field data", r.offset + 4 + r.length);
+			VisitExtraFields(ZIP_EXTRA_ARCHIVE, r.extra_field);
+		}
 	}
-}
 
-void Dump_Central_directory_file_header(FILE* fin, FILE* fout, int n)
-{
-/*
-  F.  Central directory structure:
-
-      [file header 1]
-      .
-      .
-      . 
-      [file header n]
-      [digital signature] 
-
-      File header:
-
-        central file header signature   4 bytes  (0x02014b50)
-        version made by                 2 bytes
-        version needed to extract       2 bytes
-        general purpose bit flag        2 bytes
-        compression method              2 bytes
-        last mod file time              2 bytes
-        last mod file date              2 bytes
-        crc-32                          4 bytes
-        compressed size                 4 bytes
-        uncompressed size               4 bytes
-        file name length                2 bytes
-        extra field length              2 bytes
-        file comment length             2 bytes
-        disk number start               2 bytes
-        internal file attributes        2 bytes
-        external file attributes        4 bytes
-        relative offset of local header 4 bytes
-
-        file name (variable size)
-        extra field (variable size)
-        file comment (variable size)
-*/
-	uint16 w16, flags=0, method=0, mod_time=0, mod_date=0, file_name_length=0, extra_field_length=0, file_comment_length=0;
-	uint32 w32, compressed_size=0;
-
-	//     "12345678901234567890123456789012",
-	DUMP2x("version made by",                 w16,                  x, Print_version(fout, w16));
-	DUMP2x("version needed to extract",       w16,                  x, Print_version(fout, w16));
-	DUMP2 ("general purpose bit flag",        flags,                x);
-	DUMP2x("compression method",              method,               x, Print_general_purpose_bit_flag(fout, flags, method));
-	DUMP2 ("last mod file time",              mod_time,             x);
-	DUMP2x("last mod file date",              mod_date,             x, Print_date_and_time(fout, mod_time, mod_date));
-	DUMP4 ("crc-32",                          w32,                  x); // ZIP64ł́A0xFFFFFFFFɌŒ肷.
-	DUMP4 ("compressed size",                 compressed_size,     ux); // ZIP64ł́A0xFFFFFFFFɌŒ肷.
-	DUMP4 ("uncompressed size",               w32,                 ux); // ZIP64ł́A0xFFFFFFFFɌŒ肷.
-	DUMP2 ("file name length",                file_name_length,    ux); // 65,535ȏ͕s.
-	DUMP2 ("extra field length",              extra_field_length,  ux); // 65,535ȏ͕s.
-	DUMP2 ("file comment length",             file_comment_length, ux); // 65,535ȏ͕s.
-	DUMP2 ("disk number start",               w16,                uFF); // ZIP64ł́A0xFFFFɌŒ肷.
-	DUMP2x("internal file attributes",        w16,                  x, Print_internal_file_attributes(fout, w16));
-	DUMP4x("external file attributes",        w32,                  x, Print_external_file_attributes(fout, w32));
-	DUMP4 ("relative offset of local header", w32,                 ux); // ZIP64ł́A0xFFFFFFFFɌŒ肷.
-
-	if (file_name_length) {
-		Print_section(fout, "file name", _ftelli64(fin), n);
-		Dump_string(fin, fout, file_name_length);
-	}
-	if (extra_field_length) {
-		Print_section(fout, "extra field", _ftelli64(fin), n);
-		Dump_extra_field(fin, fout, extra_field_length);
-	}
-	if (file_comment_length) {
-		Print_section(fout, "file comment", _ftelli64(fin), n);
-		Dump_string(fin, fout, file_comment_length);
-	}
-}
-
-void Dump_Central_directory_digital_signature(FILE* fin, FILE* fout)
-{
-/*
-      Digital signature:
-
-        header signature                4 bytes  (0x05054b50)
-        size of data                    2 bytes
-        signature data (variable size)
-
-      With the introduction of the Central Directory Encryption 
-      feature in version 6.2 of this specification, the Central 
-      Directory Structure may be stored both compressed and encrypted. 
-      Although not required, it is assumed when encrypting the
-      Central Directory Structure, that it will be compressed
-      for greater storage efficiency.  Information on the
-      Central Directory Encryption feature can be found in the section
-      describing the Strong Encryption Specification. The Digital 
-      Signature record will be neither compressed nor encrypted.
-*/
-	uint16 size = 0;
+	virtual void CentralFileHeader(const ZipCentralFileHeader& r) {
+		FieldCursor cur(r);
+		Print_header(fout, "Central file header", r.signature, r.offset, r.n);
+		//     "12345678901234567890123456789012",
+		FIELDx("version made by",                 r.version_made,         x, Print_version(fout, r.version_made));
+		FIELDx("version needed to extract",       r.version_needed,       x, Print_version(fout, r.version_needed));
+		FIELD ("general purpose bit flag",        r.flags,                x);
+		FIELDx("compression method",              r.method,               x, Print_general_purpose_bit_flag(fout, r.flags, r.method));
+		FIELD ("last mod file time",              r.mod_time,             x);
+		FIELDx("last mod file date",              r.mod_date,             x, Print_date_and_time(fout, r.mod_time, r.mod_date));
+		FIELD ("crc-32",                          r.crc,                  x);
+		FIELD ("compressed size",                 r.compressed_size,     ux);
+		FIELD ("uncompressed size",               r.uncompressed_size,   ux);
+		FIELD ("file name length",                r.file_name_length,    ux); // 65,535ȏ͕s.
+		FIELD ("extra field length",              r.extra_field_length,  ux); // 65,535ȏ͕s.
+		FIELD ("file comment length",             r.file_comment_length, ux); // 65,535ȏ͕s.
+		FIELD ("disk number start",               r.disk_start,         uFF);
+		FIELDx("internal file attributes",        r.internal_attr,        x, Print_internal_file_attributes(fout, r.internal_attr));
+		FIELDx("external file attributes",        r.external_attr,        x, Print_external_file_attributes(fout, r.external_attr));
+		FIELD ("relative offset of local header", r.local_header_offset, ux);
+		__int64 pos = r.offset + 4 + r.length;
+		if (r.file_name_length) {
+			Print_section(fout, "file name", pos, r.n);
+			Print_string(fout, r.file_name);
+			pos += r.file_name.size();
+		}
+		if (r.extra_field_length) {
+			Print_section(fout, "extra field", pos, r.n);
+			VisitExtraFields(ZIP_EXTRA_CENTRAL, r.extra_field);
+			pos += r.extra_field.size();
+		}
+		if (r.file_comment_length) {
+			Print_section(fout, "file comment", pos, r.n);
+			Print_string(fout, r.file_comment);
+		}
+	}
 
-	DUMP2("size of data", size, ux);
-	if (size) {
-		Print_section(fout, "signature data", _ftelli64(fin));
-		Dump_bytes(fin, fout, size);
+	virtual void DigitalSignature(const ZipDigitalSignature& r) {
+		FieldCursor cur(r);
+		Print_header(fout, "Digital signature", r.signature, r.offset);
+		FIELD("size of data", r.size, ux);
 	}
-}
 
-void Dump_Zip64_end_of_central_directory_record(FILE* fin, FILE* fout)
-{
-/*
-  G.  Zip64 end of central directory record
-
-        zip64 end of central dir 
-        signature                       4 bytes  (0x06064b50)
-        size of zip64 end of central
-        directory record                8 bytes
-        version made by                 2 bytes
-        version needed to extract       2 bytes
-        number of this disk             4 bytes
-        number of the disk with the 
-        start of the central directory  4 bytes
-        total number of entries in the
-        central directory on this disk  8 bytes
-        total number of entries in the
-        central directory               8 bytes
-        size of the central directory   8 bytes
-        offset of start of central
-        directory with respect to
-        the starting disk number        8 bytes
-        zip64 extensible data sector    (variable size)
-
-        The value stored into the "size of zip64 end of central
-        directory record" should be the size of the remaining
-        record and should not include the leading 12 bytes.
-  
-        Size = SizeOfFixedFields + SizeOfVariableData - 12.
-
-        The above record structure defines Version 1 of the 
-        zip64 end of central directory record. Version 1 was 
-        implemented in versions of this specification preceding 
-        6.2 in support of the ZIP64 large file feature. The 
-        introduction of the Central Directory Encryption feature 
-        implemented in version 6.2 as part of the Strong Encryption 
-        Specification defines Version 2 of this record structure. 
-        Refer to the section describing the Strong Encryption 
-        Specification for details on the version 2 format for 
-        this record.
-
-        Special purpose data may reside in the zip64 extensible data
-        sector field following either a V1 or V2 version of this
-        record.  To ensure identification of this special purpose data
-        it must include an identifying header block consisting of the
-        following:
-
-           Header ID  -  2 bytes
-           Data Size  -  4 bytes
-
-        The Header ID field indicates the type of data that is in the 
-        data block that follows.
-
-        Data Size identifies the number of bytes that follow for this
-        data block type.
-
-        Multiple special purpose data blocks may be present, but each
-        must be preceded by a Header ID and Data Size field.  Current
-        mappings of Header ID values supported in this field are as
-        defined in APPENDIX C.
+	virtual void Zip64EndOfCentralDirectoryRecord(const ZipZip64EndOfCentralDirectoryRecord& r) {
+		FieldCursor cur(r);
+		Print_header(fout, "Zip64 end of central directory record", r.signature, r.offset);
+		//     "12345678901234567890123456789012",
+		FIELD ("size of this record",             r.size,           ux);
+		FIELDx("version made by",                 r.version_made,    x, Print_version(fout, r.version_made));
+		FIELDx("version needed to extract",       r.version_needed,  x, Print_version(fout, r.version_needed));
+		FIELD ("number of this disk",             r.disk,            u);
+		FIELD ("disk of starting directory",      r.dir_disk,        u);
+		FIELD ("directory-entries on this disk",  r.disk_entries,    u);
+		FIELD ("directory-entries in all disks",  r.entries,         u);
+		FIELD ("size of the directory",           r.dir_size,       ux);
+		FIELD ("offset of starting directory",    r.dir_offset,     ux);
+	}
 
-*/
-	uint16 w16;
-	uint32 w32;
-	uint64 w64;
-	uint64 size = 0;
+	virtual void Zip64EndOfCentralDirectoryLocator(const ZipZip64EndOfCentralDirectoryLocator& r) {
+		FieldCursor cur(r);
+		Print_header(fout, "Zip64 end of central directory locator", r.signature, r.offset);
+		//    "12345678901234567890123456789012",
+		FIELD("disk of starting directory",      r.dir_disk,       u);
+		FIELD("relative offset of zip64 record", r.record_offset, ux);
+		FIELD("total number of disks",           r.disks,          u);
+	}
 
-	//     "12345678901234567890123456789012",
-	DUMP8 ("size of this record",             size, ux);
-	DUMP2x("version made by",                 w16,  x, Print_version(fout, w16));
-	DUMP2x("version needed to extract",       w16,  x, Print_version(fout, w16));
-	DUMP4 ("number of this disk",             w32,  u);
-	DUMP4 ("disk of starting directory",      w32,  u);
-	DUMP8 ("directory-entries on this disk",  w64,  u);
-	DUMP8 ("directory-entries in all disks",  w64,  u);
-	DUMP8 ("size of the directory",           w64,  ux);
-	DUMP8 ("offset of starting directory",    w64,  ux);
+	virtual void EndOfCentralDirectoryRecord(const ZipEndOfCentralDirectoryRecord& r) {
+		FieldCursor cur(r);
+		Print_header(fout, "End of central directory record", r.signature, r.offset);
+		//    "12345678901234567890123456789012",
+		FIELD("number of this disk",             r.disk,          uFF);
+		FIELD("disk of starting directory",      r.dir_disk,      uFF);
+		FIELD("directory-entries on this disk",  r.disk_entries,  uFF);
+		FIELD("directory-entries in all disks",  r.entries,       uFF);
+		FIELD("size of the directory",           r.dir_size,       ux);
+		FIELD("offset of starting directory",    r.dir_offset,     ux);
+		FIELD(".ZIP file comment length",        r.comment_length, ux); // 65,535ȏ͕s.
+		if (r.comment_length) {
+			Print_section(fout, ".ZIP file comment", r.offset + 4 + r.length);
+			Print_string(fout, r.comment);
+		}
+	}
 
-	Print_section(fout, "zip64 extensible data sector", _ftelli64(fin));
-	Dump_bytes(fin, fout, size - 2*2 - 4*2 - 8*4); // sizetB[hȌ̌Œ蒷.
-	// Todo: ID(2),SIZE(4) ̏ڍ׃_vs.
-}
+	virtual void UnknownRecord(const ZipRecord& r) {
+		Print_header(fout, "!! Unknown record", r.signature, r.offset);
+	}
 
-void Dump_Zip64_end_of_central_directory_locator(FILE* fin, FILE* fout)
-{
-/*
-  H.  Zip64 end of central directory locator
-
-        zip64 end of central dir locator 
-        signature                       4 bytes  (0x07064b50)
-        number of the disk with the
-        start of the zip64 end of 
-        central directory               4 bytes
-        relative offset of the zip64
-        end of central directory record 8 bytes
-        total number of disks           4 bytes
-*/
-	uint32 w32;
-	uint64 w64;
+	virtual void Data(const ZipData& d, ZipSource& fin) {
+		switch (d.kind) {
+		case ZIP_DATA_UNKNOWN:
+			SkipUnknownData(fin, fout, d.size);
+			break;
+		case ZIP_DATA_FILE:
+			Print_section(fout, "File data", d.offset, d.n);
+			Dump_if_fulldump(fin, fout, "file data", d.size);
+			break;
+		case ZIP_DATA_SIGNATURE:
+			Print_section(fout, "signature data", d.offset);
+			Dump_bytes(fin, fout, d.size);
+			break;
+		case ZIP_DATA_ZIP64_EXTENSIBLE:
+			Print_section(fout, "zip64 extensible data sector", d.offset);
+			Dump_bytes(fin, fout, d.size);
+			// Todo: ID(2),SIZE(4) ̏ڍ׃_vs.
+			break;
+		}
+	}
 
-	//    "12345678901234567890123456789012",
-	DUMP4("disk of starting directory",      w32, u);
-	DUMP8("relative offset of zip64 record", w64, ux);
-	DUMP4("total number of disks",           w32, u);
-}
+	virtual void ExtraField(ZipExtraOwner, uint16 id, uint16 size, const uchar* data, size_t avail) {
+		ZipMemorySource fin(data, avail);
+		Dump_extra_field(fin, fout, id, size);
+	}
+};
 
-void Dump_End_of_central_directory_record(FILE* fin, FILE* fout)
+//........................................................................
+//!@name fBNg̃nbVl.
+//@{
+/** fBNgEOCD̃nbVlvZ.
+ * eGg̖OACRCATCYAItZbg܂ނ̂ŁAA[JCue̓ꐫɎg.
+ * @retval false	fBNgȂ.
+ */
+bool HashCentralDirectory(FILE* fin, uint64& hash)
 {
-/*
-  I.  End of central directory record:
-
-        end of central dir signature    4 bytes  (0x06054b50)
-        number of this disk             2 bytes
-        number of the disk with the
-        start of the central directory  2 bytes
-        total number of entries in the
-        central directory on this disk  2 bytes
-        total number of entries in
-        the central directory           2 bytes
-        size of the central directory   4 bytes
-        offset of start of central
-        directory with respect to
-        the starting disk number        4 bytes
-        .ZIP file comment length        2 bytes
-        .ZIP file comment       (variable size)
-*/
-	uint16 w16, zipfile_comment_length = 0;
-	uint32 w32;
-
-	//    "12345678901234567890123456789012",
-	DUMP2("number of this disk",             w16, uFF); // ZIP64ł́A0xFFFFɌŒ肷.
-	DUMP2("disk of starting directory",      w16, uFF); // ZIP64ł́A0xFFFFɌŒ肷.
-	DUMP2("directory-entries on this disk",  w16, uFF); // ZIP64ł́A0xFFFFɌŒ肷.
-	DUMP2("directory-entries in all disks",  w16, uFF); // ZIP64ł́A0xFFFFɌŒ肷.
-	DUMP4("size of the directory",           w32, ux);  // ZIP64ł́A0xFFFFFFFFɌŒ肷.
-	DUMP4("offset of starting directory",    w32, ux);  // ZIP64ł́A0xFFFFFFFFɌŒ肷.
-	DUMP2(".ZIP file comment length", zipfile_comment_length, ux); // 65,535ȏ͕s.
-	if (zipfile_comment_length) {
-		Print_section(fout, ".ZIP file comment", _ftelli64(fin));
-		Dump_string(fin, fout, zipfile_comment_length);
+	CentralDirInfo info;
+	if (!FindCentralDirectory(fin, info))
+		return false;
+
+	char buf[0x10000];
+	hash = FNV1A64_INIT;
+	_fseeki64(fin, info.dir_offset, SEEK_SET);
+	for (uint64 rest = info.dir_size; rest > 0; ) {
+		size_t n = (size_t) (rest < sizeof(buf) ? rest : sizeof(buf));
+		if (fread(buf, 1, n, fin) != n)
+			return false;
+		hash = fnv1a64(buf, n, hash);
+		rest -= n;
 	}
+	_fseeki64(fin, info.eocd_offset, SEEK_SET);
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), fin)) > 0)
+		hash = fnv1a64(buf, n, hash);
+	return true;
 }
 //@}
 
@@ -1565,148 +1423,2470 @@ void Dump_End_of_central_directory_record(FILE* fin, FILE* fout)
 /** finPKZIPt@C͂ɑ΂āAfoutɃ_vo͂. */
 void ZipDumpFile(FILE* fin, FILE* fout)
 {
-	uint32 signature = 0;
-	int file_count = 0;
-	int dir_count = 0;
+	// 蓖Ăt@CȂ΁AstdiooRɃœǂ.
+	MappedFile map;
+	ZipTextDumper dumper(fout);
+	if (map.Map(fin)) {
+		ZipMemorySource in(map.Data(), map.Size());
+		ZipReader(in).Read(dumper);
+	}
+	else {
+		ZipFileSource in(fin);
+		ZipReader(in).Read(dumper);
+	}
+}
 
-	while (SkipToNextPK(fin, fout)) {
-		__int64 offset = _ftelli64(fin);
-		if (!Read32(fin, signature)) {
-			continue;
+//........................................................................
+//!@name -l: \[gς݃Ggꗗ.
+//@{
+/** ꗗR[ȟŒ蒷. ꎞt@Cɂ͂̍\̂̂܂܏oAĖOo. */
+struct ListKey {
+	uint64 seq;			///< fBNg̏. L[l̃R[h̏ۂ߂Ɏg.
+	uint64 offset;		///< local header ̈ʒu.
+	uint64 size;		///< 񈳏kTCY.
+	uint64 csize;		///< kTCY.
+	uint32 crc;
+	uint16 method;
+	uint16 name_len;
+};
+
+/** ꗗR[h */
+struct ListRecord {
+	ListKey k;
+	const char* name;	///< O. '\0'I[Ƃ͌Ȃ̂ k.name_len g.
+};
+
+/** ꗗR[h̏r.
+ * O̓oCgƂĔr. L[lȂΒfBNg̏ԂƂ.
+ */
+class ListLess {
+	int mKey;
+public:
+	explicit ListLess(int key) : mKey(key) {}
+
+	bool operator()(const ListRecord& a, const ListRecord& b) const {
+		switch (mKey) {
+		case 'n': {
+			int c = memcmp(a.name, b.name, a.k.name_len < b.k.name_len ? a.k.name_len : b.k.name_len);
+			if (c != 0)
+				return c < 0;
+			if (a.k.name_len != b.k.name_len)
+				return a.k.name_len < b.k.name_len;
+			break;
 		}
-		switch (signature) {
-		case 0x04034b50:
-			Print_header(fout, "Local file header", signature, offset, ++file_count);
-			Dump_Local_file(fin, fout, file_count);
+		case 's':
+			if (a.k.size != b.k.size)
+				return a.k.size < b.k.size;
 			break;
-
-		case 0x08074b50:
-			Print_header(fout, "Data descriptor header", signature, offset, file_count);
-			Dump_Data_descriptor(fin, fout);
+		case 'o':
+			if (a.k.offset != b.k.offset)
+				return a.k.offset < b.k.offset;
 			break;
+		}//.endswitch
+		return a.k.seq < b.k.seq;
+	}
+};
+
+/** ꗗR[h̏o͐ */
+class ListSink {
+public:
+	virtual ~ListSink() {}
+	virtual void Put(const ListRecord& r) = 0;
+};
+
+/** ꗗR[heLXgo͂ */
+class ListPrinter : public ListSink {
+	FILE* mOut;
+public:
+	explicit ListPrinter(FILE* fout) : mOut(fout) {
+		fprintf(mOut, "%12s %12s %12s %6s %8s  %s\n", "offset", "size", "compressed", "method", "crc-32", "name");
+	}
 
-		case 0x08064b50:
-			Print_header(fout, "Archive extra data record", signature, offset);
-			Dump_Archive_extra_data_record(fin, fout);
-			break;
-		case 0x02014b50:
-			Print_header(fout, "Central file header", signature, offset, ++dir_count);
-			Dump_Central_directory_file_header(fin, fout, dir_count);
-			break;
-		case 0x05054b50:
-			Print_header(fout, "Digital signature", signature, offset);
-			Dump_Central_directory_digital_signature(fin, fout);
-			break;
-		case 0x06064b50:
-			Print_header(fout, "Zip64 end of central directory record", signature, offset);
-			Dump_Zip64_end_of_central_directory_record(fin, fout);
-			break;
-		case 0x07064b50:
-			Print_header(fout, "Zip64 end of central directory locator", signature, offset);
-			Dump_Zip64_end_of_central_directory_locator(fin, fout);
-			break;
-		case 0x06054b50:
-			Print_header(fout, "End of central directory record", signature, offset);
-			Dump_End_of_central_directory_record(fin, fout);
-			break;
-		default:
-			Print_header(fout, "!! Unknown record", signature, offset);
-			break;
-		}//.endswitch signature
-	}//.endwhile NextPK
-}
+	virtual void Put(const ListRecord& r) {
+		fprintf(mOut, "%12llu %12llu %12llu %6u %08X  ", r.k.offset, r.k.size, r.k.csize, r.k.method, r.k.crc);
+		for (size_t i = 0; i < r.k.name_len; ++i) {
+			int c = (uchar) r.name[i];
+			if (iscntrl(c))
+				fprintf(mOut, "^%c", c + '@'); // print control-code as visible.
+			else
+				fputc(c, mOut);
+		}
+		fputc('\n', mOut);
+	}
+};
 
-//........................................................................
-// ZIPt@C_ṽC֐.
-/** fnameǂݍ݁ARgƗ]ȋ󔒂Afname+".zipdump"ɏo͂. */
-void DumpMain(const char* fname)
-{
-	FILE* fin = OpenInput(fname);
-	FILE* fout;
-	if (gIsStdout) {
-		fout = stdout;
-		printf("<<< %s >>> begin.\n", fname);
+/** ꎞt@C(\[gς݃)փR[ho */
+class RunWriter : public ListSink {
+	FILE* mFp;
+public:
+	explicit RunWriter(FILE* fp) : mFp(fp) {}
+
+	virtual void Put(const ListRecord& r) {
+		fwrite(&r.k, sizeof(r.k), 1, mFp);
+		fwrite(r.name, 1, r.k.name_len, mFp);
 	}
-	else {
-		fout = OpenOutput(fname, ".zipdump");
+};
+
+/** ꎞt@C(\[gς݃)烌R[hɓǂݏo */
+class RunReader {
+	FILE* mFp;
+	string mName;
+public:
+	ListRecord rec;		///< ǂݏoR[h.
+
+	explicit RunReader(FILE* fp) : mFp(fp) {
+		rewind(mFp);
 	}
-	fprintf(fout, "*** zipdump of \"%s\" ***\n", fname);
 
-	ZipDumpFile(fin, fout);
+	/** ̃R[hǂݏo. I[Ȃ false Ԃ. */
+	bool Next() {
+		if (fread(&rec.k, sizeof(rec.k), 1, mFp) != 1)
+			return false;
+		mName.resize(rec.k.name_len);
+		if (rec.k.name_len && fread(&mName[0], 1, rec.k.name_len, mFp) != rec.k.name_len)
+			return false;
+		rec.name = mName.data();
+		return true;
+	}
+};
 
-	if (ferror(fin)) {
-		print_win32error(fname);
+/** ꎞt@C쐬.
+ * 쐬ꏊ̓VXëꎞtH_ƂAN[YɎ폜.
+ * 쐬sɂ̓^[ȂŁAŏI.
+ */
+FILE* OpenTempFile()
+{
+#ifndef _WIN32
+	FILE* fp = tmpfile();	// 쐬ɍ폜ς݂ƂȂ.
+	if (fp == NULL) {
+		print_win32error("tmpfile");
+		exit(EXIT_FAILURE);
 	}
-	fclose(fin);
-	if (gIsStdout) {
-		printf("<<< %s >>> end.\n\n", fname);
+#else
+	char dir[MY_MAX_PATH];
+	char fname[MY_MAX_PATH];
+	if (!::GetTempPathA(sizeof(dir), dir) || !::GetTempFileNameA(dir, "zdp", 0, fname)) {
+		print_win32error("GetTempFileName");
+		exit(EXIT_FAILURE);
 	}
-	else {
-		fclose(fout);
+	FILE* fp = fopen(fname, "w+bD");	// D: Ō̃N[Yɍ폜.
+	if (fp == NULL) {
+		fprintf(stderr, "can't open temporary file: %s\n", fname);
+		exit(EXIT_FAILURE);
 	}
+#endif
+	setvbuf(fp, NULL, _IOFBF, 0x10000);
+	return fp;
 }
 
-/** ChJ[hWJƍċATt DumpMain */
-void DumpWildMain(const char* fname)
-{
-	if (strpbrk(fname, "*?") == NULL) {
-		//----- ChJ[h܂܂ȂpX̏
-		DumpMain(fname);
+/** gpʂ̏t\[g.
+ * R[h̓ɗߍ݁AO̓A[iɋl߂Ċi[.
+ * ɒB\[gĈꎞt@Cɏo()AŌɑSk-way}[W.
+ * SR[hɎ܂΁Aꎞt@Cg킸Ƀ̃\[gōς܂.
+ */
+class ExternalSorter {
+	ListLess mLess;
+	size_t mMemLimit;
+	Arena mNames;
+	vector<ListRecord> mRecs;
+	vector<FILE*> mRuns;
+
+	/** xɃ}[W郉̍ő吔. ̓ǂݏoobt@(64KB)̑ʂ}. */
+	enum { MAX_FANIN = 64 };
+
+	/** q[ṽ̔r. 擪R[ĥ擪ɒu. */
+	class HeapLess {
+		const ListLess& mLess;
+	public:
+		explicit HeapLess(const ListLess& less) : mLess(less) {}
+		bool operator()(const RunReader* a, const RunReader* b) const {
+			return mLess(b->rec, a->rec);
+		}
+	};
+
+public:
+	/** RXgN^.
+	 * @param key		\[gL[. 'n':name, 's':size, 'o':offset
+	 * @param memlimit	gpʂ̏(bytes).
+	 * @param expected	\zR[h. Ȃ΂̐\񂵂Ă.
+	 */
+	ExternalSorter(int key, size_t memlimit, uint64 expected)
+		: mLess(key), mMemLimit(memlimit)
+	{
+		uint64 n = mMemLimit / 2 / sizeof(ListRecord);
+		mRecs.reserve((size_t) (expected < n ? expected : n));
 	}
-	else {
-		//----- ChJ[h܂ރpX̏
-		char path[MY_MAX_PATH + 1000];
-		char drv[_MAX_DRIVE];
-		char dir[MY_MAX_PATH + 1000];
-		char base[MY_MAX_PATH];
-		char ext[MY_MAX_PATH];
-		_splitpath(fname, drv, dir, base, ext);
 
-		_finddata_t find;
-		long h = _findfirst(fname, &find);
-		if (h != -1) {
-			do {
-				if (find.attrib & _A_SUBDIR)
-					continue;
-				_makepath(path, drv, dir, find.name, NULL);
-				// fprintf(stderr, "zipdump: %s\n", find.name);
-				DumpMain(path);
-			} while (_findnext(h, &find) == 0);
-			_findclose(h);
-		}
-		if (!gIsRecursive)
-			return;
+	~ExternalSorter() {
+		for (size_t i = 0; i < mRuns.size(); ++i)
+			fclose(mRuns[i]);
+	}
 
-		// TutH_Aꂼɑ΂čċA
-		_makepath(path, drv, dir, "*.*", NULL);
-		h = _findfirst(path, &find);
-		if (h != -1) {
-			do {
-				if (!(find.attrib & _A_SUBDIR))
-					continue;
-				if (strequ(find.name, ".") || strequ(find.name, ".."))
-					continue;
-				_makepath(path, drv, dir, find.name, NULL);
-				strcat(path, "\\");
-				strcat(path, base);
-				strcat(path, ext);
-				// fprintf(stderr, "zipdump recursive: %s\n", path);
-				DumpWildMain(path); // ċAĂяo.
-			} while (_findnext(h, &find) == 0);
-			_findclose(h);
+	/** R[hǉ. */
+	void Add(const CentralDirEntry& e, uint64 seq) {
+		size_t name_len = e.name.size() < 0xffff ? e.name.size() : 0xffff;
+		size_t recs = mRecs.size() < mRecs.capacity() ? mRecs.capacity() : mRecs.size() * 2;
+		if (!mRecs.empty() && recs * sizeof(ListRecord) + mNames.Used() + name_len > mMemLimit)
+			SpillRun();
+		ListRecord r;
+		r.k.seq      = seq;
+		r.k.offset   = e.local_header_offset;
+		r.k.size     = e.uncompressed_size;
+		r.k.csize    = e.compressed_size;
+		r.k.crc      = e.crc;
+		r.k.method   = e.method;
+		r.k.name_len = (uint16) name_len;
+		r.name = mNames.StrDup(e.name.data(), name_len);
+		mRecs.push_back(r);
+	}
+
+	/** \[gς݂̑SR[h out ɏo͂. */
+	void Finish(ListSink& out) {
+		if (mRuns.empty()) {
+			// SR[hɎ܂̂ŁA\[gōς܂.
+			sort(mRecs.begin(), mRecs.end(), mLess);
+			for (size_t i = 0; i < mRecs.size(); ++i)
+				out.Put(mRecs[i]);
+			return;
+		}
+		if (!mRecs.empty())
+			SpillRun();
+		mNames.Clear();
+		vector<ListRecord>().swap(mRecs);
+
+		// ̐Ȃ΁AMAX_FANIN}[WČ炷.
+		while (mRuns.size() > MAX_FANIN) {
+			vector<FILE*> group(mRuns.begin(), mRuns.begin() + MAX_FANIN);
+			mRuns.erase(mRuns.begin(), mRuns.begin() + MAX_FANIN);
+			FILE* fp = OpenTempFile();
+			RunWriter w(fp);
+			Merge(group, w);
+			for (size_t i = 0; i < group.size(); ++i)
+				fclose(group[i]);
+			mRuns.push_back(fp);
+		}
+		Merge(mRuns, out);
+	}
+
+private:
+	/** ̃R[h\[gāAƂĈꎞt@Cɏo. */
+	void SpillRun() {
+		sort(mRecs.begin(), mRecs.end(), mLess);
+		FILE* fp = OpenTempFile();
+		RunWriter w(fp);
+		for (size_t i = 0; i < mRecs.size(); ++i)
+			w.Put(mRecs[i]);
+		if (ferror(fp)) {
+			print_win32error("write temporary file");
+			exit(EXIT_FAILURE);
+		}
+		mRuns.push_back(fp);
+		mRecs.clear();
+		mNames.Clear();
+	}
+
+	/** k-way}[W out ɏo͂. */
+	void Merge(vector<FILE*>& runs, ListSink& out) {
+		vector<RunReader*> heap;
+		vector<RunReader*> readers;
+		HeapLess less(mLess);
+		for (size_t i = 0; i < runs.size(); ++i) {
+			RunReader* r = new RunReader(runs[i]);
+			readers.push_back(r);
+			if (r->Next())
+				heap.push_back(r);
+		}
+		make_heap(heap.begin(), heap.end(), less);
+		while (!heap.empty()) {
+			pop_heap(heap.begin(), heap.end(), less);
+			RunReader* r = heap.back();
+			out.Put(r->rec);
+			if (r->Next())
+				push_heap(heap.begin(), heap.end(), less);
+			else
+				heap.pop_back();
+		}
+		for (size_t i = 0; i < readers.size(); ++i)
+			delete readers[i];
+	}
+};
+
+/** fin̒fBNgǂݏoA\[gς݂̃Ggꗗfoutɏo͂. */
+void ZipListFile(FILE* fin, FILE* fout)
+{
+	const char* keyname = gListKey == 'n' ? "name" : gListKey == 's' ? "size" : "offset";
+	fprintf(fout, "; sorted by %s\n", keyname);
+
+	CentralDirReader reader;
+	if (!reader.Open(fin)) {
+		fprintf(fout, "!! End of central directory record is not found\n");
+		return;
+	}
+	ExternalSorter sorter(gListKey, gSortMemLimit, reader.Info().entries);
+	CentralDirEntry e;
+	uint64 seq = 0;
+	while (reader.Next(e))
+		sorter.Add(e, seq++);
+	if (seq != reader.Info().entries)
+		fprintf(fout, "!! central directory has %llu entries, but %llu entries are read\n", reader.Info().entries, seq);
+
+	ListPrinter printer(fout);
+	sorter.Finish(printer);
+}
+//@}
+
+//........................................................................
+//!@name -a: zu.
+//@{
+/** k(񈳏kTCY/kTCY)𒴂GgُƂ݂Ȃ.
+ * deflate̗_̍ő刳k͖1032Ȃ̂ŁAʏ̃f[^ł͂܂ŒBȂ.
+ */
+const uint64 LAYOUT_RATIO_LIMIT = 100;
+
+/** t@C̈̗̈ */
+struct LayoutRange {
+	uint64 begin;		///< Jnʒu.
+	uint64 end;			///< Iʒu(̈ʒu܂܂Ȃ).
+	uint64 seq;			///< fBNg̃Ggԍ. 0͒fBNgȍ~̗̈.
+	uint64 csize;		///< kTCY.
+	uint64 usize;		///< 񈳏kTCY.
+	uint32 cd_len;		///< fBNg̖O extra field ̒. local header ĂꍇɎg.
+	const char* name;	///< Gg.
+
+	bool operator<(const LayoutRange& r) const {
+		return begin != r.begin ? begin < r.begin : end > r.end;
+	}
+};
+
+/** ُ񍐂. */
+void Print_layout_error(FILE* fout, const LayoutRange& r, const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	fprintf(fout, "!! #%llu [%llX-%llX) \"%s\": ", r.seq, r.begin, r.end, r.name);
+	vfprintf(fout, fmt, args);
+	fputc('\n', fout);
+	va_end(args);
+}
+
+/** local header ɑ data descriptor ̃TCY߂.
+ * @param h		local header ̌Œ蒷.
+ * @param pos	file data ̏I[ʒu.
+ * @return		data descriptor 0.
+ */
+uint32 DataDescriptorSize(FILE* fin, const uchar* h, uint64 pos)
+{
+	if ((Get16(h+6) & 0x0008) == 0)
+		return 0;
+	// Bit 3: data descriptor . signature ͏ȗ\ŁATCY ZIP64 Ȃ8oCgɂȂ.
+	uint32 size = 0;
+	uchar sig[4];
+	_fseeki64(fin, pos, SEEK_SET);
+	if (fread(sig, 1, sizeof(sig), fin) == sizeof(sig) && Get32(sig) == 0x08074b50)
+		size += 4;
+	bool zip64 = Get32(h+18) == 0xffffffff || Get32(h+22) == 0xffffffff;
+	return size + (zip64 ? 20 : 12);
+}
+
+/** Gg߂͈(Local file header, file data, data descriptor)̏I[߂.
+ * local header ̌Œ蒷ƁAdata descriptor  signature ǂݏoAf[^͓ǂ܂Ȃ.
+ * @retval false	local header Ă. I[͒fBNg̒l琄肷.
+ */
+bool LocalRecordEnd(FILE* fin, LayoutRange& r)
+{
+	uchar h[30];
+	_fseeki64(fin, r.begin, SEEK_SET);
+	if (fread(h, 1, sizeof(h), fin) != sizeof(h) || Get32(h) != 0x04034b50) {
+		r.end = r.begin + sizeof(h) + r.cd_len + r.csize;
+		return false;
+	}
+	uint64 end = r.begin + sizeof(h) + Get16(h+26) + Get16(h+28) + r.csize;
+	r.end = end + DataDescriptorSize(fin, h, end);
+	return true;
+}
+
+/** fin̊eR[h̔zu͂AԁAdȂAdQƁAُȈkfoutɕ񍐂.
+ * fBNgeGg͈̔͂߁AJnʒuŃ\[gđ̂ O(n log n) ōς.
+ * f[^̓WJ͍sȂ.
+ * @return	ُ̐.
+ */
+uint64 ZipLayoutFile(FILE* fin, FILE* fout)
+{
+	CentralDirReader reader;
+	if (!reader.Open(fin)) {
+		fprintf(fout, "!! End of central directory record is not found\n");
+		return 1;
+	}
+	const CentralDirInfo info = reader.Info();
+	uint64 errors = 0;
+
+	//--- fBNg̑SGg͈̔͂W߂.
+	Arena names;
+	vector<LayoutRange> ranges;
+	ranges.reserve((size_t) (info.entries < 0x1000000 ? info.entries + 1 : 0x1000000));
+	uint64 total_csize = 0, total_usize = 0;
+	CentralDirEntry e;
+	uint64 seq = 0;
+	while (reader.Next(e)) {
+		LayoutRange r;
+		r.seq    = ++seq;
+		r.csize  = e.compressed_size;
+		r.usize  = e.uncompressed_size;
+		r.cd_len = (uint32) (e.name.size() + e.extra.size());
+		r.name   = names.StrDup(e.name.c_str(), e.name.size());
+		r.begin  = r.end = e.local_header_offset;
+		ranges.push_back(r);
+		total_csize += e.compressed_size;
+		total_usize += e.uncompressed_size;
+	}
+	if (seq != info.entries) {
+		fprintf(fout, "!! central directory has %llu entries, but %llu entries are read\n", info.entries, seq);
+		++errors;
+	}
+
+	//--- ʒuɕׁAlocal header ǂݏoĊeGg̏I[߂. ǂݏo̓t@C̐擪珇ɐi.
+	sort(ranges.begin(), ranges.end());
+	for (size_t i = 0; i < ranges.size(); ++i) {
+		const LayoutRange& r = ranges[i];
+		if (!LocalRecordEnd(fin, ranges[i])) {
+			Print_layout_error(fout, r, "bad local file header");
+			++errors;
+		}
+		// k͒fBNg̒lŔ肷.
+		uint64 csize = r.csize ? r.csize : 1;
+		if (r.usize / csize > LAYOUT_RATIO_LIMIT) {
+			Print_layout_error(fout, r, "compression ratio %llu:1 (%llu -> %llu bytes)", r.usize / csize, r.csize, r.usize);
+			++errors;
+		}
+	}
+
+	//--- fBNgȍ~̗̈Ƃĉ. Jnʒu͑SGgȏȂ̂ŁAɉĂ͕ۂ.
+	LayoutRange tail;
+	tail.seq    = 0;
+	tail.csize  = 0;
+	tail.usize  = 0;
+	tail.cd_len = 0;
+	tail.name   = "central directory";
+	tail.begin  = info.dir_offset;
+	tail.end    = info.file_size;
+	ranges.push_back(tail);
+	if (ranges.size() >= 2 && tail < ranges[ranges.size()-2])
+		sort(ranges.begin(), ranges.end());
+
+	//--- Jnʒuɑ. ܂ł̍őI[On܂͈͂́ȀI[͈͂ƏdȂĂ.
+	uint64 slack = 0, overlaps = 0, duplicates = 0;
+	uint64 reach = 0;			// ܂ł͈̔͂̍őI[.
+	const LayoutRange* owner = NULL;	// reach I[Ƃ͈.
+	for (size_t i = 0; i < ranges.size(); ++i) {
+		const LayoutRange& r = ranges[i];
+		if (r.end > (uint64) info.file_size) {
+			Print_layout_error(fout, r, "beyond end of file(%llX)", info.file_size);
+			++errors;
+		}
+		if (r.begin > reach) {
+			fprintf(fout, "gap [%llX-%llX) %llu bytes\n", reach, r.begin, r.begin - reach);
+			slack += r.begin - reach;
+		}
+		else if (i > 0 && r.begin == ranges[i-1].begin && r.seq != 0 && ranges[i-1].seq != 0) {
+			Print_layout_error(fout, r, "same local header as #%llu \"%s\"", ranges[i-1].seq, ranges[i-1].name);
+			++duplicates;
+		}
+		else if (owner && r.begin < reach) {
+			Print_layout_error(fout, r, "overlaps #%llu \"%s\" [%llX-%llX) by %llu bytes",
+				owner->seq, owner->name, owner->begin, owner->end, (r.end < reach ? r.end : reach) - r.begin);
+			++overlaps;
+		}
+		if (r.end > reach) {
+			reach = r.end;
+			owner = &r;
+		}
+	}
+
+	fprintf(fout, "; %llu entries, file size %llu, compressed %llu, uncompressed %llu\n",
+		seq, info.file_size, total_csize, total_usize);
+	fprintf(fout, "; slack %llu bytes, %llu overlaps, %llu duplicate references\n", slack, overlaps, duplicates);
+	errors += overlaps + duplicates;
+	if (total_usize / (info.file_size ? info.file_size : 1) > LAYOUT_RATIO_LIMIT) {
+		fprintf(fout, "!! total uncompressed size is %llu times of file size\n", total_usize / info.file_size);
+		++errors;
+	}
+	fprintf(fout, "; %s\n", errors ? "SUSPICIOUS" : "OK");
+	return errors;
+}
+//@}
+
+//........................................................................
+//!@name --check: fBNg local header ̏ƍ.
+//@{
+/** ƍ钆fBNg̃Gg. ZIP64g͓Kpς݂̒lƂ. */
+struct CheckEntry {
+	uint64 offset;		///< local header ̈ʒu.
+	uint64 seq;			///< fBNg̃Ggԍ.
+	uint64 csize;		///< kTCY.
+	uint64 usize;		///< 񈳏kTCY.
+	uint32 crc;
+	uint16 method;
+	bool matched;		///< ʒu local header ?
+	const char* name;	///< Gg. '\0'I[Ƃ͌Ȃ̂ name_len g.
+	size_t name_len;
+
+	bool operator<(const CheckEntry& r) const {
+		return offset != r.offset ? offset < r.offset : seq < r.seq;
+	}
+};
+
+/** fBNg̃GgƂ̕sv񍐂. */
+void Print_check_error(FILE* fout, const CheckEntry& e, const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	fprintf(fout, "!! #%llu [%llX] \"%.*s\": ", e.seq, e.offset, (int) e.name_len, e.name);
+	vfprintf(fout, fmt, args);
+	fputc('\n', fout);
+	va_end(args);
+}
+
+/** t@C擪瑖A local header ʒuɕׂfBNg̃GgƓ˂킹.
+ * local header ͈ʒȕɌ̂ŁAGgxȂ邾ŏƍł.
+ * ƍς݂̃Gg̃f[^̈Ɍꂽ local header ́Ai[ꂽZIPt@CȂǂ̓eƂ݂ȂĐ邾ɂ.
+ */
+class CheckVisitor : public ZipVisitor {
+	ZipSource& mIn;
+	FILE* mOut;
+	vector<CheckEntry>& mEntries;	///< ʒuɕׂGg.
+	size_t mNext;					///< ɏƍGg.
+	uint64 mCoveredEnd;				///< ƍς݃Gg̐߂͈͂̍őI[.
+	const CheckEntry* mCoveredBy;	///< mCoveredEnd I[ƂGg.
+public:
+	uint64 locals;			///<  local header ̐.
+	uint64 mismatches;		///< evȂGg.
+	uint64 orphan_locals;	///< ǂ̃GgQƂȂ local header ̐.
+	uint64 embedded;		///< Gg̃f[^̈Ɍꂽ local header ̐.
+
+	CheckVisitor(ZipSource& in, FILE* fout, vector<CheckEntry>& entries)
+		: mIn(in), mOut(fout), mEntries(entries), mNext(0), mCoveredEnd(0), mCoveredBy(NULL),
+		  locals(0), mismatches(0), orphan_locals(0), embedded(0) {}
+
+	virtual void LocalFileHeader(const ZipLocalFileHeader& r);
+
+	// fBNg͓ǂݍݍς݂Ȃ̂ŁAextra field ̕sv.
+	virtual void CentralFileHeader(const ZipCentralFileHeader&) {}
+
+private:
+	bool Compare(const ZipLocalFileHeader& r, const CheckEntry& e, uint64& end);
+};
+
+void CheckVisitor::LocalFileHeader(const ZipLocalFileHeader& r)
+{
+	++locals;
+	uint64 offset = (uint64) r.offset;
+	while (mNext < mEntries.size() && mEntries[mNext].offset < offset)
+		++mNext;	// ȂGǵAɕ񍐂.
+
+	if (mNext == mEntries.size() || mEntries[mNext].offset != offset) {
+		if (offset < mCoveredEnd) {
+			++embedded;
+			if (!gQuiet)
+				fprintf(mOut, "; local header at %llX is inside the data of #%llu, ignored\n", offset, mCoveredBy->seq);
+			return;
+		}
+		++orphan_locals;
+		fprintf(mOut, "!! local header at %llX \"", offset);
+		Print_string(mOut, r.file_name.substr(0, 0x100) + "\" is not referenced by central directory");
+		return;
+	}
+
+	//  local header QƂGg΁AꂼƏƍ.
+	for (; mNext < mEntries.size() && mEntries[mNext].offset == offset; ++mNext) {
+		CheckEntry& e = mEntries[mNext];
+		e.matched = true;
+		uint64 end;
+		if (!Compare(r, e, end))
+			++mismatches;
+		if (end > mCoveredEnd) {
+			mCoveredEnd = end;
+			mCoveredBy = &e;
+		}
+	}
+}
+
+/** local header ̓eGgƔׁAقȂ鍀ڂ񍐂.
+ * bit 3 Ă΁Acrc ƃTCY file data ɑ data descriptor ̒lg.
+ * @param end	Gg̐߂͈͂̏I[̊i[.
+ * @retval false	قȂ鍀ڂ.
+ */
+bool CheckVisitor::Compare(const ZipLocalFileHeader& r, const CheckEntry& e, uint64& end)
+{
+	bool ok = true;
+	const uint64 data = (uint64) r.offset + 30 + r.file_name.size() + r.extra_field.size();
+	end = data + e.csize;
+	if (r.length < 26) {
+		Print_check_error(mOut, e, "local file header is truncated");
+		return false;
+	}
+	if (r.file_name.size() != e.name_len || memcmp(r.file_name.data(), e.name, e.name_len) != 0) {
+		fprintf(mOut, "!! #%llu [%llX] \"%.*s\": name is different, local \"", e.seq, e.offset, (int) e.name_len, e.name);
+		Print_string(mOut, r.file_name.substr(0, 0x100) + "\"");
+		ok = false;
+	}
+	if (r.method != e.method) {
+		Print_check_error(mOut, e, "method is different, local %u, central %u", r.method, e.method);
+		ok = false;
+	}
+
+	// ZIP64Ȃ΁ATCY local header  Zip64 extended information extra field ɂ.
+	bool zip64 = false;
+	uint64 usize = r.uncompressed_size;
+	uint64 csize = r.compressed_size;
+	for (size_t i = 0; i + 4 <= r.extra_field.size(); ) {
+		const uchar* p = &r.extra_field[i];
+		size_t size = Get16(p+2);
+		if (i + 4 + size > r.extra_field.size())
+			break;
+		if (Get16(p) == 0x0001) {
+			zip64 = true;
+			const uchar* q = p + 4;
+			const uchar* qend = q + size;
+			if (usize == 0xffffffff && q + 8 <= qend) { usize = Get64(q); q += 8; }
+			if (csize == 0xffffffff && q + 8 <= qend) { csize = Get64(q); q += 8; }
+			break;
+		}
+		i += 4 + size;
+	}
+	uint32 crc = r.crc;
+	const char* where = "local";
+	if (r.flags & 0x0008) {
+		// Bit 3: data descriptor ǂݏo. ̓ǂݏoʒúAǂݏI߂.
+		uchar h[24];
+		__int64 pos = mIn.Tell();
+		mIn.Seek(end, SEEK_SET);
+		size_t n = mIn.Read(h, sizeof(h));
+		mIn.Seek(pos, SEEK_SET);
+		size_t skip = (n >= 4 && Get32(h) == 0x08074b50) ? 4 : 0;
+		zip64 = zip64 || r.compressed_size == 0xffffffff || r.uncompressed_size == 0xffffffff;
+		size_t need = skip + (zip64 ? 20 : 12);
+		if (n < need) {
+			Print_check_error(mOut, e, "data descriptor is truncated");
+			return false;
+		}
+		crc   = Get32(h + skip);
+		csize = zip64 ? Get64(h + skip + 4)  : Get32(h + skip + 4);
+		usize = zip64 ? Get64(h + skip + 12) : Get32(h + skip + 8);
+		end += need;
+		where = "data descriptor";
+	}
+	if (crc != e.crc) {
+		Print_check_error(mOut, e, "crc-32 is different, %s %08X, central %08X", where, crc, e.crc);
+		ok = false;
+	}
+	if (csize != e.csize) {
+		Print_check_error(mOut, e, "compressed size is different, %s %llu, central %llu", where, csize, e.csize);
+		ok = false;
+	}
+	if (usize != e.usize) {
+		Print_check_error(mOut, e, "uncompressed size is different, %s %llu, central %llu", where, usize, e.usize);
+		ok = false;
+	}
+	return ok;
+}
+
+/** fin̒fBNg̊eGg local header ƍAsvƌǗR[hfoutɕ񍐂.
+ * fBNgǂݍňʒuɕׂĂAt@C擪xďƍ.
+ * @return	ُ̐.
+ */
+uint64 ZipCheckFile(FILE* fin, FILE* fout)
+{
+	CentralDirReader reader;
+	if (!reader.Open(fin)) {
+		fprintf(fout, "!! End of central directory record is not found\n");
+		return 1;
+	}
+	const CentralDirInfo info = reader.Info();
+	uint64 errors = 0;
+
+	//--- fBNg̑SGgW߁Alocal header ̈ʒuɕׂ.
+	Arena names;
+	vector<CheckEntry> entries;
+	entries.reserve((size_t) (info.entries < 0x1000000 ? info.entries : 0x1000000));
+	bool sorted = true;
+	CentralDirEntry ce;
+	while (reader.Next(ce)) {
+		CheckEntry e;
+		e.offset   = ce.local_header_offset;
+		e.seq      = entries.size() + 1;
+		e.csize    = ce.compressed_size;
+		e.usize    = ce.uncompressed_size;
+		e.crc      = ce.crc;
+		e.method   = ce.method;
+		e.matched  = false;
+		e.name     = names.StrDup(ce.name.data(), ce.name.size());
+		e.name_len = ce.name.size();
+		if (!entries.empty() && e < entries.back())
+			sorted = false;
+		entries.push_back(e);
+	}
+	if (entries.size() != info.entries) {
+		fprintf(fout, "!! central directory has %llu entries, but %llu entries are read\n", info.entries, (uint64) entries.size());
+		++errors;
+	}
+	if (!sorted)	// ʏ͊ɈʒuȂ̂ŁA\[gȂ.
+		sort(entries.begin(), entries.end());
+
+	//--- t@C擪瑖ďƍ. 蓖Ăt@CȂ΃œǂ.
+	_fseeki64(fin, 0, SEEK_SET);
+	MappedFile map;
+	map.Map(fin);
+	ZipMemorySource mem_in(map.Data(), map.Size());
+	ZipFileSource file_in(fin);
+	ZipSource& in = map.Data() ? (ZipSource&) mem_in : file_in;
+	CheckVisitor checker(in, fout, entries);
+	ZipReader(in).Read(checker);
+
+	//--- local header ȂGg񍐂.
+	uint64 orphan_centrals = 0;
+	for (size_t i = 0; i < entries.size(); ++i) {
+		const CheckEntry& e = entries[i];
+		if (e.matched)
+			continue;
+		++orphan_centrals;
+		uchar sig[4];
+		_fseeki64(fin, e.offset, SEEK_SET);
+		if (fread(sig, 1, sizeof(sig), fin) == sizeof(sig) && Get32(sig) == 0x04034b50)
+			Print_check_error(fout, e, "local header is hidden inside the data of another entry");
+		else
+			Print_check_error(fout, e, "no local header at the offset");
+	}
+
+	fprintf(fout, "; %llu central entries, %llu local headers, %llu mismatched entries\n",
+		(uint64) entries.size(), checker.locals, checker.mismatches);
+	fprintf(fout, "; %llu orphan local headers, %llu orphan central entries, %llu local headers inside data\n",
+		checker.orphan_locals, orphan_centrals, checker.embedded);
+	errors += checker.mismatches + checker.orphan_locals + orphan_centrals;
+	fprintf(fout, "; %s\n", errors ? "SUSPICIOUS" : "OK");
+	return errors;
+}
+//@}
+
+//........................................................................
+//!@name --repack: č\.
+//@{
+/** č\̃Rs[P. 傫ȒPʂœǂݏāAVXeR[̉񐔂炷. */
+const size_t REPACK_COPY_SIZE = 0x100000;
+
+/** p extra field ̃^O(Android zipalign ݊). f[^͐P(2oCg)ƁAɑpfBO. */
+const uint16 ALIGNMENT_EXTRA_TAG = 0xd935;
+
+/** extra field Aw^ÕtB[h菜.
+ * 4oCgɖȂ]́AÂ zipalign ̃pfBOȂ̂Ŏ菜.
+ */
+void RemoveExtraField(vector<uchar>& extra, uint16 tag)
+{
+	vector<uchar> out;
+	size_t i = 0;
+	while (i + 4 <= extra.size()) {
+		size_t size = Get16(&extra[i+2]);
+		if (i + 4 + size > extra.size())
+			break;
+		if (Get16(&extra[i]) != tag)
+			out.insert(out.end(), extra.begin() + i, extra.begin() + i + 4 + size);
+		i += 4 + size;
+	}
+	if (extra.size() - i >= 4)
+		out.insert(out.end(), extra.begin() + i, extra.end());
+	extra.swap(out);
+}
+
+/** finoffsetʒunoCgAfoutɃRs[. */
+bool CopyRange(FILE* fin, uint64 offset, uint64 n, FILE* fout, vector<char>& buf)
+{
+	_fseeki64(fin, offset, SEEK_SET);
+	while (n > 0) {
+		size_t len = (size_t) (n < buf.size() ? n : buf.size());
+		if (fread(&buf[0], 1, len, fin) != len || fwrite(&buf[0], 1, len, fout) != len)
+			return false;
+		n -= len;
+	}
+	return true;
+}
+
+/** Ggԍ local header ̈ʒuɕׂ. */
+class LocalOrder {
+	const vector<CentralDirEntry>& mEntries;
+public:
+	explicit LocalOrder(const vector<CentralDirEntry>& entries) : mEntries(entries) {}
+
+	bool operator()(size_t a, size_t b) const {
+		return mEntries[a].local_header_offset < mEntries[b].local_header_offset;
+	}
+};
+
+/** č\̒fBNg̃Gg.
+ * ZIP64ǵAVItZbgɍ킹č蒼.
+ */
+void MakeCentralHeader(vector<uchar>& h, const CentralDirEntry& e, uint64 offset)
+{
+	vector<uchar> extra = e.extra;
+	RemoveExtraField(extra, 0x0001);
+	vector<uchar> zip64;
+	if (e.uncompressed_size >= 0xffffffff)	Put64(zip64, e.uncompressed_size);
+	if (e.compressed_size >= 0xffffffff)	Put64(zip64, e.compressed_size);
+	if (offset >= 0xffffffff)				Put64(zip64, offset);
+	if (!zip64.empty()) {
+		vector<uchar> field;
+		Put16(field, 0x0001);
+		Put16(field, (uint16) zip64.size());
+		field.insert(field.end(), zip64.begin(), zip64.end());
+		extra.insert(extra.begin(), field.begin(), field.end());
+	}
+	uint16 version_needed = e.version_needed;
+	if (!zip64.empty() && version_needed < 45)
+		version_needed = 45;
+
+	h.clear();
+	Put32(h, 0x02014b50);
+	Put16(h, e.version_made);
+	Put16(h, version_needed);
+	Put16(h, e.flags);
+	Put16(h, e.method);
+	Put16(h, e.mod_time);
+	Put16(h, e.mod_date);
+	Put32(h, e.crc);
+	Put32(h, (uint32) (e.compressed_size   < 0xffffffff ? e.compressed_size   : 0xffffffff));
+	Put32(h, (uint32) (e.uncompressed_size < 0xffffffff ? e.uncompressed_size : 0xffffffff));
+	Put16(h, (uint16) e.name.size());
+	Put16(h, (uint16) extra.size());
+	Put16(h, (uint16) e.comment.size());
+	Put16(h, 0);	// disk number start: Pt@Cɍč\.
+	Put16(h, e.internal_attr);
+	Put32(h, e.external_attr);
+	Put32(h, (uint32) (offset < 0xffffffff ? offset : 0xffffffff));
+	h.insert(h.end(), e.name.begin(), e.name.end());
+	h.insert(h.end(), extra.begin(), extra.end());
+	h.insert(h.end(), e.comment.begin(), e.comment.end());
+}
+
+/** fBNg̏I[R[h. KvȂ Zip64 end of central directory record  locator Ou. */
+void MakeEndOfCentralDirectory(vector<uchar>& h, uint64 entries, uint64 dir_offset, uint64 dir_size, const string& comment)
+{
+	h.clear();
+	if (entries >= 0xffff || dir_size >= 0xffffffff || dir_offset >= 0xffffffff) {
+		uint64 zip64_offset = dir_offset + dir_size;
+		Put32(h, 0x06064b50);
+		Put64(h, 44);		// size of zip64 end of central directory record
+		Put16(h, 45);		// version made by
+		Put16(h, 45);		// version needed to extract
+		Put32(h, 0);		// number of this disk
+		Put32(h, 0);		// number of the disk with the start of the central directory
+		Put64(h, entries);
+		Put64(h, entries);
+		Put64(h, dir_size);
+		Put64(h, dir_offset);
+		Put32(h, 0x07064b50);
+		Put32(h, 0);
+		Put64(h, zip64_offset);
+		Put32(h, 1);		// total number of disks
+	}
+	Put32(h, 0x06054b50);
+	Put16(h, 0);
+	Put16(h, 0);
+	Put16(h, (uint16) (entries < 0xffff ? entries : 0xffff));
+	Put16(h, (uint16) (entries < 0xffff ? entries : 0xffff));
+	Put32(h, (uint32) (dir_size   < 0xffffffff ? dir_size   : 0xffffffff));
+	Put32(h, (uint32) (dir_offset < 0xffffffff ? dir_offset : 0xffffffff));
+	Put16(h, (uint16) comment.size());
+	h.insert(h.end(), comment.begin(), comment.end());
+}
+
+/** ̃pXt@Cw? \L̈Ⴂn[hNA{[ƃt@CIDŌ. */
+bool IsSameFile(const char* path1, const char* path2)
+{
+	RandomFile f1, f2;
+	FileStamp st1, st2;
+	return f1.OpenRead(path1) && f2.OpenRead(path2) && f1.Stamp(st1) && f2.Stamp(st2)
+		&& st1.volume == st2.volume && st1.file_id == st2.file_id;
+}
+
+/** finAkf[^ĈkɃRs[ gRepackFile ɍč\.
+ * fBNgQƂĂȂ̈(Ԃsf[^)͎̂āA
+ * kGg̃f[^JnʒúAlocal header  extra field  gRepackAlign ̔{ɐ񂷂.
+ * fBNgEOCD͍蒼.
+ */
+void ZipRepackFile(FILE* fin, const char* fname)
+{
+	CentralDirReader reader;
+	if (!reader.Open(fin)) {
+		gDiag.Report(DIAG_ERROR, "no end of central directory", "%s: End of central directory record is not found", fname);
+		return;
+	}
+	vector<CentralDirEntry> entries;
+	CentralDirEntry e;
+	while (reader.Next(e))
+		entries.push_back(e);
+	const CentralDirInfo info = reader.Info();
+
+	string comment;
+	uchar eocd[22];
+	_fseeki64(fin, info.eocd_offset, SEEK_SET);
+	if (fread(eocd, 1, sizeof(eocd), fin) == sizeof(eocd)) {
+		comment.resize(Get16(eocd+20));
+		if (!comment.empty() && fread(&comment[0], 1, comment.size(), fin) != comment.size())
+			comment.clear();
+	}
+
+	if (IsSameFile(fname, gRepackFile)) {
+		gDiag.Report(DIAG_ERROR, "output file is the input file", "%s: can't repack a file onto itself", fname);
+		return;
+	}
+	FILE* fout = fopen(gRepackFile, "wb");
+	if (fout == NULL) {
+		gDiag.Report(DIAG_ERROR, "can't open output file", "can't open output file: %s", gRepackFile);
+		return;
+	}
+	setvbuf(fout, NULL, _IOFBF, REPACK_COPY_SIZE);
+	vector<char> buf(REPACK_COPY_SIZE);
+
+	//--- eGg̕яɃRs[. ͂̓t@C̐擪珇ɓǂݐi.
+	const uint64 SKIPPED = ~(uint64)0;
+	vector<size_t> order(entries.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	sort(order.begin(), order.end(), LocalOrder(entries));
+	vector<uint64> new_offset(entries.size(), SKIPPED);
+	uint64 pos = 0, aligned = 0, errors = 0;
+	for (size_t i = 0; i < order.size(); ++i) {
+		const CentralDirEntry& e = entries[order[i]];
+		uchar h[30];
+		_fseeki64(fin, e.local_header_offset, SEEK_SET);
+		if (fread(h, 1, sizeof(h), fin) != sizeof(h) || Get32(h) != 0x04034b50) {
+			gDiag.Report(DIAG_WARNING, "bad local file header", "%s: %s: bad local file header, skipped", fname, e.name.c_str());
+			++errors;
+			continue;
+		}
+		vector<uchar> name(Get16(h+26)), extra(Get16(h+28));
+		if ((!name.empty() && fread(&name[0], 1, name.size(), fin) != name.size())
+		 || (!extra.empty() && fread(&extra[0], 1, extra.size(), fin) != extra.size())) {
+			gDiag.Report(DIAG_WARNING, "bad local file header", "%s: %s: bad local file header, skipped", fname, e.name.c_str());
+			++errors;
+			continue;
+		}
+		uint64 data_offset = e.local_header_offset + sizeof(h) + name.size() + extra.size();
+		uint64 data_size = e.compressed_size + DataDescriptorSize(fin, h, data_offset + e.compressed_size);
+
+		if (e.method == 0 && gRepackAlign > 1) {
+			vector<uchar> padded = extra;
+			RemoveExtraField(padded, ALIGNMENT_EXTRA_TAG);
+			uint64 data = pos + sizeof(h) + name.size() + padded.size() + 6;
+			size_t pad = (size_t) ((gRepackAlign - data % gRepackAlign) % gRepackAlign);
+			Put16(padded, ALIGNMENT_EXTRA_TAG);
+			Put16(padded, (uint16) (2 + pad));
+			Put16(padded, (uint16) gRepackAlign);
+			padded.insert(padded.end(), pad, 0);
+			if (padded.size() <= 0xffff) {
+				extra.swap(padded);
+				++aligned;
+			}
+		}
+		h[28] = (uchar) extra.size();
+		h[29] = (uchar) (extra.size() >> 8);
+
+		new_offset[order[i]] = pos;
+		fwrite(h, 1, sizeof(h), fout);
+		if (!name.empty())
+			fwrite(&name[0], 1, name.size(), fout);
+		if (!extra.empty())
+			fwrite(&extra[0], 1, extra.size(), fout);
+		if (!CopyRange(fin, data_offset, data_size, fout, buf)) {
+			// r܂ł̃GgwfBNgȂ悤ɁAo͂̂Ă.
+			gDiag.Report(DIAG_ERROR, "read/write error", "%s: %s: read/write error", fname, e.name.c_str());
+			fclose(fout);
+			remove(gRepackFile);
+			return;
+		}
+		pos += sizeof(h) + name.size() + extra.size() + data_size;
+	}
+
+	//--- fBNgEOCDÃGgɍ蒼.
+	const uint64 dir_offset = pos;
+	uint64 count = 0;
+	vector<uchar> h;
+	for (size_t i = 0; i < entries.size(); ++i) {
+		if (new_offset[i] == SKIPPED)
+			continue;
+		MakeCentralHeader(h, entries[i], new_offset[i]);
+		fwrite(&h[0], 1, h.size(), fout);
+		pos += h.size();
+		++count;
+	}
+	MakeEndOfCentralDirectory(h, count, dir_offset, pos - dir_offset, comment);
+	fwrite(&h[0], 1, h.size(), fout);
+	pos += h.size();
+
+	if (ferror(fout) || fclose(fout) != 0) {
+		gDiag.SysError("can't write output file", gRepackFile);
+		remove(gRepackFile);
+		return;
+	}
+	printf("%s: repacked %llu entries to %s, %llu -> %llu bytes, %llu entries aligned to %u, %llu errors\n",
+		fname, count, gRepackFile, (uint64) info.file_size, pos, aligned, gRepackAlign, errors);
+}
+//@}
+
+//........................................................................
+//!@name --extract: WJ.
+//@{
+/** WJΏۂ̃Gg */
+struct ExtractEntry {
+	uint64 local_header_offset;
+	uint64 span_end;	///< ̃Gg߂͈͂̏I[. ̃Gg local headerA܂͒fBNg̈ʒu.
+	uint64 csize;		///< kTCY.
+	uint64 usize;		///< 񈳏kTCY.
+	uint64 mtime;		///< XV(FILETIMEl).
+	uint32 crc;
+	uint16 method;
+	uint16 flags;
+	size_t seq;			///< fBNg̏. --manifest ̃nbVl̊i[ʒuɎg.
+	string path;		///< o͐pX. --manifest ł̓Gg.
+};
+
+/** WJɁA܂Ƃ߂ĈTaskŏGg̏.
+ * ߂͈͂EXTRACT_SMALL_SIZẼGgAǂݏo͈͂EXTRACT_BATCH_BYTESɎ܂܂ł܂Ƃ߂.
+ * ܂Ƃ߂Gg͈̓ǂݏoōςނ̂ŁAVXeR[Task̉񐔂点.
+ */
+enum {
+	EXTRACT_SMALL_SIZE  = 0x10000,
+	EXTRACT_BATCH_BYTES = 0x100000,
+	EXTRACT_BATCH_COUNT = 256,
+};
+
+/** WJ̋L */
+class ExtractContext {
+public:
+	const char* zipname;	///< ̓t@C.
+	RandomFile in;			///< ̓t@C. eTaskʒuwŕsɓǂݏo.
+	vector<string>* digests;	///< --manifest Ȃ΁AWJSHA-256lGgɊi[. eTask͎̃Gg̗vf.
+	Mutex mutex;			///< ȉ̃JE^ی삷.
+	uint64 files;			///< WJt@C.
+	uint64 bytes;			///< WJoCg.
+	uint64 errors;			///< G[.
+
+	explicit ExtractContext(const char* fname, vector<string>* digest_list = NULL)
+		: zipname(fname), digests(digest_list), files(0), bytes(0), errors(0) {}
+
+	/** G[񍐂. o͂ gDiag ɔCATask҂Ȃ.
+	 * @param msg	G[e. G[̎ނƂďWv̂ŁA񃊃en.
+	 */
+	void Error(const string& path, const char* msg) {
+		{
+			Lock lock(mutex);
+			++errors;
+		}
+		gDiag.Report(DIAG_ERROR, msg, "%s: %s: %s", zipname, path.c_str(), msg);
+	}
+
+	/** WJL^. */
+	void Done(const ExtractEntry& e) {
+		Lock lock(mutex);
+		++files;
+		bytes += e.usize;
+	}
+};
+
+/** ̈kf[^͌Ƃ */
+class MemorySource : public InflateSource {
+	const uchar* mData;
+	size_t mRest;
+public:
+	MemorySource(const uchar* data, size_t n) : mData(data), mRest(n) {}
+
+	virtual size_t Read(void* buf, size_t n) {
+		if (n > mRest)
+			n = mRest;
+		memcpy(buf, mData, n);
+		mData += n;
+		mRest -= n;
+		return n;
+	}
+};
+
+/** t@C̎w͈͂̈kf[^͌Ƃ */
+class FileRangeSource : public InflateSource {
+	const RandomFile& mFile;
+	uint64 mPos;
+	uint64 mRest;
+public:
+	FileRangeSource(const RandomFile& file, uint64 offset, uint64 n) : mFile(file), mPos(offset), mRest(n) {}
+
+	virtual size_t Read(void* buf, size_t n) {
+		if (n > mRest)
+			n = (size_t) mRest;
+		n = mFile.ReadAt(buf, n, mPos);
+		mPos += n;
+		mRest -= n;
+		return n;
+	}
+};
+
+/** WJf[^t@CɏoACRC-32ƃTCY߂ */
+class ExtractSink : public InflateSink {
+	RandomFile& mFile;
+public:
+	uint32 crc;
+	uint64 size;
+
+	explicit ExtractSink(RandomFile& file) : mFile(file), crc(0), size(0) {}
+
+	virtual bool Write(const void* data, size_t n) {
+		crc = crc32(data, n, crc);
+		size += n;
+		return mFile.Write(data, n);
+	}
+};
+
+/** WJf[^SHA-256lACRC-32ƃTCY߂ */
+class DigestSink : public InflateSink {
+public:
+	Sha256 sha;
+	uint32 crc;
+	uint64 size;
+
+	DigestSink() : crc(0), size(0) {}
+
+	virtual bool Write(const void* data, size_t n) {
+		sha.Update(data, n);
+		crc = crc32(data, n, crc);
+		size += n;
+		return true;
+	}
+};
+
+/** GgAWJtH_̃pXɕϊ.
+ * WJ̊O֏oƂ悤ɁA΃pXAhCuwA".." ܂ޖO͋ۂ.
+ * @param path	pX̊i[.
+ * @param e		Gg.
+ * @retval false	ۂ.
+ */
+bool MakeExtractPath(string& path, const CentralDirEntry& e)
+{
+	string name = e.name;
+#ifdef _WIN32
+	if (e.flags & 0x0800) {
+		// Bit 11: UTF-8 Ȃ̂ŁAANSIR[hy[Wɕϊ.
+		int n = ::MultiByteToWideChar(CP_UTF8, 0, name.data(), (int) name.size(), NULL, 0);
+		if (n > 0) {
+			vector<wchar_t> w(n);
+			::MultiByteToWideChar(CP_UTF8, 0, name.data(), (int) name.size(), &w[0], n);
+			int m = ::WideCharToMultiByte(CP_ACP, 0, &w[0], n, NULL, 0, NULL, NULL);
+			if (m > 0) {
+				name.resize(m);
+				::WideCharToMultiByte(CP_ACP, 0, &w[0], n, &name[0], m, NULL, NULL);
+			}
+		}
+	}
+#endif
+	path = gExtractDir;
+	if (pathname_needs_sep(path.data(), path.size()))
+		path += MY_PATH_SEP;
+	size_t base_len = path.size();
+	const char* p = name.c_str();
+	const char* last = p + name.size();
+	while (p < last) {
+		// VtgJIS2oCgڂ '\' ؂LƌFȂ悤ɁAPʂŐi߂.
+		const char* end = p;
+		while (end < last && *end != '/' && *end != '\\')
+			end = mbs_next(end);
+		if (end > last)
+			end = last;
+		string comp(p, end);
+		p = (end < last) ? end + 1 : last;
+		if (comp.empty() || comp == ".")
+			continue;
+		if (comp == ".." || comp.find(':') != string::npos)
+			return false;
+		if (path.size() > base_len)
+			path += MY_PATH_SEP;
+		path += comp;
+	}
+	return path.size() > base_len;
+}
+
+/** WJpX̐etH_A쐬ׂtH_Ƃēo^. */
+void AddParentFolders(set<string>& folders, const string& path, size_t base_len)
+{
+	const char* top = path.c_str();
+	const char* end = top + path.size();
+	for (const char* p = top + base_len; p < end; p = mbs_next(p)) {
+		if (*p == MY_PATH_SEP)
+			folders.insert(string(top, p));
+	}
+}
+
+/** WJpXGǵÂ̂c.
+ * t@C֕sɏ܂Ȃ悤ɂ邽. ㏑ÕGg͌xĎ̂Ă.
+ */
+void RemoveDuplicatePaths(vector<ExtractEntry>& entries, const char* fname)
+{
+	map<string, size_t> last;
+	string key;
+	for (size_t i = 0; i < entries.size(); ++i) {
+		filename_key(entries[i].path.c_str(), key);
+		last[key] = i;
+	}
+	if (last.size() == entries.size())
+		return;
+	vector<ExtractEntry> unique;
+	unique.reserve(last.size());
+	for (size_t i = 0; i < entries.size(); ++i) {
+		filename_key(entries[i].path.c_str(), key);
+		if (last[key] != i) {
+			gDiag.Report(DIAG_WARNING, "duplicate entry name", "%s: %s: duplicate entry name, skipped", fname, entries[i].path.c_str());
+			continue;
+		}
+		unique.push_back(entries[i]);
+		unique.back().seq = unique.size() - 1;
+	}
+	entries.swap(unique);
+}
+
+/** deflate ̈k̏. kTCŶ̔{z񈳏kTCÝAꂽ׍Hꂽlł. */
+enum { DEFLATE_MAX_RATIO = 1032 };
+
+/** WJf[^A񈳏kTCYzȂ͈͂ŕʂ sink ɓn.
+ * ׍HꂽGgfBXN𖄂ߐsOɁAWJł؂邽.
+ */
+class LimitedSink : public InflateSink {
+	InflateSink& mSink;
+	uint64 mRest;
+public:
+	bool exceeded;	///< 񈳏kTCYz?
+
+	LimitedSink(InflateSink& sink, uint64 limit) : mSink(sink), mRest(limit), exceeded(false) {}
+
+	virtual bool Write(const void* data, size_t n) {
+		if (n > mRest) {
+			exceeded = true;
+			return false;
+		}
+		mRest -= n;
+		return mSink.Write(data, n);
+	}
+};
+
+/** kf[^WJ sink ɓn. kȂ΂̂܂ܓn.
+ * 񈳏kTCYzȂ΁A̎_őł؂.
+ * @retval false	s. G[͕񍐍ς.
+ */
+bool DecodeEntry(ExtractContext& ctx, const ExtractEntry& e, InflateSource& src, Inflater& inflater, InflateSink& sink)
+{
+	LimitedSink limited(sink, e.usize);
+	bool ok = true;
+	if (e.method == 0) {
+		char buf[0x10000];
+		size_t n;
+		while (ok && (n = src.Read(buf, sizeof(buf))) > 0)
+			ok = limited.Write(buf, n);
+	}
+	else
+		ok = inflater.Inflate(src, limited);
+	if (!ok)
+		ctx.Error(e.path, limited.exceeded ? "size mismatch" : e.method == 0 ? "write error" : inflater.Error());
+	return ok;
+}
+
+/** WJʂ̃TCYCRC-32. */
+bool VerifyEntry(ExtractContext& ctx, const ExtractEntry& e, uint64 size, uint32 crc)
+{
+	if (size != e.usize)
+		ctx.Error(e.path, "size mismatch");
+	else if (crc != e.crc)
+		ctx.Error(e.path, "crc-32 mismatch");
+	else
+		return true;
+	return false;
+}
+
+/** ̃GgWJ. --manifest Ȃ΁AWJSHA-256l߂.
+ * @param ctx	L.
+ * @param e		Gg.
+ * @param src	kf[^̓͌.
+ * @param inflater	deflateWJɎgfR[_.
+ */
+void ExtractOne(ExtractContext& ctx, const ExtractEntry& e, InflateSource& src, Inflater& inflater)
+{
+	if (ctx.digests) {
+		// WJf[^͗ĂɃnbV̂ŁA傫ȃGgłŜɒuȂ.
+		DigestSink sink;
+		if (!DecodeEntry(ctx, e, src, inflater, sink) || !VerifyEntry(ctx, e, sink.size, sink.crc))
+			return;
+		uchar digest[32];
+		sink.sha.Final(digest);
+		char hex[65];
+		for (int i = 0; i < 32; ++i)
+			sprintf(hex + i*2, "%02x", digest[i]);
+		(*ctx.digests)[e.seq] = hex;
+		ctx.Done(e);
+		return;
+	}
+
+	RandomFile out;
+	if (!out.Create(e.path.c_str())) {
+		ctx.Error(e.path, "can't create file");
+		return;
+	}
+	// ̗̈\́AkTCYL蓾傫܂łƂ. zGg͓WJɑł؂.
+	if (e.usize && e.usize / DEFLATE_MAX_RATIO <= e.csize)
+		out.Preallocate(e.usize);
+
+	ExtractSink sink(out);
+	if (!DecodeEntry(ctx, e, src, inflater, sink) || !VerifyEntry(ctx, e, sink.size, sink.crc)) {
+		// r܂ł̓e\񂵂܂܂̗̈cȂ悤ɁAo͂̂Ă.
+		out.Close();
+		remove(e.path.c_str());
+		return;
+	}
+	ctx.Done(e);
+	if (e.mtime)
+		out.SetTime(e.mtime);
+}
+
+/** Gg̃f[^JnʒuAlocal header 狁߂.
+ * @param h		local header ̐擪30oCg.
+ * @retval 0	local header Ă.
+ */
+uint64 LocalDataOffset(const uchar* h, const ExtractEntry& e)
+{
+	if (Get32(h) != 0x04034b50)
+		return 0;
+	return e.local_header_offset + 30 + Get16(h+26) + Get16(h+28);
+}
+
+/** 傫ȃGgWJTask. kf[^̓t@C班ǂݏo. */
+class ExtractLargeTask : public Task {
+	ExtractContext& mCtx;
+	const ExtractEntry& mEntry;
+public:
+	ExtractLargeTask(ExtractContext& ctx, const ExtractEntry& e) : mCtx(ctx), mEntry(e) {}
+
+	virtual void Run() {
+		uchar h[30];
+		uint64 data = 0;
+		if (mCtx.in.ReadAt(h, sizeof(h), mEntry.local_header_offset) == sizeof(h))
+			data = LocalDataOffset(h, mEntry);
+		if (data == 0) {
+			mCtx.Error(mEntry.path, "bad local file header");
+			return;
+		}
+		Inflater* inflater = new Inflater;
+		FileRangeSource src(mCtx.in, data, mEntry.csize);
+		ExtractOne(mCtx, mEntry, src, *inflater);
+		delete inflater;
+	}
+};
+
+/** אڂ鏬ȃGg܂Ƃ߂ēWJTask. ͈͑ŜxɓǂݏoĂWJ. */
+class ExtractBatchTask : public Task {
+	ExtractContext& mCtx;
+	vector<const ExtractEntry*> mEntries;
+public:
+	ExtractBatchTask(ExtractContext& ctx, const vector<const ExtractEntry*>& entries) : mCtx(ctx), mEntries(entries) {}
+
+	virtual void Run() {
+		uint64 base = mEntries.front()->local_header_offset;
+		size_t len = (size_t) (mEntries.back()->span_end - base);
+		vector<uchar> buf(len + 1);
+		len = mCtx.in.ReadAt(&buf[0], len, base);
+
+		Inflater* inflater = new Inflater;
+		for (size_t i = 0; i < mEntries.size(); ++i) {
+			const ExtractEntry& e = *mEntries[i];
+			size_t pos = (size_t) (e.local_header_offset - base);
+			uint64 data = pos + 30 <= len ? LocalDataOffset(&buf[pos], e) : 0;
+			if (data == 0 || data - base + e.csize > len) {
+				mCtx.Error(e.path, "bad local file header");
+				continue;
+			}
+			MemorySource src(&buf[(size_t) (data - base)], (size_t) e.csize);
+			ExtractOne(mCtx, e, src, *inflater);
+		}
+		delete inflater;
+	}
+};
+
+/** kTCY̍~ɕׂ. 傫Ȃ̂ɏāAXbhԂׂ̕ς. */
+bool LargerEntry(const ExtractEntry* a, const ExtractEntry* b)
+{
+	return a->csize > b->csize;
+}
+
+/** local header ̈ʒuɕׂ. */
+bool EarlierEntry(const ExtractEntry* a, const ExtractEntry* b)
+{
+	return a->local_header_offset < b->local_header_offset;
+}
+
+/** eGgWJTaskAXbhv[Ŏs.
+ * 傫ȃGg͒PƂŁAȃGg͗אڂ̂܂Ƃ߂āA[J[XbhɊU.
+ * @param dir_offset	fBNg̈ʒu. Ō̃Gg߂͈͂̏I[Ƃ.
+ * @return	[J[Xbh.
+ */
+int RunExtractTasks(ExtractContext& ctx, vector<ExtractEntry>& entries, uint64 dir_offset)
+{
+	//--- ʒuɕׂāAeGg߂͈͂̏I[߂.
+	vector<const ExtractEntry*> order;
+	for (size_t i = 0; i < entries.size(); ++i)
+		order.push_back(&entries[i]);
+	sort(order.begin(), order.end(), EarlierEntry);
+	for (size_t i = 0; i < order.size(); ++i) {
+		ExtractEntry* e = const_cast<ExtractEntry*>(order[i]);
+		e->span_end = (i + 1 < order.size()) ? order[i+1]->local_header_offset : dir_offset;
+		if (e->span_end < e->local_header_offset)
+			e->span_end = e->local_header_offset;
+	}
+
+	//--- 傫ȃGg͒PƂŁAȃGg͗אڂ̂܂Ƃ߂āA[J[XbhɊU.
+	ThreadPool pool(gThreads);
+	vector<const ExtractEntry*> large;
+	vector<const ExtractEntry*> batch;
+	vector<Task*> batches;
+	for (size_t i = 0; i < order.size(); ++i) {
+		const ExtractEntry* e = order[i];
+		if (e->span_end - e->local_header_offset >= EXTRACT_SMALL_SIZE) {
+			large.push_back(e);
+			continue;
+		}
+		if (!batch.empty() && (batch.size() >= EXTRACT_BATCH_COUNT
+			|| e->span_end - batch.front()->local_header_offset > EXTRACT_BATCH_BYTES)) {
+			batches.push_back(new ExtractBatchTask(ctx, batch));
+			batch.clear();
+		}
+		batch.push_back(e);
+	}
+	if (!batch.empty())
+		batches.push_back(new ExtractBatchTask(ctx, batch));
+	sort(large.begin(), large.end(), LargerEntry);
+	for (size_t i = 0; i < large.size(); ++i)
+		pool.Submit(new ExtractLargeTask(ctx, *large[i]));
+	for (size_t i = 0; i < batches.size(); ++i)
+		pool.Submit(batches[i]);
+	pool.Wait();
+	return pool.Size();
+}
+
+/** fin̑SGgAgExtractDir ȉɕWJ.
+ * fBNgSGg̈ʒuƃTCY𓾂āA[J[XbhɊU.
+ */
+void ZipExtractFile(FILE* fin, const char* fname)
+{
+	ExtractContext ctx(fname);
+	if (!ctx.in.OpenRead(fname)) {
+		gDiag.SysError("can't open input file", fname);
+		return;
+	}
+	CentralDirReader reader;
+	if (!reader.Open(fin)) {
+		gDiag.Report(DIAG_ERROR, "no end of central directory", "%s: End of central directory record is not found", fname);
+		return;
+	}
+
+	//--- fBNgWJΏۂW߁A쐬ׂtH_߂.
+	vector<ExtractEntry> entries;
+	set<string> folders;
+	size_t base_len = strlen(gExtractDir);
+	folders.insert(gExtractDir);
+	CentralDirEntry ce;
+	while (reader.Next(ce)) {
+		ExtractEntry e;
+		if (!MakeExtractPath(e.path, ce)) {
+			ctx.Error(ce.name, "unsafe path name, skipped");
+			continue;
+		}
+		AddParentFolders(folders, e.path, base_len);
+		char last = ce.name.empty() ? 0 : ce.name[ce.name.size()-1];
+		if (last == '/' || last == '\\') {
+			folders.insert(e.path);
+			continue;
+		}
+		if (ce.flags & 0x0001) {
+			ctx.Error(e.path, "encrypted entry is not supported");
+			continue;
+		}
+		if (ce.method != 0 && ce.method != 8) {
+			ctx.Error(e.path, "unsupported compression method");
+			continue;
+		}
+		e.local_header_offset = ce.local_header_offset;
+		e.csize  = ce.compressed_size;
+		e.usize  = ce.uncompressed_size;
+		e.crc    = ce.crc;
+		e.method = ce.method;
+		e.flags  = ce.flags;
+		e.mtime  = EntryModTime(ce);
+		e.seq    = entries.size();
+		entries.push_back(e);
+	}
+	RemoveDuplicatePaths(entries, fname);
+
+	//--- tH_쐬. etH_͎qtH_ɕԂ̂ŁAɍ쐬Ηǂ.
+	for (set<string>::const_iterator i = folders.begin(); i != folders.end(); ++i) {
+		if (!create_folder(i->c_str()))
+			ctx.Error(*i, "can't create folder");
+	}
+
+	int threads = RunExtractTasks(ctx, entries, reader.Info().dir_offset);
+	printf("%s: extracted %llu files (%llu bytes) to %s with %d threads, %llu errors\n",
+		fname, ctx.files, ctx.bytes, gExtractDir, threads, ctx.errors);
+}
+//@}
+
+//........................................................................
+//!@name --manifest: eSHA-256lꗗ.
+//@{
+/** ꗗ1s. */
+struct DigestLine {
+	const string* name;
+	const string* digest;
+
+	bool operator<(const DigestLine& r) const {
+		return *name < *r.name;
+	}
+};
+
+/** fin̑SGg̓WJeSHA-256lAOfout֏o͂.
+ * WJƓUŕXbhŕsɌvZ. WJf[^͏oɁAĂɃnbV.
+ * o͂ sha256sum Ɠ "nbVl<2>O" `Ȃ̂ŁAWJt@C sha256sum -c Ōł.
+ * @return	G[.
+ */
+uint64 ZipManifestFile(FILE* fin, const char* fname, FILE* fout)
+{
+	vector<string> digests;
+	ExtractContext ctx(fname, &digests);
+	if (!ctx.in.OpenRead(fname)) {
+		gDiag.SysError("can't open input file", fname);
+		return 1;
+	}
+	CentralDirReader reader;
+	if (!reader.Open(fin)) {
+		gDiag.Report(DIAG_ERROR, "no end of central directory", "%s: End of central directory record is not found", fname);
+		return 1;
+	}
+
+	//--- fBNgΏۃGgW߂. tH_͏.
+	vector<ExtractEntry> entries;
+	CentralDirEntry ce;
+	while (reader.Next(ce)) {
+		char last = ce.name.empty() ? 0 : ce.name[ce.name.size()-1];
+		if (last == '/' || last == '\\')
+			continue;
+		if (ce.flags & 0x0001) {
+			ctx.Error(ce.name, "encrypted entry is not supported");
+			continue;
+		}
+		if (ce.method != 0 && ce.method != 8) {
+			ctx.Error(ce.name, "unsupported compression method");
+			continue;
+		}
+		ExtractEntry e;
+		e.local_header_offset = ce.local_header_offset;
+		e.csize  = ce.compressed_size;
+		e.usize  = ce.uncompressed_size;
+		e.crc    = ce.crc;
+		e.method = ce.method;
+		e.flags  = ce.flags;
+		e.mtime  = 0;
+		e.seq    = entries.size();
+		e.path   = ce.name;
+		entries.push_back(e);
+	}
+	digests.resize(entries.size());
+	RunExtractTasks(ctx, entries, reader.Info().dir_offset);
+
+	//--- Oɏo͂. sGg̓nbVlȂ̂ŏ.
+	vector<DigestLine> lines;
+	for (size_t i = 0; i < entries.size(); ++i) {
+		if (digests[i].empty())
+			continue;
+		DigestLine line = { &entries[i].path, &digests[i] };
+		lines.push_back(line);
+	}
+	sort(lines.begin(), lines.end());
+	for (size_t i = 0; i < lines.size(); ++i) {
+		fprintf(fout, "%s  ", lines[i].digest->c_str());
+		Print_string(fout, *lines[i].name);
+	}
+	return ctx.errors;
+}
+//@}
+
+//........................................................................
+//!@name --serve: ₢킹T[o[.
+//@{
+/** HEXvňxɕԂőoCg. */
+const uint64 SERVE_HEX_LIMIT = 0x100000;
+
+/** ͍ς݂̒fBNg.
+ * LbVǂoꂽA̗vgI܂Ŏc悤ɎQƃJEgŎǗ.
+ */
+class ZipIndex {
+	volatile long mRef;
+
+	ZipIndex(const ZipIndex&);			// Rs[֎~.
+	void operator=(const ZipIndex&);	// ֎~.
+	~ZipIndex() {}
+public:
+	string path;						///< ̓t@C̊SpX.
+	__int64 mtime;						///< ͎̍XV.
+	uint64 size;						///< ͎̃t@CTCY.
+	vector<CentralDirEntry> entries;	///< fBNg̏̃Gg.
+	vector<uint32> by_name;				///< Oɕׂ entries ̓Y.
+	size_t cost;						///< TZgp.
+
+	ZipIndex() : mRef(1), mtime(0), size(0), cost(0) {}
+
+	void AddRef() {
+		atomic_increment(&mRef);
+	}
+	void Release() {
+		if (atomic_decrement(&mRef) == 0)
+			delete this;
+	}
+
+	/** OŃGgT. Ȃ NULL Ԃ. */
+	const CentralDirEntry* Find(const string& name) const;
+};
+
+/** ZipIndex::by_name ̕בւp */
+class IndexNameLess {
+	const vector<CentralDirEntry>& mEntries;
+public:
+	explicit IndexNameLess(const vector<CentralDirEntry>& entries) : mEntries(entries) {}
+
+	bool operator()(uint32 a, uint32 b) const {
+		return mEntries[a].name < mEntries[b].name;
+	}
+	bool operator()(uint32 a, const string& name) const {
+		return mEntries[a].name < name;
+	}
+};
+
+const CentralDirEntry* ZipIndex::Find(const string& name) const
+{
+	vector<uint32>::const_iterator i = lower_bound(by_name.begin(), by_name.end(), name, IndexNameLess(entries));
+	if (i == by_name.end() || entries[*i].name != name)
+		return NULL;
+	return &entries[*i];
+}
+
+/** ̓t@C̒fBNg͂.
+ * @param err	s̃G[bZ[W̊i[.
+ * @retval NULL	s.
+ */
+ZipIndex* LoadZipIndex(const string& path, const struct __stat64& st, string& err)
+{
+	FILE* fin = fopen(path.c_str(), "rb");
+	if (!fin) {
+		err = "can't open input file";
+		return NULL;
+	}
+	CentralDirReader reader;
+	if (!reader.Open(fin)) {
+		fclose(fin);
+		err = "End of central directory record is not found";
+		return NULL;
+	}
+	ZipIndex* index = new ZipIndex;
+	index->path  = path;
+	index->mtime = st.st_mtime;
+	index->size  = st.st_size;
+	index->cost  = sizeof(ZipIndex) + path.size();
+	CentralDirEntry e;
+	while (index->entries.size() < reader.Info().entries && reader.Next(e)) {
+		index->entries.push_back(e);
+		index->cost += sizeof(CentralDirEntry) + sizeof(uint32) + e.name.size() + e.extra.size() + e.comment.size();
+	}
+	fclose(fin);
+	for (uint32 i = 0; i < index->entries.size(); ++i)
+		index->by_name.push_back(i);
+	sort(index->by_name.begin(), index->by_name.end(), IndexNameLess(index->entries));
+	return index;
+}
+
+/** ͍ςݒfBNgLRULbV.
+ * TZgpʂ̍vzAłgĂȂ̂̂Ă.
+ * ̓t@C̍XVTCYςĂA͂.
+ */
+class ZipIndexCache {
+	typedef std::list<ZipIndex*> LruList;
+	typedef map<string, LruList::iterator> LruMap;
+
+	Mutex mMutex;			///< ȉ̑Soی삷.
+	LruList mLru;			///< ŋߎgꂽ. 擪ŐV.
+	LruMap mMap;			///< pX mLru ̈ʒu.
+	size_t mBudget;			///< gpʂ̏.
+	size_t mUsed;			///< LbV̊TZgp.
+	uint64 mHits;
+	uint64 mMisses;
+
+	ZipIndexCache(const ZipIndexCache&);	// Rs[֎~.
+	void operator=(const ZipIndexCache&);	// ֎~.
+public:
+	explicit ZipIndexCache(size_t budget)
+		: mBudget(budget), mUsed(0), mHits(0), mMisses(0) {}
+
+	~ZipIndexCache() {
+		for (LruList::iterator i = mLru.begin(); i != mLru.end(); ++i)
+			(*i)->Release();
+	}
+
+	/** ̓t@C͍̉ςݒfBNg𓾂.
+	 * gI Release() 邱.
+	 * @param err	s̃G[bZ[W̊i[.
+	 * @retval NULL	s.
+	 */
+	ZipIndex* Get(const char* fname, string& err);
+
+	/** v𕶎ɂ. */
+	string Stats();
+
+private:
+	/** mLru ̈ʒu i ̂̂LbVO. mMutex bNČĂԂ. */
+	void Remove(LruMap::iterator i) {
+		ZipIndex* index = *i->second;
+		mUsed -= index->cost;
+		mLru.erase(i->second);
+		mMap.erase(i);
+		index->Release();
+	}
+};
+
+ZipIndex* ZipIndexCache::Get(const char* fname, string& err)
+{
+	char fullpath[MY_MAX_PATH];
+	struct __stat64 st;
+	if (!_fullpath(fullpath, fname, sizeof(fullpath)) || _stat64(fullpath, &st) != 0) {
+		err = "can't open input file";
+		return NULL;
+	}
+	string path = fullpath;
+	{
+		Lock lock(mMutex);
+		LruMap::iterator i = mMap.find(path);
+		if (i != mMap.end()) {
+			ZipIndex* index = *i->second;
+			if (index->mtime == st.st_mtime && index->size == (uint64) st.st_size) {
+				++mHits;
+				mLru.splice(mLru.begin(), mLru, i->second);
+				index->AddRef();
+				return index;
+			}
+			Remove(i);	// XVꂽ̂Ŏ̂Ă.
+		}
+		++mMisses;
+	}
+
+	// ͂̓bN̊OōsA̗v҂Ȃ.
+	ZipIndex* index = LoadZipIndex(path, st, err);
+	if (!index)
+		return NULL;
+	if (index->cost > mBudget)
+		return index;	// ẑ̓LbVȂ.
+
+	Lock lock(mMutex);
+	LruMap::iterator i = mMap.find(path);
+	if (i != mMap.end())
+		Remove(i);	// sĉ͂ꂽ̂́AVŒu.
+	while (!mLru.empty() && mUsed + index->cost > mBudget)
+		Remove(mMap.find(mLru.back()->path));
+	mLru.push_front(index);
+	mMap[path] = mLru.begin();
+	mUsed += index->cost;
+	index->AddRef();
+	return index;
+}
+
+string ZipIndexCache::Stats()
+{
+	Lock lock(mMutex);
+	char buf[200];
+	sprintf(buf, "files %u\nbytes %llu\nbudget %llu\nhits %llu\nmisses %llu\n",
+		(uint) mLru.size(), (uint64) mUsed, (uint64) mBudget, mHits, mMisses);
+	return buf;
+}
+
+/** R[h ^@ `ŃGXP[vĒǉ. */
+void AppendVisible(string& s, const string& a)
+{
+	for (size_t i = 0; i < a.size(); ++i) {
+		int c = (uchar) a[i];
+		if (iscntrl(c)) {
+			s += '^';
+			s += (char) (c + '@');
+		}
+		else {
+			s += (char) c;
+		}
+	}
+}
+
+/** wŒǉ. ̒ǉ1000Ƃ邱. */
+void Appendf(string& s, const char* fmt, ...)
+{
+	char buf[1000];
+	va_list ap;
+	va_start(ap, fmt);
+	_vsnprintf(buf, sizeof(buf) - 1, fmt, ap);
+	va_end(ap);
+	buf[sizeof(buf) - 1] = '\0';
+	s += buf;
+}
+
+/** LIST v: Ggꗗ𒆉fBNg̏ŕԂ.  -l Ɠ. */
+void Serve_list(const ZipIndex& index, string& out)
+{
+	Appendf(out, "%12s %12s %12s %6s %8s  %s\n", "offset", "size", "compressed", "method", "crc-32", "name");
+	for (size_t i = 0; i < index.entries.size(); ++i) {
+		const CentralDirEntry& e = index.entries[i];
+		Appendf(out, "%12llu %12llu %12llu %6u %08X  ",
+			e.local_header_offset, e.uncompressed_size, e.compressed_size, e.method, e.crc);
+		AppendVisible(out, e.name);
+		out += '\n';
+	}
+}
+
+/** STAT v: ̃Gg̏Ԃ. */
+void Serve_stat(const CentralDirEntry& e, string& out)
+{
+	out += "name : ";
+	AppendVisible(out, e.name);
+	out += '\n';
+	Appendf(out, "central header offset : %llu\n", (uint64) e.offset);
+	Appendf(out, "local header offset : %llu\n", e.local_header_offset);
+	Appendf(out, "version made by : 0x%04X\n", e.version_made);
+	Appendf(out, "version needed : 0x%04X\n", e.version_needed);
+	Appendf(out, "flags : 0x%04X\n", e.flags);
+	Appendf(out, "method : %u\n", e.method);
+	Appendf(out, "modified : %04u-%02u-%02u %02u:%02u:%02u\n",
+		1980 + (e.mod_date >> 9), (e.mod_date >> 5) & 15, e.mod_date & 31,
+		e.mod_time >> 11, (e.mod_time >> 5) & 63, (e.mod_time & 31) * 2);
+	Appendf(out, "crc-32 : 0x%08X\n", e.crc);
+	Appendf(out, "compressed size : %llu\n", e.compressed_size);
+	Appendf(out, "uncompressed size : %llu\n", e.uncompressed_size);
+	Appendf(out, "internal attributes : 0x%04X\n", e.internal_attr);
+	Appendf(out, "external attributes : 0x%08X\n", e.external_attr);
+	Appendf(out, "extra field length : %u\n", (uint) e.extra.size());
+	out += "comment : ";
+	AppendVisible(out, e.comment);
+	out += '\n';
+}
+
+/** HEX v: ̓t@C offset  length oCg_v.  -f ̃oCg_vƓ. */
+bool Serve_hex(const char* fname, uint64 offset, uint64 length, string& out)
+{
+	RandomFile in;
+	if (!in.OpenRead(fname))
+		return false;
+	vector<uchar> buf((size_t) length);
+	size_t n = length ? in.ReadAt(&buf[0], (size_t) length, offset) : 0;
+	for (size_t i = 0; i < n; i += 16) {
+		char hex_dump[16*3+1] = "";
+		char ascii_dump[16+1] = "";
+		for (size_t j = 0; j < 16 && i + j < n; ++j) {
+			sprintf(hex_dump + j*3, "%02X%c", buf[i+j], j==7 ? '-' : ' ');
+			ascii_dump[j] = ascii(buf[i+j]);
+			ascii_dump[j+1] = '\0';
+		}
+		Appendf(out, "+%08llX : %-48s:%-16s\n", offset + i, hex_dump, ascii_dump);
+	}
+	return true;
+}
+
+/** ₢킹T[o[̋L */
+class ServerContext {
+public:
+	const char* pipename;
+	ZipIndexCache cache;
+	volatile long quit;		///< Iv󂯂1.
+
+	ServerContext(const char* name, size_t budget)
+		: pipename(name), cache(budget), quit(0) {}
+};
+
+/** 1̗v.
+ * v TAB ؂1sŁAR}hƈȂ.
+ * - LIST <zip>
+ * - STAT <zip> <entry-name>
+ * - HEX <zip> <offset> <length>
+ * - STATS
+ * - QUIT
+ * @param out	{̊i[.
+ * @retval false	s. out ̓G[bZ[WƂ.
+ */
+bool ServeRequest(ServerContext& ctx, const vector<string>& args, string& out)
+{
+	const string& cmd = args[0];
+	if (cmd == "STATS" && args.size() == 1) {
+		out = ctx.cache.Stats();
+		return true;
+	}
+	if (cmd == "QUIT" && args.size() == 1) {
+		atomic_exchange(&ctx.quit, 1);
+		return true;
+	}
+	if (cmd == "HEX" && args.size() == 4) {
+		uint64 offset = _strtoui64(args[2].c_str(), NULL, 0);
+		uint64 length = _strtoui64(args[3].c_str(), NULL, 0);
+		if (length > SERVE_HEX_LIMIT) {
+			out = "length is too large";
+			return false;
+		}
+		if (!Serve_hex(args[1].c_str(), offset, length, out)) {
+			out = "can't open input file";
+			return false;
+		}
+		return true;
+	}
+	if ((cmd == "LIST" && args.size() == 2) || (cmd == "STAT" && args.size() == 3)) {
+		ZipIndex* index = ctx.cache.Get(args[1].c_str(), out);
+		if (!index)
+			return false;
+		bool ok = true;
+		if (cmd == "LIST") {
+			Serve_list(*index, out);
+		}
+		else if (const CentralDirEntry* e = index->Find(args[2])) {
+			Serve_stat(*e, out);
+		}
+		else {
+			out = "entry is not found";
+			ok = false;
+		}
+		index->Release();
+		return ok;
+	}
+	out = "bad request";
+	return false;
+}
+
+/** 1̗v̏. */
+struct ServeReply {
+	bool ok;
+	string body;
+	Event done;		///< IVOiԂɂȂ.
+
+	ServeReply() : ok(false) {}
+};
+
+/** 1̗vTask. ʂ͐ڑ ServeReply ɏ. */
+class ServeRequestTask : public Task {
+	ServerContext& mCtx;
+	const vector<string>& mArgs;
+	ServeReply& mReply;
+public:
+	ServeRequestTask(ServerContext& ctx, const vector<string>& args, ServeReply& reply)
+		: mCtx(ctx), mArgs(args), mReply(reply) {}
+
+	virtual void Run() {
+		mReply.ok = ServeRequest(mCtx, mArgs, mReply.body);
+		mReply.done.Set();
+	}
+};
+
+/** ̃NCAgڑ.
+ * ڑɐp̃Xbhŗvǂ݁Av̏Xbhv[ɔC.
+ * ҋ@̃NCAg[J[XbhǂȂ̂ŁAVڑ QUIT vł.
+ *  "OK <n>\n" ܂ "ERR <n>\n" ̌ n oCg̖{𑱂.
+ */
+class ServeConnection {
+	ServerContext& mCtx;
+	ThreadPool& mPool;
+	PipeStream mPipe;
+	Thread mThread;
+	volatile long mFinished;	///< ڑ؂ăXbhIƂȂ1.
+
+	ServeConnection(const ServeConnection&);	// Rs[֎~.
+	void operator=(const ServeConnection&);		// ֎~.
+public:
+	ServeConnection(ServerContext& ctx, ThreadPool& pool, PipeHandle h)
+		: mCtx(ctx), mPool(pool), mPipe(h, true), mFinished(0) {}
+
+	/** ڑXbhN. */
+	bool Start() {
+		return mThread.Start(ThreadMain, this);
+	}
+
+	/** XbhIƂ납? Join() ͂ɖ߂. */
+	bool IsFinished() const {
+		return mFinished != 0;
+	}
+
+	/** v҂Ăڑ̓ǂݏoł؂.
+	 * @retval false	ł؂Ȃ. 肪ؒf܂ŃXbh͏IȂ.
+	 */
+	bool Shutdown() {
+		return mPipe.Shutdown();
+	}
+
+	/** Xbh̏I҂. */
+	void Join() {
+		mThread.Join();
+	}
+
+private:
+	static void ThreadMain(void* arg) {
+		ServeConnection* self = (ServeConnection*) arg;
+		self->Run();
+		atomic_exchange(&self->mFinished, 1);
+	}
+
+	/** ڑ؂邩AQUIT v󂯂܂ŁAvɏ. */
+	void Run() {
+		string line;
+		while (!mCtx.quit && mPipe.ReadLine(line)) {
+			vector<string> args;
+			for (size_t pos = 0; ; ) {
+				size_t tab = line.find('\t', pos);
+				args.push_back(line.substr(pos, tab == string::npos ? string::npos : tab - pos));
+				if (tab == string::npos)
+					break;
+				pos = tab + 1;
+			}
+			ServeReply reply;
+			mPool.Submit(new ServeRequestTask(mCtx, args, reply));
+			reply.done.Wait();
+			char head[40];
+			sprintf(head, "%s %u\n", reply.ok ? "OK" : "ERR", (uint) reply.body.size());
+			if (!mPipe.Write(head, strlen(head)) || !mPipe.Write(reply.body))
+				break;
+			if (mCtx.quit) {
+				// ҂󂯒̃CXbhAւ̐ڑŋN.
+				PipeStream wakeup;
+				wakeup.Connect(mCtx.pipename, 1000);
+				break;
+			}
+		}
+	}
+};
+
+/** IڑЕt. all Ȃ΁Ac̐ڑ̓ǂݏoł؂ďI҂.
+ * all  QUIT v󂯂ɌĂԂ. eXbh͎̗vǂޑOɏI.
+ */
+void ReapConnections(list<ServeConnection*>& conns, bool all)
+{
+	for (list<ServeConnection*>::iterator i = conns.begin(); i != conns.end(); ) {
+		ServeConnection* c = *i;
+		if (!all && !c->IsFinished()) {
+			++i;
+			continue;
+		}
+		// ł؂ɓǂݏon߂Ȃ̂ŁAXbhI܂ŌJԂ.
+		while (!c->IsFinished() && c->Shutdown()) {
+#ifdef _WIN32
+			::Sleep(10);
+#else
+			usleep(10000);
+#endif
+		}
+		c->Join();
+		delete c;
+		i = conns.erase(i);
+	}
+}
+
+/** ₢킹T[o[̃C֐.
+ * ڑɃXbhNAev̓Xbhv[ŕsɏ. QUIT v󂯂I.
+ */
+int ZipServe(const char* pipename)
+{
+	ServerContext ctx(pipename, gServeCacheSize);
+	PipeListener listener(pipename);
+	ThreadPool pool(gThreads);
+	list<ServeConnection*> conns;
+	fprintf(stderr, "zipdump: serving on %s with %d threads, cache %llu bytes\n",
+		listener.Name(), pool.Size(), (uint64) gServeCacheSize);
+	for (;;) {
+		PipeHandle h = listener.Accept();
+		if (h == INVALID_PIPE) {
+			print_win32error(listener.Name());
+			atomic_exchange(&ctx.quit, 1);
+			ReapConnections(conns, true);
+			return EXIT_FAILURE;
+		}
+		if (ctx.quit) {
+			PipeStream closing(h, true);
+			break;
+		}
+		ReapConnections(conns, false);
+		ServeConnection* c = new ServeConnection(ctx, pool, h);
+		if (!c->Start()) {
+			print_win32error("can't start thread");
+			delete c;
+			continue;
+		}
+		conns.push_back(c);
+	}
+	ReapConnections(conns, true);
+	pool.Wait();
+	return EXIT_SUCCESS;
+}
+
+/** ₢킹NCAg̃C֐.
+ *  TAB ؂1sɂđA{Wo͂ɏo.
+ */
+int ZipQuery(const char* pipename, int argc, char* argv[])
+{
+	PipeStream pipe;
+	if (!pipe.Connect(pipename)) {
+		print_win32error(pipename);
+		return EXIT_FAILURE;
+	}
+	string req;
+	for (int i = 0; i < argc; ++i) {
+		if (i) req += '\t';
+		req += argv[i];
+	}
+	req += '\n';
+	string head;
+	if (!pipe.Write(req) || !pipe.ReadLine(head)) {
+		fprintf(stderr, "%s: no response\n", pipename);
+		return EXIT_FAILURE;
+	}
+	bool ok = strncmp(head.c_str(), "OK ", 3) == 0;
+	if (!ok && strncmp(head.c_str(), "ERR ", 4) != 0) {
+		fprintf(stderr, "%s: bad response\n", pipename);
+		return EXIT_FAILURE;
+	}
+	vector<char> body(strtoul(head.c_str() + (ok ? 3 : 4), NULL, 10));
+	if (!body.empty() && !pipe.Read(&body[0], body.size())) {
+		fprintf(stderr, "%s: response is truncated\n", pipename);
+		return EXIT_FAILURE;
+	}
+	if (ok) {
+		if (!body.empty())
+			fwrite(&body[0], 1, body.size(), stdout);
+		return EXIT_SUCCESS;
+	}
+	fprintf(stderr, "%s: %.*s\n", pipename, (int) body.size(), body.empty() ? "" : &body[0]);
+	return EXIT_FAILURE;
+}
+//@}
+
+//........................................................................
+//!@name -u: XVp}jtFXg.
+//@{
+/** }jtFXg1Gg. ̓t@C̏ԂƁȀo̓t@CL^. */
+struct ManifestEntry {
+	uint64 size;		///< ̓t@C̃TCY.
+	__int64 mtime;		///< ̓t@C̍XV.
+	uint64 dirhash;		///< fBNg̃nbVl. 0 ͕s.
+	string outname;		///< o̓t@C.
+};
+
+/** ̓t@CL[Ƃ}jtFXg */
+typedef map<string, ManifestEntry> Manifest;
+
+/** Os̃}jtFXg. ̎sʂōXVAIɕۑ. */
+Manifest gManifest;
+
+/** gManifest ̋L^eAXLbvɎgĂ悢?
+ * _veɉeIvVOƈقȂ΁ASt@C_v.
+ */
+bool gManifestTrusted = false;
+
+/** }jtFXg̃t@C𓾂. */
+void MakeManifestName(char* fname)
+{
+	_makepath(fname, NULL, gOutDir, "zipdump", ".manifest");
+}
+
+/** _veɉeIvV𕶎񉻂. */
+string DumpOptionString()
+{
+	string s = "-";
+	if (gIsFullDump)			s += 'f';
+	if (gQuiet)					s += 'q';
+	if (gOmitSameHexDumpLine)	s += 'o';
+	if (gAnalyzeLayout)			s += 'a';
+	if (gCheck)					s += 'c';
+	if (gDigestManifest)		s += 'H';
+	if (gListKey) {
+		s += 'l';
+		s += (char) gListKey;
+	}
+	return s;
+}
+
+/** }jtFXgǂݍ. t@C΋̃}jtFXgƂ. */
+void LoadManifest()
+{
+	char fname[MY_MAX_PATH+100];
+	MakeManifestName(fname);
+	FILE* fp = fopen(fname, "r");
+	if (fp == NULL)
+		return;
+
+	char line[MY_MAX_PATH*3 + 200];
+	if (fgets(line, sizeof(line), fp)) {
+		char opt[100];
+		gManifestTrusted = sscanf(line, "#zipdump-manifest 1 %99s", opt) == 1
+			&& DumpOptionString() == opt;
+	}
+	// "size<TAB>mtime<TAB>dirhash<TAB>outname<TAB>inputname" `̍sǂݍ.
+	while (fgets(line, sizeof(line), fp)) {
+		char* p = strchr(line, '\n');
+		if (p) *p = '\0';
+		ManifestEntry e;
+		if (sscanf(line, "%llu\t%lld\t%llX\t", &e.size, &e.mtime, &e.dirhash) != 3)
+			continue;
+		char* outname = strchr(line, '\t');
+		if (outname) outname = strchr(outname+1, '\t');
+		if (outname) outname = strchr(outname+1, '\t');
+		char* inname = outname ? strchr(outname+1, '\t') : NULL;
+		if (!inname)
+			continue;
+		*inname++ = '\0';
+		e.outname = outname+1;
+		gManifest[inname] = e;
+	}
+	fclose(fp);
+}
+
+/** }jtFXgۑ.
+ * ݓrŒfĂÕ}jtFXgȂ悤ɁAꎞt@CɏĂu.
+ */
+void SaveManifest()
+{
+	char fname[MY_MAX_PATH+100];
+	char tmpname[MY_MAX_PATH+100];
+	MakeManifestName(fname);
+	strcpy(tmpname, fname);
+	strcat(tmpname, ".tmp");
+	FILE* fp = fopen(tmpname, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "can't open output file: %s\n", tmpname);
+		exit(EXIT_FAILURE);
+	}
+	fprintf(fp, "#zipdump-manifest 1 %s\n", DumpOptionString().c_str());
+	for (Manifest::const_iterator i = gManifest.begin(); i != gManifest.end(); ++i) {
+		const ManifestEntry& e = i->second;
+		fprintf(fp, "%llu\t%lld\t%016llX\t%s\t%s\n",
+			e.size, e.mtime, e.dirhash, e.outname.c_str(), i->first.c_str());
+	}
+	if (fclose(fp) != 0) {
+		print_win32error(tmpname);
+		exit(EXIT_FAILURE);
+	}
+	remove(fname);
+	if (rename(tmpname, fname) != 0) {
+		print_win32error(fname);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/** ̓t@CGgɂāȀo̓t@C폜A}jtFXg. */
+void RemoveStaleOutputs()
+{
+	Manifest::iterator i = gManifest.begin();
+	while (i != gManifest.end()) {
+		struct __stat64 st;
+		if (_stat64(i->first.c_str(), &st) == 0) {
+			++i;
+			continue;
+		}
+		if (remove(i->second.outname.c_str()) == 0)
+			printf("remove stale output: %s\n", i->second.outname.c_str());
+		gManifest.erase(i++);
+	}
+}
+
+/** ̓t@C͑Õ_vȌɕύXĂȂ?
+ * TCYƍXVvΖύXƂ. XVقȂꍇ(Rs[touchz)A
+ * fBNg̃nbVlvΖύXƂ.
+ * @param fin		̓t@C.
+ * @param fname		̓t@C.
+ * @param outname	o̓t@C.
+ * @param cur		̓t@Č݂̏Ԃ̊i[.
+ */
+bool IsUnchanged(FILE* fin, const char* fname, const char* outname, ManifestEntry& cur)
+{
+	struct __stat64 st;
+	_fstat64(_fileno(fin), &st);
+	cur.size = st.st_size;
+	cur.mtime = st.st_mtime;
+	cur.dirhash = 0;
+	cur.outname = outname;
+
+	Manifest::const_iterator i = gManifest.find(fname);
+	bool known = gManifestTrusted && i != gManifest.end()
+		&& i->second.size == cur.size && i->second.outname == cur.outname
+		&& _access(outname, 0) == 0;
+	if (known && i->second.mtime == cur.mtime) {
+		cur.dirhash = i->second.dirhash;
+		return true;
+	}
+	if (!HashCentralDirectory(fin, cur.dirhash))
+		cur.dirhash = 0;
+	_fseeki64(fin, 0, SEEK_SET);
+	return known && cur.dirhash != 0 && i->second.dirhash == cur.dirhash;
+}
+//@}
+
+//........................................................................
+// ZIPt@C_ṽC֐.
+/** fnameǂݍ݁ARgƗ]ȋ󔒂Afname+".zipdump"ɏo͂. */
+void DumpMain(const char* fname)
+{
+	FILE* fin = OpenInput(fname);
+	if (fin == NULL)
+		return;
+	FILE* fout;
+	if (gExtractDir) {
+		ZipExtractFile(fin, fname);
+		fclose(fin);
+		return;
+	}
+	if (gRepackFile) {
+		ZipRepackFile(fin, fname);
+		fclose(fin);
+		return;
+	}
+	if (gUpdateOnly) {
+		char outname[MY_MAX_PATH+100];
+		MakeOutputName(outname, fname, OutputExt());
+		ManifestEntry cur;
+		bool unchanged = IsUnchanged(fin, fname, outname, cur);
+		gManifest[fname] = cur;
+		if (unchanged) {
+			fclose(fin);
+			return;
+		}
+	}
+	if (gIsStdout) {
+		fout = stdout;
+		printf("<<< %s >>> begin.\n", fname);
+	}
+	else {
+		fout = OpenOutput(fname, OutputExt());
+		if (fout == NULL) {
+			fclose(fin);
+			return;
+		}
+	}
+	fprintf(fout, "*** zipdump of \"%s\" ***\n", fname);
+
+	if (gAnalyzeLayout) {
+		if (ZipLayoutFile(fin, fout))
+			++gSuspiciousFiles;
+	}
+	else if (gCheck) {
+		if (ZipCheckFile(fin, fout))
+			++gSuspiciousFiles;
+	}
+	else if (gDigestManifest) {
+		if (ZipManifestFile(fin, fname, fout))
+			++gSuspiciousFiles;
+	}
+	else if (gListKey)
+		ZipListFile(fin, fout);
+	else
+		ZipDumpFile(fin, fout);
+
+	if (ferror(fin)) {
+		gDiag.SysError("read error", fname);
+	}
+	fclose(fin);
+	if (gIsStdout) {
+		printf("<<< %s >>> end.\n\n", fname);
+	}
+	else {
+		fclose(fout);
+	}
+}
+
+/** ChJ[hWJƍċATt DumpMain.
+ * tH_؂̒T͕sɍsAt@C̓pXɈ_v.
+ */
+void DumpWildMain(const char* fname)
+{
+	if (strpbrk(fname, "*?") == NULL) {
+		//----- ChJ[h܂܂ȂpX̏
+		DumpMain(fname);
+	}
+	else {
+		//----- ChJ[h܂ރpX̏
+		size_t pos = pathname_name_pos(fname);
+		string dir(fname, pos);
+		const char* wild = fname + pos;
+
+		WalkOptions opt;
+		opt.recursive = gIsRecursive;
+		opt.need_stat = false;	// ƃTCY͎gȂ.
+		opt.threads = gThreads;
+		WalkList list;
+		DirWalker(list, opt).Walk(dir.c_str(), wild);
+		list.Sort();
+		PathBuf path;
+		for (size_t i = 0; i < list.entries.size(); ++i) {
+			list.MakePath(list.entries[i], path);
+			DumpMain(path.c_str());
 		}
 	}
 }
 
 //------------------------------------------------------------------------
+/** MB Pʂ̑傫ǂŁAoCgԂ. 0  size_t Ɏ܂Ȃl͎sƂ. */
+bool parse_megabytes(const char* s, size_t& bytes)
+{
+	unsigned long mb;
+	if (!parse_uint(s, 1, (unsigned long) -1, mb) || mb > ((size_t) -1 >> 20))
+		return false;
+	bytes = (size_t) mb << 20;
+	return true;
+}
+
 /** C֐ */
 int main(int argc, char* argv[])
 {
 	//--- R}hC̃IvV͂.
+	unsigned long n;	// l̈.
 	while (argc > 1 && argv[1][0]=='-') {
 		char* sw = &argv[1][1];
 		if (strcmp(sw, "help") == 0)
 			goto show_help;
+		else if (strcmp(sw, "-extract") == 0) {
+			if (argc < 3)
+				error_abort("--extract needs DIR.\n");
+			gExtractDir = argv[2]; ++argv; --argc;
+		}
+		else if (strcmp(sw, "-repack") == 0) {
+			if (argc < 3)
+				error_abort("--repack needs OUT.zip.\n");
+			gRepackFile = argv[2]; ++argv; --argc;
+		}
+		else if (strcmp(sw, "-check") == 0) {
+			gCheck = true;
+		}
+		else if (strcmp(sw, "-manifest") == 0) {
+			gDigestManifest = true;
+		}
+		else if (strcmp(sw, "-serve") == 0) {
+			if (argc < 3)
+				error_abort("--serve needs NAME.\n");
+			gServePipe = argv[2]; ++argv; --argc;
+		}
+		else if (strcmp(sw, "-cache") == 0) {
+			if (argc < 3 || !parse_megabytes(argv[2], gServeCacheSize))
+				error_abort("--cache needs memory budget in MB.\n");
+			++argv; --argc;
+		}
+		else if (strcmp(sw, "-query") == 0) {
+			if (argc < 4)
+				error_abort("--query needs NAME and request.\n");
+			return ZipQuery(argv[2], argc - 3, argv + 3);
+		}
+		else if (strcmp(sw, "-align") == 0) {
+			if (argc < 3 || !parse_uint(argv[2], 1, 0x8000, n))
+				error_abort("--align needs N(1..32768).\n");
+			gRepackAlign = (unsigned) n;
+			++argv; --argc;
+		}
 		else {
 			do {
 				switch (*sw) {
@@ -1728,6 +3908,27 @@ show_help:			error_abort(gUsage2);
 				case 'r':
 					gIsRecursive = true;
 					break;
+				case 'u':
+					gUpdateOnly = true;
+					break;
+				case 'a':
+					gAnalyzeLayout = true;
+					break;
+				case 'l':
+					gListKey = sw[1];	// -l<KEY>
+					if (gListKey == 0 || strchr("nso", gListKey) == NULL)
+						error_abort("-l needs KEY(n:name, s:size, o:offset).\n");
+					++sw;
+					break;
+				case 'm':
+					if (!parse_megabytes(sw+1, gSortMemLimit))	// -m<MB>
+						error_abort("-m needs memory limit in MB.\n");
+					goto next_arg;
+				case 'j':
+					if (!parse_uint(sw+1, 1, MAX_THREADS, n))	// -j<N>
+						error_abort("-j needs N(1..1024).\n");
+					gThreads = (int) n;
+					goto next_arg;
 				case 'd':
 					gOutDir = sw+1;		// -d<DIR>
 					if (!*gOutDir) {	// -d <DIR>
@@ -1744,18 +3945,41 @@ next_arg:
 		++argv;
 		--argc;
 	}
+	if (gServePipe) {
+		if (argc != 1)
+			error_abort("--serve takes no input file.\n");
+		return ZipServe(gServePipe);
+	}
 	if (argc == 1) {
 		error_abort("please specify input file.\n");
 	}
 
+	if (gRepackFile && (argc != 2 || strpbrk(argv[1], "*?")))
+		error_abort("--repack needs just one input file.\n");
+
 	//--- t\̂߂ɃJgJ[ݒ肷.
 	setlocale(LC_TIME, "");
 
+	//--- XVȂ΁AÕ}jtFXgǂݍ.
+	if (gUpdateOnly) {
+		if (!gOutDir || gIsStdout)
+			error_abort("-u needs -d<DIR>, and can't use with -s.\n");
+		LoadManifest();
+	}
+
 	//--- R}hC̊e̓t@C.
 	for (int i = 1; i < argc; i++)
 		DumpWildMain(argv[i]);
 
-	return EXIT_SUCCESS;
+	//--- XVȂ΁A̓t@C̏o͂폜A}jtFXgۑ.
+	if (gUpdateOnly) {
+		RemoveStaleOutputs();
+		SaveManifest();
+	}
+
+	//--- łȂt@C΁Ǎޖɕ\.
+	gDiag.Summary("zipdump");
+	return (gSuspiciousFiles || gDiag.Count(DIAG_ERROR)) ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 //------------------------------------------------------------------------
 /**@page zipdump-manual zipdump.exe - dump zip file structure
@@ -1777,6 +4001,28 @@ next_arg:
 @section func 
 	- PKZIP APPNOTE.TXT Version 6.3.2[September 28, 2007] ̃t@CtH[}bgdlɊÂA\Pʂł̃_vs܂B
 	- ΏZIPt@C ".zipdump" tÕeLXgt@C𐶐A_vʂo͂܂B
+	- -u IvVŁAO񂩂ύXꂽZIPt@C_v܂B
+	  o̓tH_ zipdump.manifest ɁAe̓t@C̃TCYAXVAfBNg̃nbVlL^܂B
+	- -l IvVŁAfBNg̃Ggꗗ𖼑OATCYAItZbgɃ\[gďo͂܂B
+	  gpʂ -m Ŏw肵ɗ}Aߕ͈ꎞt@CgO\[gŏ܂B
+	- -a IvVŁAeR[h̔zu͂AԁAGgԂ̏dȂ(dQƌ^zip bomb)A
+	  local headeȓdQƁAُȈk񍐂܂Bf[^̓WJ͍sȂ̂ŁAGgɔႵԂōς݂܂B
+	- --check IvVŁAfBNg̊eGgƁAꂪw local header ̖OAkACRCATCYƍ܂B
+	  ǂ炩ɂR[h񍐂܂Bt@Cx邾Ȃ̂ŁAGgɔႵԂōς݂܂B
+	- --repack IvVŁAkf[^ĈkɃRs[ZIPt@Cč\܂B
+	  ǂ̃GgQƂȂ̈菜AkGg̃f[^ʒu --align Ŏw肵Eɐ񂵂܂B
+	- --manifest IvVŁAeGg̓WJeSHA-256l𖼑Oɕׂꗗo͂܂B
+	  sha256sum Ɠ`Ȃ̂ŁAWJt@C sha256sum -c Ōł܂B
+	  vZ͕XbhŕsɍsAWJf[^͏oɃnbV̂ŁA傫ȃGgł܂B
+	  CPUSHAg߂Ă΁Ag܂(VC++2015ȍ~Ńrhꍇ).
+	- --extract IvVŁASGg𕡐XbhŕɓWJ܂(kdeflateɑΉ)B
+	  XV NTFS extra fieldAExtended TimestampADOS̏ɍ̗pĕ܂B
+	- --serve IvVŁAOtpCvŖ₢킹󂯕tT[o[Ƃď풓܂B
+	  ͍ς݂̒fBNg --cache Ŏw肵܂LRULbVɕێA̓t@C̍XVTCYςΉ͂܂B
+	  Ggꗗ(LIST)AGg(STAT)Aw͈͂̃oCg_v(HEX)ɁANƍĉ͂̃RXgŉ܂B
+	  --query IvVŁAst@C₢킹𑗂܂B
+	- JȂt@Cǂ߂ȂtH_ĂA񍐂Ďc̏𑱂܂B
+	  ŌɃG[ƌx̌ޖɕ\AG[ΏIR[h1Ƃ܂B
 
 @section env 
 	Windows2000ȍ~𓮍ΏۂƂĂ܂B